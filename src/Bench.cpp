@@ -0,0 +1,517 @@
+/*
+* Copyright 2023 Au Yeong Wing Yau
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+/**
+ * \file Bench.cpp
+ * Benchmark driver for the WY_Serialize library. Saves and loads synthetic populations of WY_SerializeObj objects through WY_SerializeMgr and WY_SerializeAgent, and prints one JSON object per measurement so results can be compared between builds. <br>
+ * Usage: Bench [-d dir] [-m MB] [-r reps] [-t threads] [-a align] [-p tiny|huge|mixed] [-b default|fstream|posix|uring|direct] [-c] [-k] [-s] [-i] [-x] [-A] [-D none|data|full]
+*/
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "WY_SerializeMgr.hpp"
+#include "WY_SerializeAgent.hpp"
+#include "WY_SerializeCodec.hpp"
+#include "WY_SerializeStats.hpp"
+
+using namespace WY_Serialize;
+
+static std::atomic<uint64_t> g_alloc_count(0); /**< Number of calls to operator new since the program started. */
+static std::atomic<uint64_t> g_alloc_bytes(0); /**< Bytes requested from operator new since the program started. */
+
+/* Every heap allocation of the library and the standard containers goes through these, so they are counted here. */
+void * operator new(std::size_t p_size)
+{
+    g_alloc_count.fetch_add(1, std::memory_order_relaxed);
+    g_alloc_bytes.fetch_add(p_size, std::memory_order_relaxed);
+    void * ptr = std::malloc(p_size ? p_size : 1);
+    if(ptr == NULL)
+        throw std::bad_alloc();
+    return ptr;
+}
+
+void * operator new[](std::size_t p_size)
+{
+    return operator new(p_size);
+}
+
+void * operator new(std::size_t p_size, const std::nothrow_t &) noexcept
+{
+    g_alloc_count.fetch_add(1, std::memory_order_relaxed);
+    g_alloc_bytes.fetch_add(p_size, std::memory_order_relaxed);
+    return std::malloc(p_size ? p_size : 1);
+}
+
+void * operator new[](std::size_t p_size, const std::nothrow_t &p_tag) noexcept
+{
+    return operator new(p_size, p_tag);
+}
+
+void operator delete(void * p_ptr) noexcept
+{
+    std::free(p_ptr);
+}
+
+void operator delete[](void * p_ptr) noexcept
+{
+    std::free(p_ptr);
+}
+
+void operator delete(void * p_ptr, std::size_t) noexcept
+{
+    std::free(p_ptr);
+}
+
+void operator delete[](void * p_ptr, std::size_t) noexcept
+{
+    std::free(p_ptr);
+}
+
+
+/**
+ * Object saved and loaded by the benchmark. Holds one block of synthetic data.
+*/
+class BenchObj: public WY_SerializeObj
+{
+public:
+    /**
+     * Virtual function to provide the object's data for saving.
+     * \param p_data Returns the data of the object, which stays valid until the object changes.
+     * \return 0 if successful.
+    */
+    int get_save_data(S_SerializeData *__restrict__ const p_data) noexcept override
+    {
+        p_data->m_type = BENCH_OBJ;
+        p_data->m_size = m_data.size();
+        p_data->m_data = m_data.data();
+        return 0;
+    }
+
+    /**
+     * Virtual function to copy loaded data into the object. The copy reuses the object's memory when the size is unchanged, so loads do not count allocations of the benchmark itself.
+     * \param p_size Size of the loaded data.
+     * \param p_data The loaded data.
+     * \return 0 if successful, -1 if the data could not be stored.
+    */
+    int get_load_data(const uint64_t p_size, const unsigned char *__restrict__ const p_data) noexcept override
+    {
+        if(p_size != m_data.size()) {
+            try {
+                m_data.resize(p_size);
+            } catch (std::exception &e) {
+                return -1;
+            }
+        }
+        if(p_size > 0)
+            memcpy(m_data.data(), p_data, p_size);
+        return 0;
+    }
+
+    /**
+     * The data is not changed while the benchmark saves it.
+     * \return True.
+    */
+    bool is_save_data_stable() noexcept override {return true;};
+
+    std::vector<unsigned char> m_data; /**< The block data. */
+};
+
+
+/**
+ * Options given on the command line.
+*/
+struct S_BenchOptions {
+    std::string m_dir; /**< Directory the benchmark files are written to. */
+    uint64_t m_total_size; /**< Approximate payload size of every population in bytes. */
+    unsigned int m_reps; /**< Repetitions of every measurement. The median is reported. */
+    unsigned int m_threads; /**< Threads used by WY_SerializeMgr. */
+    unsigned int m_alignment; /**< Alignment of block data in saved files. */
+    std::string m_population; /**< Only this population is run if not empty. */
+    IO_BACKEND m_io_backend; /**< I/O backend of every save and load. */
+    std::string m_io_name; /**< Name of m_io_backend. */
+    bool m_codec; /**< Whether blocks are compressed with WY_LZCodec. */
+    bool m_crc; /**< Whether blocks are saved with a CRC32C. */
+    bool m_stats; /**< Whether WY_SerializeStats counts while measuring. */
+    bool m_keyed; /**< Whether objects are added to WY_SerializeMgr with a type and instance. */
+    bool m_compact; /**< Whether blocks are saved with compact headers. */
+    bool m_atomic; /**< Whether saves replace the file atomically. */
+    SAVE_DURABILITY m_durability; /**< How far saves are flushed to storage. */
+    std::string m_durability_name; /**< Name of m_durability. */
+};
+
+
+/**
+ * Result of one measurement.
+*/
+struct S_BenchResult {
+    double m_seconds; /**< Median time of one repetition. */
+    double m_min_seconds; /**< Fastest repetition. */
+    uint64_t m_allocs; /**< Calls to operator new during the last repetition. */
+    uint64_t m_alloc_bytes; /**< Bytes requested from operator new during the last repetition. */
+    uint64_t m_peak_rss_kb; /**< Peak resident set size of the process during the measurement. */
+};
+
+
+/**
+ * Fills a buffer with data that WY_LZCodec compresses to roughly a third, like typical structured data. Part of the bytes are random and the rest repeat earlier bytes.
+ * \param p_data The buffer.
+ * \param p_size Size of the buffer.
+ * \param p_seed Seed of the generator, updated on return.
+*/
+static void fill_data(unsigned char *__restrict__ const p_data, const uint64_t p_size, uint64_t *__restrict__ const p_seed) noexcept
+{
+    uint64_t x = *p_seed;
+    uint64_t i = 0;
+
+    while(i < p_size) {
+        x ^= x << 13; x ^= x >> 7; x ^= x << 17; /* xorshift64 */
+        if((i >= 256) && ((x & 3) != 0)) {
+            uint64_t len = std::min<uint64_t>(4 + ((x >> 8) & 31), p_size - i);
+            uint64_t from = i - 1 - ((x >> 16) & 255);
+            for(uint64_t j=0; j<len; j++)
+                p_data[i+j] = p_data[from+j];
+            i += len;
+        } else
+            p_data[i++] = (unsigned char)(x >> 24);
+    }
+    *p_seed = x;
+}
+
+
+/**
+ * Creates the objects of a population.
+ * \param p_name "tiny" for 64 byte blocks, "huge" for 16 MB blocks, or "mixed" for sizes spread evenly on a log scale from 16 bytes to 1 MB.
+ * \param p_total_size Approximate total payload size.
+ * \param p_objs Returns the objects.
+*/
+static void make_population(const std::string &p_name, const uint64_t p_total_size, std::vector<BenchObj> *__restrict__ const p_objs)
+{
+    uint64_t seed = 0x9E3779B97F4A7C15ULL;
+    uint64_t total = 0;
+
+    p_objs->clear();
+    while(total < p_total_size) {
+        uint64_t size;
+        if(p_name == "tiny")
+            size = 64;
+        else if(p_name == "huge")
+            size = std::min<uint64_t>(16*1024*1024, p_total_size);
+        else {
+            seed ^= seed << 13; seed ^= seed >> 7; seed ^= seed << 17;
+            size = (uint64_t)(16.0 * std::pow(65536.0, (double)(seed >> 11) / 9007199254740992.0)); /* 16 bytes to 1 MB */
+        }
+        p_objs->emplace_back();
+        p_objs->back().m_data.resize(size);
+        fill_data(p_objs->back().m_data.data(), size, &seed);
+        total += size;
+    }
+}
+
+
+/**
+ * Resets the peak resident set size of the process, so the next read_peak_rss() reports the peak from now on. Has no effect on kernels without /proc/self/clear_refs.
+*/
+static void reset_peak_rss() noexcept
+{
+    FILE * file = fopen("/proc/self/clear_refs", "w");
+    if(file == NULL)
+        return;
+    fputs("5", file);
+    fclose(file);
+}
+
+
+/**
+ * Reads the peak resident set size of the process.
+ * \return Peak resident set size in KB, 0 if it cannot be read.
+*/
+static uint64_t read_peak_rss() noexcept
+{
+    FILE * file = fopen("/proc/self/status", "r");
+    char line[256];
+    unsigned long long kb = 0;
+
+    if(file == NULL)
+        return 0;
+    while(fgets(line, sizeof(line), file) != NULL) {
+        if(sscanf(line, "VmHWM: %llu", &kb) == 1)
+            break;
+    }
+    fclose(file);
+    return kb;
+}
+
+
+/**
+ * Gets the size of a file.
+ * \param p_file Name of the file.
+ * \return Size of the file, 0 if it does not exist.
+*/
+static uint64_t get_file_size(const std::string &p_file) noexcept
+{
+    struct stat st;
+    return (stat(p_file.c_str(), &st) == 0) ? st.st_size : 0;
+}
+
+
+/**
+ * Runs a measurement p_opts.m_reps times.
+ * \param p_opts The options.
+ * \param p_run Performs one repetition.
+ * \return The result.
+ * \throw -1 integer exception if p_run throws.
+*/
+template <typename T>
+static S_BenchResult measure(const S_BenchOptions &p_opts, T p_run)
+{
+    S_BenchResult result;
+    std::vector<double> times;
+    uint64_t allocs = 0, alloc_bytes = 0;
+
+    reset_peak_rss();
+    for(unsigned int r=0; r<p_opts.m_reps; r++) {
+        allocs = g_alloc_count.load();
+        alloc_bytes = g_alloc_bytes.load();
+        auto start = std::chrono::steady_clock::now();
+        p_run();
+        times.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        allocs = g_alloc_count.load() - allocs;
+        alloc_bytes = g_alloc_bytes.load() - alloc_bytes;
+    }
+    std::sort(times.begin(), times.end());
+    result.m_seconds = times[times.size()/2];
+    result.m_min_seconds = times[0];
+    result.m_allocs = allocs;
+    result.m_alloc_bytes = alloc_bytes;
+    result.m_peak_rss_kb = read_peak_rss();
+    return result;
+}
+
+
+/**
+ * Prints a result as one line of JSON.
+ * \param p_opts The options.
+ * \param p_bench Name of the measurement.
+ * \param p_population Name of the population.
+ * \param p_mode Name of the save or load mode.
+ * \param p_blocks Number of blocks saved or loaded per repetition.
+ * \param p_bytes Payload bytes saved or loaded per repetition.
+ * \param p_file_bytes Size of the save file.
+ * \param p_result The result.
+*/
+static void print_result(const S_BenchOptions &p_opts, const char *p_bench, const std::string &p_population, const char *p_mode, const uint64_t p_blocks, const uint64_t p_bytes, const uint64_t p_file_bytes, const S_BenchResult &p_result) noexcept
+{
+    printf("{\"bench\":\"%s\",\"population\":\"%s\",\"mode\":\"%s\",\"threads\":%u,\"alignment\":%u,\"codec\":%s,\"crc\":%s,\"stats\":%s,\"keyed\":%s,\"compact\":%s,\"atomic\":%s,\"durability\":\"%s\",\"io\":\"%s\","
+        "\"blocks\":%llu,\"bytes\":%llu,\"file_bytes\":%llu,\"seconds\":%.6f,\"min_seconds\":%.6f,"
+        "\"mb_per_s\":%.1f,\"ops_per_s\":%.0f,\"allocs\":%llu,\"alloc_bytes\":%llu,\"peak_rss_kb\":%llu}\n",
+        p_bench, p_population.c_str(), p_mode, p_opts.m_threads, p_opts.m_alignment, p_opts.m_codec ? "true" : "false", p_opts.m_crc ? "true" : "false", p_opts.m_stats ? "true" : "false", p_opts.m_keyed ? "true" : "false", p_opts.m_compact ? "true" : "false", p_opts.m_atomic ? "true" : "false", p_opts.m_durability_name.c_str(), p_opts.m_io_name.c_str(),
+        (unsigned long long)p_blocks, (unsigned long long)p_bytes, (unsigned long long)p_file_bytes, p_result.m_seconds, p_result.m_min_seconds,
+        p_bytes / p_result.m_seconds / 1e6, p_blocks / p_result.m_seconds,
+        (unsigned long long)p_result.m_allocs, (unsigned long long)p_result.m_alloc_bytes, (unsigned long long)p_result.m_peak_rss_kb);
+    fflush(stdout);
+}
+
+
+/**
+ * Runs all measurements on one population.
+ * \param p_opts The options.
+ * \param p_population Name of the population, see make_population().
+ * \throw -1 integer exception if a save or load fails.
+*/
+static void run_population(const S_BenchOptions &p_opts, const std::string &p_population)
+{
+    static const SAVE_MODE save_modes[] = {SAVE_STREAM, SAVE_VECTORED};
+    static const char * save_names[] = {"stream", "vectored"};
+    static const LOAD_MODE load_modes[] = {LOAD_BUFFERED, LOAD_MMAP, LOAD_STREAM};
+    static const char * load_names[] = {"buffered", "mmap", "stream"};
+    const std::string file = p_opts.m_dir + "/wy_bench.sav";
+    std::vector<BenchObj> objs;
+    uint64_t bytes = 0;
+    WY_LZCodec codec;
+
+    make_population(p_population, p_opts.m_total_size, &objs);
+    for(const BenchObj &obj : objs)
+        bytes += obj.m_data.size();
+
+    WY_SerializeMgr mgr(objs.size());
+    for(uint32_t i=0; i<objs.size(); i++) {
+        if(p_opts.m_keyed)
+            mgr.add_serialize_obj(&objs[i], BENCH_OBJ, i+1);
+        else
+            mgr.add_serialize_obj(&objs[i]);
+    }
+    mgr.set_thread_count(p_opts.m_threads);
+    mgr.set_codec(p_opts.m_codec ? &codec : NULL);
+    mgr.set_save_crc(p_opts.m_crc);
+    mgr.set_save_compact(p_opts.m_compact);
+    mgr.set_save_atomic(p_opts.m_atomic);
+    mgr.set_save_durability(p_opts.m_durability);
+    mgr.set_save_alignment(p_opts.m_alignment);
+    mgr.set_io_backend(p_opts.m_io_backend);
+
+    for(unsigned int m=0; m<2; m++) {
+        mgr.set_save_mode(save_modes[m]);
+        S_BenchResult result = measure(p_opts, [&] { mgr.save_all_objs(file.c_str()); });
+        print_result(p_opts, "mgr_save", p_population, save_names[m], objs.size(), bytes, get_file_size(file), result);
+    }
+    for(unsigned int m=0; m<3; m++) {
+        mgr.set_load_mode(load_modes[m]);
+        S_BenchResult result = measure(p_opts, [&] { mgr.load_all_objs(file.c_str()); });
+        print_result(p_opts, "mgr_load", p_population, load_names[m], objs.size(), bytes, get_file_size(file), result);
+    }
+
+    for(unsigned int m=0; m<2; m++) {
+        S_BenchResult result = measure(p_opts, [&] {
+            WY_SerializeAgent agent;
+            S_SerializeData data;
+            agent.set_file_name(file.c_str());
+            agent.set_save_mode(save_modes[m]);
+            agent.set_io_backend(p_opts.m_io_backend);
+            agent.set_codec(p_opts.m_codec ? &codec : NULL);
+            agent.set_save_crc(p_opts.m_crc);
+            agent.set_save_compact(p_opts.m_compact);
+            agent.set_save_atomic(p_opts.m_atomic);
+            agent.set_save_durability(p_opts.m_durability);
+            agent.set_save_alignment(p_opts.m_alignment);
+            agent.prepare_save_file();
+            for(BenchObj &obj : objs) {
+                init_serializable_data(&data);
+                obj.get_save_data(&data);
+                agent.append_save_file(&data);
+            }
+            agent.finalise_save_file();
+        });
+        print_result(p_opts, "agent_save", p_population, save_names[m], objs.size(), bytes, get_file_size(file), result);
+    }
+    for(unsigned int m=0; m<3; m++) {
+        S_BenchResult result = measure(p_opts, [&] {
+            WY_SerializeAgent agent;
+            S_SerializeView view;
+            size_t count = 0;
+            agent.set_file_name(file.c_str());
+            agent.set_load_mode(load_modes[m]);
+            agent.set_io_backend(p_opts.m_io_backend);
+            agent.load_from_file();
+            while((count < objs.size()) && (agent.load_next_serializable_view(&view) == 0)) { /* Copied out like WY_SerializeMgr does, so every mode reads the data. */
+                if(objs[count].get_load_data(view.m_size, view.m_data) != 0)
+                    break;
+                ++count;
+            }
+            agent.clear_loaded_file_buffer();
+            if(count != objs.size())
+                throw -1;
+        });
+        print_result(p_opts, "agent_load", p_population, load_names[m], objs.size(), bytes, get_file_size(file), result);
+    }
+
+    unlink(file.c_str());
+}
+
+
+int main(int argc, char * argv[])
+{
+    S_BenchOptions opts;
+    int opt;
+
+    opts.m_dir = ".";
+    opts.m_total_size = 64*1024*1024;
+    opts.m_reps = 5;
+    opts.m_threads = 1;
+    opts.m_alignment = 1;
+    opts.m_codec = false;
+    opts.m_crc = false;
+    opts.m_stats = false;
+    opts.m_keyed = false;
+    opts.m_compact = false;
+    opts.m_atomic = false;
+    opts.m_durability = SAVE_DURABILITY_NONE;
+    opts.m_durability_name = "none";
+    opts.m_io_backend = IO_BACKEND_DEFAULT;
+    opts.m_io_name = "default";
+    while((opt = getopt(argc, argv, "d:m:r:t:a:p:b:cksixAD:")) != -1) {
+        switch(opt) {
+        case 'd': opts.m_dir = optarg; break;
+        case 'm': opts.m_total_size = strtoull(optarg, NULL, 10) * 1024 * 1024; break;
+        case 'r': opts.m_reps = std::max(1, atoi(optarg)); break;
+        case 't': opts.m_threads = std::max(1, atoi(optarg)); break;
+        case 'a': opts.m_alignment = std::max(1, atoi(optarg)); break;
+        case 'p': opts.m_population = optarg; break;
+        case 'b':
+            opts.m_io_name = optarg;
+            if(opts.m_io_name == "default")
+                opts.m_io_backend = IO_BACKEND_DEFAULT;
+            else if(opts.m_io_name == "fstream")
+                opts.m_io_backend = IO_BACKEND_FSTREAM;
+            else if(opts.m_io_name == "posix")
+                opts.m_io_backend = IO_BACKEND_POSIX;
+            else if(opts.m_io_name == "uring")
+                opts.m_io_backend = IO_BACKEND_URING;
+            else if(opts.m_io_name == "direct")
+                opts.m_io_backend = IO_BACKEND_URING_DIRECT;
+            else {
+                fprintf(stderr, "Unknown I/O backend %s.\n", optarg);
+                return -1;
+            }
+            break;
+        case 'c': opts.m_codec = true; break;
+        case 'k': opts.m_crc = true; break;
+        case 's': opts.m_stats = true; break;
+        case 'i': opts.m_keyed = true; break;
+        case 'x': opts.m_compact = true; break;
+        case 'A': opts.m_atomic = true; break;
+        case 'D':
+            opts.m_durability_name = optarg;
+            if(opts.m_durability_name == "none")
+                opts.m_durability = SAVE_DURABILITY_NONE;
+            else if(opts.m_durability_name == "data")
+                opts.m_durability = SAVE_DURABILITY_DATA;
+            else if(opts.m_durability_name == "full")
+                opts.m_durability = SAVE_DURABILITY_FULL;
+            else {
+                fprintf(stderr, "Unknown durability %s.\n", optarg);
+                return -1;
+            }
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-d dir] [-m MB] [-r reps] [-t threads] [-a align] [-p tiny|huge|mixed] [-b default|fstream|posix|uring|direct] [-c] [-k] [-s] [-i] [-x] [-A] [-D none|data|full]\n", argv[0]);
+            return -1;
+        }
+    }
+
+    WY_SerializeStats::set_stats(opts.m_stats);
+    try {
+        for(const char * population : {"tiny", "huge", "mixed"}) {
+            if(opts.m_population.empty() || (opts.m_population == population))
+                run_population(opts, population);
+        }
+    } catch (int &e) {
+        fprintf(stderr, "Benchmark failed.\n");
+        return -1;
+    } catch (std::exception &e) {
+        fprintf(stderr, "Benchmark failed.\n");
+        return -1;
+    }
+    return 0;
+}
@@ -22,7 +22,9 @@
 #include <cstring>
 #include "DemoObj1.hpp"
 #include "DemoObj2.hpp"
+#include "DemoObj3.hpp"
 #include "WY_SerializeMgr.hpp"
+#include "WY_StaticSerializeMgr.hpp"
 #include "WY_DebugIO.hpp"
 
 using namespace WY_Serialize;
@@ -41,15 +43,24 @@ int main(int argc, char * argv[])
         return -1;
     }
     obj2.check_data();
+    DemoObj3 obj3; /* Same data as DemoObj1, with save and load generated by WY_SerializePod. */
+    obj3.check_data();
 
     try {
         WY_SerializeMgr mgr; /*Create the serialize mgr.*/
         mgr.add_serialize_obj(&obj1); /* Add objects that need to be serialized to WY_SerializeMgr. */
         mgr.add_serialize_obj(&obj2);
+        mgr.add_serialize_obj(&obj3);
         mgr.save_all_objs("savefile"); /* Save all objects to file. */
         mgr.load_all_objs("savefile"); /* Now load all data from file back into the objects. */
         obj1.check_data();
         obj2.check_data();
+        obj3.check_data();
+
+        WY_StaticSerializeMgr<DemoObj1, DemoObj2, DemoObj3> static_mgr(obj1, obj2, obj3); /* Same objects, known at compile time. */
+        static_mgr.load_all_objs("savefile"); /* Files are the same as the ones written by WY_SerializeMgr. */
+        static_mgr.save_all_objs("savefile");
+        obj3.check_data();
     } catch (int &e) {
         std::cout << "Caught Exception. Exit." << "\n";
     }
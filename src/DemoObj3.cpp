@@ -0,0 +1,46 @@
+/*
+* Copyright 2023 Au Yeong Wing Yau
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+/**
+ * \file DemoObj3.cpp
+ * Example demo code to illustrate the use of the WY_Serialize library.
+*/
+#include <cstring>
+#include <iostream>
+#include "DemoObj3.hpp"
+using namespace WY_Serialize;
+
+
+DemoObj3::DemoObj3() noexcept
+{
+    m_data.s_int = 456;
+    strncpy(m_data.s_char, "Hello 456", 31);
+}
+
+
+int DemoObj3::on_pod_loaded() noexcept
+{
+    m_data.s_char[sizeof(m_data.s_char)-1] = 0;
+    return 0;
+}
+
+
+int DemoObj3::check_data() noexcept
+{
+    std::cout << "DemoObj3: " << m_data.s_int << "\n" << "DemoObj3: " << m_data.s_char << "\n";
+    return 0;
+}
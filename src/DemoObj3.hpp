@@ -0,0 +1,65 @@
+/*
+* Copyright 2023 Au Yeong Wing Yau
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+/**
+ * \file DemoObj3.hpp
+ * Example demo code to illustrate the use of the WY_Serialize library.
+*/
+#ifndef _DEMO_OBJ_3_HPP_
+#define _DEMO_OBJ_3_HPP_
+
+#include "WY_SerializePod.hpp"
+#include "WY_SerializeTypes.hpp"
+
+#pragma once
+namespace WY_Serialize {
+
+/**
+ * The data structure of DemoObj3. 
+ */
+struct S_DemoObj3Data {
+    int s_int; /**< Demo integer value. */
+    char s_char[32]; /**< Demo char array. */
+};
+
+/**
+ * Example demo object with the same data as DemoObj1, which gets its save and load functions from WY_SerializePod instead of implementing them.
+*/
+class DemoObj3: public WY_SerializePod<DemoObj3, S_DemoObj3Data, DEMO_OBJ3>
+{
+public:
+    /**
+     * Constructor.
+     */
+    DemoObj3() noexcept;
+
+    /**
+     * Called by WY_SerializePod after loading. Terminates the string in case the file was corrupted.
+     * \return 0.
+    */
+    int on_pod_loaded() noexcept;
+
+    /**
+     * Implements the WY_SerializeObj virtual function. Optional to implement. This function is provided for internal checks of the object data if required.
+     * @return 0 if success. -1 if error. 
+     */
+    int check_data() noexcept;
+};
+
+}
+
+#endif
@@ -0,0 +1,105 @@
+/*
+* Copyright 2023 Au Yeong Wing Yau
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+#include <cstring>
+#if defined(__SSSE3__)
+#include <immintrin.h>
+#endif
+#include "WY_ByteOrder.hpp"
+using namespace WY_Serialize;
+
+
+#if defined(__SSSE3__)
+/**
+ * Gets the PSHUFB mask that reverses the bytes of each value of a 16 byte vector.
+ * \tparam SIZE Size of a value: 2, 4 or 8.
+ * \return The mask.
+*/
+template <unsigned int SIZE>
+static inline __m128i get_swap_mask() noexcept
+{
+    alignas(16) unsigned char mask[16];
+    for(unsigned int b=0; b<16; b++)
+        mask[b] = (b - b%SIZE) + (SIZE-1 - b%SIZE);
+    return _mm_load_si128((const __m128i *)mask);
+}
+#endif
+
+
+/**
+ * Reverses the bytes of every value of an array.
+ * \tparam SIZE Size of a value: 2, 4 or 8.
+ * \param p_src The values.
+ * \param p_dst Where the swapped values go. Either p_src or not overlapping it.
+ * \param p_count Number of values.
+*/
+template <unsigned int SIZE>
+static void swap_values(const unsigned char *p_src, unsigned char *p_dst, const uint64_t p_count) noexcept
+{
+    uint64_t i = 0;
+
+#if defined(__AVX2__)
+    const __m256i mask = _mm256_broadcastsi128_si256(get_swap_mask<SIZE>()); /* PSHUFB stays within 16 byte lanes, which hold whole values. */
+    for(; i + 64/SIZE <= p_count; i += 64/SIZE) { /* Two vectors per iteration, so loads and stores overlap. */
+        const __m256i a = _mm256_loadu_si256((const __m256i *)(p_src + i*SIZE));
+        const __m256i b = _mm256_loadu_si256((const __m256i *)(p_src + i*SIZE + 32));
+        _mm256_storeu_si256((__m256i *)(p_dst + i*SIZE), _mm256_shuffle_epi8(a, mask));
+        _mm256_storeu_si256((__m256i *)(p_dst + i*SIZE + 32), _mm256_shuffle_epi8(b, mask));
+    }
+#endif
+#if defined(__SSSE3__)
+    const __m128i mask16 = get_swap_mask<SIZE>();
+    for(; i + 16/SIZE <= p_count; i += 16/SIZE)
+        _mm_storeu_si128((__m128i *)(p_dst + i*SIZE), _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(p_src + i*SIZE)), mask16));
+#endif
+
+    for(; i<p_count; i++) {
+        if(SIZE == 2) {
+            uint16_t value;
+            memcpy(&value, p_src + i*2, 2);
+            value = __builtin_bswap16(value);
+            memcpy(p_dst + i*2, &value, 2);
+        } else if(SIZE == 4) {
+            uint32_t value;
+            memcpy(&value, p_src + i*4, 4);
+            value = __builtin_bswap32(value);
+            memcpy(p_dst + i*4, &value, 4);
+        } else {
+            uint64_t value;
+            memcpy(&value, p_src + i*8, 8);
+            value = __builtin_bswap64(value);
+            memcpy(p_dst + i*8, &value, 8);
+        }
+    }
+}
+
+
+void WY_ByteOrder::swap_array(const void *p_src, void *p_dst, const uint64_t p_count, const unsigned int p_size) noexcept
+{
+    const unsigned char * const src = (const unsigned char *)p_src;
+    unsigned char * const dst = (unsigned char *)p_dst;
+
+    switch(p_size) {
+    case 2: swap_values<2>(src, dst, p_count); break;
+    case 4: swap_values<4>(src, dst, p_count); break;
+    case 8: swap_values<8>(src, dst, p_count); break;
+    default:
+        if((p_size == 1) && (src != dst) && (p_count > 0))
+            memcpy(dst, src, p_count);
+        break;
+    }
+}
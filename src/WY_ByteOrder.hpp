@@ -0,0 +1,165 @@
+/*
+* Copyright 2023 Au Yeong Wing Yau
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+#ifndef _WY_BYTE_ORDER_HPP_
+#define _WY_BYTE_ORDER_HPP_
+
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <type_traits>
+#include <vector>
+#include "WY_SerializeDef.hpp"
+#pragma once
+namespace WY_Serialize
+{
+
+/**
+ * Saves and loads arrays of numbers in the little-endian byte order of save files, so they load on machines of either byte order. The headers, CRCs, index and other fixed-size fields of save files are always little-endian, see encode_le32(). Block data is saved as it is given, so a component with numeric arrays uses these helpers instead of saving its arrays raw, as WY_SerializePod does. <br>
+ * On little-endian machines the conversion is a plain copy, and save_array() gives the array itself to the agent without any copy. On big-endian machines, or in a build with -DWY_SERIALIZE_FORCE_SWAP, every value is byte-swapped. On x86-64 the swap is a byte shuffle of 32 bytes at a time with AVX2, or 16 with SSSE3, so it runs close to memory bandwidth. Other CPUs swap one value at a time with a single instruction, which the compiler may vectorise as well.
+ *
+ * Usage: <br>
+ * @code
+ * int get_save_data(S_SerializeData *p_data) noexcept { 
+ *  p_data->m_type = SAMPLES; 
+ *  return WY_ByteOrder::save_array(m_samples.data(), m_samples.size(), &m_buffer, p_data); 
+ * } 
+ * int get_load_data(const uint64_t p_size, const unsigned char *p_data) noexcept { 
+ *  return WY_ByteOrder::load_array(p_size, p_data, &m_samples); 
+ * } 
+ * @endcode
+ */
+class WY_ByteOrder
+{
+public:
+    /**
+     * Checks if arrays are byte-swapped when they are saved and loaded.
+     * \return True on big-endian machines and in a build with -DWY_SERIALIZE_FORCE_SWAP.
+    */
+    static constexpr bool is_swapping() noexcept
+    {
+        return SERIALIZE_SWAP_BYTES;
+    }
+
+    /**
+     * Reverses the bytes of every value of an array, whatever the byte order of the machine.
+     * \param p_src The values.
+     * \param p_dst Where the swapped values go. May be p_src to swap in place, but must not overlap it otherwise.
+     * \param p_count Number of values.
+     * \param p_size Size of a value: 1, 2, 4 or 8. Values of 1 byte are copied.
+    */
+    static void swap_array(const void *p_src, void *p_dst, const uint64_t p_count, const unsigned int p_size) noexcept;
+
+    /**
+     * Converts an array of numbers to the byte order of save files.
+     * \tparam T Integer, floating point or enum type of 1, 2, 4 or 8 bytes.
+     * \param p_values The values.
+     * \param p_count Number of values.
+     * \param p_dst Buffer of p_count * sizeof(T) bytes, which need not be aligned.
+    */
+    template <typename T>
+    static void encode_array(const T *__restrict__ const p_values, const uint64_t p_count, unsigned char *__restrict__ const p_dst) noexcept
+    {
+        check_type<T>();
+        if(SERIALIZE_SWAP_BYTES && (sizeof(T) > 1))
+            swap_array(p_values, p_dst, p_count, sizeof(T));
+        else if(p_count > 0)
+            memcpy(p_dst, p_values, p_count * sizeof(T));
+    }
+
+    /**
+     * Converts an array of numbers from the byte order of save files.
+     * \tparam T Integer, floating point or enum type of 1, 2, 4 or 8 bytes.
+     * \param p_src The values as saved, which need not be aligned.
+     * \param p_count Number of values.
+     * \param p_values Returns the values.
+    */
+    template <typename T>
+    static void decode_array(const unsigned char *__restrict__ const p_src, const uint64_t p_count, T *__restrict__ const p_values) noexcept
+    {
+        check_type<T>();
+        if(SERIALIZE_SWAP_BYTES && (sizeof(T) > 1))
+            swap_array(p_src, p_values, p_count, sizeof(T));
+        else if(p_count > 0)
+            memcpy(p_values, p_src, p_count * sizeof(T));
+    }
+
+    /**
+     * Gets the data of a block holding an array of numbers, in the byte order of save files.
+     * \tparam T Integer, floating point or enum type of 1, 2, 4 or 8 bytes.
+     * \param p_values The values, which must stay unchanged until the block is saved.
+     * \param p_count Number of values.
+     * \param p_buffer Buffer for the converted values, which must also stay unchanged until the block is saved. Not used if no conversion is needed, as the block data is then p_values itself.
+     * \param p_data Returns the block in m_size and m_data. m_type and m_instance are left to the caller.
+     * \return 0 if no error. -1 if memory cannot be allocated.
+    */
+    template <typename T>
+    static int save_array(const T *__restrict__ const p_values, const uint64_t p_count, std::vector<unsigned char> *__restrict__ const p_buffer, S_SerializeData *__restrict__ const p_data) noexcept
+    {
+        check_type<T>();
+        p_data->m_size = p_count * sizeof(T);
+        if(!SERIALIZE_SWAP_BYTES || (sizeof(T) == 1)) {
+            p_data->m_data = (unsigned char *)p_values;
+            return 0;
+        }
+        try {
+            p_buffer->resize(p_data->m_size);
+        } catch (std::exception &e) {
+            return -1;
+        }
+        encode_array(p_values, p_count, p_buffer->data());
+        p_data->m_data = p_buffer->data();
+        return 0;
+    }
+
+    /**
+     * Loads a block saved by save_array() into an array of numbers.
+     * \tparam T Integer, floating point or enum type of 1, 2, 4 or 8 bytes.
+     * \param p_size Size of the loaded data.
+     * \param p_data The loaded data.
+     * \param p_values Returns the values.
+     * \return 0 if no error. -1 if p_size is not a multiple of sizeof(T) or memory cannot be allocated.
+    */
+    template <typename T>
+    static int load_array(const uint64_t p_size, const unsigned char *__restrict__ const p_data, std::vector<T> *__restrict__ const p_values) noexcept
+    {
+        check_type<T>();
+        if(p_size % sizeof(T) != 0)
+            return -1;
+        try {
+            p_values->resize(p_size / sizeof(T));
+        } catch (std::exception &e) {
+            return -1;
+        }
+        decode_array(p_data, p_values->size(), p_values->data());
+        return 0;
+    }
+
+private:
+    /**
+     * Checks at compile time that a type can be byte-swapped as one value.
+    */
+    template <typename T>
+    static constexpr void check_type() noexcept
+    {
+        static_assert(std::is_arithmetic<T>::value || std::is_enum<T>::value, "WY_ByteOrder needs integer, floating point or enum values.");
+        static_assert((sizeof(T) == 1) || (sizeof(T) == 2) || (sizeof(T) == 4) || (sizeof(T) == 8), "WY_ByteOrder needs values of 1, 2, 4 or 8 bytes.");
+    }
+};
+}
+
+#endif
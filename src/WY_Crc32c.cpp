@@ -0,0 +1,245 @@
+/*
+* Copyright 2023 Au Yeong Wing Yau
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include <cstring>
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#endif
+#include "WY_Crc32c.hpp"
+using namespace WY_Serialize;
+
+namespace {
+
+const uint32_t crc32c_poly = 0x82F63B78; /* Reflected CRC32C polynomial. */
+const uint64_t crc32c_long = 8192; /* Length of each of the three streams for large inputs. */
+const uint64_t crc32c_short = 256; /* Length of each of the three streams for the remainder. */
+
+/**
+ * Multiplies a 32x32 bit matrix by a vector over GF(2).
+ */
+uint32_t gf2_matrix_times(const uint32_t *__restrict__ p_mat, uint32_t p_vec) noexcept
+{
+    uint32_t sum = 0;
+    while(p_vec != 0) {
+        if(p_vec & 1)
+            sum ^= *p_mat;
+        p_vec >>= 1;
+        ++p_mat;
+    }
+    return sum;
+}
+
+/**
+ * Squares a 32x32 bit matrix over GF(2).
+ */
+void gf2_matrix_square(uint32_t *__restrict__ const p_square, const uint32_t *__restrict__ const p_mat) noexcept
+{
+    for(unsigned int n=0; n<32; n++)
+        p_square[n] = gf2_matrix_times(p_mat, p_mat[n]);
+}
+
+/**
+ * Lookup tables shared by both implementations, built once on first use.
+ */
+struct S_Crc32cTables {
+    uint32_t m_bytes[8][256]; /**< Slicing-by-8 tables of the software implementation. */
+    uint32_t m_long[4][256]; /**< Appends crc32c_long zero bytes to a CRC, to combine the three hardware streams. */
+    uint32_t m_short[4][256]; /**< Appends crc32c_short zero bytes to a CRC. */
+    bool m_hardware; /**< Whether the CPU has the SSE4.2 CRC32 instruction. */
+
+    S_Crc32cTables() noexcept {
+        for(uint32_t n=0; n<256; n++) {
+            uint32_t crc = n;
+            for(unsigned int k=0; k<8; k++)
+                crc = (crc & 1) ? (crc >> 1) ^ crc32c_poly : crc >> 1;
+            m_bytes[0][n] = crc;
+        }
+        for(uint32_t n=0; n<256; n++) {
+            uint32_t crc = m_bytes[0][n];
+            for(unsigned int k=1; k<8; k++) {
+                crc = m_bytes[0][crc & 0xFF] ^ (crc >> 8);
+                m_bytes[k][n] = crc;
+            }
+        }
+        build_zeros(m_long, crc32c_long);
+        build_zeros(m_short, crc32c_short);
+#if defined(__x86_64__)
+        m_hardware = __builtin_cpu_supports("sse4.2");
+#else
+        m_hardware = false;
+#endif
+    }
+
+    /**
+     * Builds the tables that append p_length zero bytes to a CRC. p_length must be a power of 2.
+     */
+    static void build_zeros(uint32_t p_zeros[4][256], uint64_t p_length) noexcept {
+        uint32_t even[32], odd[32];
+        uint32_t row = 1;
+
+        odd[0] = crc32c_poly; /* Operator for one zero bit. */
+        for(unsigned int n=1; n<32; n++) {
+            odd[n] = row;
+            row <<= 1;
+        }
+        gf2_matrix_square(even, odd); /* Two zero bits. */
+        gf2_matrix_square(odd, even); /* Four zero bits, which is half a byte. */
+        do { /* Square until the operator appends p_length bytes. */
+            gf2_matrix_square(even, odd);
+            p_length >>= 1;
+            if(p_length == 0) {
+                memcpy(odd, even, sizeof(odd));
+                break;
+            }
+            gf2_matrix_square(odd, even);
+            p_length >>= 1;
+        } while(p_length != 0);
+
+        for(uint32_t n=0; n<256; n++) {
+            p_zeros[0][n] = gf2_matrix_times(odd, n);
+            p_zeros[1][n] = gf2_matrix_times(odd, n << 8);
+            p_zeros[2][n] = gf2_matrix_times(odd, n << 16);
+            p_zeros[3][n] = gf2_matrix_times(odd, n << 24);
+        }
+    }
+};
+
+const S_Crc32cTables & get_tables() noexcept
+{
+    static const S_Crc32cTables tables;
+    return tables;
+}
+
+/**
+ * Appends the zero bytes of a table built by S_Crc32cTables::build_zeros() to a CRC.
+ */
+inline uint32_t crc32c_shift(const uint32_t p_zeros[4][256], const uint32_t p_crc) noexcept
+{
+    return p_zeros[0][p_crc & 0xFF] ^ p_zeros[1][(p_crc >> 8) & 0xFF] ^ p_zeros[2][(p_crc >> 16) & 0xFF] ^ p_zeros[3][p_crc >> 24];
+}
+
+}
+
+
+uint32_t WY_Crc32c::update(const uint32_t p_crc, const unsigned char *__restrict__ const p_data, const uint64_t p_size) noexcept
+{
+    if(get_tables().m_hardware)
+        return update_hardware(p_crc, p_data, p_size);
+    return update_software(p_crc, p_data, p_size);
+}
+
+
+bool WY_Crc32c::is_hardware() noexcept
+{
+    return get_tables().m_hardware;
+}
+
+
+#if defined(__x86_64__)
+__attribute__((target("sse4.2")))
+uint32_t WY_Crc32c::update_hardware(const uint32_t p_crc, const unsigned char *__restrict__ p_data, uint64_t p_size) noexcept
+{
+    const S_Crc32cTables &tables = get_tables();
+    uint64_t crc0 = p_crc ^ 0xFFFFFFFF;
+    uint64_t value;
+
+    while((p_size > 0) && (((uintptr_t)p_data & 7) != 0)) {
+        crc0 = _mm_crc32_u8(crc0, *p_data++);
+        --p_size;
+    }
+
+    /* The instruction has a latency of 3 cycles but a throughput of 1, so three independent streams run at full speed. Their CRCs are then combined by appending the length of the following streams in zeros. */
+    while(p_size >= crc32c_long*3) {
+        uint64_t crc1 = 0, crc2 = 0;
+        const unsigned char * const end = p_data+crc32c_long;
+        do {
+            memcpy(&value, p_data, 8);
+            crc0 = _mm_crc32_u64(crc0, value);
+            memcpy(&value, p_data+crc32c_long, 8);
+            crc1 = _mm_crc32_u64(crc1, value);
+            memcpy(&value, p_data+crc32c_long*2, 8);
+            crc2 = _mm_crc32_u64(crc2, value);
+            p_data += 8;
+        } while(p_data < end);
+        crc0 = crc32c_shift(tables.m_long, crc0) ^ crc1;
+        crc0 = crc32c_shift(tables.m_long, crc0) ^ crc2;
+        p_data += crc32c_long*2;
+        p_size -= crc32c_long*3;
+    }
+    while(p_size >= crc32c_short*3) {
+        uint64_t crc1 = 0, crc2 = 0;
+        const unsigned char * const end = p_data+crc32c_short;
+        do {
+            memcpy(&value, p_data, 8);
+            crc0 = _mm_crc32_u64(crc0, value);
+            memcpy(&value, p_data+crc32c_short, 8);
+            crc1 = _mm_crc32_u64(crc1, value);
+            memcpy(&value, p_data+crc32c_short*2, 8);
+            crc2 = _mm_crc32_u64(crc2, value);
+            p_data += 8;
+        } while(p_data < end);
+        crc0 = crc32c_shift(tables.m_short, crc0) ^ crc1;
+        crc0 = crc32c_shift(tables.m_short, crc0) ^ crc2;
+        p_data += crc32c_short*2;
+        p_size -= crc32c_short*3;
+    }
+
+    while(p_size >= 8) {
+        memcpy(&value, p_data, 8);
+        crc0 = _mm_crc32_u64(crc0, value);
+        p_data += 8;
+        p_size -= 8;
+    }
+    while(p_size > 0) {
+        crc0 = _mm_crc32_u8(crc0, *p_data++);
+        --p_size;
+    }
+    return (uint32_t)crc0 ^ 0xFFFFFFFF;
+}
+#else
+uint32_t WY_Crc32c::update_hardware(const uint32_t p_crc, const unsigned char *__restrict__ p_data, uint64_t p_size) noexcept
+{
+    return update_software(p_crc, p_data, p_size);
+}
+#endif
+
+
+uint32_t WY_Crc32c::update_software(const uint32_t p_crc, const unsigned char *__restrict__ p_data, uint64_t p_size) noexcept
+{
+    const S_Crc32cTables &tables = get_tables();
+    uint64_t crc = p_crc ^ 0xFFFFFFFF;
+    uint64_t value;
+
+    while((p_size > 0) && (((uintptr_t)p_data & 7) != 0)) {
+        crc = tables.m_bytes[0][(crc ^ *p_data++) & 0xFF] ^ (crc >> 8);
+        --p_size;
+    }
+    while(p_size >= 8) { /* Slicing-by-8: one lookup per byte of a 64-bit word, independent of each other. The first byte must be the lowest. */
+        memcpy(&value, p_data, 8);
+        if(__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+            value = __builtin_bswap64(value);
+        crc ^= value;
+        crc = tables.m_bytes[7][crc & 0xFF] ^ tables.m_bytes[6][(crc >> 8) & 0xFF] ^ tables.m_bytes[5][(crc >> 16) & 0xFF] ^ tables.m_bytes[4][(crc >> 24) & 0xFF]
+            ^ tables.m_bytes[3][(crc >> 32) & 0xFF] ^ tables.m_bytes[2][(crc >> 40) & 0xFF] ^ tables.m_bytes[1][(crc >> 48) & 0xFF] ^ tables.m_bytes[0][crc >> 56];
+        p_data += 8;
+        p_size -= 8;
+    }
+    while(p_size > 0) {
+        crc = tables.m_bytes[0][(crc ^ *p_data++) & 0xFF] ^ (crc >> 8);
+        --p_size;
+    }
+    return (uint32_t)crc ^ 0xFFFFFFFF;
+}
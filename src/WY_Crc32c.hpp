@@ -0,0 +1,73 @@
+/*
+* Copyright 2023 Au Yeong Wing Yau
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#ifndef _WY_CRC32C_HPP_
+#define _WY_CRC32C_HPP_
+
+#include <cstdint>
+#pragma once
+namespace WY_Serialize
+{
+
+/**
+ * Computes CRC32C (Castagnoli) checksums, used by WY_SerializeAgent to check blocks when loading. See WY_SerializeAgent::set_save_crc().
+ * On x86-64 CPUs with SSE4.2 the CRC32 instruction is used on three interleaved streams, which hides its latency. Other CPUs use a portable slicing-by-8 table implementation. The implementation is selected once at run time.
+ * 
+ * Usage: <br>
+ * @code
+ * uint32_t crc = WY_Crc32c::update(0, data, size); 
+ * crc = WY_Crc32c::update(crc, more_data, more_size); // Same as the CRC of data and more_data in one buffer. 
+ * @endcode
+ */
+class WY_Crc32c
+{
+public:
+    /**
+     * Extends a CRC32C with more data.
+     * \param p_crc CRC32C of the data so far. 0 for the start of the data.
+     * \param p_data The data.
+     * \param p_size Size of p_data.
+     * \return CRC32C of the data so far followed by p_data.
+    */
+    static uint32_t update(const uint32_t p_crc, const unsigned char *__restrict__ const p_data, const uint64_t p_size) noexcept;
+
+    /**
+     * Checks if update() uses the CPU's CRC32 instruction.
+     * \return True if the CRC32 instruction is used.
+    */
+    static bool is_hardware() noexcept;
+
+    /**
+     * Implements update() with the SSE4.2 CRC32 instruction. Public so the two implementations can be checked against each other. Only call this if is_hardware() returns true.
+     * \param p_crc CRC32C of the data so far.
+     * \param p_data The data.
+     * \param p_size Size of p_data.
+     * \return CRC32C of the data so far followed by p_data.
+    */
+    static uint32_t update_hardware(const uint32_t p_crc, const unsigned char *__restrict__ p_data, uint64_t p_size) noexcept;
+
+    /**
+     * Implements update() with lookup tables. Works on every CPU.
+     * \param p_crc CRC32C of the data so far.
+     * \param p_data The data.
+     * \param p_size Size of p_data.
+     * \return CRC32C of the data so far followed by p_data.
+    */
+    static uint32_t update_software(const uint32_t p_crc, const unsigned char *__restrict__ p_data, uint64_t p_size) noexcept;
+};
+}
+
+#endif
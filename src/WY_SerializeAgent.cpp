@@ -15,18 +15,70 @@
 */
 
 #include <exception>
-#include <fstream>
 #include <cstring>
+#include <cerrno>
+#include <algorithm>
 #include <iostream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <climits>
+#include <atomic>
 #include "WY_SerializeAgent.hpp"
 #include "WY_DebugIO.hpp"
+#include "WY_Crc32c.hpp"
+#include "WY_SerializeVarint.hpp"
+#include "WY_SerializeStats.hpp"
 using namespace WY_Serialize;
 
+static const unsigned char g_padding[SERIALIZE_ALIGN_MAX] = {}; /**< Zeros written as padding in front of aligned block data. */
+static std::atomic<uint64_t> g_save_temp_count(0); /**< Numbers the temporary files of atomic saves, so agents of one process never pick the same name. */
+
 
 WY_SerializeAgent::WY_SerializeAgent()
 {
     m_file_data_size = 0;
     m_file_data_offset = 0;
+    m_load_mode = LOAD_BUFFERED;
+    m_file_data_mode = LOAD_BUFFERED;
+    m_allocator = &m_default_allocator;
+    m_stream_window_size = 4*1024*1024;
+    m_stream_remaining = 0;
+    m_stream_offset = 0;
+    m_crc_active = false;
+    m_crc_next = 0;
+    m_crc_data = 0;
+    m_crc_data_end = 0;
+    m_crc_value = 0;
+    m_crc_expected = 0;
+    m_crc_checked_end = 0;
+    m_save_mode = SAVE_STREAM;
+    m_io_backend = IO_BACKEND_DEFAULT;
+    m_io = NULL;
+    m_file_io = NULL;
+    m_save_index = false;
+    m_save_offset = 0;
+    m_batch_offset = 0;
+    m_file_map_size = 0;
+    m_codec = NULL;
+    m_codec_min_size = 256;
+    m_save_crc = false;
+    m_save_compact = false;
+    m_block_compact = false;
+    m_file_compact = false;
+    m_file_version = SERIALIZE_FILE_VERSION;
+    m_save_alignment = 1;
+    m_block_alignment = 1;
+    m_file_alignment = 1;
+    m_save_atomic = false;
+    m_save_durability = SAVE_DURABILITY_NONE;
+    m_stats_save_start = 0;
+    m_stats_load_start = 0;
+    m_view_decoded = false;
+    m_batch_buffers_used = 0;
+    m_save_memory = false;
+    m_load_memory = false;
     m_file_data = NULL;
 }
 
@@ -34,8 +86,8 @@ WY_SerializeAgent::WY_SerializeAgent()
 WY_SerializeAgent::~WY_SerializeAgent()
 {
     clear_file_buffer();
-    if(m_file.is_open())
-        m_file.close();
+    close_io();
+    discard_save_temp(); /* An atomic save that was never finalised. */
 }
 
 
@@ -51,65 +103,283 @@ void WY_SerializeAgent::set_file_name(const char *__restrict__ const p_name)
 }
 
 
+void WY_SerializeAgent::set_load_mode(const LOAD_MODE p_mode) noexcept
+{
+    m_load_mode = p_mode;
+}
+
+
+void WY_SerializeAgent::set_allocator(WY_SerializeAllocator *__restrict__ const p_allocator) noexcept
+{
+    clear_file_buffer(); /* Loaded data belongs to the current allocator. */
+    m_allocator = (p_allocator == NULL) ? &m_default_allocator : p_allocator;
+}
+
+
+void WY_SerializeAgent::set_stream_window(const uint64_t p_size) noexcept
+{
+    const uint64_t min_size = SERIALIZE_HEADER_MAX + SERIALIZE_ALIGN_MAX; /* Room for a header after the bytes kept in front of it for alignment. */
+    m_stream_window_size = (p_size < min_size) ? min_size : p_size;
+}
+
+
+void WY_SerializeAgent::set_save_mode(const SAVE_MODE p_mode) noexcept
+{
+    m_save_mode = p_mode;
+}
+
+
+void WY_SerializeAgent::set_io_backend(const IO_BACKEND p_backend) noexcept
+{
+    m_io_backend = p_backend;
+}
+
+
+void WY_SerializeAgent::set_io(WY_SerializeIO *__restrict__ const p_io) noexcept
+{
+    m_io = p_io;
+}
+
+
+void WY_SerializeAgent::set_save_buffer(std::vector<unsigned char> *__restrict__ const p_buffer) noexcept
+{
+    m_save_memory_io.set_buffer(p_buffer);
+    m_save_memory = (p_buffer != NULL);
+}
+
+
+void WY_SerializeAgent::set_save_span(unsigned char *__restrict__ const p_data, const uint64_t p_capacity) noexcept
+{
+    m_save_memory_io.set_span(p_data, p_capacity);
+    m_save_memory = (p_data != NULL);
+}
+
+
+uint64_t WY_SerializeAgent::get_save_size() const noexcept
+{
+    return m_save_memory_io.get_size();
+}
+
+
+void WY_SerializeAgent::set_load_memory(const unsigned char *__restrict__ const p_data, const uint64_t p_size) noexcept
+{
+    clear_file_buffer(); /* A region loaded in place must not be unmapped. */
+    m_load_memory_io.set_region(p_data, p_size);
+    m_load_memory = (p_data != NULL);
+}
+
+
+void WY_SerializeAgent::set_save_index(const bool p_index) noexcept
+{
+    m_save_index = p_index;
+}
+
+
+void WY_SerializeAgent::set_codec(const WY_SerializeCodec *__restrict__ const p_codec, const uint64_t p_min_size) noexcept
+{
+    m_codec = p_codec;
+    m_codec_min_size = p_min_size;
+}
+
+
+void WY_SerializeAgent::set_save_crc(const bool p_crc) noexcept
+{
+    m_save_crc = p_crc;
+}
+
+
+void WY_SerializeAgent::set_save_compact(const bool p_compact) noexcept
+{
+    m_save_compact = p_compact;
+    m_block_compact = p_compact;
+}
+
+
+void WY_SerializeAgent::set_save_alignment(const unsigned int p_alignment) noexcept
+{
+    unsigned int alignment = 1;
+    while((alignment < p_alignment) && (alignment < SERIALIZE_ALIGN_MAX))
+        alignment <<= 1;
+    m_save_alignment = alignment;
+    m_block_alignment = alignment;
+}
+
+
+void WY_SerializeAgent::set_save_atomic(const bool p_atomic) noexcept
+{
+    m_save_atomic = p_atomic;
+}
+
+
+void WY_SerializeAgent::set_save_durability(const SAVE_DURABILITY p_durability) noexcept
+{
+    m_save_durability = p_durability;
+}
+
+
 void WY_SerializeAgent::load_from_file()
 {
-    if(m_file_name.size()==0) {
+    if((m_file_name.size()==0) && !m_load_memory) {
         WY_DebugIO::debug_print("File name undefined.");
         throw -1;
     } 
 
     clear_file_buffer(); /* Ensure buffers are clear. */
-    if(m_file.is_open()) /* A file still open. */
-        m_file.close();
+    close_io(); /* A file still open. */
+
+    const uint64_t start = WY_SerializeStats::record_begin(TRACE_LOAD_BEGIN);
+    if(m_load_mode == LOAD_MMAP) {
+        load_mapped_file();
+        read_index();
+        if(read_file_header() != 0) {
+            clear_file_buffer();
+            throw -1;
+        }
+        m_stats_load_start = start;
+        return;
+    } else if(m_load_mode == LOAD_STREAM) {
+        load_streamed_file();
+        read_index();
+        if(read_file_header() != 0) {
+            clear_file_buffer();
+            throw -1;
+        }
+        m_stats_load_start = start;
+        return;
+    }
 
-    m_file.open(m_file_name, std::fstream::in | std::fstream::binary);
-    if(!m_file.is_open()) {/* File error at the start, exit with error. */
+    if(open_io(m_file_name, IO_OPEN_READ, false) != 0) {/* File error at the start, exit with error. */
         WY_DebugIO::debug_print("Open file for reading failed.");
         throw -1;
     }
 
-    m_file.seekg(0, m_file.end); /* Go to end of file. */
-    int tmp = m_file.tellg(); /* Get size of file content. */
-    m_file.seekg(0, m_file.beg); /* Return to start of file. */
-    if((tmp>=0) && (m_file.good())) 
-        m_file_data_size = tmp;
-    else {
+    if(m_file_io->get_file_size(&m_file_data_size) != 0) {
         WY_DebugIO::debug_print("Parsing file failed.");
         goto err_exit;
     }
 
-    try {
-        m_file_data = new char[m_file_data_size];
-        m_file.read(m_file_data, m_file_data_size); /* Get file content into buffer. */
-        if(m_file.good())
-            goto good_exit;
-        else
-            WY_DebugIO::debug_print("Read file content failed.");
-    } catch (std::exception &e) { 
+    m_allocator->reserve(m_file_data_size); /* The file buffer takes exactly one chunk. */
+    m_file_data = (char *)m_allocator->allocate(m_file_data_size, std::max<uint64_t>(64, m_file_io->get_buffer_alignment())); /* Aligned so an O_DIRECT backend reads straight into it. */
+    if(m_file_data == NULL)
         goto err_exit;
-    }
+    if(read_file_buffer() == 0) /* Get file content into buffer. */
+        goto good_exit;
+    else
+        WY_DebugIO::debug_print("Read file content failed.");
 
 err_exit: /* All errors exit from here.*/
     clear_file_buffer();
+    close_io();
     throw -1;
 good_exit: /* Good exit without errors.*/
-    m_file.close();
+    close_io();
+    read_index();
+    if(read_file_header() != 0) {
+        clear_file_buffer();
+        throw -1;
+    }
+    m_stats_load_start = start;
     WY_DebugIO::debug_print("File data loaded.");
 }
 
 
 void WY_SerializeAgent::prepare_save_file()
 {
-    if(m_file_name.size()==0) {
+    open_save_file(false, 0);
+}
+
+
+void WY_SerializeAgent::prepare_append_file(const uint64_t p_offset)
+{
+    if(m_save_index) { /* The index must be the last thing in the file, so it cannot be kept when appending. */
+        WY_DebugIO::debug_print("Cannot append to a file with a block index.");
+        throw -1;
+    }
+    if(m_save_memory) {
+        WY_DebugIO::debug_print("Cannot append to memory.");
+        throw -1;
+    }
+    open_save_file(true, p_offset);
+}
+
+
+void WY_SerializeAgent::open_save_file(const bool p_append, const uint64_t p_offset)
+{
+    if((m_file_name.size()==0) && !m_save_memory) {
         WY_DebugIO::debug_print("File name undefined.");
         throw -1;
     }
 
-    /* Opens file for output, discard all current content. */
-    m_file.open(m_file_name, std::fstream::out | std::fstream::binary | std::fstream::trunc);
-    if(m_file.fail()) {
+    m_stats_save_start = WY_SerializeStats::record_begin(TRACE_SAVE_BEGIN);
+    unsigned char file_header[SERIALIZE_FILE_HEADER_SIZE];
+    unsigned int file_header_size = 0;
+    if(p_append) { /* Blocks must have the format of the blocks already in the file. */
+        S_SerializeFileHeader header;
+        if((read_file_format(m_file_name, &header, &file_header_size) != 0) || (p_offset < file_header_size)) {
+            WY_DebugIO::debug_print("Cannot append to file in this format.");
+            throw -1;
+        }
+        if(header.m_version == 0) { /* Blocks with flags cannot be written in the original format. */
+            WY_DebugIO::debug_print("Cannot append to file in this format.");
+            throw -1;
+        }
+        m_block_compact = (header.m_options & SERIALIZE_FILE_COMPACT) != 0;
+        m_block_alignment = get_file_alignment(&header);
+        file_header_size = 0; /* Already in the file. */
+    } else {
+        m_block_compact = m_save_compact;
+        m_block_alignment = m_save_alignment;
+        const S_SerializeFileHeader header = {SERIALIZE_FILE_VERSION, (m_save_compact ? SERIALIZE_FILE_COMPACT : 0) | ((uint32_t)__builtin_ctz(m_save_alignment) << SERIALIZE_FILE_ALIGN_SHIFT)};
+        encode_file_header(file_header, &header); /* Every new file is marked with its version, so older formats can be told apart. */
+        file_header_size = SERIALIZE_FILE_HEADER_SIZE;
+    }
+    if(p_append) {
+        WY_SerializeStats::record_io(STATS_IO_TRUNCATE);
+        if(truncate(m_file_name.c_str(), p_offset) != 0) { /* Drop anything after p_offset, such as a block left by an interrupted save. */
+            WY_DebugIO::debug_print("Truncate file failed.");
+            throw -1;
+        }
+    }
+    discard_save_temp(); /* A previous atomic save that was never finalised. */
+    if(!p_append && m_save_atomic && !m_save_memory)
+        create_save_temp();
+    const std::string &path = m_save_temp.empty() ? m_file_name : m_save_temp;
+    m_save_offset = p_offset + file_header_size;
+    m_index.clear();
+    m_index_lookup.clear();
+
+    /* Opens file for output, discard all current content unless appending. */
+    if(open_io(path, p_append ? IO_OPEN_WRITE : IO_OPEN_CREATE, m_save_mode == SAVE_VECTORED) != 0) {
         WY_DebugIO::debug_print("Open file failed.");
-        throw -1;        
+        throw -1;
+    }
+
+    if(m_save_mode == SAVE_VECTORED) {
+        try {
+            m_batch_stage.resize(m_batch_stage_size);
+            m_batch_iov.clear();
+            m_batch_iov.reserve(m_batch_iov_max);
+        } catch (std::exception &e) {
+            close_io();
+            throw -1;
+        }
+        memcpy(m_batch_stage.data(), file_header, file_header_size);
+        m_batch_stage_used = file_header_size;
+        m_batch_stage_queued = 0;
+        m_batch_bytes = file_header_size;
+        m_batch_offset = p_offset;
+        m_batch_buffers_used = 0;
+        WY_DebugIO::debug_print("File opened.");
+        return;
+    }
+
+    if(file_header_size > 0) {
+        struct iovec iov = {file_header, file_header_size};
+        if(m_file_io->write_file(&iov, 1, p_offset) != 0) {
+            WY_DebugIO::debug_print("Write to file NOK.");
+            close_io();
+            throw -1;
+        }
     }
 
     WY_DebugIO::debug_print("File opened.");
@@ -118,79 +388,1063 @@ void WY_SerializeAgent::prepare_save_file()
 
 void WY_SerializeAgent::finalise_save_file()
 {
-    m_file.close();
-    if(m_file.fail()) {
-        WY_DebugIO::debug_print("Saving file failed.");
+    if(m_file_io == NULL) {
+        WY_DebugIO::debug_print("Trying to save to non-opened file.");
+        throw -1;
+    }
+    try {
+        if(m_save_index)
+            write_index();
+        if(m_save_mode == SAVE_VECTORED)
+            flush_save_batch();
+    } catch (int &e) {
+        close_io();
+        discard_save_temp();
         throw -1;
     }
 
+    commit_save_file();
+    WY_SerializeStats::record_latency(STATS_LATENCY_SAVE, m_stats_save_start);
     WY_DebugIO::debug_print("File saved.");
 }
 
 
+void WY_SerializeAgent::commit_save_file()
+{
+    int ret = 0;
+    if(m_save_durability != SAVE_DURABILITY_NONE)
+        ret = m_file_io->sync_file(m_save_durability == SAVE_DURABILITY_DATA);
+    if(close_io() != 0) /* Also reports writes the backend had not finished. */
+        ret = -1;
+    if(ret != 0) {
+        WY_DebugIO::debug_print("Saving file failed.");
+        discard_save_temp();
+        throw -1;
+    }
+
+    if(!m_save_temp.empty()) {
+        WY_SerializeStats::record_io(STATS_IO_RENAME);
+        if(rename(m_save_temp.c_str(), m_file_name.c_str()) != 0) { /* Replaces the previous file in one step. */
+            WY_DebugIO::debug_print("Rename file failed.");
+            discard_save_temp();
+            throw -1;
+        }
+        m_save_temp.clear();
+    }
+
+    if((m_save_durability == SAVE_DURABILITY_FULL) && !m_save_memory && (sync_directory(m_file_name) != 0)) { /* Makes the rename, or the creation of a new file, durable. */
+        WY_DebugIO::debug_print("Sync directory failed.");
+        throw -1;
+    }
+}
+
+
+int WY_SerializeAgent::open_io(const std::string &p_path, const IO_OPEN_MODE p_mode, const bool p_vectored) noexcept
+{
+    WY_SerializeIO * io = m_io;
+
+    close_io(); /* A file still open. */
+    if((p_mode == IO_OPEN_READ) ? m_load_memory : m_save_memory)
+        io = (p_mode == IO_OPEN_READ) ? &m_load_memory_io : &m_save_memory_io;
+    else if(io == NULL) {
+        switch(m_io_backend) {
+        case IO_BACKEND_FSTREAM:
+            io = &m_fstream_io;
+            break;
+        case IO_BACKEND_POSIX:
+            io = &m_posix_io;
+            break;
+        case IO_BACKEND_URING:
+        case IO_BACKEND_URING_DIRECT:
+            m_uring_io.set_direct(m_io_backend == IO_BACKEND_URING_DIRECT);
+            io = &m_uring_io;
+            break;
+        default: /* Small blocks are cheaper to gather in a stream buffer, batches are written in one call. */
+            io = p_vectored ? (WY_SerializeIO *)&m_posix_io : (WY_SerializeIO *)&m_fstream_io;
+            break;
+        }
+    }
+
+    if(io->open_file(p_path.c_str(), p_mode) != 0)
+        return -1;
+    m_file_io = io;
+    return 0;
+}
+
+
+int WY_SerializeAgent::close_io() noexcept
+{
+    if(m_file_io == NULL)
+        return 0;
+    const int ret = m_file_io->close_file();
+    m_file_io = NULL;
+    return ret;
+}
+
+
+int WY_SerializeAgent::sync_directory(const std::string &p_file) noexcept
+{
+    const size_t slash = p_file.find_last_of('/');
+    int fd;
+
+    if(slash == std::string::npos)
+        fd = open(".", O_RDONLY | O_DIRECTORY);
+    else if(slash == 0)
+        fd = open("/", O_RDONLY | O_DIRECTORY);
+    else {
+        char dir[PATH_MAX];
+        if(slash >= sizeof(dir))
+            return -1;
+        memcpy(dir, p_file.data(), slash);
+        dir[slash] = 0;
+        fd = open(dir, O_RDONLY | O_DIRECTORY);
+    }
+    WY_SerializeStats::record_io(STATS_IO_OPEN);
+    if(fd == -1)
+        return -1;
+    WY_SerializeStats::record_io(STATS_IO_SYNC);
+    int ret = (fsync(fd) == 0) ? 0 : -1;
+    if(close(fd) != 0)
+        ret = -1;
+    return ret;
+}
+
+
+void WY_SerializeAgent::create_save_temp()
+{
+    std::string name;
+
+    while(true) {
+        try {
+            name = m_file_name + "." + std::to_string(getpid()) + "." + std::to_string(g_save_temp_count.fetch_add(1)) + ".tmp";
+        } catch (std::exception &e) {
+            throw -1;
+        }
+        const int fd = open(name.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0666); /* Claims the name. Same permissions as the backends create files with. */
+        WY_SerializeStats::record_io(STATS_IO_OPEN);
+        if(fd != -1) {
+            close(fd);
+            break;
+        }
+        if(errno != EEXIST) {
+            WY_DebugIO::debug_print("Create temporary file failed.");
+            throw -1;
+        } /* Else left by a process that had the same ID, try the next name. */
+    }
+    m_save_temp.swap(name);
+}
+
+
+void WY_SerializeAgent::discard_save_temp() noexcept
+{
+    if(m_save_temp.empty())
+        return;
+    unlink(m_save_temp.c_str());
+    m_save_temp.clear();
+}
+
+
 void WY_SerializeAgent::append_save_file(S_SerializeData *__restrict__ const p_data)
 {
-    const unsigned int min_size = sizeof(S_SerializeData::m_type) + sizeof(S_SerializeData::m_size); /* Min size of data. */
-    if(!m_file.is_open()) {
+    S_SerializeBlock block;
+    std::vector<unsigned char> * buffer = &m_save_buffer;
+
+    if(m_save_mode == SAVE_VECTORED) {
+        if(m_file_io == NULL) {
+            WY_DebugIO::debug_print("Trying to save to non-opened file.");
+            throw -1;
+        }
+        /* Flush before encoding, as encoding never makes the block larger and the buffers are reused once written. */
+        const uint64_t stage_max = SERIALIZE_BLOCK_PREFIX_MAX + SERIALIZE_ALIGN_MAX + std::min<uint64_t>(p_data->m_size, m_batch_copy_max);
+        if((m_batch_stage_used+stage_max > m_batch_stage_size) || (m_batch_iov.size()+2 > m_batch_iov_max) || (m_batch_bytes >= m_batch_bytes_max))
+            flush_save_batch();
+        if(m_codec != NULL) { /* Encoded data must stay valid until the batch is written. */
+            try {
+                if(m_batch_buffers_used == m_batch_buffers.size())
+                    m_batch_buffers.emplace_back();
+            } catch (std::exception &e) {
+                throw -1;
+            }
+            buffer = &m_batch_buffers[m_batch_buffers_used];
+        }
+    }
+    prepare_save_block(p_data, &block, buffer);
+    const uint64_t offset = m_save_offset;
+    const unsigned int padding = (unsigned int)(-(offset + block.m_prefix_size) & (m_block_alignment - 1)); /* The data starts at a multiple of the alignment. */
+
+    if(m_save_index) {
+        try {
+            m_index.push_back({block.m_header.m_type, offset, block.m_header.m_size});
+        } catch (std::exception &e) {
+            throw -1;
+        }
+    }
+    m_save_offset += block.m_prefix_size + padding + block.m_data_size;
+
+    if(m_save_mode == SAVE_VECTORED) {
+        const bool copy = (block.m_data_size <= m_batch_copy_max); /* Small payloads are cheaper to copy than to pass as their own iovec. */
+        memcpy(&m_batch_stage[m_batch_stage_used], block.m_prefix, block.m_prefix_size);
+        memset(&m_batch_stage[m_batch_stage_used+block.m_prefix_size], 0, padding);
+        m_batch_stage_used += block.m_prefix_size + padding;
+        if(copy) {
+            if(block.m_data_size > 0)
+                memcpy(&m_batch_stage[m_batch_stage_used], block.m_data, block.m_data_size);
+            m_batch_stage_used += block.m_data_size;
+        } else { /* Queue the staged bytes so far, then the payload from the caller's memory or the encode buffer. */
+            m_batch_iov.push_back({&m_batch_stage[m_batch_stage_queued], m_batch_stage_used-m_batch_stage_queued});
+            m_batch_iov.push_back({(void *)block.m_data, block.m_data_size});
+            m_batch_stage_queued = m_batch_stage_used;
+            if(block.m_data != p_data->m_data)
+                ++m_batch_buffers_used;
+        }
+        m_batch_bytes += block.m_prefix_size + padding + block.m_data_size;
+        WY_SerializeStats::record_block_write(p_data->m_type, p_data->m_size, block.m_prefix_size + padding + block.m_data_size);
+        return;
+    }
+
+    if(m_file_io == NULL) {
         WY_DebugIO::debug_print("Trying to save to non-opened file.");
         throw -1;
     }
+    write_save_file_at(&block, offset);
+}
+
+
+void WY_SerializeAgent::prepare_save_block(const S_SerializeData *__restrict__ const p_data, S_SerializeBlock *__restrict__ const p_block, std::vector<unsigned char> *__restrict__ const p_buffer) const noexcept
+{
+    p_block->m_header = {p_data->m_type, 0, p_data->m_size};
+    p_block->m_data = p_data->m_data;
+    p_block->m_data_size = p_data->m_size;
+    p_block->m_source_size = p_data->m_size;
 
-    m_file.write((char *)p_data, min_size);
-    m_file.write((char *)(p_data->m_data), p_data->m_size);
-    if(m_file.fail()){
+    if((m_codec != NULL) && (p_data->m_size >= m_codec_min_size) && (p_data->m_size > SERIALIZE_CODEC_PREFIX_SIZE+1)) {
+        bool allocated = true;
+        try {
+            if(p_buffer->size() < p_data->m_size)
+                p_buffer->resize(p_data->m_size);
+        } catch (std::exception &e) {
+            allocated = false; /* Store raw. */
+        }
+
+        /* Only keep the encoded data if it is smaller than the raw data, including the size prefix. */
+        const uint64_t encoded = allocated ? m_codec->encode(p_data->m_data, p_data->m_size, p_buffer->data()+SERIALIZE_CODEC_PREFIX_SIZE, p_data->m_size-SERIALIZE_CODEC_PREFIX_SIZE-1) : 0;
+        if(encoded != 0) {
+            encode_le64(p_buffer->data(), p_data->m_size);
+            p_block->m_header.m_flags = m_codec->get_codec_id() & SERIALIZE_FLAG_CODEC_MASK;
+            p_block->m_data = p_buffer->data();
+            p_block->m_data_size = SERIALIZE_CODEC_PREFIX_SIZE + encoded;
+        }
+    }
+
+    p_block->m_header.m_size = p_block->m_data_size;
+    if(m_save_crc) {
+        p_block->m_header.m_flags |= SERIALIZE_FLAG_CRC;
+        p_block->m_header.m_size += SERIALIZE_CRC_SIZE;
+    }
+    if(p_data->m_instance != 0) {
+        p_block->m_header.m_flags |= SERIALIZE_FLAG_INSTANCE;
+        p_block->m_header.m_size += SERIALIZE_INSTANCE_SIZE;
+    }
+    const unsigned int header_size = encode_block_header(p_block->m_prefix, &p_block->m_header, m_block_compact);
+    p_block->m_prefix_size = header_size + (m_save_crc ? SERIALIZE_CRC_SIZE : 0); /* The CRC is filled in once the rest of the prefix is known. */
+    if(p_data->m_instance != 0) {
+        encode_le32(p_block->m_prefix+p_block->m_prefix_size, p_data->m_instance);
+        p_block->m_prefix_size += SERIALIZE_INSTANCE_SIZE;
+    }
+    if(m_save_crc) { /* The CRC covers the header, so a corrupt type or size is caught as well. */
+        const unsigned int crc_end = header_size + SERIALIZE_CRC_SIZE;
+        uint32_t crc = WY_Crc32c::update(0, p_block->m_prefix, header_size);
+        crc = WY_Crc32c::update(crc, p_block->m_prefix+crc_end, p_block->m_prefix_size-crc_end);
+        crc = WY_Crc32c::update(crc, p_block->m_data, p_block->m_data_size);
+        encode_le32(p_block->m_prefix+header_size, crc);
+    }
+}
+
+
+uint64_t WY_SerializeAgent::get_save_block_size(const S_SerializeData *__restrict__ const p_data) const noexcept
+{
+    S_SerializeHeader header = {p_data->m_type, 0, p_data->m_size};
+    unsigned char prefix[SERIALIZE_BLOCK_PREFIX_MAX];
+
+    /* The same header as prepare_save_block() writes for the block stored raw. */
+    if(m_save_crc) {
+        header.m_flags |= SERIALIZE_FLAG_CRC;
+        header.m_size += SERIALIZE_CRC_SIZE;
+    }
+    if(p_data->m_instance != 0) {
+        header.m_flags |= SERIALIZE_FLAG_INSTANCE;
+        header.m_size += SERIALIZE_INSTANCE_SIZE;
+    }
+    return encode_block_header(prefix, &header, m_block_compact) + header.m_size;
+}
+
+
+uint64_t WY_SerializeAgent::reserve_save_file(const S_SerializeBlock *__restrict__ const p_block)
+{
+    if((m_save_mode != SAVE_VECTORED) || (m_file_io == NULL)) {
+        WY_DebugIO::debug_print("Positional writes need an opened file in SAVE_VECTORED mode.");
+        throw -1;
+    }
+    flush_save_batch(); /* Blocks queued by append_save_file() come first in the file. */
+
+    const uint64_t offset = m_save_offset;
+    if(m_save_index) {
+        try {
+            m_index.push_back({p_block->m_header.m_type, offset, p_block->m_header.m_size});
+        } catch (std::exception &e) {
+            throw -1;
+        }
+    }
+    m_save_offset += p_block->m_prefix_size + (-(offset + p_block->m_prefix_size) & (m_block_alignment - 1)) + p_block->m_data_size; /* Same padding as write_save_file_at(). */
+    m_batch_offset = m_save_offset;
+    return offset;
+}
+
+
+void WY_SerializeAgent::write_save_file_at(const S_SerializeBlock *__restrict__ const p_block, const uint64_t p_offset) const
+{
+    struct iovec iov[3];
+    int count = 0;
+
+    const unsigned int padding = (unsigned int)(-(p_offset + p_block->m_prefix_size) & (m_block_alignment - 1));
+    iov[count++] = {(void *)p_block->m_prefix, p_block->m_prefix_size};
+    if(padding > 0)
+        iov[count++] = {(void *)g_padding, padding};
+    if(p_block->m_data_size > 0)
+        iov[count++] = {(void *)p_block->m_data, p_block->m_data_size};
+    if(m_file_io->write_file(iov, count, p_offset) != 0) {
         WY_DebugIO::debug_print("Write to file NOK. Data Type: ");
-        WY_DebugIO::debug_print(p_data->m_type);
+        WY_DebugIO::debug_print(p_block->m_header.m_type);
+        throw -1;
+    }
+    WY_SerializeStats::record_block_write(p_block->m_header.m_type, p_block->m_source_size, p_block->m_prefix_size + padding + p_block->m_data_size);
+}
+
+
+void WY_SerializeAgent::flush_save_batch()
+{
+    if(m_batch_stage_used > m_batch_stage_queued) /* Queue the staged bytes not yet referenced. */
+        m_batch_iov.push_back({&m_batch_stage[m_batch_stage_queued], m_batch_stage_used-m_batch_stage_queued});
+
+    if(m_file_io->write_file(m_batch_iov.data(), m_batch_iov.size(), m_batch_offset) != 0) {
+        WY_DebugIO::debug_print("Write batch to file NOK.");
         throw -1;
     }
 
-    WY_DebugIO::debug_print("Write to file OK. Data Type / size: ");
-    WY_DebugIO::debug_print(p_data->m_type);
-    WY_DebugIO::debug_print(min_size + p_data->m_size);
+    m_batch_offset += m_batch_bytes;
+    m_batch_iov.clear();
+    m_batch_stage_used = 0;
+    m_batch_stage_queued = 0;
+    m_batch_bytes = 0;
+    m_batch_buffers_used = 0;
 }
 
 
 void WY_SerializeAgent::clear_loaded_file_buffer() noexcept
 {
     clear_file_buffer();
+    WY_SerializeStats::record_latency(STATS_LATENCY_LOAD, m_stats_load_start);
+    m_stats_load_start = 0;
 }
 
 
 int WY_SerializeAgent::load_next_serializable_data(S_SerializeData *__restrict__ const p_data) noexcept
 {
-    const unsigned int min_size = sizeof(S_SerializeData::m_type) + sizeof(S_SerializeData::m_size); /* Min size of data required. */
-    if((m_file_data_size-m_file_data_offset) >= min_size) { /* Is there enough data in m_file_data. */
-        memcpy(p_data, m_file_data+m_file_data_offset, min_size);
-        m_file_data_offset += min_size;
-    } else
+    S_SerializeView view;
+    if(load_next_serializable_view(&view) != 0)
         return -1;
-    
-    if(m_file_data_size - m_file_data_offset >= p_data->m_size) {
-        try {
-            p_data->m_data = new unsigned char[p_data->m_size];
-            memcpy(p_data->m_data, m_file_data+m_file_data_offset, p_data->m_size);
-        } catch (std::exception &e) {
+
+    p_data->m_type = view.m_type;
+    p_data->m_size = view.m_size;
+    p_data->m_instance = view.m_instance;
+    if(m_view_decoded) { /* Already a private copy made by decoding. */
+        p_data->m_data = (unsigned char *)view.m_data;
+        return 0;
+    }
+    if(m_file_data_mode == LOAD_STREAM) /* One buffer for all blocks, so streaming a file does not keep every block alive. */
+        p_data->m_data = resize_stream_buffer(&m_stream_copy, view.m_size, 0, false);
+    else
+        p_data->m_data = (unsigned char *)m_allocator->allocate(view.m_size, std::max(16u, m_file_alignment)); /* Copies are at least as aligned as the data in the file. */
+    if(p_data->m_data == NULL) {
+        WY_DebugIO::debug_print("Memory alloc error loading data segment. Data Type: ");
+        WY_DebugIO::debug_print(view.m_type);
+        p_data->m_size = 0;
+        return -1;
+    }
+    memcpy(p_data->m_data, view.m_data, view.m_size);
+    return 0;
+}
+
+
+int WY_SerializeAgent::load_next_serializable_view(S_SerializeView *__restrict__ const p_view) noexcept
+{
+    S_SerializeHeader header;
+
+    m_view_decoded = false;
+    if(m_file_data_mode == LOAD_STREAM)
+        return load_next_streamed_view(p_view);
+
+    const unsigned int header_size = decode_block_header((const unsigned char *)m_file_data+m_file_data_offset, m_file_data_size-m_file_data_offset, &header);
+    if(header_size == 0) /* Not enough data in m_file_data, or an invalid header. */
+        return -1;
+    m_file_data_offset += header_size;
+
+    const unsigned int padding = get_block_padding(&header, m_file_data_offset, m_file_alignment); /* The buffer starts at file offset 0, so the offset in the buffer is the file offset. */
+    p_view->m_type = header.m_type;
+    p_view->m_size = header.m_size;
+    if((m_file_data_size - m_file_data_offset >= p_view->m_size) && (m_file_data_size - m_file_data_offset - p_view->m_size >= padding))
+        p_view->m_data = (const unsigned char *)(m_file_data+m_file_data_offset);
+    else
+        return -1;
+
+    m_file_data_offset += p_view->m_size + padding;
+    return unpack_view(&header, p_view, padding, m_file_data_offset <= m_crc_checked_end);
+}
+
+
+int WY_SerializeAgent::load_next_streamed_view(S_SerializeView *__restrict__ const p_view) noexcept
+{
+    S_SerializeHeader header;
+    bool crc_checked = false; /* Blocks in the window are checked by unpack_view(). */
+
+    if(fill_stream_window(std::min<uint64_t>(SERIALIZE_HEADER_MAX, (m_file_data_size-m_file_data_offset) + m_stream_remaining)) != 0)
+        return -1;
+    const unsigned int header_size = decode_block_header((const unsigned char *)m_file_data+m_file_data_offset, m_file_data_size-m_file_data_offset, &header);
+    if(header_size == 0)
+        return -1;
+    m_file_data_offset += header_size;
+
+    const uint64_t available = (m_file_data_size-m_file_data_offset) + m_stream_remaining;
+    const unsigned int padding = get_block_padding(&header, m_stream_offset+m_file_data_offset, m_file_alignment);
+    p_view->m_type = header.m_type;
+    p_view->m_size = header.m_size;
+    if((header.m_size > available) || (padding > available-header.m_size)) /* Block runs past the end of the file. */
+        return -1;
+    const uint64_t block_size = header.m_size + padding;
+
+    if((block_size <= m_file_data_size-m_file_data_offset) || (block_size <= m_stream_window_size - (m_file_alignment-1))) { /* Block is in the window or fits in it with its alignment, return it in place. */
+        if(fill_stream_window(block_size) != 0)
+            return -1;
+        p_view->m_data = (const unsigned char *)(m_file_data+m_file_data_offset);
+        m_file_data_offset += block_size;
+    } else { /* Block is larger than the window, read it into its own buffer. */
+        const uint64_t buffered = m_file_data_size-m_file_data_offset;
+        unsigned char * const block = resize_stream_buffer(&m_stream_block, block_size, m_stream_offset+m_file_data_offset, true); /* Do not keep the largest block seen so far alive. */
+        if(block == NULL) {
             WY_DebugIO::debug_print("Memory alloc error loading data segment. Data Type: ");
-            WY_DebugIO::debug_print(p_data->m_type);        
+            WY_DebugIO::debug_print(header.m_type);
             return -1;
         }
-    } else
+        memcpy(block, m_file_data+m_file_data_offset, buffered);
+        if(read_stream_block(block, buffered, block_size, m_stream_offset+m_file_data_size, &header, padding, &crc_checked) != 0)
+            return -1;
+        m_stream_remaining -= block_size-buffered;
+        m_stream_offset += m_file_data_offset + block_size; /* The window restarts right after the block. */
+        m_file_data_size = 0;
+        m_file_data_offset = 0;
+        p_view->m_data = block;
+    }
+    return unpack_view(&header, p_view, padding, crc_checked);
+}
+
+
+int WY_SerializeAgent::read_file_buffer() noexcept
+{
+    S_SerializeFileHeader file_header;
+    unsigned char * const data = (unsigned char *)m_file_data;
+    uint64_t done = std::min<uint64_t>(m_file_data_size, m_crc_chunk_size);
+
+    if(m_file_io->read_file(data, done, 0) != 0)
+        return -1;
+    if(decode_file_header(data, done, &file_header) > 0) { /* Files without one are version 0, whose blocks have no CRC. read_file_header() sets the same format again. */
+        m_file_compact = (file_header.m_options & SERIALIZE_FILE_COMPACT) != 0;
+        m_file_alignment = get_file_alignment(&file_header);
+        m_crc_active = true;
+        m_crc_next = SERIALIZE_FILE_HEADER_SIZE;
+        check_loaded_crcs(done);
+    }
+    while(done < m_file_data_size) {
+        const uint64_t size = m_crc_active ? std::min<uint64_t>(m_file_data_size-done, m_crc_chunk_size) : m_file_data_size-done; /* The rest at once if nothing is checked. */
+        if(m_file_io->read_file(data+done, size, done) != 0)
+            return -1;
+        done += size;
+        check_loaded_crcs(done);
+    }
+    m_crc_active = false;
+    return 0;
+}
+
+
+void WY_SerializeAgent::check_loaded_crcs(const uint64_t p_end) noexcept
+{
+    const unsigned char * const data = (const unsigned char *)m_file_data;
+    unsigned char header_data[SERIALIZE_HEADER_MAX];
+    S_SerializeHeader header;
+
+    while(m_crc_active) {
+        if(m_crc_data_end != 0) { /* Add what has been read of the block being checked. */
+            const uint64_t end = std::min(p_end, m_crc_data_end);
+            m_crc_value = WY_Crc32c::update(m_crc_value, data+m_crc_data, end-m_crc_data);
+            m_crc_data = end;
+            if(end < m_crc_data_end)
+                return;
+            if(m_crc_value != m_crc_expected) /* Left to unpack_view(), which reports it. */
+                break;
+            m_crc_checked_end = m_crc_data_end;
+            m_crc_next = m_crc_data_end;
+            m_crc_data_end = 0;
+            continue;
+        }
+
+        const uint64_t avail = p_end-m_crc_next;
+        if((avail < SERIALIZE_BLOCK_PREFIX_MAX) && (p_end < m_file_data_size))
+            return; /* Wait for the whole prefix of the block. */
+        const unsigned int header_size = decode_block_header(data+m_crc_next, avail, &header);
+        if((header_size == 0) || !(header.m_flags & SERIALIZE_FLAG_CRC))
+            break;
+        const uint64_t prefix = SERIALIZE_CRC_SIZE + ((header.m_flags & SERIALIZE_FLAG_INSTANCE) ? SERIALIZE_INSTANCE_SIZE : 0);
+        const uint64_t start = m_crc_next+header_size;
+        const unsigned int padding = get_block_padding(&header, start, m_file_alignment);
+        if((header.m_size < prefix) || (prefix > avail-header_size) || (header.m_size > m_file_data_size-start) || (padding > m_file_data_size-start-header.m_size))
+            break;
+
+        encode_block_header(header_data, &header, m_file_compact); /* The same bytes unpack_view() checks. */
+        m_crc_value = WY_Crc32c::update(0, header_data, header_size);
+        if(header.m_flags & SERIALIZE_FLAG_INSTANCE)
+            m_crc_value = WY_Crc32c::update(m_crc_value, data+start+SERIALIZE_CRC_SIZE, SERIALIZE_INSTANCE_SIZE);
+        m_crc_expected = decode_le32(data+start);
+        m_crc_data = start+prefix+padding;
+        m_crc_data_end = start+header.m_size+padding;
+        if(m_crc_data == m_crc_data_end) { /* No data, checked now so the loop does not take it for a block boundary. */
+            if(m_crc_value != m_crc_expected)
+                break;
+            m_crc_checked_end = m_crc_data_end;
+            m_crc_next = m_crc_data_end;
+            m_crc_data_end = 0;
+        }
+    }
+    m_crc_active = false;
+}
+
+
+int WY_SerializeAgent::fill_stream_window(const uint64_t p_size) noexcept
+{
+    uint64_t buffered = m_file_data_size-m_file_data_offset;
+    if(buffered >= p_size)
+        return 0;
+    if(p_size-buffered > m_stream_remaining)
+        return -1;
+
+    /* Keep the unread tail, drop what has been parsed. The tail moves to the front of the window, but keeps its file offset modulo the alignment, so aligned block data stays aligned in memory. */
+    const uint64_t phase = (m_stream_offset+m_file_data_offset) & (m_file_alignment-1);
+    if(p_size > m_stream_window_size-phase)
+        return -1;
+    memmove(m_file_data+phase, m_file_data+m_file_data_offset, buffered);
+    m_stream_offset += m_file_data_offset-phase;
+    m_file_data_offset = phase;
+    m_file_data_size = phase+buffered;
+
+    const uint64_t read_size = std::min(m_stream_window_size-m_file_data_size, m_stream_remaining);
+    if(m_file_io->read_file((unsigned char *)m_file_data+m_file_data_size, read_size, m_stream_offset+m_file_data_size) != 0) {
+        WY_DebugIO::debug_print("Read file content failed.");
+        return -1;
+    }
+    m_file_data_size += read_size;
+    m_stream_remaining -= read_size;
+    return 0;
+}
+
+
+int WY_SerializeAgent::read_stream_block(unsigned char *__restrict__ const p_block, const uint64_t p_buffered, const uint64_t p_size, const uint64_t p_offset, const S_SerializeHeader *__restrict__ const p_header, const unsigned int p_padding, bool *__restrict__ const p_crc_checked) noexcept
+{
+    const uint64_t prefix = SERIALIZE_CRC_SIZE + ((p_header->m_flags & SERIALIZE_FLAG_INSTANCE) ? SERIALIZE_INSTANCE_SIZE : 0);
+    unsigned char header_data[SERIALIZE_HEADER_MAX];
+    uint64_t done = p_buffered, checked = 0; /* Bytes of the block added to crc, 0 until the prefix has been read. */
+    uint32_t crc = 0;
+
+    *p_crc_checked = false;
+    if(!(p_header->m_flags & SERIALIZE_FLAG_CRC) || (p_header->m_size < prefix)) /* Nothing to check here. */
+        return m_file_io->read_file(p_block+p_buffered, p_size-p_buffered, p_offset);
+
+    while(true) {
+        if((checked == 0) && (done >= prefix+p_padding)) {
+            const unsigned int header_size = encode_block_header(header_data, p_header, m_file_compact);
+            crc = WY_Crc32c::update(0, header_data, header_size);
+            if(p_header->m_flags & SERIALIZE_FLAG_INSTANCE)
+                crc = WY_Crc32c::update(crc, p_block+SERIALIZE_CRC_SIZE, SERIALIZE_INSTANCE_SIZE);
+            checked = prefix+p_padding;
+        }
+        if(checked != 0) {
+            crc = WY_Crc32c::update(crc, p_block+checked, done-checked);
+            checked = done;
+        }
+        if(done == p_size)
+            break;
+        const uint64_t size = std::min<uint64_t>(p_size-done, m_crc_chunk_size);
+        if(m_file_io->read_file(p_block+done, size, p_offset+done-p_buffered) != 0)
+            return -1;
+        done += size;
+    }
+    *p_crc_checked = (crc == decode_le32(p_block));
+    return 0;
+}
+
+
+uint64_t WY_SerializeAgent::get_load_offset() const noexcept
+{
+    if(m_file_data_mode == LOAD_STREAM)
+        return m_stream_offset + m_file_data_offset;
+    return m_file_data_offset;
+}
+
+
+bool WY_SerializeAgent::is_load_end() const noexcept
+{
+    if((m_file_data_mode == LOAD_STREAM) && (m_stream_remaining > 0))
+        return false;
+    return m_file_data_offset >= m_file_data_size;
+}
+
+
+bool WY_SerializeAgent::has_index() const noexcept
+{
+    return !m_index.empty();
+}
+
+
+int WY_SerializeAgent::load_serializable_view_by_type(const unsigned int p_type, S_SerializeView *__restrict__ const p_view) noexcept
+{
+    S_SerializeHeader header;
+    unsigned char header_data[SERIALIZE_HEADER_MAX];
+    unsigned int header_size, padding;
+    bool crc_checked;
+
+    auto it = m_index_lookup.find(p_type);
+    if(it == m_index_lookup.end())
+        return -1;
+    const S_SerializeIndexEntry &entry = m_index[it->second];
+
+    if(m_file_data_mode != LOAD_STREAM) { /* The whole file is in memory, the index was checked against its size in read_index(). */
+        header_size = decode_block_header((const unsigned char *)m_file_data+entry.m_offset, m_file_data_size-entry.m_offset, &header);
+        if(header_size == 0)
+            return -1;
+        padding = get_block_padding(&header, entry.m_offset+header_size, m_file_alignment);
+        if((header.m_size > m_file_data_size-entry.m_offset-header_size) || (padding > m_file_data_size-entry.m_offset-header_size-header.m_size))
+            return -1;
+        p_view->m_data = (const unsigned char *)m_file_data+entry.m_offset+header_size;
+        crc_checked = (entry.m_offset+header_size+header.m_size+padding <= m_crc_checked_end);
+    } else { /* Read only this block. Reads are positional, so sequential loading is not affected. */
+        if(m_file_io->read_file(header_data, SERIALIZE_HEADER_MAX, entry.m_offset) != 0) /* A compact header may be shorter, the rest is read again below. The index follows the blocks, so this stays within the file. */
+            return -1;
+        header_size = decode_block_header(header_data, SERIALIZE_HEADER_MAX, &header);
+        if((header_size == 0) || (header.m_size != entry.m_size))
+            return -1;
+        padding = get_block_padding(&header, entry.m_offset+header_size, m_file_alignment);
+        unsigned char * const block = resize_stream_buffer(&m_stream_block, header.m_size+padding, entry.m_offset+header_size, true);
+        if(block == NULL)
+            return -1;
+        if(read_stream_block(block, 0, header.m_size+padding, entry.m_offset+header_size, &header, padding, &crc_checked) != 0)
+            return -1;
+        p_view->m_data = block;
+    }
+
+    if((header.m_type != entry.m_type) || (header.m_size != entry.m_size)) { /* Index does not match the block it points to. */
+        WY_DebugIO::debug_print("Block index mismatch. Data Type: ");
+        WY_DebugIO::debug_print(p_type);
+        return -1;
+    }
+    p_view->m_type = header.m_type;
+    p_view->m_size = header.m_size;
+    return unpack_view(&header, p_view, padding, crc_checked);
+}
+
+
+int WY_SerializeAgent::read_file_header() noexcept
+{
+    S_SerializeFileHeader header;
+
+    m_file_compact = false;
+    m_file_alignment = 1;
+    if((m_file_data_mode == LOAD_STREAM) && (fill_stream_window(std::min<uint64_t>(SERIALIZE_FILE_HEADER_SIZE, m_stream_remaining)) != 0))
+        return -1;
+    const int size = decode_file_header((const unsigned char *)m_file_data+m_file_data_offset, m_file_data_size-m_file_data_offset, &header);
+    if(size < 0) {
+        WY_DebugIO::debug_print("File format version not supported: ");
+        WY_DebugIO::debug_print(header.m_version);
+        return -1;
+    }
+    m_file_version = header.m_version;
+    m_file_compact = (header.m_options & SERIALIZE_FILE_COMPACT) != 0;
+    m_file_alignment = get_file_alignment(&header);
+    m_file_data_offset += size;
+    return 0;
+}
+
+
+int WY_SerializeAgent::read_file_format(const std::string &p_file, S_SerializeFileHeader *__restrict__ const p_header, unsigned int *__restrict__ const p_header_size) noexcept
+{
+    unsigned char data[SERIALIZE_FILE_HEADER_SIZE];
+
+    const int fd = open(p_file.c_str(), O_RDONLY);
+    WY_SerializeStats::record_io(STATS_IO_OPEN);
+    if(fd == -1)
+        return -1;
+    const ssize_t size = pread(fd, data, SERIALIZE_FILE_HEADER_SIZE, 0);
+    WY_SerializeStats::record_io(STATS_IO_READ);
+    close(fd);
+    if(size < 0)
+        return -1;
+
+    const int header_size = decode_file_header(data, size, p_header);
+    if(header_size < 0)
+        return -1;
+    *p_header_size = header_size;
+    return 0;
+}
+
+
+unsigned int WY_SerializeAgent::encode_block_header(unsigned char *__restrict__ const p_dst, const S_SerializeHeader *__restrict__ const p_header, const bool p_compact) noexcept
+{
+    if(p_compact)
+        return WY_SerializeVarint::encode_header(p_dst, p_header);
+    encode_serialize_header(p_dst, p_header);
+    return SERIALIZE_HEADER_SIZE;
+}
+
+
+unsigned int WY_SerializeAgent::decode_block_header(const unsigned char *__restrict__ const p_src, const uint64_t p_avail, S_SerializeHeader *__restrict__ const p_header) const noexcept
+{
+    if(m_file_compact)
+        return WY_SerializeVarint::decode_header(p_src, p_avail, p_header);
+    if(m_file_version == 0) {
+        if(p_avail < SERIALIZE_LEGACY_HEADER_SIZE)
+            return 0;
+        decode_legacy_header(p_src, p_header);
+        return SERIALIZE_LEGACY_HEADER_SIZE;
+    }
+    if(p_avail < SERIALIZE_HEADER_SIZE)
+        return 0;
+    decode_serialize_header(p_src, p_header);
+    return SERIALIZE_HEADER_SIZE;
+}
+
+
+int WY_SerializeAgent::unpack_view(const S_SerializeHeader *__restrict__ const p_header, S_SerializeView *__restrict__ const p_view, const unsigned int p_padding, const bool p_crc_checked) noexcept
+{
+    const unsigned int codec_id = p_header->m_flags & SERIALIZE_FLAG_CODEC_MASK;
+    const WY_SerializeCodec * codec = NULL;
+    uint64_t decoded_size;
+    unsigned char * decoded;
+
+    p_view->m_instance = 0;
+    if((p_header->m_flags & ~(SERIALIZE_FLAG_CODEC_MASK | SERIALIZE_FLAG_CRC | SERIALIZE_FLAG_INSTANCE)) != 0) { /* Options from a newer version. */
+        WY_DebugIO::debug_print("Unknown block flags. Data Type: ");
+        WY_DebugIO::debug_print(p_view->m_type);
         return -1;
+    }
+
+    uint32_t crc = 0;
+    if(p_header->m_flags & SERIALIZE_FLAG_CRC) {
+        if(p_view->m_size < SERIALIZE_CRC_SIZE)
+            return -1;
+        crc = decode_le32(p_view->m_data);
+        p_view->m_data += SERIALIZE_CRC_SIZE;
+        p_view->m_size -= SERIALIZE_CRC_SIZE;
+    }
 
-    m_file_data_offset += p_data->m_size;
-    WY_DebugIO::debug_print("Data segment loaded. Data Type / size: ");
-    WY_DebugIO::debug_print(p_data->m_type);
-    WY_DebugIO::debug_print(min_size + p_data->m_size);
+    const unsigned char * instance = NULL;
+    if(p_header->m_flags & SERIALIZE_FLAG_INSTANCE) {
+        if(p_view->m_size < SERIALIZE_INSTANCE_SIZE)
+            return -1;
+        instance = p_view->m_data;
+        p_view->m_instance = decode_le32(instance);
+        p_view->m_data += SERIALIZE_INSTANCE_SIZE;
+        p_view->m_size -= SERIALIZE_INSTANCE_SIZE;
+    }
+    p_view->m_data += p_padding; /* Not counted in the size in the header. */
+
+    if((p_header->m_flags & SERIALIZE_FLAG_CRC) && !p_crc_checked) { /* Covers the header, the instance ID and the data, but not the padding. */
+        unsigned char header_data[SERIALIZE_HEADER_MAX];
+        const unsigned int header_size = encode_block_header(header_data, p_header, m_file_compact); /* Encoding is exact, so this is the header as it is in the file. */
+        uint32_t check = WY_Crc32c::update(0, header_data, header_size);
+        if(instance != NULL)
+            check = WY_Crc32c::update(check, instance, SERIALIZE_INSTANCE_SIZE);
+        if(WY_Crc32c::update(check, p_view->m_data, p_view->m_size) != crc) {
+            WY_DebugIO::debug_print("CRC mismatch in data segment. Data Type: ");
+            WY_DebugIO::debug_print(p_view->m_type);
+            return -1;
+        }
+    }
+
+    const uint64_t header_size = m_file_compact ? WY_SerializeVarint::get_header_size(p_header) : ((m_file_version == 0) ? SERIALIZE_LEGACY_HEADER_SIZE : SERIALIZE_HEADER_SIZE);
+    const uint64_t file_size = header_size + p_header->m_size + p_padding;
+    if(codec_id == 0) {
+        WY_SerializeStats::record_block_read(p_header->m_type, p_view->m_size, file_size);
+        return 0;
+    }
+
+    if((m_codec != NULL) && (m_codec->get_codec_id() == codec_id))
+        codec = m_codec;
+    else if(m_lz_codec.get_codec_id() == codec_id)
+        codec = &m_lz_codec;
+    if((codec == NULL) || (p_view->m_size < SERIALIZE_CODEC_PREFIX_SIZE)) {
+        WY_DebugIO::debug_print("Cannot decode data segment. Data Type: ");
+        WY_DebugIO::debug_print(p_view->m_type);
+        return -1;
+    }
+
+    decoded_size = decode_le64(p_view->m_data);
+    if(decoded_size > codec->get_max_decoded_size(p_view->m_size-SERIALIZE_CODEC_PREFIX_SIZE))
+        return -1;
+    if(m_file_data_mode == LOAD_STREAM) /* Like the window, only valid until the next block. */
+        decoded = resize_stream_buffer(&m_stream_decoded, decoded_size, 0, false);
+    else
+        decoded = (unsigned char *)m_allocator->allocate(decoded_size, std::max(16u, m_file_alignment));
+    if(decoded == NULL)
+        return -1;
+
+    if(codec->decode(p_view->m_data+SERIALIZE_CODEC_PREFIX_SIZE, p_view->m_size-SERIALIZE_CODEC_PREFIX_SIZE, decoded, decoded_size) != 0) {
+        WY_DebugIO::debug_print("Decoding data segment failed. Data Type: ");
+        WY_DebugIO::debug_print(p_view->m_type);
+        return -1;
+    }
+    p_view->m_data = decoded;
+    p_view->m_size = decoded_size;
+    m_view_decoded = true;
+    WY_SerializeStats::record_block_read(p_header->m_type, p_view->m_size, file_size);
     return 0;
 }
 
 
+unsigned char * WY_SerializeAgent::resize_stream_buffer(std::vector<unsigned char> *__restrict__ const p_buffer, const uint64_t p_size, const uint64_t p_offset, const bool p_shrink) const noexcept
+{
+    const uint64_t slack = m_file_alignment-1; /* Room to move the bytes to the alignment they have in the file. */
+    try {
+        p_buffer->resize(std::max<uint64_t>(p_size+slack, 1)); /* An empty vector may have no memory at all, which would read as an allocation failure. */
+        if(p_shrink)
+            p_buffer->shrink_to_fit();
+    } catch (std::exception &e) {
+        return NULL;
+    }
+    return p_buffer->data() + ((p_offset - (uintptr_t)p_buffer->data()) & slack);
+}
+
+
+void WY_SerializeAgent::read_index() noexcept
+{
+    unsigned char trailer[SERIALIZE_INDEX_TRAILER_SIZE];
+    uint64_t count, index_offset, magic;
+    const unsigned char * entries = NULL;
+    std::vector<unsigned char> stream_entries;
+    const uint64_t header_min = 3; /* Smallest compact block header. The file header is only read after the index, so the format is not known yet. */
+
+    const uint64_t file_size = (m_file_data_mode == LOAD_STREAM) ? m_stream_remaining : m_file_data_size;
+    if(file_size < SERIALIZE_INDEX_TRAILER_SIZE)
+        return;
+
+    if(m_file_data_mode == LOAD_STREAM) {
+        if(m_file_io->read_file(trailer, SERIALIZE_INDEX_TRAILER_SIZE, file_size-SERIALIZE_INDEX_TRAILER_SIZE) != 0)
+            return;
+    } else
+        memcpy(trailer, m_file_data+file_size-SERIALIZE_INDEX_TRAILER_SIZE, SERIALIZE_INDEX_TRAILER_SIZE);
+    count = decode_le64(trailer);
+    index_offset = decode_le64(trailer+8);
+    magic = decode_le64(trailer+16);
+
+    /* A file without an index simply ends in block data, so anything inconsistent means there is no index. */
+    if((magic != SERIALIZE_INDEX_MAGIC) || (index_offset > file_size-SERIALIZE_INDEX_TRAILER_SIZE)
+        || (count != (file_size-SERIALIZE_INDEX_TRAILER_SIZE-index_offset)/SERIALIZE_INDEX_ENTRY_SIZE)
+        || ((file_size-SERIALIZE_INDEX_TRAILER_SIZE-index_offset)%SERIALIZE_INDEX_ENTRY_SIZE != 0))
+        return;
+
+    try {
+        if(m_file_data_mode == LOAD_STREAM) {
+            stream_entries.resize(count*SERIALIZE_INDEX_ENTRY_SIZE);
+            if(m_file_io->read_file(stream_entries.data(), stream_entries.size(), index_offset) != 0)
+                goto err_exit;
+            entries = stream_entries.data();
+        } else
+            entries = (const unsigned char *)m_file_data+index_offset;
+
+        m_index.resize(count);
+        m_index_lookup.reserve(count);
+        for(uint64_t i=0; i<count; i++) {
+            S_SerializeIndexEntry &entry = m_index[i];
+            entry.m_type = decode_le32(entries+i*SERIALIZE_INDEX_ENTRY_SIZE);
+            entry.m_offset = decode_le64(entries+i*SERIALIZE_INDEX_ENTRY_SIZE+8);
+            entry.m_size = decode_le64(entries+i*SERIALIZE_INDEX_ENTRY_SIZE+16);
+            if((entry.m_offset > index_offset) || (index_offset-entry.m_offset < header_min) || (entry.m_size > index_offset-entry.m_offset-header_min))
+                goto err_exit; /* Entry points outside the block data. The exact header size is checked when the block is loaded. */
+            m_index_lookup.emplace(entry.m_type, i); /* Keeps the first block of each type. */
+        }
+    } catch (std::exception &e) {
+        goto err_exit;
+    }
+
+    if(m_file_data_mode == LOAD_STREAM)
+        m_stream_remaining = index_offset;
+    else
+        m_file_data_size = index_offset;
+    WY_DebugIO::debug_print("Block index loaded. Blocks: ");
+    WY_DebugIO::debug_print(count);
+    return;
+
+err_exit:
+    WY_DebugIO::debug_print("Block index invalid, ignored.");
+    m_index.clear();
+    m_index_lookup.clear();
+}
+
+
+void WY_SerializeAgent::write_index()
+{
+    std::vector<unsigned char> data;
+    const uint64_t count = m_index.size();
+    const uint32_t reserved = 0;
+
+    try {
+        data.resize(count*SERIALIZE_INDEX_ENTRY_SIZE + SERIALIZE_INDEX_TRAILER_SIZE);
+    } catch (std::exception &e) {
+        throw -1;
+    }
+
+    unsigned char * p = data.data();
+    for(const S_SerializeIndexEntry &entry : m_index) {
+        encode_le32(p, entry.m_type);
+        encode_le32(p+4, reserved);
+        encode_le64(p+8, entry.m_offset);
+        encode_le64(p+16, entry.m_size);
+        p += SERIALIZE_INDEX_ENTRY_SIZE;
+    }
+    encode_le64(p, count);
+    encode_le64(p+8, m_save_offset); /* The index starts right after the last block. */
+    encode_le64(p+16, SERIALIZE_INDEX_MAGIC);
+
+    write_save_bytes(data.data(), data.size());
+    WY_DebugIO::debug_print("Block index written. Blocks: ");
+    WY_DebugIO::debug_print(count);
+}
+
+
+void WY_SerializeAgent::write_save_bytes(const unsigned char *__restrict__ const p_data, const uint64_t p_size)
+{
+    if(m_save_mode == SAVE_VECTORED) {
+        flush_save_batch();
+        m_batch_iov.push_back({(void *)p_data, p_size});
+        m_batch_bytes = p_size;
+        flush_save_batch();
+        return;
+    }
+
+    struct iovec iov = {(void *)p_data, p_size};
+    if(m_file_io->write_file(&iov, 1, m_save_offset) != 0) {
+        WY_DebugIO::debug_print("Write to file NOK.");
+        throw -1;
+    }
+}
+
+
+void WY_SerializeAgent::load_mapped_file()
+{
+    struct stat file_stat;
+    void * map;
+
+    if(m_load_memory) { /* Used in place like a mapping, which clear_file_buffer() leaves alone. */
+        if(m_load_memory_io.get_size() > 0) {
+            m_file_data = (char *)m_load_memory_io.get_data();
+            m_file_data_size = m_load_memory_io.get_size();
+            m_file_map_size = m_file_data_size;
+            m_file_data_mode = LOAD_MMAP;
+        }
+        return;
+    }
+
+    int fd = open(m_file_name.c_str(), O_RDONLY);
+    WY_SerializeStats::record_io(STATS_IO_OPEN);
+    if(fd == -1) {
+        WY_DebugIO::debug_print("Open file for mapping failed.");
+        throw -1;
+    }
+
+    if((fstat(fd, &file_stat) != 0) || (file_stat.st_size < 0)) {
+        WY_DebugIO::debug_print("Parsing file failed.");
+        close(fd);
+        throw -1;
+    }
+
+    if(file_stat.st_size > 0) { /* mmap() rejects zero-length mappings, an empty file simply leaves m_file_data empty. */
+        map = mmap(NULL, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        WY_SerializeStats::record_io(STATS_IO_MAP);
+        if(map == MAP_FAILED) {
+            WY_DebugIO::debug_print("Map file content failed.");
+            close(fd);
+            throw -1;
+        }
+        madvise(map, file_stat.st_size, MADV_SEQUENTIAL); /* Hint only, blocks are parsed front to back. */
+        m_file_data = (char *)map;
+        m_file_data_size = file_stat.st_size;
+        m_file_map_size = file_stat.st_size;
+        m_file_data_mode = LOAD_MMAP;
+    }
+
+    close(fd); /* The mapping stays valid after the descriptor is closed. */
+    WY_DebugIO::debug_print("File data mapped.");
+}
+
+
+void WY_SerializeAgent::load_streamed_file()
+{
+    uint64_t size;
+
+    if(open_io(m_file_name, IO_OPEN_READ, false) != 0) {
+        WY_DebugIO::debug_print("Open file for reading failed.");
+        throw -1;
+    }
+
+    if(m_file_io->get_file_size(&size) != 0) {
+        WY_DebugIO::debug_print("Parsing file failed.");
+        close_io();
+        throw -1;
+    }
+
+    m_file_data = (char *)m_allocator->allocate(m_stream_window_size, std::max<uint64_t>(64, m_file_io->get_buffer_alignment()));
+    if(m_file_data == NULL) {
+        close_io();
+        throw -1;
+    }
+    m_file_data_mode = LOAD_STREAM;
+    m_stream_remaining = size;
+    m_stream_offset = 0;
+    WY_DebugIO::debug_print("File opened for streaming.");
+}
+
+
 void WY_SerializeAgent::clear_file_buffer() noexcept
 {
-    m_file_data_size = 0;
-    m_file_data_offset = 0;
     if(m_file_data != NULL) {
-        delete[] m_file_data;
+        if((m_file_data_mode == LOAD_MMAP) && !m_load_memory)
+            munmap(m_file_data, m_file_map_size);
         m_file_data = NULL;
     }
+    m_allocator->reset(); /* Releases the file buffer or window and all copies of loaded blocks at once. */
+    if(m_file_data_mode == LOAD_STREAM) {
+        close_io();
+        m_stream_block.clear();
+        m_stream_block.shrink_to_fit();
+        m_stream_decoded.clear();
+        m_stream_decoded.shrink_to_fit();
+        m_stream_copy.clear();
+        m_stream_copy.shrink_to_fit();
+        m_stream_remaining = 0;
+        m_stream_offset = 0;
+    }
+    m_file_data_mode = LOAD_BUFFERED;
+    m_file_data_size = 0;
+    m_file_data_offset = 0;
+    m_crc_active = false;
+    m_crc_data_end = 0;
+    m_crc_checked_end = 0;
+    m_file_map_size = 0;
+    m_index.clear();
+    m_index_lookup.clear();
 }
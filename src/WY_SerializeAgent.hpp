@@ -18,7 +18,13 @@
 #define _WY_SERIALIZE_AGENT_HPP_
 
 #include <fstream>
+#include <vector>
+#include <unordered_map>
+#include <sys/uio.h>
 #include "WY_SerializeObj.hpp"
+#include "WY_SerializeAllocator.hpp"
+#include "WY_SerializeCodec.hpp"
+#include "WY_SerializeIO.hpp"
 #include "DemoObj1.hpp"
 #pragma once
 namespace WY_Serialize
@@ -40,9 +46,13 @@ namespace WY_Serialize
  *  agent.finalise_save_file(); // Saves the file. 
  *  agent.load_from_file(); // Load all file content into memory. 
  *  init_serializable_data(&s_data); // Clean up the data structure before use. 
- *  agent.get_next_serializable_data(&s_data); // Gets the next chunk of serializable data. 
- *  .... // Copy and process the data in s_data as required. 
- *  agent.clear_loaded_serializable_data(&s_data); 
+ *  agent.load_next_serializable_data(&s_data); // Gets a copy of the next chunk of serializable data. 
+ *  .... // Process the data in s_data as required. 
+ *  clear_loaded_serializable_data(&s_data); 
+ *  S_SerializeView s_view; 
+ *  agent.load_next_serializable_view(&s_view); // Or borrow the next chunk without copying it. 
+ *  .... // s_view.m_data stays valid until clear_loaded_file_buffer(). 
+ *  agent.clear_loaded_file_buffer(); 
  * } catch (int &e) { 
  *  std::cout << "IO error" << "\n"; 
  * } 
@@ -55,16 +65,121 @@ public:
     ~WY_SerializeAgent(); /**< Destructor.*/
 
     /**
-     * Sets name of the current file to work on. It is mandatory to set this before calling any other file operation.
+     * Sets name of the current file to work on. It is mandatory to set this before calling any other file operation, unless saves and loads go to memory set with set_save_buffer(), set_save_span() or set_load_memory().
      * \param p_name Name of the file. In this implementation we use the C++ string class so an exception is thrown if the size of the file name exceeds the system-allowed length.
      * \throw Non-0 integer if error.
     */
     void set_file_name(const char *__restrict__ const p_name);
 
+    /**
+     * Sets how load_from_file() brings the save file into memory. Takes effect on the next call to load_from_file().
+     * \param p_mode LOAD_BUFFERED (default) copies the file into a heap buffer. LOAD_MMAP maps the file read-only and load_next_serializable_data() parses the mapping in place. LOAD_STREAM keeps the file open and reads it through a window of set_stream_window() bytes, so only the window and the current block are held in memory.
+    */
+    void set_load_mode(const LOAD_MODE p_mode) noexcept;
+
+    /**
+     * Sets the size of the read window used in LOAD_STREAM mode. Takes effect on the next call to load_from_file(). Blocks larger than the window are read into their own buffer.
+     * \param p_size Size of the window in bytes. Defaults to 4 MB. Values below SERIALIZE_HEADER_MAX + SERIALIZE_ALIGN_MAX are raised to that.
+    */
+    void set_stream_window(const uint64_t p_size) noexcept;
+
+    /**
+     * Sets the allocator for the file buffer, the LOAD_STREAM window and the copies made by load_next_serializable_data() outside LOAD_STREAM mode. All of it is released at once by clear_loaded_file_buffer(). Any loaded data is cleared first.
+     * \param p_allocator The allocator, which must outlive this agent or the next call to set_allocator(). NULL restores the default WY_ArenaAllocator, which sizes its chunks from the file length so a load takes one or two heap allocations.
+    */
+    void set_allocator(WY_SerializeAllocator *__restrict__ const p_allocator) noexcept;
+
+    /**
+     * Sets how the save file is written. Takes effect on the next call to prepare_save_file().
+     * \param p_mode SAVE_STREAM (default) writes each block as it is appended. SAVE_VECTORED queues headers and payload pointers and writes them in batches with one call to the I/O backend. In SAVE_VECTORED mode payloads larger than m_batch_copy_max are not copied, so the data passed to append_save_file() must stay valid and unchanged until finalise_save_file() returns.
+    */
+    void set_save_mode(const SAVE_MODE p_mode) noexcept;
+
+    /**
+     * Sets the I/O backend saves and loads go through, see WY_SerializeIO. LOAD_MMAP mode always maps the file. Takes effect on the next file opened.
+     * \param p_backend One of IO_BACKEND. Defaults to IO_BACKEND_DEFAULT.
+    */
+    void set_io_backend(const IO_BACKEND p_backend) noexcept;
+
+    /**
+     * Sets a custom I/O backend, which replaces the one selected by set_io_backend(). Takes effect on the next file opened.
+     * \param p_io The backend, which must outlive this agent or the next call to set_io(), and must not be used by another agent at the same time. NULL (default) restores the backend selected by set_io_backend().
+    */
+    void set_io(WY_SerializeIO *__restrict__ const p_io) noexcept;
+
+    /**
+     * Sets a buffer that saves are written to instead of the file set by set_file_name(), for example to send them to another process. prepare_save_file() empties the buffer, and it then grows to hold the same bytes as a save file. The save is not atomic and needs no flush, so set_save_atomic() and set_save_durability() do not apply, and prepare_append_file() is not available. Takes effect on the next call to prepare_save_file().
+     * \param p_buffer The buffer, which must outlive the save. NULL (default) saves to the file again.
+    */
+    void set_save_buffer(std::vector<unsigned char> *__restrict__ const p_buffer) noexcept;
+
+    /**
+     * Sets a fixed span of memory that saves are written to instead of the file, like set_save_buffer(). A save that does not fit fails with an error. get_save_size() tells how much of the span was used.
+     * \param p_data The span, which must outlive the save. NULL (default) saves to the file again.
+     * \param p_capacity Size of the span in bytes.
+    */
+    void set_save_span(unsigned char *__restrict__ const p_data, const uint64_t p_capacity) noexcept;
+
+    /**
+     * Gets the size of the last save to memory set with set_save_buffer() or set_save_span().
+     * \return Size in bytes.
+    */
+    uint64_t get_save_size() const noexcept;
+
+    /**
+     * Sets a memory region that load_from_file() loads instead of the file set by set_file_name(). The region holds the bytes of a save file, for example from set_save_buffer() in another process. In LOAD_MMAP mode the blocks are used in place and nothing is copied. In LOAD_BUFFERED mode the region is copied, so it may be reused once load_from_file() returns. In LOAD_STREAM mode it is read through the window. Any loaded data is cleared first.
+     * \param p_data The region, which must stay unchanged until clear_loaded_file_buffer() is called, or until load_from_file() returns in LOAD_BUFFERED mode. Aligned blocks keep their alignment in LOAD_MMAP mode only if p_data is aligned as much. NULL (default) loads the file again.
+     * \param p_size Size of the region in bytes.
+    */
+    void set_load_memory(const unsigned char *__restrict__ const p_data, const uint64_t p_size) noexcept;
+
+    /**
+     * Sets whether finalise_save_file() writes a block index at the end of the file. The index lists the type, offset and size of every block so load_serializable_view_by_type() can find a block without parsing the blocks in front of it. Takes effect on the next call to prepare_save_file().
+     * \param p_index True to write the index. Defaults to false.
+    */
+    void set_save_index(const bool p_index) noexcept;
+
+    /**
+     * Sets the codec used to compress blocks when saving. Blocks smaller than p_min_size, and blocks that the codec does not make smaller, are stored raw. The codec ID is recorded in each block header, and loading decodes blocks of the built-in WY_LZCodec and of the codec set here, whatever codec was set when the file was saved. Takes effect on the next block appended.
+     * \param p_codec The codec, which must outlive this agent or the next call to set_codec(). NULL (default) stores all blocks raw.
+     * \param p_min_size Blocks with less data than this are not encoded. Defaults to 256.
+    */
+    void set_codec(const WY_SerializeCodec *__restrict__ const p_codec, const uint64_t p_min_size = 256) noexcept;
+
+    /**
+     * Sets whether a CRC32C is stored with every block appended. Blocks with a CRC are checked whenever they are loaded, and a block that does not match is reported as an error like a truncated one. Takes effect on the next block appended.
+     * \param p_crc True to store CRCs. Defaults to false.
+    */
+    void set_save_crc(const bool p_crc) noexcept;
+
+    /**
+     * Sets whether prepare_save_file() writes a file with compact block headers. Every block header is then its type, flags and size as LEB128 varints, which takes 3 bytes instead of 16 for small blocks. See WY_SerializeVarint. The file header records the format, so files in either format load the same way. prepare_append_file() always keeps the format of the existing file. Takes effect on the next call to prepare_save_file().
+     * \param p_compact True for compact headers. Defaults to false, which writes 16 byte block headers.
+    */
+    void set_save_compact(const bool p_compact) noexcept;
+
+    /**
+     * Sets the alignment of block data in files written by prepare_save_file(). Each block is padded with zeros after its header, CRC32C and instance ID so its data starts at a multiple of p_alignment in the file. The file buffer of LOAD_BUFFERED mode, the mapping of LOAD_MMAP mode and the window of LOAD_STREAM mode keep that alignment in memory, so views of trivially copyable structs of up to that alignment can be used in place, see WY_SerializePod::view_pod(). Decoded blocks and copies from load_next_serializable_data() are allocated with the same alignment. The alignment is recorded in a file header like set_save_compact(), and prepare_append_file() always keeps the alignment of the existing file. Takes effect on the next call to prepare_save_file().
+     * \param p_alignment Alignment in bytes, such as 8, 16 or 64. Defaults to 1, which writes no padding. Other values are raised to a power of 2, and values above SERIALIZE_ALIGN_MAX are lowered to it.
+    */
+    void set_save_alignment(const unsigned int p_alignment) noexcept;
+
+    /**
+     * Sets whether prepare_save_file() replaces the file atomically. The blocks are then written to a new temporary file in the same directory, named after the save file with the process ID, a number unique in the process and ".tmp" appended. finalise_save_file() renames it over the save file, so a save that fails or is interrupted leaves the previous file intact. prepare_append_file() always writes in place. Takes effect on the next call to prepare_save_file().
+     * \param p_atomic True to replace the file atomically. Defaults to false.
+    */
+    void set_save_atomic(const bool p_atomic) noexcept;
+
+    /**
+     * Sets how far finalise_save_file() flushes the save to storage before it returns. Takes effect on the next call to finalise_save_file().
+     * \param p_durability One of SAVE_DURABILITY. Defaults to SAVE_DURABILITY_NONE.
+    */
+    void set_save_durability(const SAVE_DURABILITY p_durability) noexcept;
+
     /** 
      * Opens and loads data from the save file and then closes the file. 
-     * Writes size into m_file_data_size and data into m_file_data.
-     * \return 0 if no error. Else non-zero.
+     * Writes size into m_file_data_size and data into m_file_data. In LOAD_MMAP mode m_file_data points into a read-only mapping of the file which is kept until clear_loaded_file_buffer() is called. In LOAD_STREAM mode the file stays open and is read as blocks are loaded.
+     * \throw Non-0 integer if error.
     */
     void load_from_file();
 
@@ -74,6 +189,13 @@ public:
     */
     void prepare_save_file();
 
+    /**
+     * Opens an existing save file to append blocks to it. Works like prepare_save_file() but the first p_offset bytes of the file are kept and everything after them is discarded. Blocks are written in the format of the file. Not available with set_save_index(true), or for files of version 0, whose block headers have no flags.
+     * \param p_offset Size of the file content to keep. Must not exceed the size of the file.
+     * \throw Non-0 integer if error.
+    */
+    void prepare_append_file(const uint64_t p_offset);
+
     /** 
      * Saves the currently opened save file to IO. 
      * \throw Non-0 integer if error.
@@ -86,28 +208,333 @@ public:
     void append_save_file(S_SerializeData *__restrict__ const p_data);
 
     /**
-     * Loads the next block of serializable data from data in the save file.
-     * \param p_data Returns the next block of serialized data from the loaded save file.
-     * \return 0 if non-error. -1 if there is an error with the next serializable block of data.
+     * Prepares a block for reserve_save_file() and write_save_file_at(), encoding its data with the codec set by set_codec(). Does not change the agent, so this may be called from several threads at once.
+     * \param p_data The data of the block.
+     * \param p_block Returns the block. p_block->m_data points either to p_data->m_data or into p_buffer.
+     * \param p_buffer Buffer for the encoded data, which must stay unchanged until the block is written. If it cannot be allocated the block is stored raw.
+    */
+    void prepare_save_block(const S_SerializeData *__restrict__ const p_data, S_SerializeBlock *__restrict__ const p_block, std::vector<unsigned char> *__restrict__ const p_buffer) const noexcept;
+
+    /**
+     * Gets the number of bytes append_save_file() writes for a block with the current save settings: the header, the CRC and instance ID if they are saved, and the data. Padding for set_save_alignment() depends on the file offset and is not included. If a codec is set this is an upper bound, as blocks are only stored encoded when that makes them smaller.
+     * \param p_data The data of the block.
+     * \return Size of the block in the save file.
+    */
+    uint64_t get_save_block_size(const S_SerializeData *__restrict__ const p_data) const noexcept;
+
+    /**
+     * Reserves space for a block at the current end of an opened save file so it can be written later with write_save_file_at(). Blocks are stored in the file in the order they are appended or reserved, whatever order they are written in. Only available in SAVE_VECTORED mode.
+     * \param p_block The block to reserve space for, from prepare_save_block(). Only the header is used.
+     * \return The file offset to pass to write_save_file_at().
+     * \throw Non-0 integer if error.
+    */
+    uint64_t reserve_save_file(const S_SerializeBlock *__restrict__ const p_block);
+
+    /**
+     * Writes a block into space reserved with reserve_save_file(). Positional writes do not share any state, so this may be called from several threads at once for different blocks. Only available in SAVE_VECTORED mode.
+     * \param p_block The block to write, the same as when the space was reserved.
+     * \param p_offset The offset returned by reserve_save_file().
+     * \throw Non-0 integer if error.
+    */
+    void write_save_file_at(const S_SerializeBlock *__restrict__ const p_block, const uint64_t p_offset) const;
+
+    /**
+     * Loads a copy of the next block of serializable data from data in the save file. The copy is made with the agent's allocator, see set_allocator(), except in LOAD_STREAM mode where one buffer of the agent is reused for every block, so memory use stays bounded by the largest block.
+     * \param p_data Returns the next block of serialized data from the loaded save file. The data is valid until clear_loaded_file_buffer() is called. In LOAD_STREAM mode it is only valid until the next call to load_next_serializable_data() or load_next_serializable_view().
+     * \return 0 if non-error. -1 if there is an error with the next serializable block of data, including a block whose CRC32C does not match.
     */
     int load_next_serializable_data(S_SerializeData *__restrict__ const p_data) noexcept;
 
     /**
-     * This is a dealloc cleanup operation that clears buffers after a load_from_file() and we are done reading loaded data. Mandatory to call. 
+     * Loads the next block of serializable data from data in the save file without copying it. Unlike load_next_serializable_data() nothing is allocated, and the returned data must not be cleared with clear_loaded_serializable_data().
+     * \param p_view Returns the next block of serialized data. p_view->m_data points into the loaded file buffer and is valid until clear_loaded_file_buffer() is called. In LOAD_STREAM mode it is only valid until the next call to load_next_serializable_data() or load_next_serializable_view().
+     * \return 0 if non-error. -1 if there is an error with the next serializable block of data.
+    */
+    int load_next_serializable_view(S_SerializeView *__restrict__ const p_view) noexcept;
+
+    /**
+     * Gets the offset in the loaded file of the next block load_next_serializable_view() returns. After the last block this is the end of the block data.
+     * \return The file offset.
+    */
+    uint64_t get_load_offset() const noexcept;
+
+    /**
+     * Checks if all blocks of the file loaded by load_from_file() have been returned, so a failing load_next_serializable_view() can be told apart from the end of the file.
+     * \return True if there are no more blocks.
+    */
+    bool is_load_end() const noexcept;
+
+    /**
+     * Checks if the file loaded by load_from_file() has a block index.
+     * \return True if there is a block index.
+    */
+    bool has_index() const noexcept;
+
+    /**
+     * Loads the first block of a given type using the block index of the loaded file. Does not change the position used by load_next_serializable_view(). In LOAD_BUFFERED and LOAD_MMAP modes the block is returned in place, in LOAD_STREAM mode only the block is read from the file.
+     * \param p_type The SERIALIZE_TYPE of the block to load.
+     * \param p_view Returns the block. In LOAD_STREAM mode it is only valid until the next block is loaded, else until clear_loaded_file_buffer() is called.
+     * \return 0 if non-error. -1 if the file has no index, there is no block of type p_type or the block is invalid.
+    */
+    int load_serializable_view_by_type(const unsigned int p_type, S_SerializeView *__restrict__ const p_view) noexcept;
+
+    /**
+     * This is a dealloc cleanup operation that clears buffers after a load_from_file() and we are done reading loaded data. Mandatory to call. This also releases the data of every block returned by load_next_serializable_data(). 
     */
     void clear_loaded_file_buffer() noexcept;
 
 private:
+    /**
+     * Reads the file header of the file just loaded, if it has one, and skips it. A file without one is version 0.
+     * \return 0 if no error. -1 if the file was written by a newer version.
+    */
+    int read_file_header() noexcept;
+
+    /**
+     * Reads the file header of a file on disk to find the format of its blocks.
+     * \param p_file Name of the file.
+     * \param p_header Returns the file header. Version 0 without options if the file has none.
+     * \param p_header_size Returns the size of the file header, 0 if there is none.
+     * \return 0 if no error. -1 if the file cannot be read or was written by a newer version.
+    */
+    static int read_file_format(const std::string &p_file, S_SerializeFileHeader *__restrict__ const p_header, unsigned int *__restrict__ const p_header_size) noexcept;
+
+    /**
+     * Resizes a buffer of LOAD_STREAM mode for bytes read from the file, so they have the same alignment in memory as in the file.
+     * \param p_buffer The buffer.
+     * \param p_size Number of bytes.
+     * \param p_offset File offset of the first byte. 0 for data that is not read from the file, such as decoded blocks.
+     * \param p_shrink True to release memory the buffer holds beyond what is needed.
+     * \return Where the first byte goes in the buffer. NULL if the buffer cannot be allocated.
+    */
+    unsigned char * resize_stream_buffer(std::vector<unsigned char> *__restrict__ const p_buffer, const uint64_t p_size, const uint64_t p_offset, const bool p_shrink) const noexcept;
+
+    /**
+     * Encodes a block header in either format.
+     * \param p_dst Buffer of at least SERIALIZE_HEADER_MAX bytes.
+     * \param p_header The header.
+     * \param p_compact True for a compact header.
+     * \return Size of the encoded header.
+    */
+    static unsigned int encode_block_header(unsigned char *__restrict__ const p_dst, const S_SerializeHeader *__restrict__ const p_header, const bool p_compact) noexcept;
+
+    /**
+     * Decodes a block header of the loaded file, in the format of its version.
+     * \param p_src The header.
+     * \param p_avail Bytes available at p_src.
+     * \param p_header Returns the header.
+     * \return Size of the header, 0 if it is incomplete or invalid.
+    */
+    unsigned int decode_block_header(const unsigned char *__restrict__ const p_src, const uint64_t p_avail, S_SerializeHeader *__restrict__ const p_header) const noexcept;
+
     /** 
      * Clears content of m_file_data_size and m_file_data.
     */
     void clear_file_buffer() noexcept;
 
-    unsigned int m_file_data_size; /**< Size of the serializable data. Only used for loading operations. */
-    unsigned int m_file_data_offset; /**< Current offset in m_file_data. */
+    /**
+     * Implements prepare_save_file() and prepare_append_file().
+     * \param p_append True to keep the first p_offset bytes of the file, false to truncate it.
+     * \param p_offset Size of the file content to keep when appending. 0 if not appending.
+     * \throw Non-0 integer if error.
+    */
+    void open_save_file(const bool p_append, const uint64_t p_offset);
+
+    /**
+     * Flushes the save file as set by set_save_durability(), closes it and renames m_save_temp over m_file_name if this is an atomic save. The temporary file is removed if there is an error.
+     * \throw Non-0 integer if error.
+    */
+    void commit_save_file();
+
+    /**
+     * Opens a file with the I/O backend set by set_io() or set_io_backend(), which then holds the file until close_io(). Saves and loads to memory open m_save_memory_io or m_load_memory_io instead.
+     * \param p_path Name of the file.
+     * \param p_mode One of IO_OPEN_MODE.
+     * \param p_vectored True if the file is saved in SAVE_VECTORED mode.
+     * \return 0 if no error. -1 if error.
+    */
+    int open_io(const std::string &p_path, const IO_OPEN_MODE p_mode, const bool p_vectored) noexcept;
+
+    /**
+     * Closes the file opened by open_io(), if any.
+     * \return 0 if no error. -1 if error, including a write that failed after it was queued.
+    */
+    int close_io() noexcept;
+
+    /**
+     * Flushes the directory holding a file with fsync(), so a file created or renamed in it is not lost in a system crash.
+     * \param p_file Name of the file.
+     * \return 0 if successful, -1 if there is an error.
+    */
+    static int sync_directory(const std::string &p_file) noexcept;
+
+    /**
+     * Creates the temporary file of an atomic save under a name no other save uses, and sets m_save_temp to it.
+     * \throw Non-0 integer if error.
+    */
+    void create_save_temp();
+
+    /**
+     * Removes the temporary file of an atomic save that failed or was never finalised, and clears m_save_temp.
+    */
+    void discard_save_temp() noexcept;
+
+    /**
+     * Implements load_from_file() for LOAD_MMAP mode. Maps the file into m_file_data, or points m_file_data at the memory set by set_load_memory().
+     * \throw Non-0 integer if error.
+    */
+    void load_mapped_file();
+
+    /**
+     * Implements load_from_file() for LOAD_STREAM mode. Opens the file and allocates the read window into m_file_data.
+     * \throw Non-0 integer if error.
+    */
+    void load_streamed_file();
+
+    /**
+     * Implements load_next_serializable_view() for LOAD_STREAM mode.
+     * \param p_view Returns the next block of serialized data.
+     * \return 0 if non-error. -1 if there is an error with the next serializable block of data.
+    */
+    int load_next_streamed_view(S_SerializeView *__restrict__ const p_view) noexcept;
+
+    /**
+     * Ensures at least p_size unread bytes are in the LOAD_STREAM window, moving unread bytes to the front of the window and reading more of the file as needed.
+     * \param p_size Number of bytes required. Must not exceed m_stream_window_size.
+     * \return 0 if the bytes are available. -1 if the file ended or a read failed.
+    */
+    int fill_stream_window(const uint64_t p_size) noexcept;
+
+    /**
+     * Reads the file into m_file_data in LOAD_BUFFERED mode. The file is read m_crc_chunk_size bytes at a time, and check_loaded_crcs() checks the blocks read so far after each read, while they are still in the CPU cache.
+     * \return 0 if non-error. -1 if a read failed.
+    */
+    int read_file_buffer() noexcept;
+
+    /**
+     * Checks the CRC32C of the blocks in m_file_data up to p_end, continuing from where the last call stopped. Only done for files with a file header. Checking stops for good at the first block without a CRC, with a mismatch or that cannot be parsed, and unpack_view() checks that block and all later ones as usual.
+     * \param p_end Number of bytes of m_file_data read so far.
+    */
+    void check_loaded_crcs(const uint64_t p_end) noexcept;
+
+    /**
+     * Reads the rest of a block in LOAD_STREAM mode m_crc_chunk_size bytes at a time, and computes the CRC32C of the block after each read, while the data is still in the CPU cache.
+     * \param p_block The block, starting right after its header. The first p_buffered bytes are already there.
+     * \param p_buffered Bytes of the block already in p_block.
+     * \param p_size Size of the block with its padding.
+     * \param p_offset File offset of p_block+p_buffered.
+     * \param p_header The block header.
+     * \param p_padding Padding between the prefix and the data of the block, see get_block_padding().
+     * \param p_crc_checked Returns true if the block has a CRC32C and it matched.
+     * \return 0 if non-error. -1 if a read failed.
+    */
+    int read_stream_block(unsigned char *__restrict__ const p_block, const uint64_t p_buffered, const uint64_t p_size, const uint64_t p_offset, const S_SerializeHeader *__restrict__ const p_header, const unsigned int p_padding, bool *__restrict__ const p_crc_checked) noexcept;
+
+    /**
+     * Checks the CRC32C of a loaded block if it has one, and decodes its data if its header names a codec. Decoded data is allocated with m_allocator, or held in m_stream_decoded in LOAD_STREAM mode.
+     * \param p_header The block header.
+     * \param p_view The block as stored in the file, without its padding in p_view->m_size. Returns the data of the block.
+     * \param p_padding Padding between the prefix and the data of the block, see get_block_padding().
+     * \param p_crc_checked True if the CRC32C of the block was already checked while it was read.
+     * \return 0 if non-error. -1 if the CRC does not match, the codec is unknown or the data is invalid.
+    */
+    int unpack_view(const S_SerializeHeader *__restrict__ const p_header, S_SerializeView *__restrict__ const p_view, const unsigned int p_padding, const bool p_crc_checked) noexcept;
+
+    /**
+     * Reads the block index at the end of the loaded file into m_index if there is one, and shortens the block data so sequential loading stops in front of the index.
+    */
+    void read_index() noexcept;
+
+    /**
+     * Writes m_index and the index trailer to the save file.
+     * \throw Non-0 integer if error.
+    */
+    void write_index();
+
+    /**
+     * Writes bytes to the save file in the current SAVE_MODE, after any queued blocks.
+     * \param p_data The bytes to write.
+     * \param p_size Number of bytes.
+     * \throw Non-0 integer if error.
+    */
+    void write_save_bytes(const unsigned char *__restrict__ const p_data, const uint64_t p_size);
+
+    /**
+     * Writes all queued blocks of SAVE_VECTORED mode to m_file_io at m_batch_offset and empties the queue.
+     * \throw Non-0 integer if error.
+    */
+    void flush_save_batch();
+
+    static const unsigned int m_batch_iov_max = 1024; /**< Max number of iovec entries queued in SAVE_VECTORED mode before they are written. Equal to IOV_MAX on Linux. */
+    static const unsigned int m_batch_stage_size = 256*1024; /**< Size of the staging buffer for headers and small payloads in SAVE_VECTORED mode. */
+    static const unsigned int m_batch_copy_max = 1024; /**< Payloads up to this size are copied into the staging buffer in SAVE_VECTORED mode. Larger payloads are written from the caller's memory. */
+    static const unsigned int m_batch_bytes_max = 4*1024*1024; /**< Queued bytes in SAVE_VECTORED mode that trigger a write. */
+    static const unsigned int m_crc_chunk_size = 256*1024; /**< Bytes read at a time while the CRC32Cs of blocks are checked along, small enough that they are still in the CPU cache when checked. */
+
+    uint64_t m_file_data_size; /**< Size of the serializable data. Only used for loading operations. In LOAD_STREAM mode, the number of valid bytes in the window. */
+    uint64_t m_file_data_offset; /**< Current offset in m_file_data. */
+    uint64_t m_file_map_size; /**< Size of the mapping in LOAD_MMAP mode. Differs from m_file_data_size if the file has a block index. */
+    LOAD_MODE m_load_mode; /**< How load_from_file() loads the file. */
+    LOAD_MODE m_file_data_mode; /**< The LOAD_MODE m_file_data was loaded with, which decides how it is released. */
+    WY_ArenaAllocator m_default_allocator; /**< Used when no allocator is set with set_allocator(). */
+    WY_SerializeAllocator * m_allocator; /**< Allocates m_file_data and copies of loaded blocks. */
+    uint64_t m_stream_window_size; /**< Size of the m_file_data window in LOAD_STREAM mode. */
+    uint64_t m_stream_remaining; /**< Bytes of the file not yet read into the window in LOAD_STREAM mode. */
+    uint64_t m_stream_offset; /**< File offset of the start of the window in LOAD_STREAM mode. */
+    std::vector<unsigned char> m_stream_block; /**< Holds the current block in LOAD_STREAM mode when it is larger than the window. */
+    bool m_crc_active; /**< Whether check_loaded_crcs() still checks blocks of the file being read. */
+    uint64_t m_crc_next; /**< Offset in m_file_data of the next block check_loaded_crcs() checks. */
+    uint64_t m_crc_data; /**< Offset of the next byte of the block being checked to add to m_crc_value. */
+    uint64_t m_crc_data_end; /**< End of the block being checked, 0 if check_loaded_crcs() is between blocks. */
+    uint32_t m_crc_value; /**< CRC32C of the block being checked so far. */
+    uint32_t m_crc_expected; /**< CRC32C stored with the block being checked. */
+    uint64_t m_crc_checked_end; /**< The blocks of m_file_data that end at or before this offset had their CRC32C checked as the file was read. */
+    SAVE_MODE m_save_mode; /**< How the save file is written. */
+    std::vector<unsigned char> m_batch_stage; /**< Staging buffer for headers and small payloads in SAVE_VECTORED mode. */
+    unsigned int m_batch_stage_used; /**< Bytes used in m_batch_stage. */
+    unsigned int m_batch_stage_queued; /**< Bytes of m_batch_stage already referenced by m_batch_iov. */
+    uint64_t m_batch_bytes; /**< Total bytes queued in SAVE_VECTORED mode. */
+    uint64_t m_batch_offset; /**< File offset where the queued bytes are written in SAVE_VECTORED mode. */
+    std::vector<struct iovec> m_batch_iov; /**< Headers and payloads queued in SAVE_VECTORED mode. */
+    bool m_save_index; /**< Whether finalise_save_file() writes a block index. */
+    uint64_t m_save_offset; /**< Bytes of blocks appended since prepare_save_file(). */
+    std::vector<S_SerializeIndexEntry> m_index; /**< Block index of the file being saved or loaded. */
+    std::unordered_map<unsigned int, size_t> m_index_lookup; /**< Maps a block type to its first entry in m_index when loading. */
+    
+    const WY_SerializeCodec * m_codec; /**< Codec used to encode saved blocks. NULL if blocks are stored raw. */
+    uint64_t m_codec_min_size; /**< Blocks smaller than this are not encoded. */
+    bool m_save_crc; /**< Whether a CRC32C is stored with every block. */
+    bool m_save_compact; /**< Whether prepare_save_file() writes compact block headers. */
+    bool m_block_compact; /**< Whether blocks are prepared with compact headers. m_save_compact, or the format of the file when appending. */
+    bool m_file_compact; /**< Whether the loaded file has compact block headers. */
+    uint32_t m_file_version; /**< Format version of the loaded file. */
+    unsigned int m_save_alignment; /**< Alignment of block data in files written by prepare_save_file(). */
+    unsigned int m_block_alignment; /**< Alignment of block data in the file being saved. m_save_alignment, or the alignment of the file when appending. */
+    unsigned int m_file_alignment; /**< Alignment of block data in the loaded file. */
+    bool m_save_atomic; /**< Whether prepare_save_file() writes to a temporary file that replaces m_file_name when finalised. */
+    SAVE_DURABILITY m_save_durability; /**< How finalise_save_file() flushes the save. */
+    uint64_t m_stats_save_start; /**< Start of the current save for WY_SerializeStats, 0 if not measured. */
+    uint64_t m_stats_load_start; /**< Start of the current load for WY_SerializeStats, 0 if not measured. */
+    std::string m_save_temp; /**< Temporary file of the atomic save in progress, see create_save_temp(). Empty if none. */
+    WY_LZCodec m_lz_codec; /**< Decodes blocks of the built-in codec when another codec or none is set. */
+    bool m_view_decoded; /**< Whether the last block loaded by load_next_serializable_view() was decoded into memory of its own, of m_allocator or m_stream_decoded. */
+    std::vector<unsigned char> m_stream_decoded; /**< Holds the current decoded block in LOAD_STREAM mode. */
+    std::vector<unsigned char> m_stream_copy; /**< Holds the copy of the current block made by load_next_serializable_data() in LOAD_STREAM mode. */
+    std::vector<unsigned char> m_save_buffer; /**< Encoded block in SAVE_STREAM mode. */
+    std::vector<std::vector<unsigned char>> m_batch_buffers; /**< Encoded blocks queued in SAVE_VECTORED mode. Kept between batches so their memory is reused. */
+    size_t m_batch_buffers_used; /**< Entries of m_batch_buffers referenced by m_batch_iov. */
     
     std::string m_file_name; /**< Name of the file currently worked on. */
-    std::fstream m_file; /**< The serializable file object. Only used for saving operations. */
+    IO_BACKEND m_io_backend; /**< The built-in I/O backend selected by set_io_backend(). */
+    WY_SerializeIO * m_io; /**< The I/O backend set by set_io(). NULL if none. */
+    WY_SerializeIO * m_file_io; /**< The I/O backend holding the open file. Used for saving operations and for reading in LOAD_BUFFERED and LOAD_STREAM modes. NULL if no file is open. */
+    WY_FstreamIO m_fstream_io; /**< Backend of IO_BACKEND_FSTREAM, and of IO_BACKEND_DEFAULT except in SAVE_VECTORED mode. */
+    WY_PosixIO m_posix_io; /**< Backend of IO_BACKEND_POSIX, and of IO_BACKEND_DEFAULT in SAVE_VECTORED mode. */
+    WY_UringIO m_uring_io; /**< Backend of IO_BACKEND_URING and IO_BACKEND_URING_DIRECT. */
+    WY_MemoryIO m_save_memory_io; /**< Backend of saves to the memory set by set_save_buffer() or set_save_span(). */
+    WY_MemoryIO m_load_memory_io; /**< Backend of loads from the memory set by set_load_memory(). */
+    bool m_save_memory; /**< Whether saves go to m_save_memory_io instead of m_file_name. */
+    bool m_load_memory; /**< Whether loads come from m_load_memory_io instead of m_file_name. */
     char * __restrict__ m_file_data; /**< The serializable data. Only used for loading operations.*/
 };
 }
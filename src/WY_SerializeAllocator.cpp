@@ -0,0 +1,112 @@
+/*
+* Copyright 2023 Au Yeong Wing Yau
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include <new>
+#include <algorithm>
+#include "WY_SerializeAllocator.hpp"
+using namespace WY_Serialize;
+
+
+WY_ArenaAllocator::WY_ArenaAllocator(const uint64_t p_chunk_size) noexcept : m_chunk_size(p_chunk_size)
+{
+    m_next_chunk_size = p_chunk_size;
+    m_reserved = 0;
+    m_chunk_count = 0;
+    m_chunk_bytes = 0;
+    m_chunks = NULL;
+    m_cur = NULL;
+    m_end = NULL;
+}
+
+
+WY_ArenaAllocator::~WY_ArenaAllocator()
+{
+    reset();
+}
+
+
+void * WY_ArenaAllocator::allocate(const uint64_t p_size, const uint64_t p_align) noexcept
+{
+    uintptr_t aligned = ((uintptr_t)m_cur + (p_align-1)) & ~(uintptr_t)(p_align-1);
+    if((m_cur == NULL) || (aligned > (uintptr_t)m_end) || (p_size > (uintptr_t)m_end-aligned)) { /* Does not fit in the current chunk. */
+        if(p_size > UINT64_MAX-p_align)
+            return NULL;
+        if(add_chunk(p_size+p_align) != 0)
+            return NULL;
+        aligned = ((uintptr_t)m_cur + (p_align-1)) & ~(uintptr_t)(p_align-1);
+    }
+
+    m_cur = (unsigned char *)(aligned + p_size);
+    return (void *)aligned;
+}
+
+
+void WY_ArenaAllocator::reset() noexcept
+{
+    while(m_chunks != NULL) {
+        S_Chunk * next = m_chunks->m_next;
+        delete[] (unsigned char *)m_chunks;
+        m_chunks = next;
+    }
+    m_cur = NULL;
+    m_end = NULL;
+    m_next_chunk_size = m_chunk_size;
+    m_reserved = 0;
+}
+
+
+void WY_ArenaAllocator::reserve(const uint64_t p_size) noexcept
+{
+    if((m_cur == NULL) || ((uint64_t)(m_end-m_cur) < p_size))
+        m_reserved = std::max(m_reserved, p_size);
+}
+
+
+uint64_t WY_ArenaAllocator::get_chunk_count() const noexcept
+{
+    return m_chunk_count;
+}
+
+
+uint64_t WY_ArenaAllocator::get_chunk_bytes() const noexcept
+{
+    return m_chunk_bytes;
+}
+
+
+int WY_ArenaAllocator::add_chunk(const uint64_t p_size) noexcept
+{
+    const uint64_t size = std::max(p_size, std::max(m_next_chunk_size, m_reserved));
+    if(size > UINT64_MAX-sizeof(S_Chunk))
+        return -1;
+
+    unsigned char * memory = new (std::nothrow) unsigned char[sizeof(S_Chunk)+size];
+    if(memory == NULL)
+        return -1;
+
+    S_Chunk * chunk = (S_Chunk *)memory;
+    chunk->m_next = m_chunks;
+    chunk->m_size = size;
+    m_chunks = chunk;
+    m_cur = memory+sizeof(S_Chunk);
+    m_end = m_cur+size;
+    if(size == m_next_chunk_size) /* Only regular chunks advance the growth, a large reservation or allocation would make every later chunk as large. */
+        m_next_chunk_size = std::max(m_chunk_size, std::min(2*m_next_chunk_size, (uint64_t)1 << 30)); /* Grow geometrically but never reserve more than 1 GB ahead. */
+    m_reserved = 0;
+    ++m_chunk_count;
+    m_chunk_bytes += size;
+    return 0;
+}
@@ -0,0 +1,142 @@
+/*
+* Copyright 2023 Au Yeong Wing Yau
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#ifndef _WY_SERIALIZE_ALLOCATOR_HPP_
+#define _WY_SERIALIZE_ALLOCATOR_HPP_
+
+#include <cstdint>
+#pragma once
+namespace WY_Serialize
+{
+
+/**
+ * Interface of the monotonic allocators used by WY_SerializeAgent for loaded data. Memory is never freed individually, everything allocated is released at once by reset().
+ * Implement this class to plug a different allocator into WY_SerializeAgent::set_allocator().
+ */
+class WY_SerializeAllocator
+{
+public:
+    /**
+     * Virtual destructor.
+    */
+    virtual ~WY_SerializeAllocator() {};
+
+    /**
+     * Allocates memory that stays valid until reset() is called.
+     * \param p_size Number of bytes.
+     * \param p_align Alignment of the returned memory. Must be a power of 2.
+     * \return The memory, or NULL if error.
+    */
+    virtual void * allocate(const uint64_t p_size, const uint64_t p_align) noexcept = 0;
+
+    /**
+     * Releases all memory returned by allocate().
+    */
+    virtual void reset() noexcept = 0;
+
+    /**
+     * Hint that about p_size bytes will be allocated next, so the allocator can size its next block of memory accordingly. Optional to implement.
+     * \param p_size Number of bytes expected.
+    */
+    virtual void reserve(const uint64_t p_size) noexcept {};
+};
+
+
+/**
+ * The default WY_SerializeAllocator of WY_SerializeAgent. A bump allocator that hands out memory from large chunks, so a whole load costs a few heap allocations however many blocks are loaded.
+ *
+ * Usage: <br>
+ * <br>
+ * @code
+ * WY_ArenaAllocator arena; 
+ * arena.reserve(file_size); // Optional. The next chunk is at least file_size bytes. 
+ * void * p = arena.allocate(100, 16); 
+ * arena.reset(); // Frees p and everything else allocated. 
+ * @endcode
+ */
+class WY_ArenaAllocator: public WY_SerializeAllocator
+{
+public:
+    /**
+     * Constructor. No memory is allocated until allocate() is called.
+     * \param p_chunk_size Minimum size of a chunk. Chunks double in size as more are needed.
+    */
+    WY_ArenaAllocator(const uint64_t p_chunk_size=64*1024) noexcept;
+
+    /**
+     * Destructor. Frees all chunks.
+    */
+    ~WY_ArenaAllocator();
+
+    /**
+     * Implements the WY_SerializeAllocator virtual function.
+     * \param p_size Number of bytes.
+     * \param p_align Alignment of the returned memory. Must be a power of 2.
+     * \return The memory, or NULL if error.
+    */
+    void * allocate(const uint64_t p_size, const uint64_t p_align) noexcept;
+
+    /**
+     * Implements the WY_SerializeAllocator virtual function. Frees all chunks.
+    */
+    void reset() noexcept;
+
+    /**
+     * Implements the WY_SerializeAllocator virtual function. If the current chunk has less than p_size bytes left, the next chunk is at least p_size bytes.
+     * The reservation applies to the next chunk only, the chunks after it grow from the minimum size again.
+     * \param p_size Number of bytes expected.
+    */
+    void reserve(const uint64_t p_size) noexcept;
+
+    /**
+     * Gets the number of chunks allocated from the heap since construction. Useful to check the allocation cost of a load.
+     * \return Number of chunks.
+    */
+    uint64_t get_chunk_count() const noexcept;
+    /**
+     * Gets the number of bytes of the chunks allocated from the heap since construction, without the chunk headers.
+     * \return Number of bytes.
+    */
+    uint64_t get_chunk_bytes() const noexcept;
+
+private:
+    /**
+     * Header in front of the memory of every chunk.
+     */
+    struct S_Chunk {
+        S_Chunk * m_next; /**< The previously allocated chunk. */
+        uint64_t m_size; /**< Usable bytes after the header. */
+    };
+
+    /**
+     * Allocates a new chunk and makes it current.
+     * \param p_size Minimum number of usable bytes.
+     * \return 0 if no error. -1 if error.
+    */
+    int add_chunk(const uint64_t p_size) noexcept;
+
+    const uint64_t m_chunk_size; /**< Minimum size of a chunk. */
+    uint64_t m_next_chunk_size; /**< Size of the next chunk. */
+    uint64_t m_reserved; /**< Size reserved by reserve() for the next chunk only. 0 if none. */
+    uint64_t m_chunk_count; /**< Number of chunks allocated since construction. */
+    uint64_t m_chunk_bytes; /**< Bytes of the chunks allocated since construction. */
+    S_Chunk * m_chunks; /**< List of chunks, newest first. */
+    unsigned char * m_cur; /**< Next free byte in the newest chunk. */
+    unsigned char * m_end; /**< End of the newest chunk. */
+};
+}
+
+#endif
@@ -0,0 +1,231 @@
+/*
+* Copyright 2023 Au Yeong Wing Yau
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include <cstring>
+#include "WY_SerializeCodec.hpp"
+using namespace WY_Serialize;
+
+
+/**
+ * Reads 4 unaligned bytes.
+ */
+static inline uint32_t read32(const unsigned char *__restrict__ const p_src) noexcept
+{
+    uint32_t value;
+    memcpy(&value, p_src, 4);
+    return value;
+}
+
+
+/**
+ * Reads 8 unaligned bytes, the first in the lowest bits.
+ */
+static inline uint64_t read64(const unsigned char *__restrict__ const p_src) noexcept
+{
+    uint64_t value;
+    memcpy(&value, p_src, 8);
+    if(__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__) /* Match lengths count trailing zero bits, so the first byte must be the lowest. */
+        value = __builtin_bswap64(value);
+    return value;
+}
+
+
+/**
+ * Writes a length that did not fit into a token nibble: 255 for every full 255, then the remainder.
+ * \return Pointer after the written bytes.
+ */
+static inline unsigned char * write_length(unsigned char *__restrict__ p_dst, uint64_t p_length) noexcept
+{
+    while(p_length >= 255) {
+        *p_dst++ = 255;
+        p_length -= 255;
+    }
+    *p_dst++ = (unsigned char)p_length;
+    return p_dst;
+}
+
+
+/**
+ * Reads a length written by write_length() and adds it to p_length.
+ * \return 0 if no error. -1 if the input ends or the length exceeds p_max.
+ */
+static inline int read_length(const unsigned char *__restrict__ &p_src, const unsigned char *__restrict__ const p_end, uint64_t &p_length, const uint64_t p_max) noexcept
+{
+    unsigned char value;
+    do {
+        if(p_src >= p_end)
+            return -1;
+        value = *p_src++;
+        p_length += value;
+        if(p_length > p_max)
+            return -1;
+    } while(value == 255);
+    return 0;
+}
+
+
+unsigned int WY_LZCodec::get_codec_id() const noexcept
+{
+    return 1;
+}
+
+
+uint64_t WY_LZCodec::encode(const unsigned char *__restrict__ const p_src, const uint64_t p_size, unsigned char *__restrict__ const p_dst, const uint64_t p_capacity) const noexcept
+{
+    uint32_t table[1 << m_hash_bits_max];
+    unsigned int hash_bits = 8;
+    while((hash_bits < m_hash_bits_max) && (((uint64_t)1 << hash_bits) < p_size)) /* Small inputs do not pay for clearing a large table. */
+        ++hash_bits;
+    const uint64_t rebase_distance = (uint64_t)1 << 30; /* Table entries are 32-bit offsets from base, so base moves forward on huge inputs. */
+
+    const unsigned char * ip = p_src;
+    const unsigned char * anchor = p_src;
+    const unsigned char * base = p_src;
+    const unsigned char * const iend = p_src+p_size;
+    const unsigned char * const match_limit = (p_size > 12) ? iend-12 : p_src; /* Leaves room to read 4 bytes past a match start. */
+    unsigned char * op = p_dst;
+    unsigned char * const oend = p_dst+p_capacity;
+
+    memset(table, 0, sizeof(uint32_t) << hash_bits);
+    while(ip < match_limit) {
+        if((uint64_t)(ip-base) >= rebase_distance) {
+            memset(table, 0, sizeof(uint32_t) << hash_bits);
+            base = ip;
+        }
+
+        const uint32_t sequence = read32(ip);
+        const uint32_t hash = (sequence * 2654435761U) >> (32-hash_bits);
+        const unsigned char * ref = base+table[hash];
+        table[hash] = (uint32_t)(ip-base);
+        if((ref >= ip) || ((uint64_t)(ip-ref) > m_max_offset) || (read32(ref) != sequence)) {
+            ip += 1 + ((ip-anchor) >> 6); /* Step faster through data that does not compress. */
+            continue;
+        }
+
+        while((ip > anchor) && (ref > p_src) && (ip[-1] == ref[-1])) { /* Extend the match backwards into the literals. */
+            --ip;
+            --ref;
+        }
+        const unsigned char * match_end = ip+m_min_match;
+        const unsigned char * ref_end = ref+m_min_match;
+        while(match_end+8 <= iend) { /* Compare 8 bytes at a time, the first differing byte ends the match. */
+            const uint64_t diff = read64(match_end) ^ read64(ref_end);
+            if(diff != 0) {
+                match_end += __builtin_ctzll(diff) >> 3;
+                goto match_found;
+            }
+            match_end += 8;
+            ref_end += 8;
+        }
+        while((match_end < iend) && (*match_end == *ref_end)) {
+            ++match_end;
+            ++ref_end;
+        }
+match_found:
+
+        const uint64_t literals = ip-anchor;
+        const uint64_t match = (match_end-ip)-m_min_match;
+        const uint64_t offset = ip-ref;
+        if((uint64_t)(oend-op) < 1 + literals + literals/255 + 1 + 2 + match/255 + 1)
+            return 0;
+
+        unsigned char * token = op++;
+        *token = (unsigned char)(((literals < 15) ? literals : 15) << 4);
+        if(literals >= 15)
+            op = write_length(op, literals-15);
+        memcpy(op, anchor, literals);
+        op += literals;
+        *op++ = (unsigned char)(offset & 0xFF);
+        *op++ = (unsigned char)(offset >> 8);
+        *token |= (unsigned char)((match < 15) ? match : 15);
+        if(match >= 15)
+            op = write_length(op, match-15);
+
+        ip = match_end;
+        anchor = ip;
+        if(ip-2 >= base && ip < match_limit) /* Remember a position inside the match to find repeats sooner. */
+            table[(read32(ip-2) * 2654435761U) >> (32-hash_bits)] = (uint32_t)(ip-2-base);
+    }
+
+    /* The last sequence is only literals. */
+    const uint64_t literals = iend-anchor;
+    if((uint64_t)(oend-op) < 1 + literals + literals/255 + 1)
+        return 0;
+    *op++ = (unsigned char)(((literals < 15) ? literals : 15) << 4);
+    if(literals >= 15)
+        op = write_length(op, literals-15);
+    memcpy(op, anchor, literals);
+    op += literals;
+    return op-p_dst;
+}
+
+
+uint64_t WY_LZCodec::get_max_decoded_size(const uint64_t p_size) const noexcept
+{
+    return (p_size > (UINT64_MAX-m_min_match-15)/255) ? UINT64_MAX : p_size*255 + m_min_match + 15;
+}
+
+
+int WY_LZCodec::decode(const unsigned char *__restrict__ const p_src, const uint64_t p_size, unsigned char *__restrict__ const p_dst, const uint64_t p_decoded_size) const noexcept
+{
+    const unsigned char * ip = p_src;
+    const unsigned char * const iend = p_src+p_size;
+    unsigned char * op = p_dst;
+    unsigned char * const oend = p_dst+p_decoded_size;
+
+    while(ip < iend) {
+        const unsigned char token = *ip++;
+
+        uint64_t literals = token >> 4;
+        if((literals == 15) && (read_length(ip, iend, literals, p_decoded_size) != 0))
+            return -1;
+        if((literals > (uint64_t)(iend-ip)) || (literals > (uint64_t)(oend-op)))
+            return -1;
+        if((literals <= 16) && (iend-ip >= 16) && (oend-op >= 16)) /* Fixed-size copy of short runs, the bytes past the run are overwritten later. */
+            memcpy(op, ip, 16);
+        else
+            memcpy(op, ip, literals);
+        op += literals;
+        ip += literals;
+        if(ip == iend) /* The last sequence has no match. */
+            break;
+
+        if(iend-ip < 2)
+            return -1;
+        const uint64_t offset = ip[0] | ((uint64_t)ip[1] << 8);
+        ip += 2;
+        uint64_t match = token & 15;
+        if((match == 15) && (read_length(ip, iend, match, p_decoded_size) != 0))
+            return -1;
+        match += m_min_match;
+        if((offset == 0) || (offset > (uint64_t)(op-p_dst)) || (match > (uint64_t)(oend-op)))
+            return -1;
+
+        const unsigned char * ref = op-offset;
+        if((offset >= 8) && ((uint64_t)(oend-op) >= match+8)) { /* Copy 8 bytes at a time. Each copy only reads bytes that are already written. */
+            for(uint64_t i=0; i<match; i+=8)
+                memcpy(op+i, ref+i, 8);
+        } else if(offset >= match)
+            memcpy(op, ref, match);
+        else { /* Overlapping match repeats the last offset bytes. */
+            for(uint64_t i=0; i<match; i++)
+                op[i] = ref[i];
+        }
+        op += match;
+    }
+
+    return (op == oend) ? 0 : -1;
+}
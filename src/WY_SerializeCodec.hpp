@@ -0,0 +1,118 @@
+/*
+* Copyright 2023 Au Yeong Wing Yau
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#ifndef _WY_SERIALIZE_CODEC_HPP_
+#define _WY_SERIALIZE_CODEC_HPP_
+
+#include <cstdint>
+#pragma once
+namespace WY_Serialize
+{
+
+/**
+ * Interface of the block codecs used by WY_SerializeAgent to compress blocks. See WY_SerializeAgent::set_codec().
+ * The codec ID is stored in the header of every encoded block, so a codec must keep its ID and format once save files have been written with it. Functions are const and must be thread-safe, as blocks may be encoded from several threads.
+ */
+class WY_SerializeCodec
+{
+public:
+    /**
+     * Virtual destructor.
+    */
+    virtual ~WY_SerializeCodec() {};
+
+    /**
+     * Gets the ID of the codec stored in encoded block headers. 1 is used by WY_LZCodec.
+     * \return The codec ID, from 1 to 255.
+    */
+    virtual unsigned int get_codec_id() const noexcept = 0;
+
+    /**
+     * Encodes data.
+     * \param p_src The data to encode.
+     * \param p_size Size of p_src.
+     * \param p_dst Buffer for the encoded data.
+     * \param p_capacity Size of p_dst.
+     * \return Size of the encoded data in p_dst. 0 if the encoded data does not fit into p_capacity bytes.
+    */
+    virtual uint64_t encode(const unsigned char *__restrict__ const p_src, const uint64_t p_size, unsigned char *__restrict__ const p_dst, const uint64_t p_capacity) const noexcept = 0;
+
+    /**
+     * Gets the largest size data encoded into p_size bytes can decode to. Used to reject corrupt sizes before memory is allocated for decoding.
+     * \param p_size Size of the encoded data.
+     * \return The largest decoded size.
+    */
+    virtual uint64_t get_max_decoded_size(const uint64_t p_size) const noexcept = 0;
+
+    /**
+     * Decodes data encoded with encode(). Must check p_src so corrupt data cannot write outside p_dst.
+     * \param p_src The encoded data.
+     * \param p_size Size of p_src.
+     * \param p_dst Buffer for the decoded data.
+     * \param p_decoded_size Size of the data before it was encoded. p_dst has exactly this size.
+     * \return 0 if no error. -1 if p_src is invalid.
+    */
+    virtual int decode(const unsigned char *__restrict__ const p_src, const uint64_t p_size, unsigned char *__restrict__ const p_dst, const uint64_t p_decoded_size) const noexcept = 0;
+};
+
+
+/**
+ * The built-in WY_SerializeCodec. A byte-oriented LZ77 codec in the style of LZ4: each sequence is a token byte, a run of literals and a back-reference of up to 64 KB. It trades compression ratio for speed so it does not slow down saving and loading from fast disks.
+ */
+class WY_LZCodec: public WY_SerializeCodec
+{
+public:
+    /**
+     * Implements the WY_SerializeCodec virtual function.
+     * \return 1.
+    */
+    unsigned int get_codec_id() const noexcept;
+
+    /**
+     * Implements the WY_SerializeCodec virtual function.
+     * \param p_src The data to encode.
+     * \param p_size Size of p_src.
+     * \param p_dst Buffer for the encoded data.
+     * \param p_capacity Size of p_dst.
+     * \return Size of the encoded data in p_dst. 0 if the encoded data does not fit into p_capacity bytes.
+    */
+    uint64_t encode(const unsigned char *__restrict__ const p_src, const uint64_t p_size, unsigned char *__restrict__ const p_dst, const uint64_t p_capacity) const noexcept;
+
+    /**
+     * Implements the WY_SerializeCodec virtual function.
+     * \param p_size Size of the encoded data.
+     * \return The largest decoded size. Every encoded byte decodes to at most 255 bytes.
+    */
+    uint64_t get_max_decoded_size(const uint64_t p_size) const noexcept;
+
+    /**
+     * Implements the WY_SerializeCodec virtual function.
+     * \param p_src The encoded data.
+     * \param p_size Size of p_src.
+     * \param p_dst Buffer for the decoded data.
+     * \param p_decoded_size Size of the data before it was encoded.
+     * \return 0 if no error. -1 if p_src is invalid.
+    */
+    int decode(const unsigned char *__restrict__ const p_src, const uint64_t p_size, unsigned char *__restrict__ const p_dst, const uint64_t p_decoded_size) const noexcept;
+
+private:
+    static const unsigned int m_min_match = 4; /**< Shortest back-reference. */
+    static const unsigned int m_max_offset = 65535; /**< Longest back-reference distance. */
+    static const unsigned int m_hash_bits_max = 14; /**< Log2 of the largest hash table. */
+};
+}
+
+#endif
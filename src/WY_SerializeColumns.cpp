@@ -0,0 +1,408 @@
+/*
+* Copyright 2023 Au Yeong Wing Yau
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+#include <cstring>
+#include <exception>
+#include "WY_SerializeColumns.hpp"
+#include "WY_SerializeVarint.hpp"
+#include "WY_ByteOrder.hpp"
+using namespace WY_Serialize;
+
+static const WY_LZCodec g_lz_codec; /**< Decodes columns of the built-in codec when another codec or none is given. */
+
+
+/**
+ * Copies the values of a column from one strided array to another.
+ * \tparam SIZE Size of a value, 0 if it is only known at run time. The copy of each value then compiles to a single move.
+ * \param p_src The first value.
+ * \param p_src_stride Distance from one value to the next in p_src.
+ * \param p_dst Where the first value goes.
+ * \param p_dst_stride Distance from one value to the next in p_dst.
+ * \param p_count Number of values.
+ * \param p_size Size of a value.
+*/
+template <unsigned int SIZE>
+static void copy_values(const unsigned char *__restrict__ p_src, const uint64_t p_src_stride, unsigned char *__restrict__ p_dst, const uint64_t p_dst_stride, const uint64_t p_count, const uint64_t p_size) noexcept
+{
+    for(uint64_t i=0; i<p_count; i++) {
+        memcpy(p_dst, p_src, SIZE ? SIZE : p_size);
+        p_src += p_src_stride;
+        p_dst += p_dst_stride;
+    }
+}
+
+
+/**
+ * Copies the values of a column from one strided array to another, with a constant size copy for common value sizes.
+ * \param p_src The first value.
+ * \param p_src_stride Distance from one value to the next in p_src.
+ * \param p_dst Where the first value goes.
+ * \param p_dst_stride Distance from one value to the next in p_dst.
+ * \param p_count Number of values.
+ * \param p_size Size of a value.
+*/
+static void copy_column(const unsigned char *__restrict__ const p_src, const uint64_t p_src_stride, unsigned char *__restrict__ const p_dst, const uint64_t p_dst_stride, const uint64_t p_count, const uint64_t p_size) noexcept
+{
+    if((p_src_stride == p_size) && (p_dst_stride == p_size)) { /* Both dense. */
+        memcpy(p_dst, p_src, p_count * p_size);
+        return;
+    }
+    switch(p_size) {
+    case 1: copy_values<1>(p_src, p_src_stride, p_dst, p_dst_stride, p_count, p_size); break;
+    case 2: copy_values<2>(p_src, p_src_stride, p_dst, p_dst_stride, p_count, p_size); break;
+    case 4: copy_values<4>(p_src, p_src_stride, p_dst, p_dst_stride, p_count, p_size); break;
+    case 8: copy_values<8>(p_src, p_src_stride, p_dst, p_dst_stride, p_count, p_size); break;
+    case 16: copy_values<16>(p_src, p_src_stride, p_dst, p_dst_stride, p_count, p_size); break;
+    default: copy_values<0>(p_src, p_src_stride, p_dst, p_dst_stride, p_count, p_size); break;
+    }
+}
+
+
+/**
+ * Copies the values of a number column from one strided array to another, reversing the bytes of each value.
+ * \param p_src The first value.
+ * \param p_src_stride Distance from one value to the next in p_src.
+ * \param p_dst Where the first value goes.
+ * \param p_dst_stride Distance from one value to the next in p_dst.
+ * \param p_count Number of values.
+ * \param p_size Size of a value: 2, 4 or 8.
+*/
+static void swap_column(const unsigned char *__restrict__ p_src, const uint64_t p_src_stride, unsigned char *__restrict__ p_dst, const uint64_t p_dst_stride, const uint64_t p_count, const uint64_t p_size) noexcept
+{
+    if((p_src_stride == p_size) && (p_dst_stride == p_size)) { /* Both dense, so the vectorised swap applies. */
+        WY_ByteOrder::swap_array(p_src, p_dst, p_count, p_size);
+        return;
+    }
+    for(uint64_t i=0; i<p_count; i++) {
+        for(uint64_t b=0; b<p_size; b++)
+            p_dst[b] = p_src[p_size-1-b];
+        p_src += p_src_stride;
+        p_dst += p_dst_stride;
+    }
+}
+
+
+/**
+ * Stores the values of a column as COLUMN_SHUFFLE byte planes. Records are read in order, and each byte of a value goes to its own plane.
+ * \param p_src The first value.
+ * \param p_stride Distance from one value to the next in p_src.
+ * \param p_dst Buffer of p_count * p_size bytes.
+ * \param p_count Number of values.
+ * \param p_size Size of a value.
+ * \param p_flip 0, or p_size-1 to store the bytes of each value in reverse order.
+*/
+static void shuffle_column(const unsigned char *__restrict__ p_src, const uint64_t p_stride, unsigned char *__restrict__ const p_dst, const uint64_t p_count, const uint64_t p_size, const uint64_t p_flip) noexcept
+{
+    for(uint64_t i=0; i<p_count; i++) {
+        for(uint64_t b=0; b<p_size; b++)
+            p_dst[b*p_count + i] = p_src[b ^ p_flip];
+        p_src += p_stride;
+    }
+}
+
+
+/**
+ * Reverses shuffle_column().
+ * \param p_src The byte planes, p_count * p_size bytes.
+ * \param p_dst Where the first value goes.
+ * \param p_stride Distance from one value to the next in p_dst.
+ * \param p_count Number of values.
+ * \param p_size Size of a value.
+ * \param p_flip 0, or p_size-1 if the bytes of each value are stored in reverse order.
+*/
+static void unshuffle_column(const unsigned char *__restrict__ const p_src, unsigned char *__restrict__ p_dst, const uint64_t p_stride, const uint64_t p_count, const uint64_t p_size, const uint64_t p_flip) noexcept
+{
+    for(uint64_t i=0; i<p_count; i++) {
+        for(uint64_t b=0; b<p_size; b++)
+            p_dst[b ^ p_flip] = p_src[b*p_count + i];
+        p_dst += p_stride;
+    }
+}
+
+
+/**
+ * Stores the values of an integer column as COLUMN_DELTA varints.
+ * \tparam U Unsigned integer of the size of a value. Differences wrap around at its width, so signed and unsigned values both work.
+ * \param p_src The first value.
+ * \param p_stride Distance from one value to the next in p_src.
+ * \param p_dst Buffer of at least 10 bytes per value.
+ * \param p_count Number of values.
+ * \return Number of bytes written.
+*/
+template <typename U>
+static uint64_t encode_delta(const unsigned char *__restrict__ p_src, const uint64_t p_stride, unsigned char *__restrict__ const p_dst, const uint64_t p_count) noexcept
+{
+    typedef typename std::make_signed<U>::type S;
+    uint64_t size = 0;
+    U previous = 0;
+
+    for(uint64_t i=0; i<p_count; i++) {
+        U value;
+        memcpy(&value, p_src, sizeof(U));
+        const int64_t delta = (S)(U)(value - previous);
+        const uint64_t zigzag = ((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63); /* Small negative differences stay small. */
+        if(zigzag < 0x80)
+            p_dst[size++] = (unsigned char)zigzag;
+        else
+            size += WY_SerializeVarint::encode(zigzag, p_dst+size);
+        previous = value;
+        p_src += p_stride;
+    }
+    return size;
+}
+
+
+/**
+ * Reverses encode_delta().
+ * \tparam U Unsigned integer of the size of a value.
+ * \param p_src The varints.
+ * \param p_size Size of p_src, which must hold exactly p_count varints.
+ * \param p_dst Where the first value goes.
+ * \param p_stride Distance from one value to the next in p_dst.
+ * \param p_count Number of values.
+ * \return 0 if no error. -1 if p_src is invalid.
+*/
+template <typename U>
+static int decode_delta(const unsigned char *__restrict__ const p_src, const uint64_t p_size, unsigned char *__restrict__ p_dst, const uint64_t p_stride, const uint64_t p_count) noexcept
+{
+    uint64_t offset = 0;
+    U previous = 0;
+
+    for(uint64_t i=0; i<p_count; i++) {
+        uint64_t zigzag;
+        if((offset < p_size) && (p_src[offset] < 0x80))
+            zigzag = p_src[offset++];
+        else {
+            const unsigned int length = WY_SerializeVarint::decode(p_src+offset, p_size-offset, &zigzag);
+            if(length == 0)
+                return -1;
+            offset += length;
+        }
+        const uint64_t delta = (zigzag >> 1) ^ (0 - (zigzag & 1));
+        previous = (U)(previous + (U)delta);
+        memcpy(p_dst, &previous, sizeof(U));
+        p_dst += p_stride;
+    }
+    return (offset == p_size) ? 0 : -1;
+}
+
+
+int WY_ColumnBlock::encode(const unsigned char *__restrict__ const p_records, const uint64_t p_count, const uint64_t p_record_size, const S_ColumnLayout *__restrict__ const p_columns, const unsigned int p_column_count, const WY_SerializeCodec *__restrict__ const p_codec, std::vector<unsigned char> *__restrict__ const p_buffer) noexcept
+{
+    std::vector<unsigned char> scratch;
+    uint64_t capacity = m_header_size + (uint64_t)m_entry_size * p_column_count;
+    uint64_t scratch_size = 0;
+
+    if(p_column_count == 0)
+        return -1;
+    for(unsigned int c=0; c<p_column_count; c++) {
+        const S_ColumnLayout &column = p_columns[c];
+        if((column.m_size == 0) || (column.m_offset + (uint64_t)column.m_size > p_record_size) || (p_count > UINT64_MAX / 16 / column.m_size))
+            return -1;
+        if(((column.m_encoding == COLUMN_DELTA) || column.m_number) && (column.m_size != 1) && (column.m_size != 2) && (column.m_size != 4) && (column.m_size != 8))
+            return -1;
+        if((column.m_encoding != COLUMN_RAW) && (column.m_encoding != COLUMN_SHUFFLE) && (column.m_encoding != COLUMN_DELTA))
+            return -1;
+        const uint64_t size = (column.m_encoding == COLUMN_DELTA) ? p_count * 10 : p_count * column.m_size; /* At most 10 bytes per varint. */
+        capacity += size;
+        if(column.m_compress && (p_codec != NULL) && (size > scratch_size))
+            scratch_size = size;
+    }
+    try {
+        p_buffer->resize(capacity);
+        scratch.resize(scratch_size);
+    } catch (std::exception &e) {
+        return -1;
+    }
+
+    unsigned char *__restrict__ const dst = p_buffer->data();
+    uint64_t offset = m_header_size + (uint64_t)m_entry_size * p_column_count;
+    encode_le32(dst, m_marker);
+    encode_le32(dst+4, p_column_count);
+    encode_le64(dst+8, p_count);
+    for(unsigned int c=0; c<p_column_count; c++) {
+        const S_ColumnLayout &column = p_columns[c];
+        const bool compress = column.m_compress && (p_codec != NULL) && (p_count > 0);
+        unsigned char *__restrict__ const out = compress ? scratch.data() : dst + offset; /* Compressed columns are transformed into the scratch buffer first. */
+        const unsigned char *__restrict__ const src = p_records + column.m_offset;
+        const bool swap = SERIALIZE_SWAP_BYTES && column.m_number; /* Numbers are stored little-endian. Delta varints are already. */
+        uint64_t size = p_count * column.m_size;
+
+        if(column.m_encoding == COLUMN_SHUFFLE)
+            shuffle_column(src, p_record_size, out, p_count, column.m_size, swap ? column.m_size-1 : 0);
+        else if(column.m_encoding == COLUMN_DELTA) {
+            switch(column.m_size) {
+            case 1: size = encode_delta<uint8_t>(src, p_record_size, out, p_count); break;
+            case 2: size = encode_delta<uint16_t>(src, p_record_size, out, p_count); break;
+            case 4: size = encode_delta<uint32_t>(src, p_record_size, out, p_count); break;
+            default: size = encode_delta<uint64_t>(src, p_record_size, out, p_count); break;
+            }
+        } else if(swap)
+            swap_column(src, p_record_size, out, column.m_size, p_count, column.m_size);
+        else
+            copy_column(src, p_record_size, out, column.m_size, p_count, column.m_size);
+
+        uint64_t stored_size = size;
+        unsigned int codec_id = 0;
+        if(compress) {
+            stored_size = p_codec->encode(out, size, dst + offset, size - 1); /* Only kept if it is smaller. */
+            if(stored_size != 0)
+                codec_id = p_codec->get_codec_id();
+            else {
+                memcpy(dst + offset, out, size);
+                stored_size = size;
+            }
+        }
+
+        unsigned char *__restrict__ const entry = dst + m_header_size + (uint64_t)m_entry_size * c;
+        encode_le32(entry, column.m_size);
+        entry[4] = (unsigned char)column.m_encoding;
+        entry[5] = (unsigned char)codec_id;
+        entry[6] = column.m_number ? m_flag_number : 0;
+        entry[7] = 0;
+        encode_le64(entry+8, size);
+        encode_le64(entry+16, stored_size);
+        offset += stored_size;
+    }
+    p_buffer->resize(offset);
+    return 0;
+}
+
+
+int WY_ColumnBlock::get_record_count(const unsigned char *__restrict__ const p_src, const uint64_t p_size, uint64_t *__restrict__ const p_count, unsigned int *__restrict__ const p_column_count) noexcept
+{
+    S_ColumnView view;
+
+    if(p_size < m_header_size)
+        return -1;
+    const uint32_t column_count = decode_le32(p_src+4);
+    if((decode_le32(p_src) != m_marker) || (column_count == 0))
+        return -1;
+    if(find_column(p_src, p_size, column_count-1, &view) != 0) /* Checks every column entry, so the count is backed by the data. */
+        return -1;
+    *p_count = view.m_count;
+    *p_column_count = column_count;
+    return 0;
+}
+
+
+int WY_ColumnBlock::find_column(const unsigned char *__restrict__ const p_src, const uint64_t p_size, const unsigned int p_index, S_ColumnView *__restrict__ const p_view) noexcept
+{
+    if(p_size < m_header_size)
+        return -1;
+    const uint32_t column_count = decode_le32(p_src+4);
+    const uint64_t count = decode_le64(p_src+8);
+    if((decode_le32(p_src) != m_marker) || (p_index >= column_count) || (column_count > (p_size - m_header_size) / m_entry_size))
+        return -1;
+
+    uint64_t offset = m_header_size + (uint64_t)m_entry_size * column_count;
+    for(unsigned int c=0; c<=p_index; c++) {
+        const unsigned char *__restrict__ const entry = p_src + m_header_size + (uint64_t)m_entry_size * c;
+        const uint32_t value_size = decode_le32(entry);
+        const uint64_t encoded_size = decode_le64(entry+8);
+        const uint64_t stored_size = decode_le64(entry+16);
+        const unsigned int encoding = entry[4];
+        const unsigned int codec_id = entry[5];
+        const unsigned int flags = entry[6];
+
+        if((value_size == 0) || (count > UINT64_MAX / 16 / value_size) || (stored_size > p_size - offset))
+            return -1;
+        if(encoding == COLUMN_DELTA) {
+            if(((value_size != 1) && (value_size != 2) && (value_size != 4) && (value_size != 8)) || (encoded_size < count) || (encoded_size / 10 > count))
+                return -1;
+        } else if(((encoding != COLUMN_RAW) && (encoding != COLUMN_SHUFFLE)) || (encoded_size != count * value_size))
+            return -1;
+        if(((codec_id == 0) && (stored_size != encoded_size)) || ((flags & ~m_flag_number) != 0))
+            return -1;
+        if((flags & m_flag_number) && (value_size != 1) && (value_size != 2) && (value_size != 4) && (value_size != 8))
+            return -1;
+
+        p_view->m_count = count;
+        p_view->m_size = value_size;
+        p_view->m_encoding = (COLUMN_ENCODING)encoding;
+        p_view->m_number = (flags & m_flag_number) != 0;
+        p_view->m_codec_id = codec_id;
+        p_view->m_encoded_size = encoded_size;
+        p_view->m_stored_size = stored_size;
+        p_view->m_data = p_src + offset;
+        offset += stored_size;
+    }
+    return 0;
+}
+
+
+int WY_ColumnBlock::decode_column(const S_ColumnView &p_view, unsigned char *__restrict__ const p_dst, const uint64_t p_stride, const WY_SerializeCodec *__restrict__ const p_codec) noexcept
+{
+    std::vector<unsigned char> scratch;
+    const unsigned char * src = p_view.m_data;
+
+    if(p_view.m_codec_id != 0) {
+        const WY_SerializeCodec * codec;
+        if((p_codec != NULL) && (p_codec->get_codec_id() == p_view.m_codec_id))
+            codec = p_codec;
+        else if(p_view.m_codec_id == g_lz_codec.get_codec_id())
+            codec = &g_lz_codec;
+        else
+            return -1;
+        if(p_view.m_encoded_size > codec->get_max_decoded_size(p_view.m_stored_size)) /* Corrupt size, reject it before allocating. */
+            return -1;
+        try {
+            scratch.resize(p_view.m_encoded_size);
+        } catch (std::exception &e) {
+            return -1;
+        }
+        if(codec->decode(p_view.m_data, p_view.m_stored_size, scratch.data(), p_view.m_encoded_size) != 0)
+            return -1;
+        src = scratch.data();
+    }
+    if(p_view.m_count == 0)
+        return 0;
+
+    const bool swap = SERIALIZE_SWAP_BYTES && p_view.m_number;
+    if(p_view.m_encoding == COLUMN_SHUFFLE)
+        unshuffle_column(src, p_dst, p_stride, p_view.m_count, p_view.m_size, swap ? p_view.m_size-1 : 0);
+    else if(p_view.m_encoding == COLUMN_DELTA) {
+        switch(p_view.m_size) {
+        case 1: return decode_delta<uint8_t>(src, p_view.m_encoded_size, p_dst, p_stride, p_view.m_count);
+        case 2: return decode_delta<uint16_t>(src, p_view.m_encoded_size, p_dst, p_stride, p_view.m_count);
+        case 4: return decode_delta<uint32_t>(src, p_view.m_encoded_size, p_dst, p_stride, p_view.m_count);
+        default: return decode_delta<uint64_t>(src, p_view.m_encoded_size, p_dst, p_stride, p_view.m_count);
+        }
+    } else if(swap)
+        swap_column(src, p_view.m_size, p_dst, p_stride, p_view.m_count, p_view.m_size);
+    else
+        copy_column(src, p_view.m_size, p_dst, p_stride, p_view.m_count, p_view.m_size);
+    return 0;
+}
+
+
+int WY_ColumnBlock::decode(const unsigned char *__restrict__ const p_src, const uint64_t p_size, unsigned char *__restrict__ const p_records, const uint64_t p_record_size, const S_ColumnLayout *__restrict__ const p_columns, const unsigned int p_column_count, const WY_SerializeCodec *__restrict__ const p_codec) noexcept
+{
+    S_ColumnView view;
+    uint64_t count;
+    unsigned int column_count;
+
+    if((get_record_count(p_src, p_size, &count, &column_count) != 0) || (column_count != p_column_count))
+        return -1;
+    for(unsigned int c=0; c<p_column_count; c++) {
+        if((p_columns[c].m_offset + (uint64_t)p_columns[c].m_size > p_record_size) || (find_column(p_src, p_size, c, &view) != 0) || (view.m_size != p_columns[c].m_size))
+            return -1;
+        if(decode_column(view, p_records + p_columns[c].m_offset, p_record_size, p_codec) != 0)
+            return -1;
+    }
+    return 0;
+}
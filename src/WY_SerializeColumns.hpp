@@ -0,0 +1,288 @@
+/*
+* Copyright 2023 Au Yeong Wing Yau
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+#ifndef _WY_SERIALIZE_COLUMNS_HPP_
+#define _WY_SERIALIZE_COLUMNS_HPP_
+
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <type_traits>
+#include <vector>
+#include "WY_SerializeDef.hpp"
+#include "WY_SerializeCodec.hpp"
+#pragma once
+namespace WY_Serialize
+{
+
+/**
+ * How a column of a columnar block is stored. See WY_SerializeColumns.
+ */
+enum COLUMN_ENCODING {
+    COLUMN_RAW = 0, /**< The values as they are in memory, one after the other. */
+    COLUMN_SHUFFLE, /**< The first byte of every value, then the second byte of every value, and so on. Bytes that change slowly, such as the exponents of floats or the high bytes of small integers, end up next to each other, so the codec compresses them much better. */
+    COLUMN_DELTA /**< Only for integers of 1, 2, 4 or 8 bytes. The difference to the previous value as a zigzag varint, so sorted IDs, counters and timestamps take one or two bytes per value. */
+};
+
+/**
+ * A column of the records passed to WY_ColumnBlock::encode() and WY_ColumnBlock::decode().
+ */
+struct S_ColumnLayout {
+    uint32_t m_offset; /**< Offset of the field in a record. */
+    uint32_t m_size; /**< Size of the field. */
+    COLUMN_ENCODING m_encoding; /**< How the column is stored. */
+    bool m_compress; /**< Whether the column is compressed with the codec passed to WY_ColumnBlock::encode(). */
+    bool m_number; /**< Whether the field is a number or enum of 1, 2, 4 or 8 bytes, which is stored little-endian. Other fields are stored as they are in memory. */
+};
+
+/**
+ * A column of a columnar block, found by WY_ColumnBlock::find_column().
+ */
+struct S_ColumnView {
+    uint64_t m_count; /**< Number of values, which is the number of records. */
+    uint32_t m_size; /**< Size of a value. */
+    COLUMN_ENCODING m_encoding; /**< How the column is stored. */
+    bool m_number; /**< Whether the values are numbers stored little-endian. */
+    unsigned int m_codec_id; /**< ID of the codec the column is compressed with, 0 if it is not compressed. */
+    uint64_t m_encoded_size; /**< Size of the column before it was compressed. */
+    uint64_t m_stored_size; /**< Size of the column in the block. */
+    const unsigned char * m_data; /**< The column in the block. */
+};
+
+/**
+ * Encodes and decodes columnar blocks, which store an array of records column by column: all values of the first field, then all values of the second field, and so on. Each column has its own COLUMN_ENCODING and is compressed on its own, so columns of similar values compress much better than interleaved records, and one column can be read without decoding the others. WY_SerializeColumns builds the columns from the fields of a struct. <br>
+ * The data of a columnar block is a 16 byte header (the marker "COL1", the number of columns and the number of records), a 24 byte entry per column (value size, encoding, codec ID, flags, a reserved byte, size before compression and size in the block) and then the columns in order. All sizes are little-endian. Values of columns with S_ColumnLayout::m_number set, which flags their entry, are little-endian as well, so they load on machines of either byte order. Other values are stored as they are in memory, like WY_SerializePod.
+ *
+ * Usage, for example in a tool that only needs one field of a checkpoint: <br>
+ * @code
+ * std::vector<float> masses; 
+ * agent.load_serializable_view_by_type(PARTICLES, &view); 
+ * WY_ColumnBlock::read_column(view.m_data, view.m_size, 2, &masses); // The third column. 
+ * @endcode
+ */
+class WY_ColumnBlock
+{
+public:
+    /**
+     * Encodes an array of records as a columnar block.
+     * \param p_records The records.
+     * \param p_count Number of records.
+     * \param p_record_size Size of a record, the distance from one record to the next.
+     * \param p_columns The columns, in the order they are stored.
+     * \param p_column_count Number of entries in p_columns.
+     * \param p_codec Codec for the columns with S_ColumnLayout::m_compress set. Columns it does not make smaller are stored uncompressed. NULL to compress none.
+     * \param p_buffer Returns the block. Its capacity is kept, so encoding into the same buffer again does not allocate once it is large enough.
+     * \return 0 if no error. -1 if a column is invalid, such as COLUMN_DELTA on a size other than 1, 2, 4 or 8, or memory cannot be allocated.
+    */
+    static int encode(const unsigned char *__restrict__ const p_records, const uint64_t p_count, const uint64_t p_record_size, const S_ColumnLayout *__restrict__ const p_columns, const unsigned int p_column_count, const WY_SerializeCodec *__restrict__ const p_codec, std::vector<unsigned char> *__restrict__ const p_buffer) noexcept;
+
+    /**
+     * Decodes a columnar block into an array of records. Bytes of the records not covered by a column are left unchanged.
+     * \param p_src The block.
+     * \param p_size Size of the block.
+     * \param p_records Buffer for get_record_count() records.
+     * \param p_record_size Size of a record.
+     * \param p_columns The columns, which must have the value sizes of the stored columns. Their encodings are read from the block.
+     * \param p_column_count Number of entries in p_columns, which must be the number of stored columns.
+     * \param p_codec Codec for columns compressed with a codec other than WY_LZCodec, which is always known. NULL if none.
+     * \return 0 if no error. -1 if the block is invalid or does not match p_columns, a codec is unknown or memory cannot be allocated.
+    */
+    static int decode(const unsigned char *__restrict__ const p_src, const uint64_t p_size, unsigned char *__restrict__ const p_records, const uint64_t p_record_size, const S_ColumnLayout *__restrict__ const p_columns, const unsigned int p_column_count, const WY_SerializeCodec *__restrict__ const p_codec) noexcept;
+
+    /**
+     * Reads the header of a columnar block.
+     * \param p_src The block.
+     * \param p_size Size of the block.
+     * \param p_count Returns the number of records.
+     * \param p_column_count Returns the number of columns.
+     * \return 0 if no error. -1 if the block is not a columnar block.
+    */
+    static int get_record_count(const unsigned char *__restrict__ const p_src, const uint64_t p_size, uint64_t *__restrict__ const p_count, unsigned int *__restrict__ const p_column_count) noexcept;
+
+    /**
+     * Finds a column of a columnar block without decoding it. Only the header and the column entries are read.
+     * \param p_src The block.
+     * \param p_size Size of the block.
+     * \param p_index Index of the column.
+     * \param p_view Returns the column.
+     * \return 0 if no error. -1 if the block is invalid or has no column p_index.
+    */
+    static int find_column(const unsigned char *__restrict__ const p_src, const uint64_t p_size, const unsigned int p_index, S_ColumnView *__restrict__ const p_view) noexcept;
+
+    /**
+     * Decodes a column found by find_column().
+     * \param p_view The column.
+     * \param p_dst Where the first value goes.
+     * \param p_stride Distance from one value to the next in p_dst. p_view.m_size for an array of values, or the record size to decode into records.
+     * \param p_codec Codec for a column compressed with a codec other than WY_LZCodec. NULL if none.
+     * \return 0 if no error. -1 if the column is invalid, its codec is unknown or memory cannot be allocated.
+    */
+    static int decode_column(const S_ColumnView &p_view, unsigned char *__restrict__ const p_dst, const uint64_t p_stride, const WY_SerializeCodec *__restrict__ const p_codec) noexcept;
+
+    /**
+     * Decodes one column of a columnar block into an array of values.
+     * \tparam F Type of the values. Must have the stored value size.
+     * \param p_src The block.
+     * \param p_size Size of the block.
+     * \param p_index Index of the column.
+     * \param p_values Returns the values.
+     * \param p_codec Codec for a column compressed with a codec other than WY_LZCodec. NULL if none.
+     * \return 0 if no error. -1 if the block is invalid, has no column p_index of values of sizeof(F) bytes, or memory cannot be allocated.
+    */
+    template <typename F>
+    static int read_column(const unsigned char *__restrict__ const p_src, const uint64_t p_size, const unsigned int p_index, std::vector<F> *__restrict__ const p_values, const WY_SerializeCodec *__restrict__ const p_codec = NULL) noexcept
+    {
+        static_assert(std::is_trivially_copyable<F>::value, "WY_ColumnBlock::read_column() needs a trivially copyable type.");
+        S_ColumnView view;
+
+        if((find_column(p_src, p_size, p_index, &view) != 0) || (view.m_size != sizeof(F)))
+            return -1;
+        try {
+            p_values->resize(view.m_count);
+        } catch (std::exception &e) {
+            return -1;
+        }
+        return decode_column(view, (unsigned char *)p_values->data(), sizeof(F), p_codec);
+    }
+
+    static const uint32_t m_marker = 0x314C4F43; /**< "COL1" read as a little-endian integer. First in every columnar block. */
+    static const unsigned int m_header_size = 16; /**< Size of the header of a columnar block. */
+    static const unsigned int m_entry_size = 24; /**< Size of the entry of a column. */
+    static const unsigned int m_flag_number = 1; /**< Set in the flags of the entry of a column of little-endian numbers. */
+};
+
+
+/**
+ * Saves and loads an array of trivially copyable records as a columnar block, see WY_ColumnBlock. The columns are the fields of the struct that are added with add_column(), each with its own COLUMN_ENCODING. Fields that are not added, and padding, are not saved. A component with a large array of records gives the block to WY_SerializeObj::get_save_data() instead of the array itself. The block compresses much better, and analytics tools can read one field with WY_ColumnBlock::read_column(). <br>
+ * <br>
+ * Usage: <br>
+ * @code
+ * struct S_Particle { uint64_t m_id; double m_x; double m_y; float m_mass; };
+ * WY_SerializeColumns<S_Particle> columns; 
+ * columns.add_column(&S_Particle::m_id, COLUMN_DELTA); // Sorted IDs. 
+ * columns.add_column(&S_Particle::m_x, COLUMN_SHUFFLE); 
+ * columns.add_column(&S_Particle::m_y, COLUMN_SHUFFLE); 
+ * columns.add_column(&S_Particle::m_mass); 
+ * columns.set_codec(&codec); 
+ * 
+ * int get_save_data(S_SerializeData *p_data) noexcept { // In the component. 
+ *  p_data->m_type = PARTICLES; 
+ *  return columns.save_columns(m_particles.data(), m_particles.size(), &m_buffer, p_data); 
+ * } 
+ * int get_load_data(const uint64_t p_size, const unsigned char *p_data) noexcept { 
+ *  return columns.load_columns(p_size, p_data, &m_particles); 
+ * } 
+ * @endcode
+ * \tparam T The record. Must be trivially copyable.
+ */
+template <typename T>
+class WY_SerializeColumns
+{
+    static_assert(std::is_trivially_copyable<T>::value, "WY_SerializeColumns needs a trivially copyable type.");
+
+public:
+    /**
+     * Constructor. There are no columns and no codec.
+    */
+    WY_SerializeColumns() noexcept
+    {
+        m_codec = NULL;
+    }
+
+    /**
+     * Adds a field of the record as the next column. The columns of a loaded block must have been added in the same order, with fields of the same sizes, as when it was saved. Number and enum fields are stored little-endian, other fields as they are in memory.
+     * \tparam F Type of the field. Must be trivially copyable.
+     * \param p_field The field, such as &S_Particle::m_x.
+     * \param p_encoding How the column is stored. COLUMN_DELTA needs an integer or enum field of 1, 2, 4 or 8 bytes. Defaults to COLUMN_RAW.
+     * \param p_compress Whether the column is compressed with the codec set by set_codec(). Defaults to true.
+     * \return 0 if no error. -1 if p_encoding does not suit the field or memory cannot be allocated.
+    */
+    template <typename F>
+    int add_column(F T::*p_field, const COLUMN_ENCODING p_encoding = COLUMN_RAW, const bool p_compress = true) noexcept
+    {
+        static_assert(std::is_trivially_copyable<F>::value, "WY_SerializeColumns needs trivially copyable fields.");
+        alignas(T) unsigned char storage[sizeof(T)];
+        const T * const record = reinterpret_cast<const T *>(storage); /* Only the address of the field is taken, the record is never read. */
+        const bool number = (std::is_arithmetic<F>::value || std::is_enum<F>::value) && ((sizeof(F) & (sizeof(F)-1)) == 0) && (sizeof(F) <= 8);
+        const S_ColumnLayout column = {(uint32_t)((const unsigned char *)&(record->*p_field) - storage), (uint32_t)sizeof(F), p_encoding, p_compress, number};
+
+        if((p_encoding == COLUMN_DELTA) && (!(std::is_integral<F>::value || std::is_enum<F>::value) || ((sizeof(F) & (sizeof(F)-1)) != 0) || (sizeof(F) > 8)))
+            return -1;
+        try {
+            m_columns.push_back(column);
+        } catch (std::exception &e) {
+            return -1;
+        }
+        return 0;
+    }
+
+    /**
+     * Sets the codec columns are compressed with when they are saved. Blocks compressed by this codec can also be loaded with it.
+     * \param p_codec The codec, which must outlive this object or the next call to set_codec(). NULL (default) compresses no column.
+    */
+    void set_codec(const WY_SerializeCodec *__restrict__ const p_codec) noexcept
+    {
+        m_codec = p_codec;
+    }
+
+    /**
+     * Encodes an array of records as a columnar block.
+     * \param p_records The records.
+     * \param p_count Number of records.
+     * \param p_buffer Buffer for the block, which must stay unchanged until the block is saved.
+     * \param p_data Returns the block in m_size and m_data. m_type and m_instance are left to the caller.
+     * \return 0 if no error. -1 if memory cannot be allocated.
+    */
+    int save_columns(const T *__restrict__ const p_records, const uint64_t p_count, std::vector<unsigned char> *__restrict__ const p_buffer, S_SerializeData *__restrict__ const p_data) const noexcept
+    {
+        if(WY_ColumnBlock::encode((const unsigned char *)p_records, p_count, sizeof(T), m_columns.data(), m_columns.size(), m_codec, p_buffer) != 0)
+            return -1;
+        p_data->m_size = p_buffer->size();
+        p_data->m_data = p_buffer->data();
+        return 0;
+    }
+
+    /**
+     * Decodes a columnar block saved by save_columns() into an array of records.
+     * \param p_size Size of the loaded data.
+     * \param p_data The loaded data.
+     * \param p_records Returns the records. Fields that are not columns are value-initialised.
+     * \return 0 if no error. -1 if the block is invalid, its columns do not match the columns added, or memory cannot be allocated.
+    */
+    int load_columns(const uint64_t p_size, const unsigned char *__restrict__ const p_data, std::vector<T> *__restrict__ const p_records) const noexcept
+    {
+        uint64_t count;
+        unsigned int column_count;
+
+        if((WY_ColumnBlock::get_record_count(p_data, p_size, &count, &column_count) != 0) || (column_count != m_columns.size()))
+            return -1;
+        try {
+            p_records->clear();
+            p_records->resize(count);
+        } catch (std::exception &e) {
+            return -1;
+        }
+        return WY_ColumnBlock::decode(p_data, p_size, (unsigned char *)p_records->data(), sizeof(T), m_columns.data(), m_columns.size(), m_codec);
+    }
+
+private:
+    std::vector<S_ColumnLayout> m_columns; /**< The columns added with add_column(). */
+    const WY_SerializeCodec * m_codec; /**< Codec the columns are compressed with. NULL if none. */
+};
+}
+
+#endif
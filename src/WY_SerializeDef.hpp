@@ -18,19 +18,284 @@
 #define _WY_SERIALIZE_DEF_HPP_
 
 #include <cstddef>
+#include <cstdint>
+#include <cstring>
 #pragma once
 namespace WY_Serialize 
 {
 
+/**
+ * Modes used by WY_SerializeAgent to load a save file. Set with WY_SerializeAgent::set_load_mode().
+ */
+enum LOAD_MODE {
+    LOAD_BUFFERED = 0, /**< Reads the entire save file into a heap buffer. This is the default mode. */
+    LOAD_MMAP, /**< Maps the save file read-only into memory and parses the data in place without copying it to the heap. */
+    LOAD_STREAM /**< Reads the save file through a fixed-size window so memory use does not grow with the file size. */
+};
+
+/**
+ * Modes used by WY_SerializeAgent to write a save file. Set with WY_SerializeAgent::set_save_mode().
+ */
+enum SAVE_MODE {
+    SAVE_STREAM = 0, /**< Writes every block as it is appended. This is the default mode. */
+    SAVE_VECTORED /**< Gathers block headers and payload pointers and writes them in batches with one call to the I/O backend, pwritev() by default, without copying payloads. */
+};
+
+/**
+ * Built-in I/O backends of WY_SerializeAgent. Set with WY_SerializeAgent::set_io_backend().
+ */
+enum IO_BACKEND {
+    IO_BACKEND_DEFAULT = 0, /**< WY_FstreamIO, except for SAVE_VECTORED saves, which use WY_PosixIO. This is the default. */
+    IO_BACKEND_FSTREAM, /**< WY_FstreamIO, std::fstream with its stream buffer. */
+    IO_BACKEND_POSIX, /**< WY_PosixIO, pread() and pwritev() on a file descriptor. */
+    IO_BACKEND_URING, /**< WY_UringIO, several chunks in flight through io_uring. */
+    IO_BACKEND_URING_DIRECT /**< WY_UringIO with O_DIRECT, so aligned chunks bypass the page cache. */
+};
+
+/**
+ * How far WY_SerializeAgent::finalise_save_file() makes a save durable before it returns. Set with WY_SerializeAgent::set_save_durability().
+ */
+enum SAVE_DURABILITY {
+    SAVE_DURABILITY_NONE = 0, /**< Leaves the data in the page cache. The save survives a crash of the process but not of the system. This is the default. */
+    SAVE_DURABILITY_DATA, /**< Flushes the file data with fdatasync() before it is closed or renamed, so an atomic save never leaves an empty or partial file under the target name. The rename itself may still be lost. */
+    SAVE_DURABILITY_FULL /**< Flushes the file with fsync() and then its directory, so the save and its file name survive a system crash once finalise_save_file() returns. */
+};
+
 /** 
  * Struct for saving serializable data object.
  */
 struct S_SerializeData {
     unsigned int m_type; /**< Type of data, defined from enum SERIALIZE_TYPE. */
-    unsigned int m_size; /**< Size of the serializable data. */
+    uint64_t m_size; /**< Size of the serializable data. */
     unsigned char * m_data; /**< The data itself. */
+    uint32_t m_instance; /**< Instance of the type the data belongs to, when there are several objects of one type. 0 if there is only one, which saves no instance ID. */
+};
+
+
+/**
+ * Struct describing a block of loaded data without owning it. m_data points directly into the buffer of the WY_SerializeAgent that loaded it, so it must not be freed and is only valid until WY_SerializeAgent::clear_loaded_file_buffer() is called.
+ */
+struct S_SerializeView {
+    unsigned int m_type; /**< Type of data, defined from enum SERIALIZE_TYPE. */
+    uint64_t m_size; /**< Size of the serializable data. */
+    const unsigned char * m_data; /**< The data itself. */
+    uint32_t m_instance; /**< Instance of the type the data belongs to. 0 if the block has no instance ID. */
+};
+
+
+/**
+ * The header written in front of every block of data in a save file. It is written field by field in little-endian byte order, so the on-disk layout does not depend on struct padding or the machine.
+ */
+struct S_SerializeHeader {
+    uint32_t m_type; /**< Type of data, defined from enum SERIALIZE_TYPE. */
+    uint32_t m_flags; /**< Block options, see SERIALIZE_FLAG_CODEC_MASK, SERIALIZE_FLAG_CRC and SERIALIZE_FLAG_INSTANCE. Other bits are reserved and written as 0. */
+    uint64_t m_size; /**< Size of the data that follows the header. */
+};
+
+static const unsigned int SERIALIZE_HEADER_SIZE = 16; /**< Size of an encoded S_SerializeHeader in a save file. */
+static const unsigned int SERIALIZE_LEGACY_HEADER_SIZE = 8; /**< Size of a block header in version 0 files: the type and size as 4 byte fields, without flags. */
+static const unsigned int SERIALIZE_HEADER_MAX = 20; /**< Largest size of an encoded S_SerializeHeader in either format. A compact header takes up to 5 bytes for the type and flags and 10 for the size. */
+static const uint32_t SERIALIZE_FLAG_CODEC_MASK = 0x000000FF; /**< Bits of S_SerializeHeader::m_flags holding the ID of the WY_SerializeCodec the block data is encoded with. 0 if the data is stored raw. */
+static const unsigned int SERIALIZE_CODEC_PREFIX_SIZE = 8; /**< Size of the decoded data size written in front of the data of an encoded block. */
+static const uint32_t SERIALIZE_FLAG_CRC = 0x00000100; /**< Set in S_SerializeHeader::m_flags if the block data starts with a CRC32C of the encoded header and the rest of the data. */
+static const unsigned int SERIALIZE_CRC_SIZE = 4; /**< Size of the CRC32C of a block. */
+static const uint32_t SERIALIZE_FLAG_INSTANCE = 0x00000200; /**< Set in S_SerializeHeader::m_flags if the block data starts with the instance ID of the block, after the CRC32C if there is one. The CRC32C covers the instance ID. */
+static const unsigned int SERIALIZE_INSTANCE_SIZE = 4; /**< Size of the instance ID of a block. */
+static const unsigned int SERIALIZE_BLOCK_PREFIX_MAX = SERIALIZE_HEADER_MAX + SERIALIZE_CRC_SIZE + SERIALIZE_INSTANCE_SIZE; /**< Largest number of bytes written in front of the data of a block, not counting alignment padding. */
+static const unsigned int SERIALIZE_ALIGN_MAX = 64; /**< Largest alignment of block data in a save file, see WY_SerializeAgent::set_save_alignment(). */
+
+
+/**
+ * A block as it is written to a save file. Made from a S_SerializeData by WY_SerializeAgent::prepare_save_block(), which encodes the data if a codec is set.
+ */
+struct S_SerializeBlock {
+    S_SerializeHeader m_header; /**< Header of the block. m_header.m_size is the size of everything after the header. */
+    unsigned char m_prefix[SERIALIZE_BLOCK_PREFIX_MAX]; /**< The encoded header, followed by the CRC32C if SERIALIZE_FLAG_CRC is set and the instance ID if SERIALIZE_FLAG_INSTANCE is set. */
+    unsigned int m_prefix_size; /**< Bytes used in m_prefix. */
+    const unsigned char * m_data; /**< Data written after m_prefix. Either the data of the S_SerializeData or an encoded copy of it. */
+    uint64_t m_data_size; /**< Size of m_data. */
+    uint64_t m_source_size; /**< Size of the data of the S_SerializeData, before encoding. */
+};
+
+
+/**
+ * The header at the start of a save file of version 2 or later. Files of version 0 have no file header and start with their first block. It is written field by field after SERIALIZE_FILE_MAGIC.
+ */
+struct S_SerializeFileHeader {
+    uint32_t m_version; /**< Format version the file was written with, SERIALIZE_FILE_VERSION. */
+    uint32_t m_options; /**< Format options, see SERIALIZE_FILE_COMPACT and SERIALIZE_FILE_ALIGN_MASK. Other bits are reserved and written as 0. */
 };
 
+static const uint64_t SERIALIZE_FILE_MAGIC = 0x4C41495245535957ULL; /**< Starts a file with a file header. Reads "WYSERIAL" on disk. A version 0 file would have to start with a block of type 0x45535957 and a size of 1.2 GB to be taken for a file with a file header. */
+static const unsigned int SERIALIZE_FILE_HEADER_SIZE = 16; /**< Size of an encoded file header: SERIALIZE_FILE_MAGIC, version and options. */
+static const uint32_t SERIALIZE_FILE_VERSION = 2; /**< Current format version, written in the file header of every new file. Every file without a file header is version 0, the original format with SERIALIZE_LEGACY_HEADER_SIZE byte block headers. Version 1, 16 byte block headers without a file header, was never released and is not read. */
+static const uint32_t SERIALIZE_FILE_COMPACT = 0x00000001; /**< Set in S_SerializeFileHeader::m_options if the block headers are compact varints, see WY_SerializeVarint. */
+static const uint32_t SERIALIZE_FILE_ALIGN_MASK = 0x0000FF00; /**< Bits of S_SerializeFileHeader::m_options holding the log2 of the alignment of block data in the file. 0 if blocks are not padded. */
+static const unsigned int SERIALIZE_FILE_ALIGN_SHIFT = 8; /**< Position of SERIALIZE_FILE_ALIGN_MASK in S_SerializeFileHeader::m_options. */
+
+
+/**
+ * An entry of the optional block index written at the end of a save file. See WY_SerializeAgent::set_save_index().
+ */
+struct S_SerializeIndexEntry {
+    uint32_t m_type; /**< Type of the block, defined from enum SERIALIZE_TYPE. */
+    uint64_t m_offset; /**< Offset of the block header from the start of the file. */
+    uint64_t m_size; /**< Size of the block data, excluding the header. */
+};
+
+static const unsigned int SERIALIZE_INDEX_ENTRY_SIZE = 24; /**< Size of an encoded S_SerializeIndexEntry: type, 4 reserved bytes, offset and size. */
+static const unsigned int SERIALIZE_INDEX_TRAILER_SIZE = 24; /**< Size of the index trailer at the very end of a save file: entry count, index offset and SERIALIZE_INDEX_MAGIC. */
+static const uint64_t SERIALIZE_INDEX_MAGIC = 0x3130584449535957ULL; /**< Marks a save file that ends with a block index. Reads "WYSIDX01" on disk. */
+
+static const uint32_t SERIALIZE_TYPE_LOG = 0xFFFFFFFF; /**< Reserved block type of the commit records in a log file written by WY_SerializeMgr::save_changed_objs(). Must not be used in enum SERIALIZE_TYPE. */
+static const uint64_t SERIALIZE_LOG_MAGIC = 0x3130474F4C535957ULL; /**< Starts the data of a commit record. Reads "WYSLOG01" on disk. */
+static const unsigned int SERIALIZE_LOG_RECORD_SIZE = 12; /**< Size of a commit record without its slot list: SERIALIZE_LOG_MAGIC and the number of blocks committed. Each block then adds its 4 byte object slot. */
+
+static const uint32_t SERIALIZE_TYPE_MANIFEST = 0xFFFFFFFE; /**< Reserved block type of the manifest written by WY_SerializeMgr::save_all_objs_sharded(). Must not be used in enum SERIALIZE_TYPE. */
+static const uint64_t SERIALIZE_MANIFEST_MAGIC = 0x31304E414D535957ULL; /**< Starts the data of a manifest. Reads "WYSMAN01" on disk. */
+static const unsigned int SERIALIZE_MANIFEST_HEADER_SIZE = 24; /**< Size of a manifest without its shards: SERIALIZE_MANIFEST_MAGIC, the generation, the number of shards and the number of blocks. Each shard then adds the length of its path, its number of blocks, the path and the 4 byte object slot of each block. */
+
+
+#if defined(WY_SERIALIZE_FORCE_SWAP)
+static const bool SERIALIZE_SWAP_BYTES = true; /**< Whether fixed-size fields and WY_ByteOrder arrays are byte-swapped between memory and a save file. Forced on by building with -DWY_SERIALIZE_FORCE_SWAP, which tests the swap path of big-endian machines on a little-endian one. Files saved that way are byte-swapped themselves, so they only load with the same build. */
+#else
+static const bool SERIALIZE_SWAP_BYTES = (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__); /**< Whether fixed-size fields and WY_ByteOrder arrays are byte-swapped between memory and a save file. Save files are little-endian, so only big-endian machines swap. */
+#endif
+
+
+/**
+ * Inline helper function to write a 32-bit field in the little-endian byte order of save files.
+ * \param p_dst Buffer of at least 4 bytes.
+ * \param p_value The value.
+ */
+inline void encode_le32(unsigned char *__restrict__ const p_dst, uint32_t p_value) noexcept {
+    if(SERIALIZE_SWAP_BYTES)
+        p_value = __builtin_bswap32(p_value);
+    memcpy(p_dst, &p_value, 4);
+}
+
+/**
+ * Inline helper function to write a 64-bit field in the little-endian byte order of save files.
+ * \param p_dst Buffer of at least 8 bytes.
+ * \param p_value The value.
+ */
+inline void encode_le64(unsigned char *__restrict__ const p_dst, uint64_t p_value) noexcept {
+    if(SERIALIZE_SWAP_BYTES)
+        p_value = __builtin_bswap64(p_value);
+    memcpy(p_dst, &p_value, 8);
+}
+
+/**
+ * Inline helper function to read a 32-bit field written by encode_le32().
+ * \param p_src The field, which need not be aligned.
+ * \return The value.
+ */
+inline uint32_t decode_le32(const unsigned char *__restrict__ const p_src) noexcept {
+    uint32_t value;
+    memcpy(&value, p_src, 4);
+    return SERIALIZE_SWAP_BYTES ? __builtin_bswap32(value) : value;
+}
+
+/**
+ * Inline helper function to read a 64-bit field written by encode_le64().
+ * \param p_src The field, which need not be aligned.
+ * \return The value.
+ */
+inline uint64_t decode_le64(const unsigned char *__restrict__ const p_src) noexcept {
+    uint64_t value;
+    memcpy(&value, p_src, 8);
+    return SERIALIZE_SWAP_BYTES ? __builtin_bswap64(value) : value;
+}
+
+
+/**
+ * Inline helper function to write a block header into a save file buffer.
+ * \param p_dst Buffer of at least SERIALIZE_HEADER_SIZE bytes.
+ * \param p_header The header to write.
+ */
+inline void encode_serialize_header(unsigned char *__restrict__ const p_dst, const S_SerializeHeader *__restrict__ const p_header) noexcept {
+    encode_le32(p_dst, p_header->m_type);
+    encode_le32(p_dst+4, p_header->m_flags);
+    encode_le64(p_dst+8, p_header->m_size);
+}
+
+/**
+ * Inline helper function to read a block header from a save file buffer.
+ * \param p_src Buffer of at least SERIALIZE_HEADER_SIZE bytes.
+ * \param p_header Returns the header.
+ */
+inline void decode_serialize_header(const unsigned char *__restrict__ const p_src, S_SerializeHeader *__restrict__ const p_header) noexcept {
+    p_header->m_type = decode_le32(p_src);
+    p_header->m_flags = decode_le32(p_src+4);
+    p_header->m_size = decode_le64(p_src+8);
+}
+
+/**
+ * Inline helper function to read a block header of a version 0 file. The original format wrote the type and size in the byte order of the machine. They are read as little-endian like every other field.
+ * \param p_src Buffer of at least SERIALIZE_LEGACY_HEADER_SIZE bytes.
+ * \param p_header Returns the header, without flags.
+ */
+inline void decode_legacy_header(const unsigned char *__restrict__ const p_src, S_SerializeHeader *__restrict__ const p_header) noexcept {
+    p_header->m_type = decode_le32(p_src);
+    p_header->m_flags = 0;
+    p_header->m_size = decode_le32(p_src+4);
+}
+
+
+/**
+ * Inline helper function to write a file header into a save file buffer.
+ * \param p_dst Buffer of at least SERIALIZE_FILE_HEADER_SIZE bytes.
+ * \param p_header The header to write.
+ */
+inline void encode_file_header(unsigned char *__restrict__ const p_dst, const S_SerializeFileHeader *__restrict__ const p_header) noexcept {
+    encode_le64(p_dst, SERIALIZE_FILE_MAGIC);
+    encode_le32(p_dst+8, p_header->m_version);
+    encode_le32(p_dst+12, p_header->m_options);
+}
+
+/**
+ * Inline helper function to read the file header at the start of a save file.
+ * \param p_src Start of the file.
+ * \param p_size Bytes available at p_src.
+ * \param p_header Returns the header. Version 0 without options if the file has no file header.
+ * \return Size of the file header, 0 if there is none. -1 if the file was written by a newer version.
+ */
+inline int decode_file_header(const unsigned char *__restrict__ const p_src, const uint64_t p_size, S_SerializeFileHeader *__restrict__ const p_header) noexcept {
+    p_header->m_version = 0;
+    p_header->m_options = 0;
+    if(p_size < SERIALIZE_FILE_HEADER_SIZE)
+        return 0;
+    if(decode_le64(p_src) != SERIALIZE_FILE_MAGIC)
+        return 0;
+    p_header->m_version = decode_le32(p_src+8);
+    p_header->m_options = decode_le32(p_src+12);
+    if((p_header->m_version < 2) || (p_header->m_version > SERIALIZE_FILE_VERSION) || ((p_header->m_options & ~(SERIALIZE_FILE_COMPACT | SERIALIZE_FILE_ALIGN_MASK)) != 0)
+        || (((p_header->m_options & SERIALIZE_FILE_ALIGN_MASK) >> SERIALIZE_FILE_ALIGN_SHIFT) > (unsigned int)__builtin_ctz(SERIALIZE_ALIGN_MAX)))
+        return -1;
+    return SERIALIZE_FILE_HEADER_SIZE;
+}
+
+/**
+ * Inline helper function to get the alignment of block data from a file header.
+ * \param p_header The file header.
+ * \return The alignment in bytes, 1 if blocks are not padded.
+ */
+inline unsigned int get_file_alignment(const S_SerializeFileHeader *__restrict__ const p_header) noexcept {
+    return 1u << ((p_header->m_options & SERIALIZE_FILE_ALIGN_MASK) >> SERIALIZE_FILE_ALIGN_SHIFT);
+}
+
+/**
+ * Inline helper function to get the padding between the prefix and the data of a block in a file with aligned blocks. The padding is not counted in the size in the block header.
+ * \param p_header The block header.
+ * \param p_offset File offset of the first byte after the encoded header.
+ * \param p_alignment Alignment of block data in the file, a power of 2.
+ * \return Number of padding bytes.
+ */
+inline unsigned int get_block_padding(const S_SerializeHeader *__restrict__ const p_header, const uint64_t p_offset, const unsigned int p_alignment) noexcept {
+    const uint64_t data = p_offset + ((p_header->m_flags & SERIALIZE_FLAG_CRC) ? SERIALIZE_CRC_SIZE : 0) + ((p_header->m_flags & SERIALIZE_FLAG_INSTANCE) ? SERIALIZE_INSTANCE_SIZE : 0);
+    return (unsigned int)(-data & (p_alignment - 1));
+}
+
 
 /**
  * Inline helper function to init a S_SerializeData struct before use. Call this before using of re-using any S_SerializeData. 
@@ -40,25 +305,14 @@ inline void init_serializable_data(S_SerializeData *__restrict__ const p_data) n
     p_data->m_type = 0;
     p_data->m_size = 0;
     p_data->m_data = NULL;
+    p_data->m_instance = 0;
 }
 
 /**
- * Inline function to get the total size within a S_SerializeData structure.
- * \param p_data The S_SerializeData structure to get the size from.
- * \return Size of p_data.
- */
-inline unsigned int get_total_data_len(S_SerializeData *__restrict__ const p_data) noexcept {
-    return sizeof(p_data->m_type) + sizeof(p_data->m_size) + p_data->m_size;
-}
-
-/**
- * Inline helper function to clear a S_SerializeData struct after it was loaded with save data from a file. This is because this data is definitely dynamically allocated. This function also automatically calls init_serializable_data() implicitly so the struct is ready for reuse.  
+ * Inline helper function to clear a S_SerializeData struct after it was loaded with save data from a file. The data itself belongs to the allocator of the WY_SerializeAgent that loaded it and is released by WY_SerializeAgent::clear_loaded_file_buffer(), so this only resets the struct. This function also automatically calls init_serializable_data() implicitly so the struct is ready for reuse.  
  * \param p_data The S_SerializeData struct to clear. 
  */
 inline void clear_loaded_serializable_data(S_SerializeData *__restrict__ const p_data) noexcept {
-    if(p_data->m_size > 0) {
-        delete[] p_data->m_data;
-    }
     init_serializable_data(p_data);
 }
 
@@ -0,0 +1,845 @@
+/*
+* Copyright 2023 Au Yeong Wing Yau
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include <exception>
+#include <cstring>
+#include <cerrno>
+#include <cstdlib>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#endif
+#include "WY_SerializeIO.hpp"
+#include "WY_SerializeStats.hpp"
+using namespace WY_Serialize;
+
+#if defined(IORING_OFF_SQ_RING) && defined(__NR_io_uring_setup)
+#define WY_SERIALIZE_URING /**< The io_uring interface is known at build time. */
+#endif
+
+const uint64_t WY_UringIO::m_direct_alignment;
+
+
+WY_FstreamIO::WY_FstreamIO() noexcept
+{
+    m_position = UINT64_MAX;
+}
+
+
+int WY_FstreamIO::open_file(const char *__restrict__ const p_path, const IO_OPEN_MODE p_mode) noexcept
+{
+    std::ios_base::openmode mode = std::fstream::binary;
+
+    close_file();
+    if(p_mode == IO_OPEN_READ)
+        mode |= std::fstream::in;
+    else if(p_mode == IO_OPEN_CREATE)
+        mode |= std::fstream::out | std::fstream::trunc;
+    else
+        mode |= std::fstream::in | std::fstream::out; /* Opens without truncating. */
+    try {
+        m_path = p_path;
+    } catch (std::exception &e) {
+        return -1;
+    }
+
+    m_file.open(p_path, mode);
+    WY_SerializeStats::record_io(STATS_IO_OPEN);
+    if(!m_file.is_open())
+        return -1;
+    m_position = 0;
+    return 0;
+}
+
+
+int WY_FstreamIO::get_file_size(uint64_t *__restrict__ const p_size) noexcept
+{
+    m_file.clear();
+    m_position = UINT64_MAX;
+    const std::streampos size = m_file.rdbuf()->pubseekoff(0, std::fstream::end);
+    if(size < 0)
+        return -1;
+    *p_size = size;
+    return 0;
+}
+
+
+int WY_FstreamIO::seek_file(const uint64_t p_offset) noexcept
+{
+    if(m_position == p_offset)
+        return 0;
+    m_file.clear(); /* A read may have hit the end of the file. */
+    if(m_file.rdbuf()->pubseekpos(p_offset) != std::streampos(p_offset)) {
+        m_position = UINT64_MAX;
+        return -1;
+    }
+    m_position = p_offset;
+    return 0;
+}
+
+
+int WY_FstreamIO::read_file(unsigned char *__restrict__ const p_dst, const uint64_t p_size, const uint64_t p_offset) noexcept
+{
+    if(seek_file(p_offset) != 0)
+        return -1;
+    m_file.read((char *)p_dst, p_size);
+    WY_SerializeStats::record_io(STATS_IO_READ);
+    if(!m_file.good()) {
+        m_position = UINT64_MAX;
+        return -1;
+    }
+    m_position += p_size;
+    return 0;
+}
+
+
+int WY_FstreamIO::write_file(struct iovec *__restrict__ p_iov, int p_count, uint64_t p_offset) noexcept
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    uint64_t size = 0;
+
+    if(seek_file(p_offset) != 0)
+        return -1;
+    for(int i=0; i<p_count; i++) {
+        m_file.write((const char *)p_iov[i].iov_base, p_iov[i].iov_len);
+        size += p_iov[i].iov_len;
+    }
+    WY_SerializeStats::record_io(STATS_IO_WRITE);
+    if(m_file.fail()) {
+        m_position = UINT64_MAX;
+        return -1;
+    }
+    m_position += size;
+    return 0;
+}
+
+
+int WY_FstreamIO::sync_file(const bool p_data_only) noexcept
+{
+    m_file.flush();
+    if(m_file.fail())
+        return -1;
+
+    const int fd = open(m_path.c_str(), O_RDONLY);
+    WY_SerializeStats::record_io(STATS_IO_OPEN);
+    if(fd == -1)
+        return -1;
+    int ret = WY_PosixIO::sync_fd(fd, p_data_only);
+    if(close(fd) != 0)
+        ret = -1;
+    return ret;
+}
+
+
+int WY_FstreamIO::close_file() noexcept
+{
+    if(!m_file.is_open())
+        return 0;
+    m_file.close();
+    m_position = UINT64_MAX;
+    return m_file.fail() ? -1 : 0; /* Includes any write that failed before. */
+}
+
+
+WY_PosixIO::WY_PosixIO() noexcept
+{
+    m_fd = -1;
+}
+
+
+WY_PosixIO::~WY_PosixIO()
+{
+    close_file();
+}
+
+
+int WY_PosixIO::open_file(const char *__restrict__ const p_path, const IO_OPEN_MODE p_mode) noexcept
+{
+    close_file();
+    m_fd = open_fd(p_path, p_mode, 0);
+    WY_SerializeStats::record_io(STATS_IO_OPEN);
+    return (m_fd == -1) ? -1 : 0;
+}
+
+
+int WY_PosixIO::get_file_size(uint64_t *__restrict__ const p_size) noexcept
+{
+    struct stat file_stat;
+
+    if((fstat(m_fd, &file_stat) != 0) || (file_stat.st_size < 0))
+        return -1;
+    *p_size = file_stat.st_size;
+    return 0;
+}
+
+
+int WY_PosixIO::read_file(unsigned char *__restrict__ const p_dst, const uint64_t p_size, const uint64_t p_offset) noexcept
+{
+    return read_at(m_fd, p_dst, p_size, p_offset);
+}
+
+
+int WY_PosixIO::write_file(struct iovec *__restrict__ p_iov, int p_count, uint64_t p_offset) noexcept
+{
+    return write_vector(m_fd, p_iov, p_count, p_offset);
+}
+
+
+int WY_PosixIO::sync_file(const bool p_data_only) noexcept
+{
+    return sync_fd(m_fd, p_data_only);
+}
+
+
+int WY_PosixIO::close_file() noexcept
+{
+    if(m_fd == -1)
+        return 0;
+    const int ret = (close(m_fd) == 0) ? 0 : -1;
+    m_fd = -1;
+    return ret;
+}
+
+
+int WY_PosixIO::open_fd(const char *__restrict__ const p_path, const IO_OPEN_MODE p_mode, const int p_flags) noexcept
+{
+    int flags = O_RDONLY;
+    if(p_mode == IO_OPEN_CREATE)
+        flags = O_WRONLY | O_CREAT | O_TRUNC;
+    else if(p_mode == IO_OPEN_WRITE)
+        flags = O_WRONLY;
+    return open(p_path, flags | p_flags, 0666);
+}
+
+
+int WY_PosixIO::write_vector(const int p_fd, struct iovec *__restrict__ p_iov, int p_count, uint64_t p_offset) noexcept
+{
+    while(p_count > 0) {
+        ssize_t written = pwritev(p_fd, p_iov, p_count, p_offset);
+        WY_SerializeStats::record_io(STATS_IO_WRITE);
+        if(written < 0) {
+            if(errno == EINTR)
+                continue;
+            return -1;
+        }
+
+        p_offset += written;
+        while((p_count > 0) && ((size_t)written >= p_iov->iov_len)) { /* Skip fully written entries. */
+            written -= p_iov->iov_len;
+            ++p_iov;
+            --p_count;
+        }
+        if(p_count > 0) { /* Partial write, resume in the middle of this entry. */
+            p_iov->iov_base = (char *)p_iov->iov_base + written;
+            p_iov->iov_len -= written;
+        }
+    }
+    return 0;
+}
+
+
+int WY_PosixIO::read_at(const int p_fd, unsigned char *__restrict__ p_dst, uint64_t p_size, uint64_t p_offset) noexcept
+{
+    while(p_size > 0) {
+        ssize_t count = pread(p_fd, p_dst, p_size, p_offset);
+        WY_SerializeStats::record_io(STATS_IO_READ);
+        if(count < 0) {
+            if(errno == EINTR)
+                continue;
+            return -1;
+        }
+        if(count == 0) /* The file is shorter than expected. */
+            return -1;
+
+        p_dst += count;
+        p_size -= count;
+        p_offset += count;
+    }
+    return 0;
+}
+
+
+int WY_PosixIO::sync_fd(const int p_fd, const bool p_data_only) noexcept
+{
+    WY_SerializeStats::record_io(STATS_IO_SYNC);
+    if(p_data_only)
+        return (fdatasync(p_fd) == 0) ? 0 : -1;
+    return (fsync(p_fd) == 0) ? 0 : -1;
+}
+
+
+WY_UringIO::WY_UringIO(const unsigned int p_depth, const uint64_t p_chunk_size) noexcept :
+    m_depth(std::max(2u, p_depth)),
+    m_chunk_size(std::max(m_direct_alignment, (p_chunk_size + m_direct_alignment-1) & ~(m_direct_alignment-1)))
+{
+    m_direct = false;
+    m_fd = -1;
+    m_direct_fd = -1;
+    m_failed = false;
+    m_busy_count = 0;
+    m_queued = 0;
+    m_fill = -1;
+    m_fill_size = 0;
+    m_fill_capacity = 0;
+    m_ring_setup = false;
+    m_ring_fd = -1;
+    m_sq_map = NULL;
+    m_sq_map_size = 0;
+    m_cq_map = NULL;
+    m_cq_map_size = 0;
+    m_sqes = NULL;
+    m_sqes_size = 0;
+    m_sq_tail = NULL;
+    m_sq_mask = 0;
+    m_sq_array = NULL;
+    m_cq_head = NULL;
+    m_cq_tail = NULL;
+    m_cq_mask = 0;
+    m_cqes = NULL;
+}
+
+
+WY_UringIO::~WY_UringIO()
+{
+    close_file();
+    for(S_Slot &slot : m_slots)
+        free(slot.m_buffer);
+    release_ring();
+}
+
+
+void WY_UringIO::set_direct(const bool p_direct) noexcept
+{
+    m_direct = p_direct;
+}
+
+
+bool WY_UringIO::is_ring_active() const noexcept
+{
+    return m_ring_fd != -1;
+}
+
+
+void WY_UringIO::setup_ring() noexcept
+{
+    m_ring_setup = true;
+#ifdef WY_SERIALIZE_URING
+    struct io_uring_params params;
+
+    memset(&params, 0, sizeof(params));
+    const int fd = syscall(__NR_io_uring_setup, m_depth, &params);
+    if(fd < 0) /* Not supported by the kernel, or not allowed in this process. */
+        return;
+    m_ring_fd = fd;
+
+    m_sq_map_size = params.sq_off.array + params.sq_entries*sizeof(unsigned int);
+    m_cq_map_size = params.cq_off.cqes + params.cq_entries*sizeof(struct io_uring_cqe);
+    const bool single_map = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if(single_map)
+        m_sq_map_size = m_cq_map_size = std::max(m_sq_map_size, m_cq_map_size);
+    m_sqes_size = params.sq_entries*sizeof(struct io_uring_sqe);
+
+    m_sq_map = mmap(NULL, m_sq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if(m_sq_map == MAP_FAILED) {
+        m_sq_map = NULL;
+        release_ring();
+        return;
+    }
+    m_cq_map = single_map ? m_sq_map : mmap(NULL, m_cq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+    if(m_cq_map == MAP_FAILED) {
+        m_cq_map = NULL;
+        release_ring();
+        return;
+    }
+    m_sqes = mmap(NULL, m_sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if(m_sqes == MAP_FAILED) {
+        m_sqes = NULL;
+        release_ring();
+        return;
+    }
+
+    unsigned char * const sq = (unsigned char *)m_sq_map;
+    unsigned char * const cq = (unsigned char *)m_cq_map;
+    m_sq_tail = (unsigned int *)(sq + params.sq_off.tail);
+    m_sq_mask = *(unsigned int *)(sq + params.sq_off.ring_mask);
+    m_sq_array = (unsigned int *)(sq + params.sq_off.array);
+    m_cq_head = (unsigned int *)(cq + params.cq_off.head);
+    m_cq_tail = (unsigned int *)(cq + params.cq_off.tail);
+    m_cq_mask = *(unsigned int *)(cq + params.cq_off.ring_mask);
+    m_cqes = cq + params.cq_off.cqes;
+#endif
+}
+
+
+void WY_UringIO::release_ring() noexcept
+{
+    if(m_sqes != NULL)
+        munmap(m_sqes, m_sqes_size);
+    if((m_cq_map != NULL) && (m_cq_map != m_sq_map))
+        munmap(m_cq_map, m_cq_map_size);
+    if(m_sq_map != NULL)
+        munmap(m_sq_map, m_sq_map_size);
+    if(m_ring_fd != -1)
+        close(m_ring_fd);
+    m_sqes = NULL;
+    m_cq_map = NULL;
+    m_sq_map = NULL;
+    m_ring_fd = -1;
+}
+
+
+int WY_UringIO::open_file(const char *__restrict__ const p_path, const IO_OPEN_MODE p_mode) noexcept
+{
+    close_file();
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    try {
+        if(m_slots.empty())
+            m_slots.resize(m_depth, {NULL, {NULL, 0}, 0, -1, false, false});
+    } catch (std::exception &e) {
+        return -1;
+    }
+    if(!m_ring_setup)
+        setup_ring();
+
+    m_fd = WY_PosixIO::open_fd(p_path, p_mode, 0);
+    WY_SerializeStats::record_io(STATS_IO_OPEN);
+    if(m_fd == -1)
+        return -1;
+    if(m_direct) { /* The file exists now, so a new file is not truncated twice. Stays -1 where O_DIRECT is not supported. */
+        m_direct_fd = WY_PosixIO::open_fd(p_path, (p_mode == IO_OPEN_READ) ? IO_OPEN_READ : IO_OPEN_WRITE, O_DIRECT);
+        WY_SerializeStats::record_io(STATS_IO_OPEN);
+    }
+    m_failed = false;
+    return 0;
+}
+
+
+int WY_UringIO::get_file_size(uint64_t *__restrict__ const p_size) noexcept
+{
+    struct stat file_stat;
+
+    if((fstat(m_fd, &file_stat) != 0) || (file_stat.st_size < 0))
+        return -1;
+    *p_size = file_stat.st_size;
+    return 0;
+}
+
+
+int WY_UringIO::get_request_fd(const void *__restrict__ const p_buffer, const uint64_t p_size, const uint64_t p_offset) const noexcept
+{
+    if((m_direct_fd != -1) && ((((uintptr_t)p_buffer | p_size | p_offset) & (m_direct_alignment-1)) == 0))
+        return m_direct_fd;
+    return m_fd;
+}
+
+
+void WY_UringIO::queue_slot(const unsigned int p_slot) noexcept
+{
+    S_Slot &slot = m_slots[p_slot];
+
+    WY_SerializeStats::record_io(slot.m_write ? STATS_IO_WRITE : STATS_IO_READ);
+    if(m_ring_fd == -1) { /* Runs at once, so the slot is free again on return. */
+        const ssize_t done = slot.m_write ? pwritev(slot.m_fd, &slot.m_iov, 1, slot.m_offset) : preadv(slot.m_fd, &slot.m_iov, 1, slot.m_offset);
+        complete_slot(p_slot, (done < 0) ? -errno : done);
+        return;
+    }
+#ifdef WY_SERIALIZE_URING
+    const unsigned int tail = *m_sq_tail; /* Only written by us. */
+    const unsigned int index = tail & m_sq_mask;
+    struct io_uring_sqe * const sqe = (struct io_uring_sqe *)m_sqes + index;
+
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = slot.m_write ? IORING_OP_WRITEV : IORING_OP_READV;
+    sqe->fd = slot.m_fd;
+    sqe->off = slot.m_offset;
+    sqe->addr = (uint64_t)(uintptr_t)&slot.m_iov;
+    sqe->len = 1;
+    sqe->user_data = p_slot;
+    m_sq_array[index] = index;
+    __atomic_store_n(m_sq_tail, tail+1, __ATOMIC_RELEASE); /* The kernel sees the entry once it sees the tail. */
+    slot.m_busy = true;
+    ++m_busy_count;
+    ++m_queued;
+#endif
+}
+
+
+void WY_UringIO::submit_queue() noexcept
+{
+#ifdef WY_SERIALIZE_URING
+    while(m_queued > 0) {
+        const int ret = syscall(__NR_io_uring_enter, m_ring_fd, m_queued, 0, 0, NULL, 0);
+        if(ret > 0)
+            m_queued -= std::min((unsigned int)ret, m_queued);
+        else if((ret < 0) && (errno != EINTR))
+            return; /* Submitted by the next call to reap_slot(). */
+    }
+#endif
+}
+
+
+unsigned int WY_UringIO::reap_slot() noexcept
+{
+#ifdef WY_SERIALIZE_URING
+    for(;;) {
+        const unsigned int head = *m_cq_head; /* Only written by us. */
+        if(head != __atomic_load_n(m_cq_tail, __ATOMIC_ACQUIRE)) {
+            const struct io_uring_cqe * const cqe = (const struct io_uring_cqe *)m_cqes + (head & m_cq_mask);
+            const unsigned int slot = (unsigned int)cqe->user_data;
+            const int64_t done = cqe->res;
+            __atomic_store_n(m_cq_head, head+1, __ATOMIC_RELEASE);
+            m_slots[slot].m_busy = false;
+            --m_busy_count;
+            complete_slot(slot, done);
+            return slot;
+        }
+
+        const int ret = syscall(__NR_io_uring_enter, m_ring_fd, m_queued, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+        if(ret > 0)
+            m_queued -= std::min((unsigned int)ret, m_queued);
+        else if((ret < 0) && (errno != EINTR) && (errno != EAGAIN) && (errno != EBUSY))
+            break; /* The ring is unusable, nothing will complete. */
+    }
+#endif
+    m_failed = true;
+    for(S_Slot &slot : m_slots)
+        slot.m_busy = false;
+    m_busy_count = 0;
+    m_queued = 0;
+    return 0;
+}
+
+
+void WY_UringIO::complete_slot(const unsigned int p_slot, const int64_t p_done) noexcept
+{
+    S_Slot &slot = m_slots[p_slot];
+
+    if(p_done == (int64_t)slot.m_iov.iov_len)
+        return;
+    if((p_done < 0) && (p_done != -EINTR) && (p_done != -EAGAIN)) {
+        m_failed = true;
+        return;
+    }
+
+    /* Finish the rest on the descriptor without O_DIRECT, which takes any alignment. */
+    const uint64_t done = (p_done < 0) ? 0 : p_done;
+    unsigned char * const rest = (unsigned char *)slot.m_iov.iov_base + done;
+    if(slot.m_write) {
+        struct iovec iov = {rest, slot.m_iov.iov_len-done};
+        if(WY_PosixIO::write_vector(m_fd, &iov, 1, slot.m_offset+done) != 0)
+            m_failed = true;
+    } else if(WY_PosixIO::read_at(m_fd, rest, slot.m_iov.iov_len-done, slot.m_offset+done) != 0)
+        m_failed = true;
+}
+
+
+unsigned int WY_UringIO::get_free_slot() noexcept
+{
+    for(unsigned int i=0; i<m_depth; i++) {
+        if(!m_slots[i].m_busy && ((int)i != m_fill))
+            return i;
+    }
+    return reap_slot();
+}
+
+
+void WY_UringIO::submit_fill() noexcept
+{
+    if(m_fill == -1)
+        return;
+    S_Slot &slot = m_slots[m_fill];
+    slot.m_iov = {slot.m_buffer, m_fill_size};
+    slot.m_fd = get_request_fd(slot.m_buffer, m_fill_size, slot.m_offset);
+    slot.m_write = true;
+    const unsigned int index = m_fill;
+    m_fill = -1;
+    queue_slot(index);
+    submit_queue();
+}
+
+
+void WY_UringIO::drain() noexcept
+{
+    submit_queue();
+    while(m_busy_count > 0)
+        reap_slot();
+}
+
+
+int WY_UringIO::read_file(unsigned char *__restrict__ const p_dst, const uint64_t p_size, const uint64_t p_offset) noexcept
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const uint64_t align_mask = m_direct_alignment-1;
+
+    if(m_fd == -1)
+        return -1;
+    submit_fill(); /* Reads see everything written before. */
+    drain();
+    if(p_size <= m_chunk_size) /* Nothing to overlap. */
+        return WY_PosixIO::read_at(get_request_fd(p_dst, p_size, p_offset), p_dst, p_size, p_offset);
+
+    const bool failed = m_failed; /* A failed read is reported here, not by close_file(). */
+    const bool direct = (m_direct_fd != -1) && ((((uintptr_t)p_dst ^ p_offset) & align_mask) == 0); /* Buffer and file offset can be aligned together. */
+    m_failed = false;
+    for(uint64_t done=0; done<p_size; ) {
+        const uint64_t offset = p_offset+done;
+        uint64_t size = std::min(m_chunk_size, p_size-done);
+        if(direct) { /* An unaligned head and tail are read through the page cache, everything between them directly. */
+            const uint64_t head = -offset & align_mask;
+            if(head != 0)
+                size = std::min(size, head);
+            else if(size > align_mask)
+                size &= ~align_mask;
+        }
+        const unsigned int index = get_free_slot();
+        S_Slot &slot = m_slots[index];
+        slot.m_iov = {p_dst+done, size};
+        slot.m_offset = offset;
+        slot.m_fd = get_request_fd(p_dst+done, size, offset);
+        slot.m_write = false;
+        queue_slot(index);
+        done += size;
+    }
+    drain();
+
+    const int ret = m_failed ? -1 : 0;
+    m_failed = failed;
+    return ret;
+}
+
+
+int WY_UringIO::write_file(struct iovec *__restrict__ p_iov, int p_count, uint64_t p_offset) noexcept
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if(m_fd == -1)
+        return -1;
+    for(int i=0; i<p_count; i++) {
+        const unsigned char * src = (const unsigned char *)p_iov[i].iov_base;
+        uint64_t size = p_iov[i].iov_len;
+        while(size > 0) {
+            if((m_fill != -1) && (p_offset != m_slots[m_fill].m_offset+m_fill_size)) /* Not contiguous, such as a block written at a reserved offset. */
+                submit_fill();
+            if(m_fill == -1) {
+                const unsigned int index = get_free_slot();
+                S_Slot &slot = m_slots[index];
+                if(slot.m_buffer == NULL)
+                    slot.m_buffer = (unsigned char *)aligned_alloc(m_direct_alignment, m_chunk_size);
+                if(slot.m_buffer == NULL)
+                    return -1;
+                slot.m_offset = p_offset;
+                m_fill = index;
+                m_fill_size = 0;
+                m_fill_capacity = m_chunk_size - (p_offset & (m_direct_alignment-1)); /* Ends at an aligned offset, so the chunks after it are aligned for O_DIRECT. */
+            }
+
+            const uint64_t count = std::min(size, m_fill_capacity-m_fill_size);
+            memcpy(m_slots[m_fill].m_buffer+m_fill_size, src, count);
+            m_fill_size += count;
+            p_offset += count;
+            src += count;
+            size -= count;
+            if(m_fill_size == m_fill_capacity)
+                submit_fill();
+        }
+    }
+    return m_failed ? -1 : 0;
+}
+
+
+int WY_UringIO::sync_file(const bool p_data_only) noexcept
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    submit_fill();
+    drain();
+    if(m_failed)
+        return -1;
+    return WY_PosixIO::sync_fd(m_fd, p_data_only); /* Also flushes what was written through m_direct_fd. */
+}
+
+
+int WY_UringIO::close_file() noexcept
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if(m_fd == -1)
+        return 0;
+    submit_fill();
+    drain();
+    int ret = m_failed ? -1 : 0;
+    if(close(m_fd) != 0)
+        ret = -1;
+    if((m_direct_fd != -1) && (close(m_direct_fd) != 0))
+        ret = -1;
+    m_fd = -1;
+    m_direct_fd = -1;
+    m_failed = false;
+    return ret;
+}
+
+
+uint64_t WY_UringIO::get_buffer_alignment() const noexcept
+{
+    return (m_direct_fd != -1) ? m_direct_alignment : 1;
+}
+
+
+WY_MemoryIO::WY_MemoryIO() noexcept
+{
+    m_buffer = NULL;
+    m_span = NULL;
+    m_region = NULL;
+    m_capacity = 0;
+    m_size = 0;
+    m_open = false;
+}
+
+
+void WY_MemoryIO::set_buffer(std::vector<unsigned char> *__restrict__ const p_buffer) noexcept
+{
+    m_buffer = p_buffer;
+    m_span = NULL;
+    m_region = NULL;
+    m_capacity = 0;
+    m_size = 0;
+}
+
+
+void WY_MemoryIO::set_span(unsigned char *__restrict__ const p_data, const uint64_t p_capacity) noexcept
+{
+    m_buffer = NULL;
+    m_span = p_data;
+    m_region = NULL;
+    m_capacity = (p_data == NULL) ? 0 : p_capacity;
+    m_size = 0;
+}
+
+
+void WY_MemoryIO::set_region(const unsigned char *__restrict__ const p_data, const uint64_t p_size) noexcept
+{
+    m_buffer = NULL;
+    m_span = NULL;
+    m_region = p_data;
+    m_capacity = 0;
+    m_size = (p_data == NULL) ? 0 : p_size;
+}
+
+
+const unsigned char * WY_MemoryIO::get_data() const noexcept
+{
+    if(m_buffer != NULL)
+        return m_buffer->empty() ? NULL : m_buffer->data();
+    return (m_span != NULL) ? m_span : m_region;
+}
+
+
+uint64_t WY_MemoryIO::get_size() const noexcept
+{
+    return (m_buffer != NULL) ? m_buffer->size() : m_size;
+}
+
+
+int WY_MemoryIO::open_file(const char *__restrict__ const p_path, const IO_OPEN_MODE p_mode) noexcept
+{
+    m_open = false;
+    if((m_buffer == NULL) && (m_span == NULL) && (m_region == NULL))
+        return -1;
+    if(p_mode != IO_OPEN_READ) {
+        if(m_region != NULL) /* Read only. */
+            return -1;
+        if(p_mode == IO_OPEN_CREATE) {
+            if(m_buffer != NULL)
+                m_buffer->clear(); /* Keeps the capacity, so saving again into the same buffer does not allocate. */
+            m_size = 0;
+        }
+    }
+    m_open = true;
+    return 0;
+}
+
+
+int WY_MemoryIO::get_file_size(uint64_t *__restrict__ const p_size) noexcept
+{
+    if(!m_open)
+        return -1;
+    *p_size = get_size();
+    return 0;
+}
+
+
+int WY_MemoryIO::read_file(unsigned char *__restrict__ const p_dst, const uint64_t p_size, const uint64_t p_offset) noexcept
+{
+    const uint64_t size = get_size();
+
+    if(!m_open || (p_offset > size) || (p_size > size - p_offset))
+        return -1;
+    if(p_size > 0)
+        memcpy(p_dst, get_data() + p_offset, p_size);
+    return 0;
+}
+
+
+int WY_MemoryIO::write_file(struct iovec *__restrict__ p_iov, int p_count, uint64_t p_offset) noexcept
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if(!m_open || (m_region != NULL))
+        return -1;
+    for(int i=0; i<p_count; i++) {
+        const unsigned char * data = (const unsigned char *)p_iov[i].iov_base;
+        const uint64_t size = p_iov[i].iov_len;
+        if(m_buffer != NULL) {
+            try {
+                if(p_offset == m_buffer->size())
+                    m_buffer->insert(m_buffer->end(), data, data + size); /* Appends without zeroing the new bytes first. */
+                else {
+                    if(p_offset + size > m_buffer->size())
+                        m_buffer->resize(p_offset + size);
+                    memcpy(m_buffer->data() + p_offset, data, size);
+                }
+            } catch (std::exception &e) {
+                return -1;
+            }
+        } else {
+            if((p_offset > m_capacity) || (size > m_capacity - p_offset))
+                return -1;
+            memcpy(m_span + p_offset, data, size);
+            m_size = std::max(m_size, p_offset + size);
+        }
+        p_offset += size;
+    }
+    return 0;
+}
+
+
+int WY_MemoryIO::sync_file(const bool p_data_only) noexcept
+{
+    return 0;
+}
+
+
+int WY_MemoryIO::close_file() noexcept
+{
+    m_open = false;
+    return 0;
+}
@@ -0,0 +1,579 @@
+/*
+* Copyright 2023 Au Yeong Wing Yau
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#ifndef _WY_SERIALIZE_IO_HPP_
+#define _WY_SERIALIZE_IO_HPP_
+
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <sys/uio.h>
+#pragma once
+namespace WY_Serialize
+{
+
+/**
+ * How WY_SerializeIO::open_file() opens a file.
+ */
+enum IO_OPEN_MODE {
+    IO_OPEN_READ = 0, /**< Opens an existing file for reading. */
+    IO_OPEN_CREATE, /**< Creates a file for writing, discarding any existing content. */
+    IO_OPEN_WRITE /**< Opens an existing file for writing without changing its content. */
+};
+
+/**
+ * Interface of the I/O backends WY_SerializeAgent reads and writes files through. See WY_SerializeAgent::set_io_backend().
+ * A backend holds one open file at a time. All reads and writes are positional, so the agent never depends on a file position. Implement this class to plug a different backend into WY_SerializeAgent::set_io().
+ */
+class WY_SerializeIO
+{
+public:
+    /**
+     * Virtual destructor.
+    */
+    virtual ~WY_SerializeIO() {};
+
+    /**
+     * Opens a file. Any file still open is closed first.
+     * \param p_path Name of the file.
+     * \param p_mode One of IO_OPEN_MODE.
+     * \return 0 if no error. -1 if error.
+    */
+    virtual int open_file(const char *__restrict__ const p_path, const IO_OPEN_MODE p_mode) noexcept = 0;
+
+    /**
+     * Gets the size of the open file.
+     * \param p_size Returns the size in bytes.
+     * \return 0 if no error. -1 if error.
+    */
+    virtual int get_file_size(uint64_t *__restrict__ const p_size) noexcept = 0;
+
+    /**
+     * Reads a given number of bytes from the open file.
+     * \param p_dst Buffer of at least p_size bytes.
+     * \param p_size Number of bytes to read.
+     * \param p_offset File offset to read from.
+     * \return 0 if no error. -1 if error or the file ends before p_size bytes are read.
+    */
+    virtual int read_file(unsigned char *__restrict__ const p_dst, const uint64_t p_size, const uint64_t p_offset) noexcept = 0;
+
+    /**
+     * Writes an array of buffers to the open file. The buffers may be reused as soon as this returns, but the data may only reach the file when sync_file() or close_file() is called. Must be thread-safe, as WY_SerializeAgent::write_save_file_at() writes different parts of a file from several threads at once.
+     * \param p_iov The buffers. Entries may be modified.
+     * \param p_count Number of entries in p_iov.
+     * \param p_offset File offset to write at.
+     * \return 0 if no error. -1 if error.
+    */
+    virtual int write_file(struct iovec *__restrict__ p_iov, int p_count, uint64_t p_offset) noexcept = 0;
+
+    /**
+     * Writes all pending data and flushes the open file to storage.
+     * \param p_data_only True to flush with fdatasync(), false for fsync().
+     * \return 0 if no error. -1 if error, including an earlier write that failed after write_file() returned.
+    */
+    virtual int sync_file(const bool p_data_only) noexcept = 0;
+
+    /**
+     * Writes all pending data and closes the open file. Does nothing if no file is open.
+     * \return 0 if no error. -1 if error, including an earlier write that failed after write_file() returned.
+    */
+    virtual int close_file() noexcept = 0;
+
+    /**
+     * Gets the alignment read buffers need for read_file() to read into them directly. Optional to implement.
+     * \return Alignment in bytes, a power of 2. 1 if any buffer will do.
+    */
+    virtual uint64_t get_buffer_alignment() const noexcept { return 1; };
+};
+
+
+/**
+ * A WY_SerializeIO that reads and writes through std::fstream. Small writes are gathered in the stream buffer, which suits saves of many small blocks appended one by one. Reads and writes at the current position do not seek, so sequential I/O costs no more than plain std::fstream.
+ */
+class WY_FstreamIO: public WY_SerializeIO
+{
+public:
+    /**
+     * Constructor. No file is opened.
+    */
+    WY_FstreamIO() noexcept;
+
+    /**
+     * Implements the WY_SerializeIO virtual function.
+     * \param p_path Name of the file.
+     * \param p_mode One of IO_OPEN_MODE.
+     * \return 0 if no error. -1 if error.
+    */
+    int open_file(const char *__restrict__ const p_path, const IO_OPEN_MODE p_mode) noexcept;
+
+    /**
+     * Implements the WY_SerializeIO virtual function.
+     * \param p_size Returns the size in bytes.
+     * \return 0 if no error. -1 if error.
+    */
+    int get_file_size(uint64_t *__restrict__ const p_size) noexcept;
+
+    /**
+     * Implements the WY_SerializeIO virtual function.
+     * \param p_dst Buffer of at least p_size bytes.
+     * \param p_size Number of bytes to read.
+     * \param p_offset File offset to read from.
+     * \return 0 if no error. -1 if error or the file ends before p_size bytes are read.
+    */
+    int read_file(unsigned char *__restrict__ const p_dst, const uint64_t p_size, const uint64_t p_offset) noexcept;
+
+    /**
+     * Implements the WY_SerializeIO virtual function. Writes from several threads take turns.
+     * \param p_iov The buffers.
+     * \param p_count Number of entries in p_iov.
+     * \param p_offset File offset to write at.
+     * \return 0 if no error. -1 if error.
+    */
+    int write_file(struct iovec *__restrict__ p_iov, int p_count, uint64_t p_offset) noexcept;
+
+    /**
+     * Implements the WY_SerializeIO virtual function. std::fstream has no descriptor to flush, so the file is opened again by name.
+     * \param p_data_only True to flush with fdatasync(), false for fsync().
+     * \return 0 if no error. -1 if error.
+    */
+    int sync_file(const bool p_data_only) noexcept;
+
+    /**
+     * Implements the WY_SerializeIO virtual function.
+     * \return 0 if no error. -1 if error.
+    */
+    int close_file() noexcept;
+
+private:
+    /**
+     * Moves the file position to p_offset unless it is already there.
+     * \param p_offset The file offset.
+     * \return 0 if no error. -1 if error.
+    */
+    int seek_file(const uint64_t p_offset) noexcept;
+
+    std::fstream m_file; /**< The open file. */
+    std::string m_path; /**< Name of the open file, for sync_file(). */
+    uint64_t m_position; /**< File offset of the next read or write, UINT64_MAX if unknown. */
+    std::mutex m_mutex; /**< Serializes write_file() calls from several threads. */
+};
+
+
+/**
+ * A WY_SerializeIO that reads and writes a file descriptor with pread() and pwritev(). Every call is a system call, so it suits large writes such as the batches of SAVE_VECTORED mode, and writes from several threads run in parallel.
+ */
+class WY_PosixIO: public WY_SerializeIO
+{
+public:
+    /**
+     * Constructor. No file is opened.
+    */
+    WY_PosixIO() noexcept;
+
+    /**
+     * Destructor. Closes the file if it is open.
+    */
+    ~WY_PosixIO();
+
+    /**
+     * Implements the WY_SerializeIO virtual function.
+     * \param p_path Name of the file.
+     * \param p_mode One of IO_OPEN_MODE.
+     * \return 0 if no error. -1 if error.
+    */
+    int open_file(const char *__restrict__ const p_path, const IO_OPEN_MODE p_mode) noexcept;
+
+    /**
+     * Implements the WY_SerializeIO virtual function.
+     * \param p_size Returns the size in bytes.
+     * \return 0 if no error. -1 if error.
+    */
+    int get_file_size(uint64_t *__restrict__ const p_size) noexcept;
+
+    /**
+     * Implements the WY_SerializeIO virtual function.
+     * \param p_dst Buffer of at least p_size bytes.
+     * \param p_size Number of bytes to read.
+     * \param p_offset File offset to read from.
+     * \return 0 if no error. -1 if error or the file ends before p_size bytes are read.
+    */
+    int read_file(unsigned char *__restrict__ const p_dst, const uint64_t p_size, const uint64_t p_offset) noexcept;
+
+    /**
+     * Implements the WY_SerializeIO virtual function. Data is written before this returns.
+     * \param p_iov The buffers. Entries are modified as they are written.
+     * \param p_count Number of entries in p_iov.
+     * \param p_offset File offset to write at.
+     * \return 0 if no error. -1 if error.
+    */
+    int write_file(struct iovec *__restrict__ p_iov, int p_count, uint64_t p_offset) noexcept;
+
+    /**
+     * Implements the WY_SerializeIO virtual function.
+     * \param p_data_only True to flush with fdatasync(), false for fsync().
+     * \return 0 if no error. -1 if error.
+    */
+    int sync_file(const bool p_data_only) noexcept;
+
+    /**
+     * Implements the WY_SerializeIO virtual function.
+     * \return 0 if no error. -1 if error.
+    */
+    int close_file() noexcept;
+
+    /**
+     * Opens a file descriptor for a given IO_OPEN_MODE.
+     * \param p_path Name of the file.
+     * \param p_mode One of IO_OPEN_MODE.
+     * \param p_flags Flags added to those of p_mode, such as O_DIRECT.
+     * \return The file descriptor, -1 if error.
+    */
+    static int open_fd(const char *__restrict__ const p_path, const IO_OPEN_MODE p_mode, const int p_flags) noexcept;
+
+    /**
+     * Writes an array of buffers to a file descriptor at a given offset, resuming after partial writes.
+     * \param p_fd The file descriptor.
+     * \param p_iov The buffers. Entries are modified as they are written.
+     * \param p_count Number of entries in p_iov.
+     * \param p_offset File offset to write at.
+     * \return 0 if no error. -1 if error.
+    */
+    static int write_vector(const int p_fd, struct iovec *__restrict__ p_iov, int p_count, uint64_t p_offset) noexcept;
+
+    /**
+     * Reads a given number of bytes from a file descriptor at a given offset, resuming after partial reads.
+     * \param p_fd The file descriptor.
+     * \param p_dst Buffer of at least p_size bytes.
+     * \param p_size Number of bytes to read.
+     * \param p_offset File offset to read from.
+     * \return 0 if no error. -1 if error or the file ends before p_size bytes are read.
+    */
+    static int read_at(const int p_fd, unsigned char *__restrict__ p_dst, uint64_t p_size, uint64_t p_offset) noexcept;
+
+    /**
+     * Flushes a file descriptor to storage.
+     * \param p_fd The file descriptor.
+     * \param p_data_only True to flush with fdatasync(), false for fsync().
+     * \return 0 if no error. -1 if error.
+    */
+    static int sync_fd(const int p_fd, const bool p_data_only) noexcept;
+
+private:
+    int m_fd; /**< The open file, -1 if none. */
+};
+
+
+/**
+ * A WY_SerializeIO on Linux io_uring that keeps several large reads and writes in flight, so fast storage sees a deep queue instead of one request at a time.
+ * Writes are copied into a ring of chunk buffers and written behind the caller: each full chunk is submitted at once and write_file() only waits when every chunk is in flight. Large reads are split into chunks that are all submitted together. The ring is set up with raw system calls, so no library is needed. If the kernel does not allow io_uring, the chunks are written and read with pwritev() and pread() instead, with the same results.
+ * With set_direct(), the file is also opened with O_DIRECT and chunks at aligned offsets bypass the page cache, which keeps huge checkpoints from evicting everything else. Requests that are not aligned use the page cache as usual.
+ *
+ * Usage: <br>
+ * <br>
+ * @code
+ * WY_UringIO io(16, 1024*1024); // 16 chunks of 1 MB in flight.
+ * io.set_direct(true);
+ * agent.set_io(&io);
+ * @endcode
+ */
+class WY_UringIO: public WY_SerializeIO
+{
+public:
+    /**
+     * Constructor. The ring and the chunk buffers are set up when they are first needed.
+     * \param p_depth Number of chunks kept in flight. Raised to at least 2.
+     * \param p_chunk_size Size of a chunk. Raised to a multiple of the O_DIRECT alignment.
+    */
+    WY_UringIO(const unsigned int p_depth=8, const uint64_t p_chunk_size=1024*1024) noexcept;
+
+    /**
+     * Destructor. Closes the file if it is open and releases the ring.
+    */
+    ~WY_UringIO();
+
+    /**
+     * Sets whether files are opened with O_DIRECT as well. Takes effect on the next call to open_file(). Files on file systems without O_DIRECT support are read and written through the page cache.
+     * \param p_direct True to bypass the page cache for aligned chunks. Defaults to false.
+    */
+    void set_direct(const bool p_direct) noexcept;
+
+    /**
+     * Checks if requests go through io_uring, or through the pwritev() and pread() fallback. Known once a file has been opened.
+     * \return True if the ring is set up.
+    */
+    bool is_ring_active() const noexcept;
+
+    /**
+     * Implements the WY_SerializeIO virtual function.
+     * \param p_path Name of the file.
+     * \param p_mode One of IO_OPEN_MODE.
+     * \return 0 if no error. -1 if error.
+    */
+    int open_file(const char *__restrict__ const p_path, const IO_OPEN_MODE p_mode) noexcept;
+
+    /**
+     * Implements the WY_SerializeIO virtual function.
+     * \param p_size Returns the size in bytes.
+     * \return 0 if no error. -1 if error.
+    */
+    int get_file_size(uint64_t *__restrict__ const p_size) noexcept;
+
+    /**
+     * Implements the WY_SerializeIO virtual function. Requests of more than a chunk are split into chunks read in parallel.
+     * \param p_dst Buffer of at least p_size bytes.
+     * \param p_size Number of bytes to read.
+     * \param p_offset File offset to read from.
+     * \return 0 if no error. -1 if error or the file ends before p_size bytes are read.
+    */
+    int read_file(unsigned char *__restrict__ const p_dst, const uint64_t p_size, const uint64_t p_offset) noexcept;
+
+    /**
+     * Implements the WY_SerializeIO virtual function. Data is copied into the current chunk, which is submitted once it is full or the next write is not contiguous with it. Writes from several threads take turns.
+     * \param p_iov The buffers.
+     * \param p_count Number of entries in p_iov.
+     * \param p_offset File offset to write at.
+     * \return 0 if no error. -1 if error, including a chunk submitted earlier that failed.
+    */
+    int write_file(struct iovec *__restrict__ p_iov, int p_count, uint64_t p_offset) noexcept;
+
+    /**
+     * Implements the WY_SerializeIO virtual function.
+     * \param p_data_only True to flush with fdatasync(), false for fsync().
+     * \return 0 if no error. -1 if error.
+    */
+    int sync_file(const bool p_data_only) noexcept;
+
+    /**
+     * Implements the WY_SerializeIO virtual function.
+     * \return 0 if no error. -1 if error.
+    */
+    int close_file() noexcept;
+
+    /**
+     * Implements the WY_SerializeIO virtual function.
+     * \return The O_DIRECT alignment if the open file uses O_DIRECT, else 1.
+    */
+    uint64_t get_buffer_alignment() const noexcept;
+
+private:
+    /**
+     * A chunk of I/O in flight, or the chunk being filled by write_file().
+     */
+    struct S_Slot {
+        unsigned char * m_buffer; /**< Chunk buffer for writes, aligned for O_DIRECT. NULL until first written. */
+        struct iovec m_iov; /**< The memory read or written, referenced by the submitted request. */
+        uint64_t m_offset; /**< File offset of the request. */
+        int m_fd; /**< Descriptor the request was submitted on. */
+        bool m_busy; /**< Whether the request is in flight. */
+        bool m_write; /**< Whether the request is a write. */
+    };
+
+    /**
+     * Sets up the ring. Leaves m_ring_fd at -1 if io_uring is not available.
+    */
+    void setup_ring() noexcept;
+
+    /**
+     * Unmaps the ring and closes its descriptor.
+    */
+    void release_ring() noexcept;
+
+    /**
+     * Adds the request of a slot to the submission queue, or runs it at once if the ring is not set up.
+     * \param p_slot Index of the slot in m_slots, with m_iov, m_offset, m_fd and m_write set.
+    */
+    void queue_slot(const unsigned int p_slot) noexcept;
+
+    /**
+     * Submits the queued requests to the kernel with one system call.
+    */
+    void submit_queue() noexcept;
+
+    /**
+     * Waits for one request in flight to complete and frees its slot. Short transfers are finished with pwritev() or pread(), errors are recorded in m_failed.
+     * \return Index of the freed slot.
+    */
+    unsigned int reap_slot() noexcept;
+
+    /**
+     * Finishes a request that transferred fewer bytes than asked for.
+     * \param p_slot Index of the slot.
+     * \param p_done Bytes transferred, negative for an error number.
+    */
+    void complete_slot(const unsigned int p_slot, const int64_t p_done) noexcept;
+
+    /**
+     * Gets a free slot, waiting for a request in flight if there is none.
+     * \return Index of the slot.
+    */
+    unsigned int get_free_slot() noexcept;
+
+    /**
+     * Submits the chunk being filled by write_file(), if any.
+    */
+    void submit_fill() noexcept;
+
+    /**
+     * Waits for all requests in flight.
+    */
+    void drain() noexcept;
+
+    /**
+     * Picks the descriptor for a request, the O_DIRECT one if the request is aligned for it.
+     * \param p_buffer The memory.
+     * \param p_size Number of bytes.
+     * \param p_offset The file offset.
+     * \return The descriptor.
+    */
+    int get_request_fd(const void *__restrict__ const p_buffer, const uint64_t p_size, const uint64_t p_offset) const noexcept;
+
+    static const uint64_t m_direct_alignment = 4096; /**< Alignment of buffers, offsets and sizes for O_DIRECT. The logical block size of current devices divides it. */
+
+    const unsigned int m_depth; /**< Number of slots. */
+    const uint64_t m_chunk_size; /**< Size of a chunk buffer. */
+    bool m_direct; /**< Whether open_file() opens with O_DIRECT as well. */
+    int m_fd; /**< The open file, -1 if none. */
+    int m_direct_fd; /**< The open file with O_DIRECT, -1 if none. */
+    bool m_failed; /**< Whether a request failed since the file was opened. */
+    std::vector<S_Slot> m_slots; /**< Requests in flight and the chunk being filled. */
+    unsigned int m_busy_count; /**< Number of requests in flight, including queued ones. */
+    unsigned int m_queued; /**< Number of requests queued but not yet submitted. */
+    int m_fill; /**< Index of the slot being filled by write_file(), -1 if none. */
+    uint64_t m_fill_size; /**< Bytes in the slot being filled. */
+    uint64_t m_fill_capacity; /**< Bytes the slot being filled takes, so it ends at an aligned offset. */
+    std::mutex m_mutex; /**< Serializes access to the slots and the ring. */
+
+    bool m_ring_setup; /**< Whether setup_ring() was called. */
+    int m_ring_fd; /**< The ring, -1 if none. */
+    void * m_sq_map; /**< Mapping of the submission queue ring. */
+    uint64_t m_sq_map_size; /**< Size of m_sq_map. */
+    void * m_cq_map; /**< Mapping of the completion queue ring. Equal to m_sq_map if the kernel maps both at once. */
+    uint64_t m_cq_map_size; /**< Size of m_cq_map. */
+    void * m_sqes; /**< Mapping of the submission queue entries. */
+    uint64_t m_sqes_size; /**< Size of m_sqes. */
+    unsigned int * m_sq_tail; /**< Tail of the submission queue, written by us. */
+    unsigned int m_sq_mask; /**< Mask of submission queue indices. */
+    unsigned int * m_sq_array; /**< Submission queue array of entry indices. */
+    unsigned int * m_cq_head; /**< Head of the completion queue, written by us. */
+    unsigned int * m_cq_tail; /**< Tail of the completion queue, written by the kernel. */
+    unsigned int m_cq_mask; /**< Mask of completion queue indices. */
+    void * m_cqes; /**< Completion queue entries. */
+};
+
+
+/**
+ * A WY_SerializeIO on memory instead of a file, so a save can be sent to another process without a round trip through the disk. The file path given to open_file() is ignored. A save goes into a growable buffer or a fixed span, and a load reads a memory region, see WY_SerializeAgent::set_save_buffer() and WY_SerializeAgent::set_load_memory(). The bytes are the same as those of a save file.
+ */
+class WY_MemoryIO: public WY_SerializeIO
+{
+public:
+    /**
+     * Constructor. No memory is set.
+    */
+    WY_MemoryIO() noexcept;
+
+    /**
+     * Sets a buffer to write to. Opening with IO_OPEN_CREATE empties it, and writes past its end grow it.
+     * \param p_buffer The buffer. NULL to clear the memory set.
+    */
+    void set_buffer(std::vector<unsigned char> *__restrict__ const p_buffer) noexcept;
+
+    /**
+     * Sets a fixed span to write to. Writes past its end fail, and the size is the end of the furthest write.
+     * \param p_data The span. NULL to clear the memory set.
+     * \param p_capacity Size of the span in bytes.
+    */
+    void set_span(unsigned char *__restrict__ const p_data, const uint64_t p_capacity) noexcept;
+
+    /**
+     * Sets a region to read from. Writes fail.
+     * \param p_data The region. NULL to clear the memory set.
+     * \param p_size Size of the region in bytes.
+    */
+    void set_region(const unsigned char *__restrict__ const p_data, const uint64_t p_size) noexcept;
+
+    /**
+     * Gets the memory set, so it can be used in place.
+     * \return The memory, NULL if none is set or the buffer is empty.
+    */
+    const unsigned char * get_data() const noexcept;
+
+    /**
+     * Gets the size of the content of the memory set.
+     * \return Size in bytes.
+    */
+    uint64_t get_size() const noexcept;
+
+    /**
+     * Implements the WY_SerializeIO virtual function.
+     * \param p_path Ignored.
+     * \param p_mode One of IO_OPEN_MODE.
+     * \return 0 if no error. -1 if no memory is set, or a region is opened for writing.
+    */
+    int open_file(const char *__restrict__ const p_path, const IO_OPEN_MODE p_mode) noexcept;
+
+    /**
+     * Implements the WY_SerializeIO virtual function.
+     * \param p_size Returns the size in bytes.
+     * \return 0 if no error. -1 if error.
+    */
+    int get_file_size(uint64_t *__restrict__ const p_size) noexcept;
+
+    /**
+     * Implements the WY_SerializeIO virtual function.
+     * \param p_dst Buffer of at least p_size bytes.
+     * \param p_size Number of bytes to read.
+     * \param p_offset Offset to read from.
+     * \return 0 if no error. -1 if the memory ends before p_size bytes are read.
+    */
+    int read_file(unsigned char *__restrict__ const p_dst, const uint64_t p_size, const uint64_t p_offset) noexcept;
+
+    /**
+     * Implements the WY_SerializeIO virtual function. Writes from several threads take turns, as a buffer may move when it grows.
+     * \param p_iov The buffers.
+     * \param p_count Number of entries in p_iov.
+     * \param p_offset Offset to write at.
+     * \return 0 if no error. -1 if the span is too small or the buffer cannot grow.
+    */
+    int write_file(struct iovec *__restrict__ p_iov, int p_count, uint64_t p_offset) noexcept;
+
+    /**
+     * Implements the WY_SerializeIO virtual function. Memory needs no flush.
+     * \param p_data_only Ignored.
+     * \return 0.
+    */
+    int sync_file(const bool p_data_only) noexcept;
+
+    /**
+     * Implements the WY_SerializeIO virtual function.
+     * \return 0.
+    */
+    int close_file() noexcept;
+
+private:
+    std::vector<unsigned char> * m_buffer; /**< The buffer set by set_buffer(). NULL if none. */
+    unsigned char * m_span; /**< The span set by set_span(). NULL if none. */
+    const unsigned char * m_region; /**< The region set by set_region(). NULL if none. */
+    uint64_t m_capacity; /**< Size of m_span. */
+    uint64_t m_size; /**< Size of the content of m_span or m_region. */
+    bool m_open; /**< Whether open_file() succeeded since the last close_file(). */
+    std::mutex m_mutex; /**< Serializes write_file() calls from several threads. */
+};
+}
+
+#endif
@@ -16,19 +16,74 @@
 
 #include <cstdlib>
 #include <iostream>
+#include <atomic>
+#include <vector>
+#include <new>
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <sys/stat.h>
 #include "WY_SerializeMgr.hpp"
 #include "WY_SerializeAgent.hpp"
+#include "WY_SerializeVarint.hpp"
+#include "WY_ByteOrder.hpp"
 using namespace WY_Serialize;
 
 
+/**
+ * A save started by save_all_objs_async(). Holds everything the background thread needs, so it does not depend on the objects or settings of the WY_SerializeMgr.
+ */
+struct WY_SerializeMgr::S_AsyncSave {
+    std::string m_file; /**< Name of the file to save to. */
+    std::vector<S_SerializeData> m_data; /**< Captured data of every object, pointing into m_buffer or into stable object memory. */
+    std::unique_ptr<unsigned char[]> m_buffer; /**< Copies of the data that is not stable. */
+    uint64_t m_buffer_size; /**< Size of m_buffer. */
+    SAVE_MODE m_save_mode; /**< m_save_mode of the WY_SerializeMgr at the time of the call. */
+    IO_BACKEND m_io_backend; /**< m_io_backend of the WY_SerializeMgr at the time of the call. */
+    bool m_save_index; /**< m_save_index of the WY_SerializeMgr at the time of the call. */
+    const WY_SerializeCodec * m_codec; /**< m_codec of the WY_SerializeMgr at the time of the call. */
+    uint64_t m_codec_min_size; /**< m_codec_min_size of the WY_SerializeMgr at the time of the call. */
+    bool m_save_crc; /**< m_save_crc of the WY_SerializeMgr at the time of the call. */
+    bool m_save_compact; /**< m_save_compact of the WY_SerializeMgr at the time of the call. */
+    unsigned int m_save_alignment; /**< m_save_alignment of the WY_SerializeMgr at the time of the call. */
+    bool m_save_atomic; /**< m_save_atomic of the WY_SerializeMgr at the time of the call. */
+    SAVE_DURABILITY m_save_durability; /**< m_save_durability of the WY_SerializeMgr at the time of the call. */
+    std::function<void(const int)> m_callback; /**< Called when the save completes. May be empty. */
+    std::promise<int> m_result; /**< Completes the future returned to the caller. */
+};
+
+
+/**
+ * The content of a manifest written by save_all_objs_sharded(). The manifest is a save file with a single block of type SERIALIZE_TYPE_MANIFEST, see SERIALIZE_MANIFEST_HEADER_SIZE for its data.
+ */
+struct WY_SerializeMgr::S_ShardManifest {
+    uint64_t m_generation; /**< Incremented by every save, and part of the names of the shard files, so a save never overwrites the shards of the previous one. */
+    std::vector<std::string> m_files; /**< Name of every shard file. */
+    std::vector<std::vector<uint32_t>> m_slots; /**< Object slot of every block of every shard, in the order of the blocks. */
+};
+
+
 WY_SerializeMgr::WY_SerializeMgr(const unsigned int p_size)
 {    
-    m_serializeobj_array = NULL;
+    m_load_mode = LOAD_BUFFERED;
+    m_save_mode = SAVE_STREAM;
+    m_io_backend = IO_BACKEND_DEFAULT;
+    m_save_index = false;
+    m_codec = NULL;
+    m_codec_min_size = 256;
+    m_save_crc = false;
+    m_save_compact = false;
+    m_save_alignment = 1;
+    m_save_atomic = false;
+    m_save_durability = SAVE_DURABILITY_NONE;
+    m_thread_count = 1;
+    m_thread_pool = NULL;
+    m_log_end = 0;
+    m_async_stop = false;
+    m_async_spare_size = 0;
     m_file_name.clear();
     try {
-        m_serializeobj_array = new WY_SerializeObj * [p_size];
-        m_serializeobj_array_size = p_size;
-        m_serializeobj_array_offset = 0;
+        m_serializeobj_array.reserve(p_size);
     } catch (std::exception &e) {
         throw -1;
     }
@@ -37,25 +92,347 @@ WY_SerializeMgr::WY_SerializeMgr(const unsigned int p_size)
 
 WY_SerializeMgr::~WY_SerializeMgr()
 {
-    if(m_serializeobj_array_size > 0)
-        delete[] m_serializeobj_array;
+    if(m_async_thread.joinable()) { /* Pending saves are completed first. */
+        {
+            std::lock_guard<std::mutex> lock(m_async_mutex);
+            m_async_stop = true;
+        }
+        m_async_cv.notify_one();
+        m_async_thread.join();
+    }
+    delete m_thread_pool;
 }
 
 
 void WY_SerializeMgr::save_all_objs(const char *__restrict__ const p_file)
 {
     WY_SerializeAgent agent;
+
+    agent.set_file_name(p_file);
+    save_objs(&agent);
+}
+
+
+void WY_SerializeMgr::save_all_objs(std::vector<unsigned char> *__restrict__ const p_buffer)
+{
+    WY_SerializeAgent agent;
+
+    agent.set_save_buffer(p_buffer);
+    save_objs(&agent);
+}
+
+
+uint64_t WY_SerializeMgr::save_all_objs(unsigned char *__restrict__ const p_data, const uint64_t p_capacity)
+{
+    WY_SerializeAgent agent;
+
+    agent.set_save_span(p_data, p_capacity);
+    save_objs(&agent);
+    return agent.get_save_size();
+}
+
+
+void WY_SerializeMgr::save_objs(WY_SerializeAgent *__restrict__ const p_agent)
+{
     S_SerializeData data;
 
+    if(m_thread_count > 1) {
+        save_all_objs_parallel(p_agent);
+        return;
+    }
+
     try {
-        agent.set_file_name(p_file);
-        agent.prepare_save_file();
+        p_agent->set_save_mode(m_save_mode);
+        p_agent->set_io_backend(m_io_backend);
+        p_agent->set_save_index(m_save_index);
+        p_agent->set_codec(m_codec, m_codec_min_size);
+        p_agent->set_save_crc(m_save_crc);
+        p_agent->set_save_compact(m_save_compact);
+        p_agent->set_save_alignment(m_save_alignment);
+        p_agent->set_save_atomic(m_save_atomic);
+        p_agent->set_save_durability(m_save_durability);
+        p_agent->prepare_save_file();
 
-        for(unsigned int i=0; i<m_serializeobj_array_offset; i++) {
-            init_serializable_data(&data);
-            m_serializeobj_array[i]->get_save_data(&data);
-            agent.append_save_file(&data);            
+        for(unsigned int i=0; i<m_serializeobj_array.size(); i++) {
+            get_obj_save_data(i, &data);
+            p_agent->append_save_file(&data);            
         }
+        p_agent->finalise_save_file();
+    } catch (int &e) {
+        throw -1;
+    }
+}
+
+
+std::future<int> WY_SerializeMgr::save_all_objs_async(const char *__restrict__ const p_file, const std::function<void(const int)> &p_callback)
+{
+    std::shared_ptr<S_AsyncSave> job;
+    std::future<int> result;
+    uint64_t copy_size = 0, offset = 0;
+
+    try {
+        job = std::make_shared<S_AsyncSave>();
+        job->m_file = p_file;
+        job->m_callback = p_callback;
+        job->m_data.resize(m_serializeobj_array.size());
+        result = job->m_result.get_future();
+    } catch (std::exception &e) {
+        throw -1;
+    }
+    job->m_save_mode = m_save_mode;
+    job->m_io_backend = m_io_backend;
+    job->m_save_index = m_save_index;
+    job->m_codec = m_codec;
+    job->m_codec_min_size = m_codec_min_size;
+    job->m_save_crc = m_save_crc;
+    job->m_save_compact = m_save_compact;
+    job->m_save_alignment = m_save_alignment;
+    job->m_save_atomic = m_save_atomic;
+    job->m_save_durability = m_save_durability;
+
+    /* Capture. This is the only part the caller waits for. */
+    for(unsigned int i=0; i<m_serializeobj_array.size(); i++) {
+        get_obj_save_data(i, &job->m_data[i]);
+        if(!m_serializeobj_array[i]->is_save_data_stable())
+            copy_size += job->m_data[i].m_size;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_async_mutex);
+        if(m_async_spare_size >= copy_size) { /* Reuse the buffer of a completed save, its pages are already mapped. */
+            job->m_buffer = std::move(m_async_spare);
+            job->m_buffer_size = m_async_spare_size;
+            m_async_spare_size = 0;
+        }
+    }
+    if(job->m_buffer == NULL) {
+        job->m_buffer.reset(new (std::nothrow) unsigned char[copy_size]); /* One allocation for all copies, not zero-filled. */
+        job->m_buffer_size = copy_size;
+        if(job->m_buffer == NULL)
+            throw -1;
+    }
+    for(unsigned int i=0; i<m_serializeobj_array.size(); i++) {
+        S_SerializeData &data = job->m_data[i];
+        if(m_serializeobj_array[i]->is_save_data_stable() || (data.m_size == 0))
+            continue;
+        memcpy(job->m_buffer.get()+offset, data.m_data, data.m_size);
+        data.m_data = job->m_buffer.get()+offset;
+        offset += data.m_size;
+    }
+
+    try {
+        std::lock_guard<std::mutex> lock(m_async_mutex);
+        if(!m_async_thread.joinable())
+            m_async_thread = std::thread(&WY_SerializeMgr::run_async_saves, this);
+        m_async_jobs.push_back(job);
+    } catch (std::exception &e) {
+        throw -1;
+    }
+    m_async_cv.notify_one();
+    return result;
+}
+
+
+void WY_SerializeMgr::run_async_saves() noexcept
+{
+    for(;;) {
+        std::shared_ptr<S_AsyncSave> job;
+        {
+            std::unique_lock<std::mutex> lock(m_async_mutex);
+            m_async_cv.wait(lock, [this] { return m_async_stop || !m_async_jobs.empty(); });
+            if(m_async_jobs.empty())
+                return;
+            job = m_async_jobs.front();
+            m_async_jobs.pop_front();
+        }
+
+        int ret = 0;
+        try {
+            WY_SerializeAgent agent;
+            agent.set_file_name(job->m_file.c_str());
+            agent.set_save_mode(job->m_save_mode);
+            agent.set_io_backend(job->m_io_backend);
+            agent.set_save_index(job->m_save_index);
+            agent.set_codec(job->m_codec, job->m_codec_min_size);
+            agent.set_save_crc(job->m_save_crc);
+            agent.set_save_compact(job->m_save_compact);
+            agent.set_save_alignment(job->m_save_alignment);
+            agent.set_save_atomic(job->m_save_atomic);
+            agent.set_save_durability(job->m_save_durability);
+            agent.prepare_save_file();
+            for(S_SerializeData &data : job->m_data)
+                agent.append_save_file(&data);
+            agent.finalise_save_file();
+        } catch (int &e) {
+            ret = -1;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_async_mutex);
+            if(job->m_buffer_size > m_async_spare_size) { /* Keep the largest buffer for the next save, before reporting so the next save can take it. */
+                m_async_spare = std::move(job->m_buffer);
+                m_async_spare_size = job->m_buffer_size;
+            }
+        }
+        job->m_buffer.reset();
+        if(job->m_callback)
+            job->m_callback(ret);
+        job->m_result.set_value(ret);
+    }
+}
+
+
+void WY_SerializeMgr::save_all_objs_sharded(const char *__restrict__ const p_manifest, const char *const *__restrict__ const p_dirs, const unsigned int p_count)
+{
+    S_ShardManifest old_manifest, manifest;
+    std::vector<S_SerializeData> data;
+    std::vector<uint32_t> order;
+    std::vector<uint64_t> loads;
+    std::atomic<bool> failed(false);
+
+    if(p_count == 0)
+        throw -1;
+    old_manifest.m_generation = 0;
+    try {
+        read_manifest(p_manifest, &old_manifest);
+    } catch (int &e) { /* No previous save, or not a manifest. */
+        old_manifest.m_generation = 0;
+        old_manifest.m_files.clear();
+    }
+
+    try {
+        const char * const slash = strrchr(p_manifest, '/');
+        const std::string base = (slash != NULL) ? slash+1 : p_manifest;
+        manifest.m_generation = old_manifest.m_generation + 1;
+        manifest.m_files.resize(p_count);
+        manifest.m_slots.resize(p_count);
+        for(unsigned int k=0; k<p_count; k++) {
+            std::string &file = manifest.m_files[k];
+            file = p_dirs[k];
+            if(!file.empty() && (file.back() != '/'))
+                file += '/';
+            file += base + "." + std::to_string(manifest.m_generation) + "." + std::to_string(k);
+        }
+        data.resize(m_serializeobj_array.size());
+        order.resize(m_serializeobj_array.size());
+        loads.resize(p_count, 0);
+    } catch (std::exception &e) {
+        throw -1;
+    }
+
+    if(m_thread_count > 1) { /* The size of every block is needed before the shards are chosen. */
+        prepare_thread_pool();
+        m_thread_pool->run(m_serializeobj_array.size(), [&](const unsigned int i) {
+            get_obj_save_data(i, &data[i]);
+        });
+    } else {
+        for(unsigned int i=0; i<m_serializeobj_array.size(); i++)
+            get_obj_save_data(i, &data[i]);
+    }
+
+    /* Largest block first, each to the shard with the fewest bytes so far. Every shard keeps its blocks in registration order. */
+    for(unsigned int i=0; i<order.size(); i++)
+        order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&](const uint32_t a, const uint32_t b) { return data[a].m_size > data[b].m_size; });
+    try {
+        for(const uint32_t slot : order) {
+            const unsigned int k = std::min_element(loads.begin(), loads.end()) - loads.begin();
+            loads[k] += data[slot].m_size;
+            manifest.m_slots[k].push_back(slot);
+        }
+    } catch (std::exception &e) {
+        throw -1;
+    }
+    for(std::vector<uint32_t> &slots : manifest.m_slots)
+        std::sort(slots.begin(), slots.end());
+
+    try {
+        WY_ThreadPool pool(p_count); /* One thread per shard, so every disk is busy. */
+        pool.run(p_count, [&](const unsigned int k) {
+            try {
+                WY_SerializeAgent agent;
+                agent.set_file_name(manifest.m_files[k].c_str());
+                agent.set_save_mode(m_save_mode);
+                agent.set_io_backend(m_io_backend);
+                agent.set_save_index(m_save_index);
+                agent.set_codec(m_codec, m_codec_min_size);
+                agent.set_save_crc(m_save_crc);
+                agent.set_save_compact(m_save_compact);
+                agent.set_save_alignment(m_save_alignment);
+                agent.set_save_durability(m_save_durability); /* Not atomic, the file name is new. */
+                agent.prepare_save_file();
+                for(const uint32_t slot : manifest.m_slots[k])
+                    agent.append_save_file(&data[slot]);
+                agent.finalise_save_file();
+            } catch (int &e) {
+                failed = true;
+            }
+        });
+        if(failed)
+            throw -1;
+        write_manifest(p_manifest, manifest);
+    } catch (int &e) {
+        for(const std::string &file : manifest.m_files)
+            remove(file.c_str());
+        throw -1;
+    }
+
+    for(const std::string &file : old_manifest.m_files) { /* The new save is committed, so the previous one is no longer needed. */
+        if(std::find(manifest.m_files.begin(), manifest.m_files.end(), file) == manifest.m_files.end())
+            remove(file.c_str());
+    }
+}
+
+
+void WY_SerializeMgr::save_all_objs_parallel(WY_SerializeAgent *__restrict__ const p_agent)
+{
+    WY_SerializeAgent &agent = *p_agent;
+    std::vector<S_SerializeData> data;
+    std::vector<S_SerializeBlock> blocks;
+    std::vector<std::vector<unsigned char>> buffers;
+    std::vector<uint64_t> offsets;
+    std::atomic<bool> failed(false);
+
+    try {
+        data.resize(m_serializeobj_array.size());
+        blocks.resize(m_serializeobj_array.size());
+        buffers.resize(m_serializeobj_array.size());
+        offsets.resize(m_serializeobj_array.size());
+    } catch (std::exception &e) {
+        throw -1;
+    }
+    prepare_thread_pool();
+    agent.set_codec(m_codec, m_codec_min_size);
+    agent.set_save_crc(m_save_crc);
+    agent.set_save_compact(m_save_compact);
+    agent.set_save_alignment(m_save_alignment);
+    agent.set_save_atomic(m_save_atomic);
+    agent.set_save_durability(m_save_durability);
+
+    /* Capture and encode every object's data concurrently. The objects are independent, so this is where most of the time goes for objects that build their save data. */
+    m_thread_pool->run(m_serializeobj_array.size(), [&](const unsigned int i) {
+        get_obj_save_data(i, &data[i]);
+        agent.prepare_save_block(&data[i], &blocks[i], &buffers[i]);
+    });
+
+    try {
+        agent.set_save_mode(SAVE_VECTORED); /* Positional writes are only available in this mode. */
+        agent.set_io_backend(m_io_backend);
+        agent.set_save_index(m_save_index);
+        agent.prepare_save_file();
+
+        /* Lay the blocks out in registration order, so the file is the same as one saved serially. */
+        for(unsigned int i=0; i<m_serializeobj_array.size(); i++)
+            offsets[i] = agent.reserve_save_file(&blocks[i]);
+
+        m_thread_pool->run(m_serializeobj_array.size(), [&](const unsigned int i) {
+            try {
+                agent.write_save_file_at(&blocks[i], offsets[i]);
+            } catch (int &e) {
+                failed = true;
+            }
+        });
+        if(failed)
+            throw -1;
         agent.finalise_save_file();
     } catch (int &e) {
         throw -1;
@@ -64,33 +441,840 @@ void WY_SerializeMgr::save_all_objs(const char *__restrict__ const p_file)
 
 
 void WY_SerializeMgr::load_all_objs(const char *__restrict__ const p_file)
+{
+    WY_SerializeAgent agent;
+
+    agent.set_file_name(p_file);
+    agent.set_load_mode(m_load_mode);
+    agent.set_io_backend(m_io_backend);
+    const uint32_t type = get_first_block_type(p_file);
+    if(type == SERIALIZE_TYPE_MANIFEST) {
+        load_sharded_objs(p_file);
+        return;
+    }
+    if(type != SERIALIZE_TYPE_LOG) {
+        load_objs(&agent, m_load_mode);
+        return;
+    }
+
+    const uint64_t end = load_log_objs(&agent, m_load_mode);
+    try {
+        m_log_file = p_file;
+        m_log_end = end; /* Blocks after the last commit record are dropped by the next save_changed_objs(). */
+    } catch (std::exception &e) {
+        m_log_file.clear();
+    }
+}
+
+
+void WY_SerializeMgr::load_all_objs(const unsigned char *__restrict__ const p_data, const uint64_t p_size)
+{
+    WY_SerializeAgent agent;
+
+    agent.set_load_memory(p_data, p_size);
+    agent.set_load_mode(LOAD_MMAP); /* The region stays valid for the whole load, so its blocks are used in place. */
+    if(is_log_data(p_data, p_size))
+        load_log_objs(&agent, LOAD_MMAP);
+    else
+        load_objs(&agent, LOAD_MMAP);
+}
+
+
+void WY_SerializeMgr::load_objs(WY_SerializeAgent *__restrict__ const p_agent, const LOAD_MODE p_mode)
+{
+    WY_SerializeAgent &agent = *p_agent;
+    S_SerializeView view;
+
+    if((m_thread_count > 1) && (p_mode != LOAD_STREAM)) { /* Blocks loaded in LOAD_STREAM mode do not stay valid long enough to be dispatched. */
+        load_all_objs_parallel(p_agent);
+        return;
+    }
+
+    try {
+        agent.load_from_file();
+
+        if(m_serializeobj_keys.empty()) {
+            for(unsigned int i=0; i<m_serializeobj_array.size(); i++) {
+                if(agent.load_next_serializable_view(&view) != 0) /* Blocks are borrowed from the agent's buffer, no per-block copy. */
+                    throw -1;
+                if(m_serializeobj_array[i]->get_load_data(view.m_size, view.m_data) != 0)
+                    throw -1;
+            }
+        } else {
+            while(!agent.is_load_end()) { /* Every block goes to the object with its key, in file order. */
+                if(agent.load_next_serializable_view(&view) != 0)
+                    throw -1;
+                WY_SerializeObj * obj = find_serialize_obj(view.m_type, view.m_instance);
+                if((obj != NULL) && (obj->get_load_data(view.m_size, view.m_data) != 0)) /* Blocks of objects that are not added are skipped. */
+                    throw -1;
+            }
+        }
+        agent.clear_loaded_file_buffer();
+    } catch (int &e) {
+        throw -1;
+    }
+}
+
+
+void WY_SerializeMgr::load_all_objs_parallel(WY_SerializeAgent *__restrict__ const p_agent)
+{
+    WY_SerializeAgent &agent = *p_agent;
+    std::vector<S_SerializeView> views;
+
+    try {
+        views.resize(m_serializeobj_array.size(), {SERIALIZE_TYPE_LOG, 0, NULL, 0});
+    } catch (std::exception &e) {
+        throw -1;
+    }
+    prepare_thread_pool();
+
+    try {
+        agent.load_from_file();
+
+        /* Find every block first. This only parses headers, the views point into the loaded file. */
+        if(m_serializeobj_keys.empty()) {
+            for(unsigned int i=0; i<m_serializeobj_array.size(); i++) {
+                if(agent.load_next_serializable_view(&views[i]) != 0)
+                    throw -1;
+            }
+        } else {
+            S_SerializeView view;
+            while(!agent.is_load_end()) {
+                if(agent.load_next_serializable_view(&view) != 0)
+                    throw -1;
+                const auto it = m_serializeobj_slots.find(get_obj_key(view.m_type, view.m_instance));
+                if(it != m_serializeobj_slots.end())
+                    views[it->second] = view; /* A later block of the same key replaces an earlier one. */
+            }
+        }
+        load_views(views);
+        agent.clear_loaded_file_buffer();
+    } catch (int &e) {
+        throw -1;
+    }
+}
+
+
+void WY_SerializeMgr::load_sharded_objs(const char *__restrict__ const p_file)
+{
+    S_ShardManifest manifest;
+    std::unique_ptr<WY_SerializeAgent[]> agents;
+    std::vector<std::vector<S_SerializeView>> shard_views;
+    std::vector<S_SerializeView> views;
+    std::atomic<bool> failed(false);
+    const bool keyed = !m_serializeobj_keys.empty();
+
+    read_manifest(p_file, &manifest);
+    const unsigned int count = manifest.m_files.size();
+    try {
+        agents.reset(new WY_SerializeAgent[count]);
+        shard_views.resize(count);
+        views.resize(m_serializeobj_array.size(), {SERIALIZE_TYPE_LOG, 0, NULL, 0});
+    } catch (std::exception &e) {
+        throw -1;
+    }
+    for(unsigned int k=0; k<count; k++) {
+        agents[k].set_file_name(manifest.m_files[k].c_str());
+        agents[k].set_load_mode(m_load_mode);
+        agents[k].set_io_backend(m_io_backend);
+        if(!keyed) { /* Every object must have exactly one block. */
+            for(const uint32_t slot : manifest.m_slots[k]) {
+                if((slot >= views.size()) || (views[slot].m_type != SERIALIZE_TYPE_LOG))
+                    throw -1;
+                views[slot].m_type = 0;
+            }
+        }
+    }
+    if(!keyed) {
+        for(const S_SerializeView &view : views) {
+            if(view.m_type == SERIALIZE_TYPE_LOG)
+                throw -1;
+        }
+    }
+
+    /* Gives a block of shard k to its object, or returns the slot it belongs to. */
+    const auto find_slot = [&](const unsigned int k, const uint64_t j, const S_SerializeView &view) -> int64_t {
+        if(!keyed)
+            return (j < manifest.m_slots[k].size()) ? (int64_t)manifest.m_slots[k][j] : -1;
+        const auto it = m_serializeobj_slots.find(get_obj_key(view.m_type, view.m_instance));
+        return (it != m_serializeobj_slots.end()) ? (int64_t)it->second : INT64_MAX; /* Blocks of objects that are not added are skipped. */
+    };
+
+    try {
+        if(m_load_mode == LOAD_STREAM) { /* Blocks are only valid until the next one is read, so the shards are read one after the other. */
+            S_SerializeView view;
+            for(unsigned int k=0; k<count; k++) {
+                agents[k].load_from_file();
+                uint64_t j;
+                for(j=0; !agents[k].is_load_end(); j++) {
+                    if(agents[k].load_next_serializable_view(&view) != 0)
+                        throw -1;
+                    const int64_t slot = find_slot(k, j, view);
+                    if(slot < 0)
+                        throw -1;
+                    if((slot != INT64_MAX) && (m_serializeobj_array[slot]->get_load_data(view.m_size, view.m_data) != 0))
+                        throw -1;
+                }
+                if(!keyed && (j != manifest.m_slots[k].size()))
+                    throw -1;
+                agents[k].clear_loaded_file_buffer();
+            }
+            return;
+        }
+
+        /* Read and parse the shards concurrently, one thread each. The views point into the buffers of the agents. */
+        WY_ThreadPool pool(count);
+        pool.run(count, [&](const unsigned int k) {
+            try {
+                S_SerializeView view;
+                agents[k].load_from_file();
+                while(!agents[k].is_load_end()) {
+                    if(agents[k].load_next_serializable_view(&view) != 0)
+                        throw -1;
+                    shard_views[k].push_back(view);
+                }
+            } catch (int &e) {
+                failed = true;
+            } catch (std::exception &e) {
+                failed = true;
+            }
+        });
+        if(failed)
+            throw -1;
+
+        for(unsigned int k=0; k<count; k++) {
+            if(!keyed && (shard_views[k].size() != manifest.m_slots[k].size()))
+                throw -1;
+            for(uint64_t j=0; j<shard_views[k].size(); j++) {
+                const int64_t slot = find_slot(k, j, shard_views[k][j]);
+                if(slot != INT64_MAX)
+                    views[slot] = shard_views[k][j];
+            }
+        }
+        load_views(views);
+        for(unsigned int k=0; k<count; k++)
+            agents[k].clear_loaded_file_buffer();
+    } catch (int &e) {
+        throw -1;
+    } catch (std::exception &e) {
+        throw -1;
+    }
+}
+
+
+void WY_SerializeMgr::read_manifest(const char *__restrict__ const p_file, S_ShardManifest *__restrict__ const p_manifest)
+{
+    WY_SerializeAgent agent;
+    S_SerializeView view;
+
+    agent.set_file_name(p_file);
+    agent.set_io_backend(m_io_backend);
+    try {
+        agent.load_from_file();
+        if((agent.load_next_serializable_view(&view) != 0) || (view.m_type != SERIALIZE_TYPE_MANIFEST) || (view.m_size < SERIALIZE_MANIFEST_HEADER_SIZE)
+            || (decode_le64(view.m_data) != SERIALIZE_MANIFEST_MAGIC))
+            throw -1;
+
+        const uint32_t count = decode_le32(view.m_data+16);
+        uint64_t blocks = decode_le32(view.m_data+20), offset = SERIALIZE_MANIFEST_HEADER_SIZE;
+        if((count == 0) || (count > (view.m_size - offset) / 8)) /* Each shard takes at least 8 bytes. */
+            throw -1;
+        p_manifest->m_generation = decode_le64(view.m_data+8);
+        p_manifest->m_files.resize(count);
+        p_manifest->m_slots.resize(count);
+        for(uint32_t k=0; k<count; k++) {
+            if(view.m_size - offset < 8)
+                throw -1;
+            const uint32_t length = decode_le32(view.m_data+offset);
+            const uint32_t slots = decode_le32(view.m_data+offset+4);
+            offset += 8;
+            if((length == 0) || (slots > blocks) || (length > view.m_size - offset) || ((uint64_t)slots*4 > view.m_size - offset - length))
+                throw -1;
+            p_manifest->m_files[k].assign((const char *)view.m_data+offset, length);
+            offset += length;
+            p_manifest->m_slots[k].resize(slots);
+            for(uint32_t j=0; j<slots; j++)
+                p_manifest->m_slots[k][j] = decode_le32(view.m_data+offset+(uint64_t)j*4);
+            offset += (uint64_t)slots*4;
+            blocks -= slots;
+        }
+        if((offset != view.m_size) || (blocks != 0))
+            throw -1;
+        agent.clear_loaded_file_buffer();
+    } catch (int &e) {
+        throw -1;
+    } catch (std::exception &e) {
+        throw -1;
+    }
+}
+
+
+void WY_SerializeMgr::write_manifest(const char *__restrict__ const p_file, const S_ShardManifest &p_manifest)
+{
+    WY_SerializeAgent agent;
+    S_SerializeData data;
+    std::vector<unsigned char> buffer;
+    uint64_t size = SERIALIZE_MANIFEST_HEADER_SIZE, blocks = 0;
+
+    for(unsigned int k=0; k<p_manifest.m_files.size(); k++) {
+        size += 8 + p_manifest.m_files[k].size() + (uint64_t)p_manifest.m_slots[k].size()*4;
+        blocks += p_manifest.m_slots[k].size();
+    }
+    try {
+        buffer.resize(size);
+    } catch (std::exception &e) {
+        throw -1;
+    }
+    unsigned char * p = buffer.data();
+    encode_le64(p, SERIALIZE_MANIFEST_MAGIC);
+    encode_le64(p+8, p_manifest.m_generation);
+    encode_le32(p+16, p_manifest.m_files.size());
+    encode_le32(p+20, blocks);
+    p += SERIALIZE_MANIFEST_HEADER_SIZE;
+    for(unsigned int k=0; k<p_manifest.m_files.size(); k++) {
+        encode_le32(p, p_manifest.m_files[k].size());
+        encode_le32(p+4, p_manifest.m_slots[k].size());
+        memcpy(p+8, p_manifest.m_files[k].data(), p_manifest.m_files[k].size());
+        p += 8 + p_manifest.m_files[k].size();
+        WY_ByteOrder::encode_array(p_manifest.m_slots[k].data(), p_manifest.m_slots[k].size(), p);
+        p += (uint64_t)p_manifest.m_slots[k].size()*4;
+    }
+
+    init_serializable_data(&data);
+    data.m_type = SERIALIZE_TYPE_MANIFEST;
+    data.m_size = buffer.size();
+    data.m_data = buffer.data();
+    agent.set_file_name(p_file);
+    agent.set_io_backend(m_io_backend);
+    agent.set_save_crc(true); /* Small, and a corrupt manifest would lose the whole save. */
+    agent.set_save_atomic(true);
+    agent.set_save_durability(m_save_durability);
+    agent.prepare_save_file();
+    agent.append_save_file(&data);
+    agent.finalise_save_file();
+}
+
+
+void WY_SerializeMgr::load_views(const std::vector<S_SerializeView> &p_views)
+{
+    if(m_thread_count <= 1) {
+        for(unsigned int i=0; i<m_serializeobj_array.size(); i++) {
+            if((p_views[i].m_type != SERIALIZE_TYPE_LOG) && (m_serializeobj_array[i]->get_load_data(p_views[i].m_size, p_views[i].m_data) != 0))
+                throw -1;
+        }
+        return;
+    }
+
+    std::atomic<bool> failed(false);
+    prepare_thread_pool();
+    m_thread_pool->run(m_serializeobj_array.size(), [&](const unsigned int i) {
+        if((p_views[i].m_type != SERIALIZE_TYPE_LOG) && m_serializeobj_array[i]->is_load_thread_safe() && (m_serializeobj_array[i]->get_load_data(p_views[i].m_size, p_views[i].m_data) != 0))
+            failed = true; /* Reported once every object has been given its data. */
+    });
+    for(unsigned int i=0; i<m_serializeobj_array.size(); i++) { /* Objects that opted out are loaded here, in registration order. */
+        if((p_views[i].m_type != SERIALIZE_TYPE_LOG) && !m_serializeobj_array[i]->is_load_thread_safe() && (m_serializeobj_array[i]->get_load_data(p_views[i].m_size, p_views[i].m_data) != 0))
+            failed = true;
+    }
+    if(failed)
+        throw -1;
+}
+
+
+void WY_SerializeMgr::save_changed_objs(const char *__restrict__ const p_file)
 {
     WY_SerializeAgent agent;
     S_SerializeData data;
+    std::vector<uint32_t> slots;
+    std::vector<unsigned char> first_record, record; /* Must stay valid until the file is finalised in SAVE_VECTORED mode. */
+    uint64_t end = 0;
 
     try {
+        const bool full = !find_log_end(p_file, &end);
         agent.set_file_name(p_file);
+        agent.set_save_mode(m_save_mode);
+        agent.set_io_backend(m_io_backend);
+        agent.set_codec(m_codec, m_codec_min_size);
+        agent.set_save_crc(m_save_crc);
+        agent.set_save_compact(m_save_compact);
+        agent.set_save_alignment(m_save_alignment);
+        agent.set_save_durability(m_save_durability);
+        if(full) { /* A new log starts with an empty commit record, which marks the file as a log. */
+            agent.prepare_save_file();
+            append_log_record(&agent, slots, &first_record);
+        } else
+            agent.prepare_append_file(end); /* Also drops blocks of an interrupted save that were never committed. */
+
+        slots.reserve(m_serializeobj_array.size());
+        for(unsigned int i=0; i<m_serializeobj_array.size(); i++) {
+            if(!full && !m_serializeobj_array[i]->is_dirty())
+                continue;
+            get_obj_save_data(i, &data);
+            agent.append_save_file(&data);
+            slots.push_back(i);
+        }
+        append_log_record(&agent, slots, &record); /* The blocks only count once this record is in the file. */
+        agent.finalise_save_file();
+    } catch (int &e) {
+        m_log_file.clear(); /* Whatever was written is rescanned next time. */
+        throw -1;
+    } catch (std::exception &e) {
+        m_log_file.clear();
+        throw -1;
+    }
+
+    for(const uint32_t slot : slots)
+        m_serializeobj_array[slot]->clear_dirty();
+    set_log_end(p_file);
+}
+
+
+void WY_SerializeMgr::compact_log_file(const char *__restrict__ const p_file)
+{
+    WY_SerializeAgent reader, writer;
+    S_SerializeView view;
+    S_SerializeData data;
+    std::vector<uint64_t> newest;
+    std::vector<uint32_t> slot_of, slots;
+    std::vector<unsigned char> first_record, record;
+
+    try {
+        reader.set_file_name(p_file);
+        reader.set_load_mode(LOAD_STREAM); /* Two passes over the log, without holding it in memory. */
+        reader.set_io_backend(m_io_backend);
+        reader.load_from_file();
+        read_log(&reader, UINT32_MAX, &newest, NULL); /* The objects are not needed, so the slots are only bounded by the blocks. */
+        slot_of = get_log_slots(newest, newest.size());
+        reader.load_from_file();
+
+        writer.set_file_name(p_file);
+        writer.set_save_mode(SAVE_STREAM); /* Streamed blocks are only valid until the next one is read, so they are written at once. */
+        writer.set_io_backend(m_io_backend);
+        writer.set_codec(m_codec, m_codec_min_size);
+        writer.set_save_crc(m_save_crc);
+        writer.set_save_compact(m_save_compact);
+        writer.set_save_alignment(m_save_alignment);
+        writer.set_save_atomic(true); /* Replaces the log in one step, so it is never seen half compacted. */
+        writer.set_save_durability(m_save_durability);
+        writer.prepare_save_file();
+        append_log_record(&writer, slots, &first_record);
+        for(uint64_t ordinal=0; ordinal<slot_of.size(); ordinal++) {
+            if(reader.load_next_serializable_view(&view) != 0)
+                throw -1;
+            if(slot_of[ordinal] == UINT32_MAX) /* Superseded block or commit record. */
+                continue;
+            data.m_type = view.m_type;
+            data.m_size = view.m_size;
+            data.m_data = (unsigned char *)view.m_data;
+            data.m_instance = view.m_instance;
+            writer.append_save_file(&data);
+            slots.push_back(slot_of[ordinal]);
+        }
+        append_log_record(&writer, slots, &record);
+        writer.finalise_save_file();
+        reader.clear_loaded_file_buffer();
+    } catch (int &e) {
+        throw -1;
+    } catch (std::exception &e) {
+        throw -1;
+    }
+    set_log_end(p_file);
+}
+
+
+uint64_t WY_SerializeMgr::load_log_objs(WY_SerializeAgent *__restrict__ const p_agent, const LOAD_MODE p_mode)
+{
+    WY_SerializeAgent &agent = *p_agent;
+    S_SerializeView view;
+    std::vector<uint64_t> newest;
+    std::vector<S_SerializeView> views;
+    std::vector<uint32_t> slot_of;
+    uint64_t end;
+
+    try {
         agent.load_from_file();
-        init_serializable_data(&data);
 
-        for(unsigned int i=0; i<m_serializeobj_array_offset; i++) {
-            agent.load_next_serializable_data(&data);
-            m_serializeobj_array[i]->get_load_data(data.m_size, data.m_data);
-            clear_loaded_serializable_data(&data);
+        if(p_mode != LOAD_STREAM) { /* Views of the newest blocks stay valid, so load them directly. */
+            end = read_log(&agent, m_serializeobj_array.size(), &newest, &views);
+            get_log_slots(newest, m_serializeobj_array.size()); /* Checks every object has a block. */
+            load_views(views);
+        } else { /* Find the newest blocks first, then stream the log again and load them as they go by. */
+            end = read_log(&agent, m_serializeobj_array.size(), &newest, NULL);
+            slot_of = get_log_slots(newest, m_serializeobj_array.size());
+            agent.load_from_file();
+            for(uint64_t ordinal=0; ordinal<slot_of.size(); ordinal++) {
+                if(agent.load_next_serializable_view(&view) != 0)
+                    throw -1;
+                if((slot_of[ordinal] != UINT32_MAX) && (m_serializeobj_array[slot_of[ordinal]]->get_load_data(view.m_size, view.m_data) != 0))
+                    throw -1;
+            }
         }
         agent.clear_loaded_file_buffer();
     } catch (int &e) {
         throw -1;
+    } catch (std::exception &e) {
+        throw -1;
     }
+    return end;
 }
 
 
-int WY_SerializeMgr::add_serialize_obj(WY_SerializeObj *__restrict__ const p_obj) noexcept
+uint64_t WY_SerializeMgr::read_log(WY_SerializeAgent *__restrict__ const p_agent, const uint32_t p_slot_count, std::vector<uint64_t> *__restrict__ const p_newest, std::vector<S_SerializeView> *__restrict__ const p_views)
 {
-    if(m_serializeobj_array_offset+1 < m_serializeobj_array_size) {
-        m_serializeobj_array[m_serializeobj_array_offset] = p_obj;
-        ++m_serializeobj_array_offset;
+    S_SerializeView view;
+    std::vector<S_SerializeView> pending;
+    uint64_t ordinal = 0, pending_start = 0, end = 0, magic, blocks = 0;
+    uint32_t count, slot, k;
+
+    try {
+        while(p_agent->load_next_serializable_view(&view) == 0) {
+            if(view.m_type != SERIALIZE_TYPE_LOG) {
+                if(end == 0) /* A log starts with a commit record. */
+                    throw -1;
+                if(p_views != NULL)
+                    pending.push_back(view);
+                ++ordinal;
+                ++blocks;
+                continue;
+            }
+
+            if(view.m_size < SERIALIZE_LOG_RECORD_SIZE)
+                break;
+            magic = decode_le64(view.m_data);
+            count = decode_le32(view.m_data+8);
+            if((magic != SERIALIZE_LOG_MAGIC) || (view.m_size != SERIALIZE_LOG_RECORD_SIZE + (uint64_t)count*4) || (count != ordinal-pending_start))
+                break; /* Treated like the end of the log. */
+            const uint64_t slot_limit = std::min<uint64_t>(p_slot_count, blocks);
+            for(k=0; k<count; k++) {
+                if(decode_le32(view.m_data+SERIALIZE_LOG_RECORD_SIZE+k*4) >= slot_limit)
+                    break;
+            }
+            if(k < count) /* A corrupt slot, also treated like the end of the log. */
+                break;
+            for(k=0; k<count; k++) { /* Later commits replace the blocks of earlier ones. */
+                slot = decode_le32(view.m_data+SERIALIZE_LOG_RECORD_SIZE+k*4);
+                if(slot >= p_newest->size()) {
+                    p_newest->resize(slot+1, UINT64_MAX);
+                    if(p_views != NULL)
+                        p_views->resize(slot+1);
+                }
+                (*p_newest)[slot] = pending_start+k;
+                if(p_views != NULL)
+                    (*p_views)[slot] = pending[k];
+            }
+            pending.clear();
+            pending_start = ++ordinal;
+            end = p_agent->get_load_offset();
+        }
+    } catch (std::exception &e) {
+        throw -1;
+    }
+
+    if(end == 0)
+        throw -1;
+    return end;
+}
+
+
+std::vector<uint32_t> WY_SerializeMgr::get_log_slots(const std::vector<uint64_t> &p_newest, const size_t p_count)
+{
+    std::vector<uint32_t> slot_of;
+
+    if(p_newest.size() < p_count)
+        throw -1;
+    try {
+        for(size_t slot=0; slot<p_count; slot++) {
+            const uint64_t ordinal = p_newest[slot];
+            if(ordinal == UINT64_MAX)
+                throw -1;
+            if(ordinal >= slot_of.size())
+                slot_of.resize(ordinal+1, UINT32_MAX);
+            slot_of[ordinal] = slot;
+        }
+    } catch (std::exception &e) {
+        throw -1;
+    }
+    return slot_of;
+}
+
+
+void WY_SerializeMgr::append_log_record(WY_SerializeAgent *__restrict__ const p_agent, const std::vector<uint32_t> &p_slots, std::vector<unsigned char> *__restrict__ const p_record)
+{
+    S_SerializeData data;
+    const uint32_t count = p_slots.size();
+
+    try {
+        p_record->resize(SERIALIZE_LOG_RECORD_SIZE + (uint64_t)count*4);
+    } catch (std::exception &e) {
+        throw -1;
+    }
+    encode_le64(p_record->data(), SERIALIZE_LOG_MAGIC);
+    encode_le32(p_record->data()+8, count);
+    WY_ByteOrder::encode_array(p_slots.data(), count, p_record->data()+SERIALIZE_LOG_RECORD_SIZE);
+
+    init_serializable_data(&data);
+    data.m_type = SERIALIZE_TYPE_LOG;
+    data.m_size = p_record->size();
+    data.m_data = p_record->data();
+    p_agent->append_save_file(&data);
+}
+
+
+bool WY_SerializeMgr::is_log_file(const char *__restrict__ const p_file) noexcept
+{
+    return get_first_block_type(p_file) == SERIALIZE_TYPE_LOG;
+}
+
+
+bool WY_SerializeMgr::is_log_data(const unsigned char *__restrict__ const p_data, const uint64_t p_size) noexcept
+{
+    return get_first_block_type(p_data, p_size) == SERIALIZE_TYPE_LOG;
+}
+
+
+uint32_t WY_SerializeMgr::get_first_block_type(const char *__restrict__ const p_file) noexcept
+{
+    unsigned char header_data[SERIALIZE_FILE_HEADER_SIZE + SERIALIZE_HEADER_MAX];
+    uint64_t size;
+
+    try {
+        std::ifstream file(p_file, std::ifstream::binary);
+        file.read((char *)header_data, sizeof(header_data)); /* Files shorter than this are fine, gcount() has the bytes read. */
+        size = file.gcount();
+    } catch (std::exception &e) {
         return 0;
-    } else
+    }
+    return get_first_block_type(header_data, size);
+}
+
+
+uint32_t WY_SerializeMgr::get_first_block_type(const unsigned char *__restrict__ const p_data, const uint64_t p_size) noexcept
+{
+    S_SerializeFileHeader file_header;
+    S_SerializeHeader header;
+
+    const int offset = decode_file_header(p_data, p_size, &file_header);
+    if(offset < 0)
+        return 0;
+    if(file_header.m_options & SERIALIZE_FILE_COMPACT)
+        return (WY_SerializeVarint::decode_header(p_data+offset, p_size-offset, &header) != 0) ? header.m_type : 0;
+    if(file_header.m_version == 0) {
+        if(p_size < SERIALIZE_LEGACY_HEADER_SIZE)
+            return 0;
+        decode_legacy_header(p_data, &header);
+        return header.m_type;
+    }
+    if(p_size-offset < SERIALIZE_HEADER_SIZE)
+        return 0;
+    decode_serialize_header(p_data+offset, &header);
+    return header.m_type;
+}
+
+
+bool WY_SerializeMgr::find_log_end(const char *__restrict__ const p_file, uint64_t *__restrict__ const p_end)
+{
+    struct stat file_stat;
+    WY_SerializeAgent agent;
+    std::vector<uint64_t> newest;
+
+    if((stat(p_file, &file_stat) != 0) || !is_log_file(p_file))
+        return false;
+    if((m_log_file == p_file) && (m_log_end == (uint64_t)file_stat.st_size)) { /* Unchanged since the last save or load, no need to read the log. */
+        *p_end = m_log_end;
+        return true;
+    }
+
+    agent.set_file_name(p_file);
+    agent.set_load_mode(LOAD_STREAM);
+    agent.set_io_backend(m_io_backend);
+    agent.load_from_file();
+    *p_end = read_log(&agent, UINT32_MAX, &newest, NULL); /* Commits of slots this WY_SerializeMgr does not have still belong to the log, and must not be overwritten. */
+    agent.clear_loaded_file_buffer();
+    return true;
+}
+
+
+void WY_SerializeMgr::set_log_end(const char *__restrict__ const p_file) noexcept
+{
+    struct stat file_stat;
+
+    m_log_file.clear();
+    if(stat(p_file, &file_stat) != 0)
+        return;
+    try {
+        m_log_file = p_file;
+        m_log_end = file_stat.st_size;
+    } catch (std::exception &e) {
+        m_log_file.clear();
+    }
+}
+
+
+void WY_SerializeMgr::prepare_thread_pool()
+{
+    if((m_thread_pool != NULL) && (m_thread_pool->get_thread_count() == m_thread_count))
+        return;
+
+    delete m_thread_pool;
+    m_thread_pool = NULL;
+    try {
+        m_thread_pool = new WY_ThreadPool(m_thread_count);
+    } catch (std::exception &e) {
+        throw -1;
+    }
+}
+
+
+void WY_SerializeMgr::load_obj_by_type(const char *__restrict__ const p_file, const unsigned int p_type, WY_SerializeObj *__restrict__ const p_obj)
+{
+    WY_SerializeObj * obj = p_obj;
+    load_objs_by_type(p_file, &p_type, &obj, 1);
+}
+
+
+void WY_SerializeMgr::load_objs_by_type(const char *__restrict__ const p_file, const unsigned int *__restrict__ const p_types, WY_SerializeObj *const *__restrict__ const p_objs, const unsigned int p_count)
+{
+    WY_SerializeAgent agent;
+    S_SerializeView view;
+
+    try {
+        agent.set_file_name(p_file);
+        agent.set_load_mode((m_load_mode == LOAD_BUFFERED) ? LOAD_STREAM : m_load_mode); /* Never read the whole file just to pick out some blocks. */
+        agent.set_io_backend(m_io_backend);
+        agent.load_from_file();
+        if(!agent.has_index())
+            throw -1;
+
+        for(unsigned int i=0; i<p_count; i++) {
+            if(agent.load_serializable_view_by_type(p_types[i], &view) != 0)
+                throw -1;
+            if(p_objs[i]->get_load_data(view.m_size, view.m_data) != 0)
+                throw -1;
+        }
+        agent.clear_loaded_file_buffer();
+    } catch (int &e) {
+        throw -1;
+    }
+}
+
+
+int WY_SerializeMgr::add_serialize_obj(WY_SerializeObj *__restrict__ const p_obj) noexcept
+{
+    if(!m_serializeobj_keys.empty()) /* Objects without a key could not be found when loading. */
+        return -1;
+    try {
+        m_serializeobj_array.push_back((WY_SerializeObj *)p_obj);
+    } catch (std::exception &e) {
+        return -1;
+    }
+    return 0;
+}
+
+
+int WY_SerializeMgr::add_serialize_obj(WY_SerializeObj *__restrict__ const p_obj, const unsigned int p_type, const uint32_t p_instance) noexcept
+{
+    const uint64_t key = get_obj_key(p_type, p_instance);
+
+    if((p_type == SERIALIZE_TYPE_LOG) || (p_type == SERIALIZE_TYPE_MANIFEST) || (m_serializeobj_keys.size() != m_serializeobj_array.size()) || (m_serializeobj_array.size() >= UINT32_MAX))
         return -1;
+    try {
+        if(!m_serializeobj_slots.emplace(key, (uint32_t)m_serializeobj_array.size()).second) /* Key already added. */
+            return -1;
+    } catch (std::exception &e) {
+        return -1;
+    }
+    try {
+        m_serializeobj_array.push_back((WY_SerializeObj *)p_obj);
+        m_serializeobj_keys.push_back(key);
+    } catch (std::exception &e) {
+        m_serializeobj_slots.erase(key);
+        if(m_serializeobj_array.size() > m_serializeobj_keys.size())
+            m_serializeobj_array.pop_back();
+        return -1;
+    }
+    return 0;
+}
+
+
+WY_SerializeObj * WY_SerializeMgr::find_serialize_obj(const unsigned int p_type, const uint32_t p_instance) const noexcept
+{
+    const auto it = m_serializeobj_slots.find(get_obj_key(p_type, p_instance));
+    return (it != m_serializeobj_slots.end()) ? m_serializeobj_array[it->second] : NULL;
+}
+
+
+void WY_SerializeMgr::get_obj_save_data(const unsigned int p_slot, S_SerializeData *__restrict__ const p_data) noexcept
+{
+    init_serializable_data(p_data);
+    m_serializeobj_array[p_slot]->get_save_data(p_data);
+    if(!m_serializeobj_keys.empty()) { /* The key the object was added with is what it is found by when loading. */
+        p_data->m_type = m_serializeobj_keys[p_slot] >> 32;
+        p_data->m_instance = (uint32_t)m_serializeobj_keys[p_slot];
+    }
+}
+
+
+void WY_SerializeMgr::set_load_mode(const LOAD_MODE p_mode) noexcept
+{
+    m_load_mode = p_mode;
+}
+
+
+void WY_SerializeMgr::set_save_mode(const SAVE_MODE p_mode) noexcept
+{
+    m_save_mode = p_mode;
+}
+
+
+void WY_SerializeMgr::set_io_backend(const IO_BACKEND p_backend) noexcept
+{
+    m_io_backend = p_backend;
+}
+
+
+void WY_SerializeMgr::set_save_index(const bool p_index) noexcept
+{
+    m_save_index = p_index;
+}
+
+
+void WY_SerializeMgr::set_codec(const WY_SerializeCodec *__restrict__ const p_codec, const uint64_t p_min_size) noexcept
+{
+    m_codec = p_codec;
+    m_codec_min_size = p_min_size;
+}
+
+
+void WY_SerializeMgr::set_save_crc(const bool p_crc) noexcept
+{
+    m_save_crc = p_crc;
+}
+
+
+void WY_SerializeMgr::set_save_compact(const bool p_compact) noexcept
+{
+    m_save_compact = p_compact;
+}
+
+
+void WY_SerializeMgr::set_save_alignment(const unsigned int p_alignment) noexcept
+{
+    m_save_alignment = p_alignment;
+}
+
+
+void WY_SerializeMgr::set_save_atomic(const bool p_atomic) noexcept
+{
+    m_save_atomic = p_atomic;
+}
+
+
+void WY_SerializeMgr::set_save_durability(const SAVE_DURABILITY p_durability) noexcept
+{
+    m_save_durability = p_durability;
+}
+
+
+void WY_SerializeMgr::set_thread_count(const unsigned int p_threads) noexcept
+{
+    m_thread_count = (p_threads == 0) ? 1 : p_threads;
 }
@@ -20,6 +20,11 @@
 #include "WY_SerializeAgent.hpp"
 #include "DemoObj1.hpp"
 #include "WY_SerializeObj.hpp"
+#include "WY_ThreadPool.hpp"
+#include <deque>
+#include <future>
+#include <memory>
+#include <unordered_map>
 #pragma once
 namespace WY_Serialize
 {
@@ -57,7 +62,7 @@ class WY_SerializeMgr
 public:
     /**
      * Constructor.
-     * \param p_size Max number of WY_SerializeObj supported. Defaults to 8.
+     * \param p_size Number of WY_SerializeObj to reserve space for. More can be added. Defaults to 8.
      * \throw Integer exception if error. 
     */
     WY_SerializeMgr(const unsigned int p_size=8);
@@ -76,24 +81,387 @@ public:
     void save_all_objs(const char *__restrict__ const p_file);
 
     /**
-     * Loads all content from the save file into WY_SerializeObj objects added to the WY_SerializeMgr. This is done in the exact same sequence where WY_SerializeObj objects are added. So the sequence where the objects are loaded must match the sequence where they are saved.
+     * Saves all objects like save_all_objs(), but into a buffer instead of a file, for example to send the state to another process without writing it to disk. The buffer is emptied first and then holds the same bytes as a save file, which load_all_objs() loads from memory. set_save_atomic() and set_save_durability() do not apply. See WY_SerializeAgent::set_save_buffer().
+     * \param p_buffer The buffer. Its capacity is kept, so saving into the same buffer again does not allocate once it is large enough.
+     * \throw -1 integer exception if there is an error.
+    */
+    void save_all_objs(std::vector<unsigned char> *__restrict__ const p_buffer);
+
+    /**
+     * Saves all objects like save_all_objs(), but into a fixed span of memory, such as a shared memory segment.
+     * \param p_data The span.
+     * \param p_capacity Size of the span in bytes.
+     * \return Number of bytes of the span used.
+     * \throw -1 integer exception if there is an error, including a save that does not fit in the span.
+    */
+    uint64_t save_all_objs(unsigned char *__restrict__ const p_data, const uint64_t p_capacity);
+
+    /**
+     * Saves all WY_SerializeObj objects like save_all_objs(), but writes the file on a background thread. WY_SerializeObj::get_save_data() is called on every object before this returns, and the data is copied unless WY_SerializeObj::is_save_data_stable() returns true, so the objects may change as soon as this returns. Encoding and writing the file then happen on the background thread with the settings at the time of the call. Saves run one at a time in the order they are started, and the destructor waits for any that are pending.
+     * \param p_file Name of the file to save to.
+     * \param p_callback Optional function called on the background thread when the save completes, with 0 if the file was saved or -1 if there was an error. Must not throw.
+     * \return A future that becomes ready with the same status once the save completes.
+     * \throw -1 integer exception if the data cannot be captured or the background thread cannot be started.
+    */
+    std::future<int> save_all_objs_async(const char *__restrict__ const p_file, const std::function<void(const int)> &p_callback = nullptr);
+
+    /**
+     * Saves all objects like save_all_objs(), but splits them over several shard files that are written concurrently, one thread each, so a checkpoint can use the bandwidth of several disks. Objects are spread so the shards hold about the same number of bytes. Each shard is an ordinary save file with the settings of this WY_SerializeMgr, named after the manifest with a generation number and the shard number, such as "dir/ckpt.3.0". <br>
+     * Once every shard is written, the manifest p_manifest is replaced atomically. It lists the shard files and which objects each one holds, and load_all_objs() recognises it and loads the shards in parallel. The manifest is the commit point: the shards of the previous save are only removed after it is replaced, so with SAVE_DURABILITY_FULL a crash leaves either the previous save or the new one.
+     * \param p_manifest Name of the manifest file.
+     * \param p_dirs Directories of the shard files, one per shard, for example one on each disk. Relative directories are stored as given, so they are relative to the working directory when loading.
+     * \param p_count Number of entries in p_dirs. At least 1.
+     * \throw -1 integer exception if there is an error. The shards written so far are removed and the previous save is left as it was.
+    */
+    void save_all_objs_sharded(const char *__restrict__ const p_manifest, const char *const *__restrict__ const p_dirs, const unsigned int p_count);
+
+    /**
+     * Loads all content from the save file into WY_SerializeObj objects added to the WY_SerializeMgr. If the objects were added without a key this is done in the exact same sequence where WY_SerializeObj objects are added. So the sequence where the objects are loaded must match the sequence where they are saved. <br>
+     * If the objects were added with a type and instance, every block in the file is given to the object with the same type and instance instead, in any order. Blocks without an object are skipped, and objects without a block keep their data. <br>
+     * If p_file is a log file written by save_changed_objs() or a manifest written by save_all_objs_sharded(), it is recognised and loaded as such. The shards of a manifest are read concurrently, one thread each, and their objects are then loaded like the blocks of one file.
      * \param p_file Name of the file to load from.
-     * \throw -1 integer exception if there is an error - usually a file IO error. An easy way to debug is to call the global static function set_debug_print(true);
+     * \throw -1 integer exception if there is an error - usually a file IO error, or WY_SerializeObj::get_load_data() of an object failing. An easy way to debug is to call the global static function set_debug_print(true);
     */
     void load_all_objs(const char *__restrict__ const p_file);
 
     /**
-     * Adds a WY_SerializeObj to be managed by this WY_SerializeMgr. Only the pointer to the WY_SerializeObj object is copied, so deallocation of the original object needs to be handled separately. 
+     * Loads all objects like load_all_objs(), but from a memory region holding the bytes of a save file or log file, such as one saved into a buffer by save_all_objs(). Whatever mode is set with set_load_mode(), the blocks are given to the objects in place, so nothing is copied. See WY_SerializeAgent::set_load_memory().
+     * \param p_data The region, which must not change until this returns.
+     * \param p_size Size of the region in bytes.
+     * \throw -1 integer exception if there is an error.
+    */
+    void load_all_objs(const unsigned char *__restrict__ const p_data, const uint64_t p_size);
+
+    /**
+     * Saves the WY_SerializeObj objects that changed to a log file. The blocks of the objects whose WY_SerializeObj::is_dirty() returns true are appended to the file, followed by a commit record listing which objects they belong to, and WY_SerializeObj::clear_dirty() is then called on them. If p_file does not exist or is not a log file, a new log with all objects is written. <br>
+     * load_all_objs() recognises log files and loads the newest committed block of every object. Blocks of a save that was interrupted before its commit record are ignored, and dropped by the next call. Objects are identified by the order they are added in, which must stay the same. Call compact_log_file() from time to time to drop old blocks.
+     * \param p_file Name of the log file.
+     * \throw -1 integer exception if there is an error - usually a file IO error or a corrupt log file.
+    */
+    void save_changed_objs(const char *__restrict__ const p_file);
+
+    /**
+     * Rewrites a log file written by save_changed_objs() so it only has the newest block of every object, in one commit. The objects are not needed, the blocks are copied from the log. The new log is written next to p_file and then renamed over it, so p_file is never left half written. Blocks are re-encoded with the codec and CRC settings of this WY_SerializeMgr.
+     * \param p_file Name of the log file.
+     * \throw -1 integer exception if there is an error.
+    */
+    void compact_log_file(const char *__restrict__ const p_file);
+
+    /**
+     * Loads a single object from a save file written with set_save_index(true). The block is found through the block index, so the blocks in front of it are not read. 
+     * \param p_file Name of the file to load from.
+     * \param p_type The SERIALIZE_TYPE of the block to load. The first block of this type in the file is loaded.
+     * \param p_obj The object to load the block into. It does not need to be added to this WY_SerializeMgr.
+     * \throw -1 integer exception if there is an error - usually a file IO error, a file without a block index or no block of type p_type.
+    */
+    void load_obj_by_type(const char *__restrict__ const p_file, const unsigned int p_type, WY_SerializeObj *__restrict__ const p_obj);
+
+    /**
+     * Loads a subset of objects from a save file written with set_save_index(true). Same as load_obj_by_type() but the file and its index are only opened once.
+     * \param p_file Name of the file to load from.
+     * \param p_types Array of the SERIALIZE_TYPE of each block to load.
+     * \param p_objs Array of the objects to load each block into, in the same order as p_types.
+     * \param p_count Number of entries in p_types and p_objs.
+     * \throw -1 integer exception if there is an error - usually a file IO error, a file without a block index or a type that is not in the file.
+    */
+    void load_objs_by_type(const char *__restrict__ const p_file, const unsigned int *__restrict__ const p_types, WY_SerializeObj *const *__restrict__ const p_objs, const unsigned int p_count);
+
+    /**
+     * Adds a WY_SerializeObj to be managed by this WY_SerializeMgr. Only the pointer to the WY_SerializeObj object is copied, so deallocation of the original object needs to be handled separately. Objects added this way are loaded in the order they are added.
      * \param p_obj A WY_SerializeObj to be managed by this WY_SerializeMgr.
-     * \return 0 if no error. -1 if error - usually caused by insufficient space allocated to this WY_SerializeMgr object.
+     * \return 0 if no error. -1 if error - memory allocation failed or objects were added with a key.
     */
     int add_serialize_obj(WY_SerializeObj *__restrict__ const p_obj) noexcept;
 
+    /**
+     * Adds a WY_SerializeObj with a key of a type and an instance. load_all_objs() then finds the block of every object by its key, so objects can be added in any order and the set of objects may differ from the one that was saved. Objects are looked up in a hash table, so this scales to large numbers of objects. <br>
+     * The block of the object is saved with p_type, whatever type its get_save_data() returns, and with p_instance if it is not 0. Files saved with keys can only be loaded with keys, unless every instance is 0. Log files written by save_changed_objs() still identify objects by the order they are added in.
+     * \param p_obj A WY_SerializeObj to be managed by this WY_SerializeMgr.
+     * \param p_type The SERIALIZE_TYPE of the object. Must not be SERIALIZE_TYPE_LOG or SERIALIZE_TYPE_MANIFEST.
+     * \param p_instance Tells apart objects of the same type, for example an entity ID. 0 for a type with a single object.
+     * \return 0 if no error. -1 if error - the key was already added, objects were added without a key or memory allocation failed.
+    */
+    int add_serialize_obj(WY_SerializeObj *__restrict__ const p_obj, const unsigned int p_type, const uint32_t p_instance) noexcept;
+
+    /**
+     * Finds an object added with a key.
+     * \param p_type The SERIALIZE_TYPE of the object.
+     * \param p_instance The instance of the object.
+     * \return The object, NULL if no object was added with this key.
+    */
+    WY_SerializeObj * find_serialize_obj(const unsigned int p_type, const uint32_t p_instance) const noexcept;
+
+    /**
+     * Sets the mode used by load_all_objs() to bring the save file into memory. See WY_SerializeAgent::set_load_mode().
+     * \param p_mode The LOAD_MODE to use. Defaults to LOAD_BUFFERED.
+    */
+    void set_load_mode(const LOAD_MODE p_mode) noexcept;
+
+    /**
+     * Sets the mode used by save_all_objs() to write the save file. See WY_SerializeAgent::set_save_mode(). In SAVE_VECTORED mode the data returned by WY_SerializeObj::get_save_data() must stay valid until save_all_objs() returns.
+     * \param p_mode The SAVE_MODE to use. Defaults to SAVE_STREAM.
+    */
+    void set_save_mode(const SAVE_MODE p_mode) noexcept;
+
+    /**
+     * Sets the I/O backend of every save and load, so large checkpoints can be written through io_uring or bypass the page cache. See WY_SerializeAgent::set_io_backend().
+     * \param p_backend The IO_BACKEND to use. Defaults to IO_BACKEND_DEFAULT.
+    */
+    void set_io_backend(const IO_BACKEND p_backend) noexcept;
+
+    /**
+     * Sets whether save_all_objs() writes a block index at the end of the save file. The index is needed by load_obj_by_type() and load_objs_by_type(). See WY_SerializeAgent::set_save_index().
+     * \param p_index True to write the index. Defaults to false.
+    */
+    void set_save_index(const bool p_index) noexcept;
+
+    /**
+     * Sets the codec used by save_all_objs() to compress blocks. With more than 1 thread blocks are encoded concurrently. See WY_SerializeAgent::set_codec().
+     * \param p_codec The codec, which must outlive this WY_SerializeMgr or the next call to set_codec(). NULL (default) stores all blocks raw.
+     * \param p_min_size Blocks with less data than this are not encoded. Defaults to 256.
+    */
+    void set_codec(const WY_SerializeCodec *__restrict__ const p_codec, const uint64_t p_min_size = 256) noexcept;
+
+    /**
+     * Sets whether save_all_objs() stores a CRC32C with every block. load_all_objs() then throws if a block does not match its CRC. See WY_SerializeAgent::set_save_crc().
+     * \param p_crc True to store CRCs. Defaults to false.
+    */
+    void set_save_crc(const bool p_crc) noexcept;
+
+    /**
+     * Sets whether saves write compact block headers, which makes files of many small blocks much smaller. Files in both formats are loaded the same way, and save_changed_objs() keeps the format of an existing log. See WY_SerializeAgent::set_save_compact().
+     * \param p_compact True for compact headers. Defaults to false.
+    */
+    void set_save_compact(const bool p_compact) noexcept;
+
+    /**
+     * Sets the alignment of block data in saved files, so objects that load from views can use trivially copyable data in place. save_changed_objs() keeps the alignment of an existing log. See WY_SerializeAgent::set_save_alignment().
+     * \param p_alignment Alignment in bytes, such as 8, 16 or 64. Defaults to 1, which writes no padding.
+    */
+    void set_save_alignment(const unsigned int p_alignment) noexcept;
+
+    /**
+     * Sets whether save_all_objs() and save_all_objs_async() replace the save file atomically, so a failed or interrupted save leaves the previous file intact. save_changed_objs() appends in place and relies on its commit records instead, and compact_log_file() is always atomic. See WY_SerializeAgent::set_save_atomic().
+     * \param p_atomic True to replace the file atomically. Defaults to false.
+    */
+    void set_save_atomic(const bool p_atomic) noexcept;
+
+    /**
+     * Sets how far every save flushes the file to storage before it completes. See WY_SerializeAgent::set_save_durability().
+     * \param p_durability One of SAVE_DURABILITY. Defaults to SAVE_DURABILITY_NONE.
+    */
+    void set_save_durability(const SAVE_DURABILITY p_durability) noexcept;
+
+    /**
+     * Sets the number of threads used by save_all_objs() and load_all_objs(). With more than 1 thread, WY_SerializeObj::get_save_data() is called concurrently on the objects, so it must be safe to call on different objects at the same time. The blocks are then written with positional writes in any order, but the file is identical to one saved with 1 thread. <br>
+     * When loading, the block of every object is located first and WY_SerializeObj::get_load_data() is then called concurrently on all objects whose WY_SerializeObj::is_load_thread_safe() returns true. The other objects are loaded afterwards on the calling thread. Loading in LOAD_STREAM mode always uses 1 thread.
+     * \param p_threads Number of threads, including the calling thread. Defaults to 1. 0 is treated as 1.
+    */
+    void set_thread_count(const unsigned int p_threads) noexcept;
+
 private:
-    unsigned int m_serializeobj_array_size; /**< Max size of the number of WY_SerializeObj supported. */
-    unsigned int m_serializeobj_array_offset; /**< Current offset of the WY_SerializeObj array. */
+    /**
+     * Implements save_all_objs() to a file or to memory.
+     * \param p_agent Agent with the file or memory to save to set.
+     * \throw -1 integer exception if there is an error.
+    */
+    void save_objs(WY_SerializeAgent *__restrict__ const p_agent);
+
+    /**
+     * Implements save_objs() when more than 1 thread is set with set_thread_count().
+     * \param p_agent Agent with the file or memory to save to set.
+     * \throw -1 integer exception if there is an error.
+    */
+    void save_all_objs_parallel(WY_SerializeAgent *__restrict__ const p_agent);
+
+    /**
+     * Implements load_all_objs() from a file or from memory that is not a log file.
+     * \param p_agent Agent with the file or memory to load from and the load mode set.
+     * \param p_mode The load mode set on p_agent.
+     * \throw -1 integer exception if there is an error.
+    */
+    void load_objs(WY_SerializeAgent *__restrict__ const p_agent, const LOAD_MODE p_mode);
+
+    /**
+     * Implements load_objs() when more than 1 thread is set with set_thread_count().
+     * \param p_agent Agent with the file or memory to load from and the load mode set.
+     * \throw -1 integer exception if there is an error.
+    */
+    void load_all_objs_parallel(WY_SerializeAgent *__restrict__ const p_agent);
+
+    /**
+     * Calls WY_SerializeObj::get_load_data() of every object with its block, concurrently if more than 1 thread is set with set_thread_count().
+     * \param p_views The block of every object, in registration order. Objects whose view has the type SERIALIZE_TYPE_LOG have no block and are skipped.
+     * \throw -1 integer exception if get_load_data() of an object fails, after all objects have been given their data.
+    */
+    void load_views(const std::vector<S_SerializeView> &p_views);
+
+    struct S_ShardManifest; /**< The content of a manifest written by save_all_objs_sharded(), defined in the implementation. */
+
+    /**
+     * Implements load_all_objs() for manifests written by save_all_objs_sharded().
+     * \param p_file Name of the manifest.
+     * \throw -1 integer exception if there is an error, or the shards do not hold exactly one block of every object added without a key.
+    */
+    void load_sharded_objs(const char *__restrict__ const p_file);
+
+    /**
+     * Reads a manifest written by save_all_objs_sharded().
+     * \param p_file Name of the manifest.
+     * \param p_manifest Returns its content.
+     * \throw -1 integer exception if the file cannot be read or is not a valid manifest.
+    */
+    void read_manifest(const char *__restrict__ const p_file, S_ShardManifest *__restrict__ const p_manifest);
+
+    /**
+     * Writes a manifest atomically, replacing p_file.
+     * \param p_file Name of the manifest.
+     * \param p_manifest Its content.
+     * \throw -1 integer exception if there is an error.
+    */
+    void write_manifest(const char *__restrict__ const p_file, const S_ShardManifest &p_manifest);
+
+    /**
+     * Implements load_all_objs() for log files written by save_changed_objs().
+     * \param p_agent Agent with the file or memory to load from and the load mode set.
+     * \param p_mode The load mode set on p_agent.
+     * \return File offset of the end of the last commit record.
+     * \throw -1 integer exception if there is an error, or an object has no block in the log.
+    */
+    uint64_t load_log_objs(WY_SerializeAgent *__restrict__ const p_agent, const LOAD_MODE p_mode);
+
+    /**
+     * Reads a log file up to its last complete commit record and finds the newest block of every object. Each block and commit record returned by the agent counts as one ordinal, starting at 0. <br>
+     * A commit record that names a slot at or above p_slot_count, or at or above the number of blocks before it, is treated as the end of the log like any other corrupt record, so a corrupt slot cannot make p_newest huge. Objects start out dirty, so save_changed_objs() never commits a slot before every lower slot has a block.
+     * \param p_agent Agent that has just loaded the log file.
+     * \param p_slot_count Number of object slots, or UINT32_MAX if the objects are not known.
+     * \param p_newest Returns the ordinal of the newest block of every object slot. UINT64_MAX for slots without a block.
+     * \param p_views If not NULL, returns the newest block of every object slot. Must be NULL if the agent is in LOAD_STREAM mode.
+     * \return File offset of the end of the last commit record.
+     * \throw -1 integer exception if the file is not a log file or there is an error.
+    */
+    uint64_t read_log(WY_SerializeAgent *__restrict__ const p_agent, const uint32_t p_slot_count, std::vector<uint64_t> *__restrict__ const p_newest, std::vector<S_SerializeView> *__restrict__ const p_views);
+
+    /**
+     * Inverts the result of read_log() for the first p_count object slots.
+     * \param p_newest The ordinal of the newest block of every slot.
+     * \param p_count Number of slots, all of which must have a block.
+     * \return For every ordinal up to the last one needed, the slot whose newest block it is. UINT32_MAX for other ordinals.
+     * \throw -1 integer exception if a slot has no block or there is an error.
+    */
+    static std::vector<uint32_t> get_log_slots(const std::vector<uint64_t> &p_newest, const size_t p_count);
+
+    /**
+     * Appends a commit record to a log file.
+     * \param p_agent Agent with the log file open for saving.
+     * \param p_slots The object slots of the blocks appended since the last commit record, in order.
+     * \param p_record Buffer for the record. Must stay valid until the file is finalised.
+     * \throw -1 integer exception if there is an error.
+    */
+    static void append_log_record(WY_SerializeAgent *__restrict__ const p_agent, const std::vector<uint32_t> &p_slots, std::vector<unsigned char> *__restrict__ const p_record);
+
+    /**
+     * Checks if a file starts with a commit record, so it is a log file written by save_changed_objs().
+     * \param p_file Name of the file.
+     * \return True if the file is a log file.
+    */
+    static bool is_log_file(const char *__restrict__ const p_file) noexcept;
+
+    /**
+     * Checks if the first bytes of a file are a commit record, like is_log_file().
+     * \param p_data The start of the file.
+     * \param p_size Bytes at p_data.
+     * \return True if the file is a log file.
+    */
+    static bool is_log_data(const unsigned char *__restrict__ const p_data, const uint64_t p_size) noexcept;
+
+    /**
+     * Gets the type of the first block of a file, which tells log files and manifests from other save files.
+     * \param p_file Name of the file.
+     * \return The type. 0 if the file cannot be read or has no block.
+    */
+    static uint32_t get_first_block_type(const char *__restrict__ const p_file) noexcept;
+
+    /**
+     * Gets the type of the first block of a file in memory, like get_first_block_type().
+     * \param p_data The start of the file.
+     * \param p_size Bytes at p_data.
+     * \return The type. 0 if there is no complete block header.
+    */
+    static uint32_t get_first_block_type(const unsigned char *__restrict__ const p_data, const uint64_t p_size) noexcept;
+
+    /**
+     * Finds the end of the last commit record in a log file. Uses m_log_end if p_file is m_log_file and its size is still m_log_end, else reads the log.
+     * \param p_file Name of the file.
+     * \param p_end Returns the file offset of the end of the last commit record.
+     * \return False if p_file does not exist or is not a log file.
+     * \throw -1 integer exception if there is an error reading the log.
+    */
+    bool find_log_end(const char *__restrict__ const p_file, uint64_t *__restrict__ const p_end);
+
+    /**
+     * Records the size of a log file that was just written in m_log_file and m_log_end.
+     * \param p_file Name of the file.
+    */
+    void set_log_end(const char *__restrict__ const p_file) noexcept;
+
+    struct S_AsyncSave; /**< A save started by save_all_objs_async(), defined in the implementation. */
+
+    /**
+     * Body of m_async_thread. Runs the saves queued in m_async_jobs until m_async_stop is set and the queue is empty.
+    */
+    void run_async_saves() noexcept;
+
+    /**
+     * Gets the save data of an object. If objects were added with a key, the type and instance of the data are set from the key.
+     * \param p_slot Index of the object in m_serializeobj_array.
+     * \param p_data Returns the data to be saved.
+    */
+    void get_obj_save_data(const unsigned int p_slot, S_SerializeData *__restrict__ const p_data) noexcept;
+
+    /**
+     * Makes the key of an object from its type and instance.
+     * \param p_type The SERIALIZE_TYPE of the object.
+     * \param p_instance The instance of the object.
+     * \return The key.
+    */
+    static uint64_t get_obj_key(const unsigned int p_type, const uint32_t p_instance) noexcept
+    {
+        return ((uint64_t)p_type << 32) | p_instance;
+    }
+
+    /**
+     * Creates m_thread_pool with m_thread_count threads if it does not exist or has a different number of threads.
+     * \throw -1 integer exception if there is an error.
+    */
+    void prepare_thread_pool();
+
+    LOAD_MODE m_load_mode; /**< The LOAD_MODE passed to the WY_SerializeAgent when loading. */
+    SAVE_MODE m_save_mode; /**< The SAVE_MODE passed to the WY_SerializeAgent when saving. */
+    IO_BACKEND m_io_backend; /**< The IO_BACKEND passed to the WY_SerializeAgent when saving and loading. */
+    bool m_save_index; /**< Whether save_all_objs() writes a block index. */
+    const WY_SerializeCodec * m_codec; /**< Codec used by save_all_objs(). NULL if blocks are stored raw. */
+    uint64_t m_codec_min_size; /**< Blocks smaller than this are not encoded. */
+    bool m_save_crc; /**< Whether save_all_objs() stores a CRC32C with every block. */
+    bool m_save_compact; /**< Whether saves write compact block headers. */
+    unsigned int m_save_alignment; /**< Alignment of block data in saved files. */
+    bool m_save_atomic; /**< Whether save_all_objs() replaces the save file atomically. */
+    SAVE_DURABILITY m_save_durability; /**< How far saves are flushed to storage. */
+    unsigned int m_thread_count; /**< Number of threads used to save and load. */
+    WY_ThreadPool * m_thread_pool; /**< Created when first needed with m_thread_count threads. */
+    std::thread m_async_thread; /**< Background thread of save_all_objs_async(). Started on first use. */
+    std::mutex m_async_mutex; /**< Protects m_async_jobs, m_async_stop and m_async_spare. */
+    std::condition_variable m_async_cv; /**< Wakes m_async_thread when a save is queued or it must stop. */
+    std::deque<std::shared_ptr<S_AsyncSave>> m_async_jobs; /**< Saves waiting for m_async_thread. */
+    bool m_async_stop; /**< Set by the destructor to end m_async_thread. */
+    std::unique_ptr<unsigned char[]> m_async_spare; /**< Copy buffer of a completed save, reused by the next one. */
+    uint64_t m_async_spare_size; /**< Size of m_async_spare. */
+    std::string m_log_file; /**< Log file last saved or loaded. Empty if none. */
+    uint64_t m_log_end; /**< End of the last commit record in m_log_file, which is its size unless it was loaded with a torn tail. */
     std::string m_file_name; /**< The current file that is being processed. */
-    WY_SerializeObj ** m_serializeobj_array; /**< The array of pointers to WY_SerializeObj. */
+    std::vector<WY_SerializeObj *> m_serializeobj_array; /**< The array of pointers to WY_SerializeObj, in the order they were added. */
+    std::vector<uint64_t> m_serializeobj_keys; /**< Key of every object in m_serializeobj_array, from get_obj_key(). Empty if the objects were added without a key. */
+    std::unordered_map<uint64_t, uint32_t> m_serializeobj_slots; /**< Index in m_serializeobj_array of the object of every key. */
 };
 }
 
@@ -17,6 +17,7 @@
 #ifndef _WY_SERIALIZE_OBJ_HPP_
 #define _WY_SERIALIZE_OBJ_HPP_
 
+#include <climits>
 #include "WY_SerializeDef.hpp"
 #pragma once
 namespace WY_Serialize
@@ -41,13 +42,49 @@ public:
     virtual int get_save_data(S_SerializeData *__restrict__ const p_data) noexcept {return -1;};
     
     /** 
-     * Virtual function that gets the data that is loaded from file.
+     * Virtual function that gets the data that is loaded from file. Override this for blocks of less than 4 GB, or the uint64_t overload for larger ones.
      * \param p_size Size of the data that is loaded.
      * \param p_data The loaded data.
      * \return 0 if no error, non-zero if error.
     */     
     virtual int get_load_data(const unsigned int p_size, const unsigned char *__restrict__ const p_data) noexcept {return -1;};
 
+    /** 
+     * Virtual function that gets the data that is loaded from file, with a 64-bit size. This is the one WY_SerializeMgr calls. Unless overridden, it passes blocks that fit in an unsigned int to the unsigned int overload, and fails for larger ones.
+     * \param p_size Size of the data that is loaded.
+     * \param p_data The loaded data.
+     * \return 0 if no error, non-zero if error.
+    */     
+    virtual int get_load_data(const uint64_t p_size, const unsigned char *__restrict__ const p_data) noexcept
+    {
+        if(p_size > UINT_MAX) /* Would be truncated. */
+            return -1;
+        return get_load_data((unsigned int)p_size, p_data);
+    };
+
+    /**
+     * Virtual function that tells WY_SerializeMgr whether get_load_data() may run on a worker thread at the same time as get_load_data() of other objects. Override to return false for objects that are not thread-safe, their data is then loaded on the calling thread.
+     * \return True if get_load_data() is thread-safe. Defaults to true.
+    */
+    virtual bool is_load_thread_safe() noexcept {return true;};
+
+    /**
+     * Virtual function that tells WY_SerializeMgr::save_all_objs_async() whether the data returned by get_save_data() stays valid and unchanged until the save completes. Such data is written from the object's memory, other data is copied before save_all_objs_async() returns.
+     * \return True if the save data need not be copied. Defaults to false.
+    */
+    virtual bool is_save_data_stable() noexcept {return false;};
+
+    /**
+     * Virtual function that tells WY_SerializeMgr::save_changed_objs() whether the object changed since its data was last saved. Override together with clear_dirty() to have the object skipped by incremental saves while it is unchanged. Objects should start out dirty.
+     * \return True if the object must be saved. Defaults to true, so objects without change tracking are saved every time.
+    */
+    virtual bool is_dirty() noexcept {return true;};
+
+    /**
+     * Virtual function called by WY_SerializeMgr::save_changed_objs() once the data of the object is saved, so the object can reset its change tracking.
+    */
+    virtual void clear_dirty() noexcept {};
+
     /**
      * Virtual function to check the serializable data. Specific to implementation, so this can be ignored if so desired.
      * \return 0 iff no error. Non-zero if error.
@@ -0,0 +1,149 @@
+/*
+* Copyright 2023 Au Yeong Wing Yau
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+#ifndef _WY_SERIALIZE_POD_HPP_
+#define _WY_SERIALIZE_POD_HPP_
+
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include "WY_SerializeObj.hpp"
+#pragma once
+namespace WY_Serialize
+{
+
+/**
+ * Base class for objects whose data is one trivially copyable struct. It implements get_save_data() and get_load_data() at compile time: the struct is saved as one block of type TYPE and loaded with a copy of a constant size, after checking the block has that size.
+ * 
+ * D is the derived class (CRTP). It can define any of the following functions, which are called without virtual dispatch:
+ * - int on_pod_loaded() noexcept: called after a block is copied into m_data, for example to check or fix up the values. Returns 0 if the data is valid. Defaults to accepting any data.
+ * 
+ * The struct is saved as it is in memory, so it must not contain pointers, and files can only be loaded on machines with the same byte order and struct layout. Arrays of numbers that must load on other machines are saved with WY_ByteOrder instead. <br>
+ * Files saved with WY_SerializeAgent::set_save_alignment() of at least alignof(T) can be read without any copy: view_pod() and view_pod_array() return the loaded data of a view as the struct in place. <br>
+ * <br>
+ * Usage: <br>
+ * @code
+ * struct S_Position { double m_x; double m_y; };
+ * class Position: public WY_SerializePod<Position, S_Position, POSITION> {}; 
+ * 
+ * Position pos; 
+ * mgr.add_serialize_obj(&pos); 
+ * @endcode
+ * \tparam D The derived class.
+ * \tparam T The struct holding the data of the object. Must be trivially copyable.
+ * \tparam TYPE Block type of the object, from enum SERIALIZE_TYPE.
+ */
+template <typename D, typename T, unsigned int TYPE>
+class WY_SerializePod: public WY_SerializeObj
+{
+    static_assert(std::is_trivially_copyable<T>::value, "WY_SerializePod needs a trivially copyable type.");
+
+public:
+    static constexpr unsigned int m_serialize_type = TYPE; /**< Block type of the object. */
+    static constexpr uint64_t m_serialize_size = sizeof(T); /**< Size of the block data of the object. */
+
+    /**
+     * Describes a struct as save data. Usable without an object, for example with WY_SerializeAgent::append_save_file().
+     * \param p_pod The struct, which must stay valid until it is saved.
+     * \param p_data Returns the data to be saved.
+    */
+    static void save_pod(const T &p_pod, S_SerializeData *__restrict__ const p_data) noexcept
+    {
+        p_data->m_type = TYPE;
+        p_data->m_size = sizeof(T);
+        p_data->m_data = (unsigned char *)&p_pod;
+    }
+
+    /**
+     * Copies loaded data into a struct if it has the size of the struct. Usable without an object.
+     * \param p_pod The struct to load into. Unchanged if the size does not match.
+     * \param p_size Size of the loaded data.
+     * \param p_data The loaded data.
+     * \return 0 if the data was copied, -1 if the size does not match.
+    */
+    static int load_pod(T *__restrict__ const p_pod, const uint64_t p_size, const unsigned char *__restrict__ const p_data) noexcept
+    {
+        if(p_size != sizeof(T))
+            return -1;
+        memcpy((void *)p_pod, p_data, sizeof(T)); /* Constant size, so this compiles to a few moves for small structs. */
+        return 0;
+    }
+
+    /**
+     * Gets loaded data as the struct in place, without copying it. Usable without an object, for example with WY_SerializeAgent::load_next_serializable_view().
+     * \param p_size Size of the loaded data.
+     * \param p_data The loaded data.
+     * \return The struct, valid as long as p_data is. NULL if the size does not match or p_data is not aligned for T.
+    */
+    static const T * view_pod(const uint64_t p_size, const unsigned char *__restrict__ const p_data) noexcept
+    {
+        if((p_size != sizeof(T)) || (((uintptr_t)p_data & (alignof(T)-1)) != 0))
+            return NULL;
+        return reinterpret_cast<const T *>(p_data);
+    }
+
+    /**
+     * Gets loaded data as an array of the struct in place, for example a lookup table saved as one block. Usable without an object.
+     * \param p_size Size of the loaded data.
+     * \param p_data The loaded data.
+     * \param p_count Returns the number of structs in the array.
+     * \return The first struct, valid as long as p_data is. NULL if the size is not a multiple of the struct size or p_data is not aligned for T.
+    */
+    static const T * view_pod_array(const uint64_t p_size, const unsigned char *__restrict__ const p_data, uint64_t *__restrict__ const p_count) noexcept
+    {
+        if((p_size % sizeof(T) != 0) || (((uintptr_t)p_data & (alignof(T)-1)) != 0))
+            return NULL;
+        *p_count = p_size / sizeof(T);
+        return reinterpret_cast<const T *>(p_data);
+    }
+
+    /**
+     * Implements the WY_SerializeObj virtual function by saving m_data.
+     * \param p_data Returns the data to be saved.
+     * \return 0.
+    */
+    int get_save_data(S_SerializeData *__restrict__ const p_data) noexcept final
+    {
+        save_pod(m_data, p_data);
+        return 0;
+    }
+
+    /**
+     * Implements the WY_SerializeObj virtual function by copying the data into m_data and calling D::on_pod_loaded().
+     * \param p_size Size of the loaded data.
+     * \param p_data The loaded data.
+     * \return 0 if successful, -1 if the size does not match or on_pod_loaded() fails.
+    */
+    int get_load_data(const uint64_t p_size, const unsigned char *__restrict__ const p_data) noexcept final
+    {
+        if(load_pod(&m_data, p_size, p_data) != 0)
+            return -1;
+        return (static_cast<D *>(this)->on_pod_loaded() == 0) ? 0 : -1;
+    }
+
+    /**
+     * Called after data is loaded into m_data. D can define its own version to check or fix up the data.
+     * \return 0.
+    */
+    int on_pod_loaded() noexcept {return 0;};
+
+protected:
+    T m_data{}; /**< The data of the object. */
+};
+}
+
+#endif
@@ -0,0 +1,417 @@
+/*
+* Copyright 2023 Au Yeong Wing Yau
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <exception>
+#include <map>
+#include <mutex>
+#include "WY_SerializeStats.hpp"
+using namespace WY_Serialize;
+
+std::atomic<unsigned int> WY_SerializeStats::m_flags(0);
+
+namespace {
+
+/**
+ * Counters of one thread. Only the thread using them changes them, with a relaxed load and store instead of an atomic add, so counting costs about as much as with plain integers. get_stats() only reads them.
+ */
+struct S_ThreadStats {
+    std::atomic<uint64_t> m_type_keys[SERIALIZE_STATS_TYPES_MAX]; /**< Block type of each row of m_types plus 1. 0 if the row is unused. */
+    std::atomic<uint64_t> m_types[SERIALIZE_STATS_TYPES_MAX+1][6]; /**< Counters of each block type in the order of S_SerializeTypeStats. The last row counts the other types. */
+    std::atomic<uint64_t> m_io_calls[STATS_IO_COUNT]; /**< See S_SerializeStats::m_io_calls. */
+    std::atomic<uint64_t> m_latency_total_ns[STATS_LATENCY_COUNT]; /**< See S_SerializeStats::m_latency_total_ns. */
+    std::atomic<uint64_t> m_latency[STATS_LATENCY_COUNT][SERIALIZE_STATS_BUCKETS]; /**< See S_SerializeStats::m_latency. */
+};
+
+/**
+ * Counters of all threads. Counters of a thread that exits are handed to the next new thread instead of being freed, so their counts stay included and memory is bounded by the most threads alive at once.
+ */
+struct S_Registry {
+    std::mutex m_mutex; /**< Protects the members. */
+    std::vector<S_ThreadStats *> m_all; /**< Every S_ThreadStats ever created. */
+    std::vector<S_ThreadStats *> m_free; /**< Counters of threads that have exited. */
+    S_SerializeStats m_baseline; /**< Counters at the last reset_stats(), subtracted by get_stats(). */
+};
+
+/**
+ * Gets the registry. It is never destroyed, as threads may exit after static objects are destroyed.
+ */
+S_Registry & get_registry()
+{
+    static S_Registry * registry = new S_Registry();
+    return *registry;
+}
+
+/**
+ * Returns the counters of a thread to the registry when the thread exits.
+ */
+struct S_ThreadExit {
+    S_ThreadStats * m_stats = NULL; /**< Counters of the thread. */
+
+    ~S_ThreadExit()
+    {
+        if(m_stats == NULL)
+            return;
+        S_Registry &registry = get_registry();
+        std::lock_guard<std::mutex> lock(registry.m_mutex);
+        registry.m_free.push_back(m_stats); /* Cannot fail, capacity is reserved when the counters are created. */
+    }
+};
+
+/* Plain pointers are read without the initialisation check that thread_local objects with a destructor need on every access. */
+thread_local S_ThreadStats * thread_stats = NULL; /**< Counters of the calling thread. NULL until first used. */
+thread_local uint32_t thread_number = 0; /**< Number of the calling thread in the trace plus 1. 0 until first used. */
+thread_local S_ThreadExit thread_exit; /**< Only touched when the counters of the thread are taken. */
+std::atomic<uint32_t> thread_count(0); /**< Threads that have recorded statistics or events. */
+
+/**
+ * An entry of the trace ring. m_seq is the position of the event in the trace plus 1 once the event is written, and 0 while it is being written.
+ */
+struct S_TraceSlot {
+    std::atomic<uint64_t> m_seq;
+    std::atomic<uint64_t> m_time_ns;
+    std::atomic<uint64_t> m_value;
+    std::atomic<uint64_t> m_info; /**< Block type in bits 0-31, event in bits 32-39, thread in bits 40-63. */
+};
+
+S_TraceSlot trace_ring[SERIALIZE_TRACE_SIZE];
+std::atomic<uint64_t> trace_head(0); /**< Position of the next event in the trace. */
+
+const char * const trace_names[] = {"save_begin", "save_end", "load_begin", "load_end", "block_write", "block_read"};
+
+/**
+ * Adds to a counter that only the calling thread changes.
+ */
+inline void add_counter(std::atomic<uint64_t> &p_counter, const uint64_t p_value) noexcept
+{
+    p_counter.store(p_counter.load(std::memory_order_relaxed) + p_value, std::memory_order_relaxed);
+}
+
+/**
+ * Gets the number of the calling thread in the trace.
+ */
+uint32_t get_thread() noexcept
+{
+    if(thread_number == 0)
+        thread_number = thread_count.fetch_add(1, std::memory_order_relaxed) + 1;
+    return thread_number - 1;
+}
+
+/**
+ * Takes free counters for the calling thread, or creates them. Returns NULL if they cannot be allocated.
+ */
+S_ThreadStats * take_thread_stats() noexcept
+{
+    S_Registry &registry = get_registry();
+    std::lock_guard<std::mutex> lock(registry.m_mutex);
+    if(!registry.m_free.empty()) {
+        thread_stats = registry.m_free.back();
+        registry.m_free.pop_back();
+    } else {
+        try {
+            registry.m_all.reserve(registry.m_all.size()+1);
+            registry.m_free.reserve(registry.m_all.size()+1); /* So the thread can always give them back. */
+            S_ThreadStats * stats = new S_ThreadStats(); /* Value-initialised, so all counters start at 0. */
+            registry.m_all.push_back(stats);
+            thread_stats = stats;
+        } catch (std::exception &e) {
+            return NULL;
+        }
+    }
+    thread_exit.m_stats = thread_stats;
+    return thread_stats;
+}
+
+/**
+ * Gets the counters of the calling thread, taking them on first use. Returns NULL if they cannot be allocated.
+ */
+inline S_ThreadStats * get_thread_stats() noexcept
+{
+    if(thread_stats != NULL)
+        return thread_stats;
+    return take_thread_stats();
+}
+
+/**
+ * Gets the current time on the steady clock in ns.
+ */
+uint64_t get_time_ns() noexcept
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * Adds an event to the trace ring.
+ */
+void add_trace(const SERIALIZE_TRACE_EVENT p_event, const uint32_t p_type, const uint64_t p_value, const uint64_t p_time) noexcept
+{
+    const uint64_t pos = trace_head.fetch_add(1, std::memory_order_relaxed);
+    S_TraceSlot &slot = trace_ring[pos % SERIALIZE_TRACE_SIZE];
+
+    slot.m_seq.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release); /* Readers see the slot as busy before any field changes. */
+    slot.m_time_ns.store(p_time, std::memory_order_relaxed);
+    slot.m_value.store(p_value, std::memory_order_relaxed);
+    slot.m_info.store(p_type | ((uint64_t)p_event << 32) | ((uint64_t)get_thread() << 40), std::memory_order_relaxed);
+    slot.m_seq.store(pos+1, std::memory_order_release);
+}
+
+/**
+ * Adds the counters of a thread to a snapshot.
+ */
+void add_thread_stats(const S_ThreadStats &p_thread, std::map<uint32_t, S_SerializeTypeStats> *p_types, S_SerializeStats *p_stats)
+{
+    for(unsigned int row=0; row<=SERIALIZE_STATS_TYPES_MAX; row++) {
+        S_SerializeTypeStats * type;
+        if(row < SERIALIZE_STATS_TYPES_MAX) {
+            const uint64_t key = p_thread.m_type_keys[row].load(std::memory_order_acquire);
+            if(key == 0)
+                break; /* Rows are used in order. */
+            type = &(*p_types)[key-1];
+            type->m_type = key-1;
+        } else
+            type = &p_stats->m_other_types;
+        type->m_blocks_written += p_thread.m_types[row][0].load(std::memory_order_relaxed);
+        type->m_bytes_written += p_thread.m_types[row][1].load(std::memory_order_relaxed);
+        type->m_file_bytes_written += p_thread.m_types[row][2].load(std::memory_order_relaxed);
+        type->m_blocks_read += p_thread.m_types[row][3].load(std::memory_order_relaxed);
+        type->m_bytes_read += p_thread.m_types[row][4].load(std::memory_order_relaxed);
+        type->m_file_bytes_read += p_thread.m_types[row][5].load(std::memory_order_relaxed);
+    }
+    for(unsigned int i=0; i<STATS_IO_COUNT; i++)
+        p_stats->m_io_calls[i] += p_thread.m_io_calls[i].load(std::memory_order_relaxed);
+    for(unsigned int i=0; i<STATS_LATENCY_COUNT; i++) {
+        p_stats->m_latency_total_ns[i] += p_thread.m_latency_total_ns[i].load(std::memory_order_relaxed);
+        for(unsigned int j=0; j<SERIALIZE_STATS_BUCKETS; j++)
+            p_stats->m_latency[i][j] += p_thread.m_latency[i][j].load(std::memory_order_relaxed);
+    }
+}
+
+/**
+ * Subtracts the counters of one block type from another.
+ */
+void subtract_type_stats(S_SerializeTypeStats *p_to, const S_SerializeTypeStats &p_from) noexcept
+{
+    p_to->m_blocks_written -= p_from.m_blocks_written;
+    p_to->m_bytes_written -= p_from.m_bytes_written;
+    p_to->m_file_bytes_written -= p_from.m_file_bytes_written;
+    p_to->m_blocks_read -= p_from.m_blocks_read;
+    p_to->m_bytes_read -= p_from.m_bytes_read;
+    p_to->m_file_bytes_read -= p_from.m_file_bytes_read;
+}
+
+/**
+ * Sums the counters of all threads. The registry must be locked.
+ */
+void sum_stats(const S_Registry &p_registry, S_SerializeStats *p_stats)
+{
+    std::map<uint32_t, S_SerializeTypeStats> types;
+
+    memset(&p_stats->m_other_types, 0, sizeof(p_stats->m_other_types));
+    memset(p_stats->m_io_calls, 0, sizeof(p_stats->m_io_calls));
+    memset(p_stats->m_latency_total_ns, 0, sizeof(p_stats->m_latency_total_ns));
+    memset(p_stats->m_latency, 0, sizeof(p_stats->m_latency));
+    for(const S_ThreadStats * thread : p_registry.m_all)
+        add_thread_stats(*thread, &types, p_stats);
+    p_stats->m_types.clear();
+    p_stats->m_types.reserve(types.size());
+    for(const auto &type : types)
+        p_stats->m_types.push_back(type.second);
+}
+
+}
+
+
+void WY_SerializeStats::set_stats(const bool p_stats) noexcept
+{
+    if(p_stats)
+        m_flags.fetch_or(m_flag_stats, std::memory_order_relaxed);
+    else
+        m_flags.fetch_and(~m_flag_stats, std::memory_order_relaxed);
+}
+
+
+void WY_SerializeStats::set_trace(const bool p_trace) noexcept
+{
+    if(p_trace)
+        m_flags.fetch_or(m_flag_trace, std::memory_order_relaxed);
+    else
+        m_flags.fetch_and(~m_flag_trace, std::memory_order_relaxed);
+}
+
+
+void WY_SerializeStats::get_stats(S_SerializeStats *__restrict__ const p_stats)
+{
+    S_Registry &registry = get_registry();
+
+    try {
+        std::lock_guard<std::mutex> lock(registry.m_mutex);
+        sum_stats(registry, p_stats);
+        const S_SerializeStats &base = registry.m_baseline;
+        size_t j = 0;
+        for(S_SerializeTypeStats &type : p_stats->m_types) { /* Both are ordered by type, and types are never removed. */
+            while((j < base.m_types.size()) && (base.m_types[j].m_type < type.m_type))
+                ++j;
+            if((j < base.m_types.size()) && (base.m_types[j].m_type == type.m_type))
+                subtract_type_stats(&type, base.m_types[j]);
+        }
+        subtract_type_stats(&p_stats->m_other_types, base.m_other_types);
+        for(unsigned int i=0; i<STATS_IO_COUNT; i++)
+            p_stats->m_io_calls[i] -= base.m_io_calls[i];
+        for(unsigned int i=0; i<STATS_LATENCY_COUNT; i++) {
+            p_stats->m_latency_total_ns[i] -= base.m_latency_total_ns[i];
+            for(unsigned int k=0; k<SERIALIZE_STATS_BUCKETS; k++)
+                p_stats->m_latency[i][k] -= base.m_latency[i][k];
+        }
+    } catch (std::exception &e) {
+        throw -1;
+    }
+}
+
+
+void WY_SerializeStats::reset_stats()
+{
+    S_Registry &registry = get_registry();
+
+    try {
+        std::lock_guard<std::mutex> lock(registry.m_mutex);
+        sum_stats(registry, &registry.m_baseline);
+    } catch (std::exception &e) {
+        throw -1;
+    }
+}
+
+
+void WY_SerializeStats::get_trace(std::vector<S_SerializeTraceEvent> *__restrict__ const p_events)
+{
+    const uint64_t head = trace_head.load(std::memory_order_acquire);
+    const uint64_t first = (head > SERIALIZE_TRACE_SIZE) ? head-SERIALIZE_TRACE_SIZE : 0;
+
+    p_events->clear();
+    try {
+        p_events->reserve(head-first);
+    } catch (std::exception &e) {
+        throw -1;
+    }
+    for(uint64_t pos=first; pos<head; pos++) {
+        const S_TraceSlot &slot = trace_ring[pos % SERIALIZE_TRACE_SIZE];
+        if(slot.m_seq.load(std::memory_order_acquire) != pos+1) /* Being written, or already overwritten by a newer event. */
+            continue;
+        S_SerializeTraceEvent event;
+        event.m_time_ns = slot.m_time_ns.load(std::memory_order_relaxed);
+        event.m_value = slot.m_value.load(std::memory_order_relaxed);
+        const uint64_t info = slot.m_info.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if(slot.m_seq.load(std::memory_order_relaxed) != pos+1) /* Changed while it was read. */
+            continue;
+        event.m_type = (uint32_t)info;
+        event.m_event = (info >> 32) & 0xFF;
+        event.m_thread = info >> 40;
+        p_events->push_back(event);
+    }
+}
+
+
+void WY_SerializeStats::dump_trace(std::ostream &p_out)
+{
+    std::vector<S_SerializeTraceEvent> events;
+
+    get_trace(&events);
+    for(const S_SerializeTraceEvent &event : events) {
+        p_out << event.m_time_ns << " thread " << event.m_thread << " " << trace_names[event.m_event];
+        if((event.m_event == TRACE_BLOCK_WRITE) || (event.m_event == TRACE_BLOCK_READ))
+            p_out << " type " << event.m_type << " size " << event.m_value << "\n";
+        else if((event.m_event == TRACE_SAVE_END) || (event.m_event == TRACE_LOAD_END))
+            p_out << " ns " << event.m_value << "\n";
+        else
+            p_out << "\n";
+    }
+    if(p_out.fail())
+        throw -1;
+}
+
+
+uint64_t WY_SerializeStats::begin(const SERIALIZE_TRACE_EVENT p_event) noexcept
+{
+    const uint64_t time = get_time_ns();
+    if(m_flags.load(std::memory_order_relaxed) & m_flag_trace)
+        add_trace(p_event, 0, 0, time);
+    return (time != 0) ? time : 1;
+}
+
+
+void WY_SerializeStats::add_latency(const SERIALIZE_STATS_LATENCY p_latency, const uint64_t p_start) noexcept
+{
+    const unsigned int flags = m_flags.load(std::memory_order_relaxed);
+    const uint64_t time = get_time_ns();
+    const uint64_t latency = (time > p_start) ? time-p_start : 0;
+
+    if(flags & m_flag_trace)
+        add_trace((p_latency == STATS_LATENCY_SAVE) ? TRACE_SAVE_END : TRACE_LOAD_END, 0, latency, time);
+    if(!(flags & m_flag_stats))
+        return;
+    S_ThreadStats * stats = get_thread_stats();
+    if(stats == NULL)
+        return;
+    const uint64_t us = latency / 1000;
+    const unsigned int bucket = (us == 0) ? 0 : std::min<unsigned int>(64 - __builtin_clzll(us), SERIALIZE_STATS_BUCKETS-1);
+    add_counter(stats->m_latency_total_ns[p_latency], latency);
+    add_counter(stats->m_latency[p_latency][bucket], 1);
+}
+
+
+void WY_SerializeStats::add_block(const bool p_write, const uint32_t p_type, const uint64_t p_size, const uint64_t p_file_size) noexcept
+{
+    const unsigned int flags = m_flags.load(std::memory_order_relaxed);
+
+    if(flags & m_flag_trace)
+        add_trace(p_write ? TRACE_BLOCK_WRITE : TRACE_BLOCK_READ, p_type, p_file_size, get_time_ns());
+    if(!(flags & m_flag_stats))
+        return;
+    S_ThreadStats * stats = get_thread_stats();
+    if(stats == NULL)
+        return;
+
+    /* Rows are taken in order, so the search ends at the first unused one. Typical applications have few types, found in the first rows. */
+    unsigned int row = 0;
+    const uint64_t key = (uint64_t)p_type + 1;
+    for(; row<SERIALIZE_STATS_TYPES_MAX; row++) {
+        const uint64_t row_key = stats->m_type_keys[row].load(std::memory_order_relaxed);
+        if(row_key == key)
+            break;
+        if(row_key == 0) {
+            stats->m_type_keys[row].store(key, std::memory_order_release); /* The counters of an unused row are 0. */
+            break;
+        }
+    }
+    std::atomic<uint64_t> * counters = stats->m_types[row];
+    if(!p_write)
+        counters += 3;
+    add_counter(counters[0], 1);
+    add_counter(counters[1], p_size);
+    add_counter(counters[2], p_file_size);
+}
+
+
+void WY_SerializeStats::add_io(const SERIALIZE_STATS_IO p_io) noexcept
+{
+    S_ThreadStats * stats = get_thread_stats();
+    if(stats != NULL)
+        add_counter(stats->m_io_calls[p_io], 1);
+}
@@ -0,0 +1,253 @@
+/*
+* Copyright 2023 Au Yeong Wing Yau
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+#ifndef _WY_SERIALIZE_STATS_HPP_
+#define _WY_SERIALIZE_STATS_HPP_
+
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+#pragma once
+namespace WY_Serialize
+{
+
+/**
+ * Kinds of I/O calls counted by WY_SerializeStats.
+ */
+enum SERIALIZE_STATS_IO {
+    STATS_IO_OPEN = 0, /**< Files and directories opened. */
+    STATS_IO_READ, /**< Reads, one per read() or std::fstream read. */
+    STATS_IO_WRITE, /**< Writes, one per pwritev() or per block written through std::fstream. */
+    STATS_IO_MAP, /**< Files mapped with mmap(). */
+    STATS_IO_SYNC, /**< Calls to fsync() and fdatasync(). */
+    STATS_IO_RENAME, /**< Files renamed by atomic saves. */
+    STATS_IO_TRUNCATE, /**< Files truncated before appending. */
+    STATS_IO_COUNT /**< Number of kinds. */
+};
+
+/**
+ * Operations whose latency WY_SerializeStats keeps histograms of.
+ */
+enum SERIALIZE_STATS_LATENCY {
+    STATS_LATENCY_SAVE = 0, /**< WY_SerializeAgent::prepare_save_file() or prepare_append_file() until finalise_save_file() returns. */
+    STATS_LATENCY_LOAD, /**< WY_SerializeAgent::load_from_file() until clear_loaded_file_buffer() is called. */
+    STATS_LATENCY_COUNT /**< Number of operations. */
+};
+
+/**
+ * Events recorded in the trace ring of WY_SerializeStats.
+ */
+enum SERIALIZE_TRACE_EVENT {
+    TRACE_SAVE_BEGIN = 0, /**< A save file was opened. */
+    TRACE_SAVE_END, /**< A save file was finalised. The value is the save latency in ns. */
+    TRACE_LOAD_BEGIN, /**< A file is being loaded. */
+    TRACE_LOAD_END, /**< A loaded file was cleared. The value is the load latency in ns. */
+    TRACE_BLOCK_WRITE, /**< A block was saved. The value is its size in the file. */
+    TRACE_BLOCK_READ /**< A block was loaded. The value is its size in the file. */
+};
+
+static const unsigned int SERIALIZE_STATS_BUCKETS = 32; /**< Buckets of a latency histogram. Bucket 0 counts latencies below 1 us, bucket i latencies from 2^(i-1) us to below 2^i us, and the last bucket everything longer. */
+static const unsigned int SERIALIZE_STATS_TYPES_MAX = 64; /**< Block types counted separately by each thread. Further types are counted together in S_SerializeStats::m_other_types. */
+static const unsigned int SERIALIZE_TRACE_SIZE = 4096; /**< Events kept in the trace ring. Older events are overwritten. */
+
+/**
+ * Blocks and bytes saved and loaded for one block type.
+ */
+struct S_SerializeTypeStats {
+    uint32_t m_type; /**< The block type. */
+    uint64_t m_blocks_written; /**< Blocks saved. */
+    uint64_t m_bytes_written; /**< Data saved, before encoding. */
+    uint64_t m_file_bytes_written; /**< Bytes the blocks take in the file, including headers, CRCs and encoding. */
+    uint64_t m_blocks_read; /**< Blocks loaded. */
+    uint64_t m_bytes_read; /**< Data loaded, after decoding. */
+    uint64_t m_file_bytes_read; /**< Bytes the loaded blocks take in the file. */
+};
+
+/**
+ * A snapshot of the counters of WY_SerializeStats, summed over all threads.
+ */
+struct S_SerializeStats {
+    std::vector<S_SerializeTypeStats> m_types; /**< Counters of every block type seen, ordered by type. */
+    S_SerializeTypeStats m_other_types; /**< Counters of the types a thread saw after its first SERIALIZE_STATS_TYPES_MAX. m_type is 0. */
+    uint64_t m_io_calls[STATS_IO_COUNT]; /**< Calls of each SERIALIZE_STATS_IO kind. */
+    uint64_t m_latency_total_ns[STATS_LATENCY_COUNT]; /**< Sum of the latencies of each SERIALIZE_STATS_LATENCY operation. */
+    uint64_t m_latency[STATS_LATENCY_COUNT][SERIALIZE_STATS_BUCKETS]; /**< Latency histogram of each SERIALIZE_STATS_LATENCY operation, see SERIALIZE_STATS_BUCKETS. */
+};
+
+/**
+ * An event of the trace ring.
+ */
+struct S_SerializeTraceEvent {
+    uint64_t m_time_ns; /**< Time of the event on the steady clock. */
+    uint32_t m_thread; /**< Number of the thread that recorded the event, in the order threads first recorded statistics or events. */
+    uint32_t m_event; /**< The event, from enum SERIALIZE_TRACE_EVENT. */
+    uint32_t m_type; /**< Block type of block events, 0 for others. */
+    uint64_t m_value; /**< Value of the event, see enum SERIALIZE_TRACE_EVENT. */
+};
+
+/**
+ * Collects statistics of saves and loads, and keeps a trace of recent events in memory. Both are off by default and are switched on at run time, so they can be used in production builds.
+ * 
+ * Statistics are counted per thread without locks or atomic read-modify-write instructions, and summed when they are read. The trace is a ring of the last SERIALIZE_TRACE_SIZE events, which threads add to without locks. Recording an event costs one atomic increment on a shared counter, so the trace is slower than the statistics when many threads save or load at once. <br>
+ * <br>
+ * Usage: <br>
+ * @code
+ * WY_SerializeStats::set_stats(true); 
+ * WY_SerializeStats::set_trace(true); 
+ * mgr.save_all_objs("savefile"); 
+ * S_SerializeStats stats; 
+ * WY_SerializeStats::get_stats(&stats); 
+ * WY_SerializeStats::dump_trace(std::cout); 
+ * @endcode
+ */
+class WY_SerializeStats
+{
+public:
+    /**
+     * Switches the statistics on or off. Counters keep their values while they are off.
+     * \param p_stats True to count. Defaults to false.
+    */
+    static void set_stats(const bool p_stats) noexcept;
+
+    /**
+     * Switches the trace on or off. The ring keeps its events while it is off.
+     * \param p_trace True to record events. Defaults to false.
+    */
+    static void set_trace(const bool p_trace) noexcept;
+
+    /**
+     * Reads the counters, summed over all threads, since the program started or reset_stats() was last called. Counters of threads that have exited are included. Counters being updated by running threads may be read before or after the update.
+     * \param p_stats Returns the counters.
+     * \throw -1 integer exception if there is an error.
+    */
+    static void get_stats(S_SerializeStats *__restrict__ const p_stats);
+
+    /**
+     * Makes get_stats() count from zero again.
+     * \throw -1 integer exception if there is an error.
+    */
+    static void reset_stats();
+
+    /**
+     * Gets the events in the trace ring, oldest first. Events being written while they are read are left out.
+     * \param p_events Returns the events.
+     * \throw -1 integer exception if there is an error.
+    */
+    static void get_trace(std::vector<S_SerializeTraceEvent> *__restrict__ const p_events);
+
+    /**
+     * Writes the events in the trace ring as text, one line per event, oldest first.
+     * \param p_out The stream to write to.
+     * \throw -1 integer exception if there is an error.
+    */
+    static void dump_trace(std::ostream &p_out);
+
+    /**
+     * Records the start of an operation whose latency is measured. Called by WY_SerializeAgent.
+     * \param p_event The begin event to trace.
+     * \return Start time to pass to record_latency(), or 0 if statistics and trace are both off.
+    */
+    static uint64_t record_begin(const SERIALIZE_TRACE_EVENT p_event) noexcept
+    {
+        if(m_flags.load(std::memory_order_relaxed) == 0)
+            return 0;
+        return begin(p_event);
+    }
+
+    /**
+     * Records the latency of an operation started with record_begin(). Called by WY_SerializeAgent.
+     * \param p_latency The operation.
+     * \param p_start The value returned by record_begin(). Nothing is recorded if it is 0.
+    */
+    static void record_latency(const SERIALIZE_STATS_LATENCY p_latency, const uint64_t p_start) noexcept
+    {
+        if(p_start != 0)
+            add_latency(p_latency, p_start);
+    }
+
+    /**
+     * Records a saved block. Called by WY_SerializeAgent.
+     * \param p_type Type of the block.
+     * \param p_size Size of the data before encoding.
+     * \param p_file_size Size of the block in the file.
+    */
+    static void record_block_write(const uint32_t p_type, const uint64_t p_size, const uint64_t p_file_size) noexcept
+    {
+        if(m_flags.load(std::memory_order_relaxed) != 0)
+            add_block(true, p_type, p_size, p_file_size);
+    }
+
+    /**
+     * Records a loaded block. Called by WY_SerializeAgent.
+     * \param p_type Type of the block.
+     * \param p_size Size of the data after decoding.
+     * \param p_file_size Size of the block in the file.
+    */
+    static void record_block_read(const uint32_t p_type, const uint64_t p_size, const uint64_t p_file_size) noexcept
+    {
+        if(m_flags.load(std::memory_order_relaxed) != 0)
+            add_block(false, p_type, p_size, p_file_size);
+    }
+
+    /**
+     * Records an I/O call. Called by WY_SerializeAgent.
+     * \param p_io The kind of call.
+    */
+    static void record_io(const SERIALIZE_STATS_IO p_io) noexcept
+    {
+        if(m_flags.load(std::memory_order_relaxed) & m_flag_stats)
+            add_io(p_io);
+    }
+
+private:
+    /**
+     * Implements record_begin() when statistics or trace are on.
+     * \param p_event The begin event to trace.
+     * \return The current time, never 0.
+    */
+    static uint64_t begin(const SERIALIZE_TRACE_EVENT p_event) noexcept;
+
+    /**
+     * Implements record_latency().
+     * \param p_latency The operation.
+     * \param p_start Start time of the operation.
+    */
+    static void add_latency(const SERIALIZE_STATS_LATENCY p_latency, const uint64_t p_start) noexcept;
+
+    /**
+     * Implements record_block_write() and record_block_read() when statistics or trace are on.
+     * \param p_write True for a saved block, false for a loaded one.
+     * \param p_type Type of the block.
+     * \param p_size Size of the data.
+     * \param p_file_size Size of the block in the file.
+    */
+    static void add_block(const bool p_write, const uint32_t p_type, const uint64_t p_size, const uint64_t p_file_size) noexcept;
+
+    /**
+     * Implements record_io() when statistics are on.
+     * \param p_io The kind of call.
+    */
+    static void add_io(const SERIALIZE_STATS_IO p_io) noexcept;
+
+    static const unsigned int m_flag_stats = 1; /**< Bit of m_flags set by set_stats(). */
+    static const unsigned int m_flag_trace = 2; /**< Bit of m_flags set by set_trace(). */
+    static std::atomic<unsigned int> m_flags; /**< m_flag_stats and m_flag_trace. */
+};
+}
+
+#endif
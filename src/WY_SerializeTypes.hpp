@@ -24,7 +24,9 @@ namespace WY_Serialize {
  */
 enum SERIALIZE_TYPE {
     DEMO_OBJ1 = 1,
-    DEMO_OBJ2
+    DEMO_OBJ2,
+    DEMO_OBJ3,
+    BENCH_OBJ /**< Blocks of the benchmark driver in Bench.cpp. */
 };
 }
 
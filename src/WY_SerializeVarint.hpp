@@ -0,0 +1,230 @@
+/*
+* Copyright 2023 Au Yeong Wing Yau
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+#ifndef _WY_SERIALIZE_VARINT_HPP_
+#define _WY_SERIALIZE_VARINT_HPP_
+
+#include <cstdint>
+#include <cstring>
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+#include "WY_SerializeDef.hpp"
+#pragma once
+namespace WY_Serialize
+{
+
+/**
+ * Encodes and decodes LEB128 varints, and the compact block headers made of them. See WY_SerializeAgent::set_save_compact(). 
+ * 
+ * A compact header is the type, flags and size of a block as three varints, so a block of a small type with up to 127 bytes of data has a 3 byte header instead of SERIALIZE_HEADER_SIZE. Only the shortest encoding of a value is accepted, so a decoded header encodes back to the same bytes. <br>
+ * Headers of three single byte values are decoded directly. Otherwise, on x86-64 decode_header() finds the ends of all three varints of a header with one SSE2 compare of 16 bytes, and extracts each value with one PEXT instruction when compiled for a CPU with BMI2. Headers less than SERIALIZE_HEADER_MAX bytes from the end of a buffer, or with a size of 2^56 or more, are decoded one byte at a time. All functions are inline as they are called once per block.
+ * 
+ * Usage: <br>
+ * @code
+ * unsigned char buffer[SERIALIZE_HEADER_MAX]; 
+ * S_SerializeHeader header = {type, 0, size}; 
+ * const unsigned int length = WY_SerializeVarint::encode_header(buffer, &header); 
+ * WY_SerializeVarint::decode_header(buffer, length, &header); // Returns length. 
+ * @endcode
+ */
+class WY_SerializeVarint
+{
+public:
+    /**
+     * Encodes a value as a varint.
+     * \param p_value The value.
+     * \param p_dst Buffer of at least get_size(p_value) bytes, at most 10.
+     * \return Number of bytes written.
+    */
+    static unsigned int encode(uint64_t p_value, unsigned char *__restrict__ const p_dst) noexcept
+    {
+        unsigned int size = 0;
+        while(p_value >= 0x80) {
+            p_dst[size++] = (unsigned char)(p_value | 0x80);
+            p_value >>= 7;
+        }
+        p_dst[size++] = (unsigned char)p_value;
+        return size;
+    }
+
+    /**
+     * Gets the size of the varint of a value.
+     * \param p_value The value.
+     * \return Number of bytes encode() writes, from 1 to 10.
+    */
+    static unsigned int get_size(const uint64_t p_value) noexcept
+    {
+        return 1 + (63 - __builtin_clzll(p_value | 1)) / 7;
+    }
+
+    /**
+     * Decodes a varint one byte at a time.
+     * \param p_src The varint.
+     * \param p_avail Bytes available at p_src.
+     * \param p_value Returns the value.
+     * \return Number of bytes read, 0 if the varint is incomplete, longer than its shortest encoding or overflows 64 bits.
+    */
+    static unsigned int decode(const unsigned char *__restrict__ const p_src, const uint64_t p_avail, uint64_t *__restrict__ const p_value) noexcept
+    {
+        const unsigned int max = (p_avail < 10) ? p_avail : 10;
+        uint64_t value = 0;
+        for(unsigned int i=0; i<max; i++) {
+            const uint64_t byte = p_src[i];
+            if((i == 9) && (byte > 1)) /* Bits past 64. */
+                return 0;
+            value |= (byte & 0x7F) << (7*i);
+            if((byte & 0x80) == 0) {
+                if((byte == 0) && (i > 0)) /* Not the shortest encoding. */
+                    return 0;
+                *p_value = value;
+                return i+1;
+            }
+        }
+        return 0;
+    }
+
+    /**
+     * Encodes a compact block header.
+     * \param p_dst Buffer of at least SERIALIZE_HEADER_MAX bytes.
+     * \param p_header The header.
+     * \return Number of bytes written.
+    */
+    static unsigned int encode_header(unsigned char *__restrict__ const p_dst, const S_SerializeHeader *__restrict__ const p_header) noexcept
+    {
+        unsigned int size = encode(p_header->m_type, p_dst);
+        size += encode(p_header->m_flags, p_dst+size);
+        return size + encode(p_header->m_size, p_dst+size);
+    }
+
+    /**
+     * Gets the size of a compact block header.
+     * \param p_header The header.
+     * \return Number of bytes encode_header() writes.
+    */
+    static unsigned int get_header_size(const S_SerializeHeader *__restrict__ const p_header) noexcept
+    {
+        return get_size(p_header->m_type) + get_size(p_header->m_flags) + get_size(p_header->m_size);
+    }
+
+    /**
+     * Decodes a compact block header.
+     * \param p_src The header.
+     * \param p_avail Bytes available at p_src. 
+     * \param p_header Returns the header.
+     * \return Number of bytes read, 0 if the header is incomplete or invalid.
+    */
+    static unsigned int decode_header(const unsigned char *__restrict__ const p_src, const uint64_t p_avail, S_SerializeHeader *__restrict__ const p_header) noexcept
+    {
+        if((p_avail >= 3) && (((p_src[0] | p_src[1] | p_src[2]) & 0x80) == 0)) { /* The common header of a small block, three single byte values. */
+            p_header->m_type = p_src[0];
+            p_header->m_flags = p_src[1];
+            p_header->m_size = p_src[2];
+            return 3;
+        }
+#if defined(__SSE2__)
+        if(p_avail >= SERIALIZE_HEADER_MAX) { /* Every value can then be read as 8 bytes in place. */
+            const unsigned char *__restrict__ const bytes = p_src;
+            const __m128i v = _mm_loadu_si128((const __m128i *)p_src);
+            unsigned int ends = ~_mm_movemask_epi8(v) & 0xFFFF; /* Bit i is set if byte i is the last byte of a varint. */
+            if(__builtin_popcount(ends) >= 3) {
+                const unsigned int end_type = __builtin_ctz(ends) + 1;
+#if defined(__BMI2__)
+                const unsigned int end_flags = __builtin_ctz(_pdep_u32(2, ends)) + 1; /* Second and third set bits directly, so the header size does not wait for the earlier ends. */
+                const unsigned int end_size = __builtin_ctz(_pdep_u32(4, ends)) + 1;
+#else
+                ends &= ends - 1;
+                const unsigned int end_flags = __builtin_ctz(ends) + 1;
+                ends &= ends - 1;
+                const unsigned int end_size = __builtin_ctz(ends) + 1;
+#endif
+                const unsigned int type_length = end_type;
+                const unsigned int flags_length = end_flags - end_type;
+                const unsigned int size_length = end_size - end_flags;
+                const unsigned int type_last = bytes[end_type-1];
+                const unsigned int flags_last = bytes[end_flags-1];
+                const unsigned int size_last = bytes[end_size-1];
+                /* Checked with & rather than && so a mix of header sizes costs one branch, not one per condition. */
+                const bool valid = (type_length <= 5) & (flags_length <= 5) & (size_length <= 8)
+                    & ((type_length < 5) | (type_last <= 0x0F)) & ((flags_length < 5) | (flags_last <= 0x0F)) /* Values fit in 32 bits. */
+                    & ((type_length == 1) | (type_last != 0)) & ((flags_length == 1) | (flags_last != 0)) & ((size_length == 1) | (size_last != 0)); /* Shortest encodings. */
+                if(valid) {
+                    p_header->m_type = extract(bytes, type_length);
+                    p_header->m_flags = extract(bytes+end_type, flags_length);
+                    p_header->m_size = extract(bytes+end_flags, size_length);
+                    return end_size;
+                }
+                if(size_length <= 8) /* The header is invalid, not too long for this path. */
+                    return 0;
+            }
+        }
+#endif
+        return decode_header_bytewise(p_src, p_avail, p_header);
+    }
+
+    /**
+     * Implements decode_header() one byte at a time. Used by decode_header() for headers its fast paths do not take, and by the checks as the reference for them.
+     * \param p_src The header.
+     * \param p_avail Bytes available at p_src. 
+     * \param p_header Returns the header.
+     * \return Number of bytes read, 0 if the header is incomplete or invalid.
+    */
+    static unsigned int decode_header_bytewise(const unsigned char *__restrict__ const p_src, const uint64_t p_avail, S_SerializeHeader *__restrict__ const p_header) noexcept
+    {
+        uint64_t type, flags;
+        unsigned int size = decode(p_src, p_avail, &type);
+        if((size == 0) || (type > UINT32_MAX))
+            return 0;
+        unsigned int length = decode(p_src+size, p_avail-size, &flags);
+        if((length == 0) || (flags > UINT32_MAX))
+            return 0;
+        size += length;
+        length = decode(p_src+size, p_avail-size, &p_header->m_size);
+        if(length == 0)
+            return 0;
+        p_header->m_type = type;
+        p_header->m_flags = flags;
+        return size + length;
+    }
+
+private:
+    /**
+     * Gets the value of a varint of up to 8 bytes whose length is known.
+     * \param p_src The varint, with at least 8 readable bytes.
+     * \param p_length Length of the varint, from 1 to 8.
+     * \return The value.
+    */
+    static uint64_t extract(const unsigned char *__restrict__ const p_src, const unsigned int p_length) noexcept
+    {
+        uint64_t word;
+        memcpy(&word, p_src, 8);
+        if(__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__) /* The first byte holds the lowest 7 bits. */
+            word = __builtin_bswap64(word);
+#if defined(__BMI2__)
+        return _pext_u64(word, 0x7F7F7F7F7F7F7F7FULL >> (64 - 8*p_length));
+#else
+        if(p_length < 8)
+            word &= (1ULL << (8*p_length)) - 1;
+        word = (word & 0x007F007F007F007FULL) | ((word & 0x7F007F007F007F00ULL) >> 1); /* Pairs of 7 bits into 14. */
+        word = (word & 0x00003FFF00003FFFULL) | ((word & 0x3FFF00003FFF0000ULL) >> 2); /* 28 bits. */
+        return (word & 0x000000000FFFFFFFULL) | ((word & 0x0FFFFFFF00000000ULL) >> 4);
+#endif
+    }
+};
+}
+
+#endif
@@ -0,0 +1,269 @@
+/*
+* Copyright 2023 Au Yeong Wing Yau
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+#ifndef _WY_STATIC_SERIALIZE_MGR_HPP_
+#define _WY_STATIC_SERIALIZE_MGR_HPP_
+
+#include <memory>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include "WY_SerializeAgent.hpp"
+#include "WY_SerializeStats.hpp"
+#include "WY_DebugIO.hpp"
+#pragma once
+namespace WY_Serialize
+{
+
+/**
+ * Implements a serialization manager for a set of objects that is known at compile time. 
+ * 
+ * WY_SerializeMgr keeps a heap array of WY_SerializeObj pointers and calls every object through its vtable. WY_StaticSerializeMgr instead keeps references to the objects in a std::tuple and saves and loads them with fold expressions. get_save_data() and get_load_data() are called qualified with the type of each object, so there are no virtual calls and they can be inlined. Objects must therefore be passed as their most derived type. <br>
+ * <br>
+ * Types with a constant block size, such as those derived from WY_SerializePod, have the offset and header of their block computed at compile time. If all types have a constant size the whole file size is known, a save is a single writev() of stack buffers and a load reads the file into a stack buffer with one pread() when it fits in m_stack_max bytes. Other types are saved in the same way but their files are loaded into a heap buffer. <br>
+ * <br>
+ * Files are identical to the ones WY_SerializeMgr::save_all_objs() writes for the same objects with the default settings, and both managers can load each other's files. Files of version 0, without a file header, cannot be loaded. Blocks that are encoded or have a CRC cannot be loaded, nor can files with compact headers or aligned blocks, and a block index at the end of the file is ignored. <br>
+ * <br>
+ * Usage: <br>
+ * @code
+ * DemoObj1 obj1; 
+ * DemoObj3 obj3; 
+ * WY_StaticSerializeMgr<DemoObj1, DemoObj3> mgr(obj1, obj3); 
+ * try { 
+ *  mgr.save_all_objs("savefile"); 
+ *  mgr.load_all_objs("savefile"); 
+ * } catch (int &e) { 
+ *  std::cout << "IO error" << "\n"; 
+ * } 
+ * @endcode
+ * \tparam Ts The types of the objects, in the order they are saved. Each must derive from WY_SerializeObj.
+ */
+template <typename... Ts>
+class WY_StaticSerializeMgr
+{
+    static_assert(sizeof...(Ts) > 0, "WY_StaticSerializeMgr needs at least one type.");
+    static_assert((std::is_base_of<WY_SerializeObj, Ts>::value && ...), "WY_StaticSerializeMgr types must derive from WY_SerializeObj.");
+    static_assert(2*sizeof...(Ts) <= 1024, "WY_StaticSerializeMgr supports up to 512 types, so a save fits in one writev() call.");
+
+    /**
+     * Checks at compile time if a type declares a constant block size in m_serialize_size, like WY_SerializePod.
+     */
+    template <typename T, typename = void>
+    struct S_FixedSize: std::false_type {};
+
+    template <typename T>
+    struct S_FixedSize<T, std::void_t<decltype(T::m_serialize_size), decltype(T::m_serialize_type)>>: std::true_type {};
+
+    /**
+     * Gets the size of a block in the file if its type has a constant size.
+     * \tparam T The type of the block.
+     * \return Size of the header and data of the block, 0 if the size is not constant.
+    */
+    template <typename T>
+    static constexpr uint64_t get_block_size() noexcept
+    {
+        if constexpr (S_FixedSize<T>::value)
+            return SERIALIZE_HEADER_SIZE + T::m_serialize_size;
+        else
+            return 0;
+    }
+
+public:
+    static constexpr unsigned int m_count = sizeof...(Ts); /**< Number of objects. */
+    static constexpr bool m_fixed = (S_FixedSize<Ts>::value && ...); /**< True if the size of every block, and so of the file, is known at compile time. */
+    static constexpr uint64_t m_file_size = m_fixed ? (SERIALIZE_FILE_HEADER_SIZE + ... + get_block_size<Ts>()) : 0; /**< Size of the save file if m_fixed is true, else 0. */
+    static constexpr uint64_t m_stack_max = 64*1024; /**< Files with m_fixed set up to this size are loaded into a stack buffer. */
+
+    /**
+     * Constructor.
+     * \param p_objs The objects to save and load. Only references are kept, so they must outlive this WY_StaticSerializeMgr.
+    */
+    explicit WY_StaticSerializeMgr(Ts &... p_objs) noexcept: m_objs(p_objs...) {}
+
+    /**
+     * Saves all objects to file, in the order of Ts.
+     * \param p_file Name of the file to save to.
+     * \throw -1 integer exception if there is an error - usually a file IO error or get_save_data() failing.
+    */
+    void save_all_objs(const char *__restrict__ const p_file)
+    {
+        const uint64_t start = WY_SerializeStats::record_begin(TRACE_SAVE_BEGIN);
+        unsigned char file_header[SERIALIZE_FILE_HEADER_SIZE];
+        unsigned char headers[m_count][SERIALIZE_HEADER_SIZE];
+        struct iovec iov[2*m_count+1];
+        const S_SerializeFileHeader header = {SERIALIZE_FILE_VERSION, 0};
+        encode_file_header(file_header, &header);
+        iov[0].iov_base = file_header;
+        iov[0].iov_len = SERIALIZE_FILE_HEADER_SIZE;
+        if(fill_save_iov(headers, iov+1, std::index_sequence_for<Ts...>{}) != 0) {
+            WY_DebugIO::debug_print("Getting save data failed.");
+            throw -1;
+        }
+
+        int fd = open(p_file, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+        WY_SerializeStats::record_io(STATS_IO_OPEN);
+        if(fd < 0) {
+            WY_DebugIO::debug_print("Unable to open save file.");
+            throw -1;
+        }
+        int ret = WY_PosixIO::write_vector(fd, iov, 2*m_count+1, 0);
+        if(close(fd) != 0)
+            ret = -1;
+        if(ret != 0) {
+            WY_DebugIO::debug_print("Saving file failed.");
+            throw -1;
+        }
+        WY_SerializeStats::record_latency(STATS_LATENCY_SAVE, start);
+    }
+
+    /**
+     * Loads all objects from a save file, in the order of Ts. Each block must have the type of its object if the type has a constant size.
+     * \param p_file Name of the file to load from.
+     * \throw -1 integer exception if there is an error - usually a file IO error, a block that does not match its object or get_load_data() failing.
+    */
+    void load_all_objs(const char *__restrict__ const p_file)
+    {
+        const uint64_t start = WY_SerializeStats::record_begin(TRACE_LOAD_BEGIN);
+        int fd = open(p_file, O_RDONLY);
+        WY_SerializeStats::record_io(STATS_IO_OPEN);
+        if(fd < 0) {
+            WY_DebugIO::debug_print("Unable to open load file.");
+            throw -1;
+        }
+
+        int ret;
+        uint64_t size = m_file_size;
+        if constexpr (m_fixed && (m_file_size <= m_stack_max)) {
+            unsigned char buffer[m_file_size];
+            ret = WY_PosixIO::read_at(fd, buffer, m_file_size, 0);
+            if(ret == 0)
+                ret = load_buffer(buffer, size, std::index_sequence_for<Ts...>{});
+        } else {
+            struct stat st;
+            ret = fstat(fd, &st);
+            if constexpr (!m_fixed)
+                size = (ret == 0) ? st.st_size : 0;
+            std::unique_ptr<unsigned char[]> buffer(new (std::nothrow) unsigned char[size]);
+            ret = (buffer) ? WY_PosixIO::read_at(fd, buffer.get(), size, 0) : -1;
+            if(ret == 0)
+                ret = load_buffer(buffer.get(), size, std::index_sequence_for<Ts...>{});
+        }
+        close(fd);
+        WY_SerializeStats::record_latency(STATS_LATENCY_LOAD, start);
+        if(ret != 0) {
+            WY_DebugIO::debug_print("Loading file failed.");
+            throw -1;
+        }
+    }
+
+private:
+    /**
+     * Gets the save data of every object and describes the file as headers and data buffers.
+     * \param p_headers Returns the encoded header of every block.
+     * \param p_iov Returns the header and data of every block, in file order.
+     * \return 0 if no error. -1 if get_save_data() of an object fails.
+    */
+    template <std::size_t... Is>
+    int fill_save_iov(unsigned char (*__restrict__ p_headers)[SERIALIZE_HEADER_SIZE], struct iovec *__restrict__ const p_iov, std::index_sequence<Is...>) noexcept
+    {
+        return ((save_block<Is>(p_headers[Is], p_iov + 2*Is) == 0) && ...) ? 0 : -1;
+    }
+
+    /**
+     * Gets the save data of object I and encodes its header.
+     * \param p_header Returns the encoded header.
+     * \param p_iov Returns the header and the data.
+     * \return 0 if no error. -1 if get_save_data() fails.
+    */
+    template <std::size_t I>
+    int save_block(unsigned char *__restrict__ const p_header, struct iovec *__restrict__ const p_iov) noexcept
+    {
+        using T = std::tuple_element_t<I, std::tuple<Ts...>>;
+        S_SerializeData data;
+        init_serializable_data(&data);
+        if(std::get<I>(m_objs).T::get_save_data(&data) != 0)
+            return -1;
+
+        S_SerializeHeader header;
+        header.m_type = data.m_type;
+        header.m_flags = 0;
+        header.m_size = data.m_size;
+        encode_serialize_header(p_header, &header);
+        p_iov[0].iov_base = p_header;
+        p_iov[0].iov_len = SERIALIZE_HEADER_SIZE;
+        p_iov[1].iov_base = data.m_data;
+        p_iov[1].iov_len = data.m_size;
+        WY_SerializeStats::record_block_write(data.m_type, data.m_size, SERIALIZE_HEADER_SIZE + data.m_size);
+        return 0;
+    }
+
+    /**
+     * Loads every object from a file in memory.
+     * \param p_buffer The file.
+     * \param p_size Size of the file.
+     * \return 0 if no error. -1 if a block is invalid or get_load_data() fails.
+    */
+    template <std::size_t... Is>
+    int load_buffer(const unsigned char *__restrict__ const p_buffer, const uint64_t p_size, std::index_sequence<Is...>) noexcept
+    {
+        S_SerializeFileHeader header;
+        const int header_size = decode_file_header(p_buffer, p_size, &header);
+        if((header_size <= 0) || (header.m_options != 0)) /* Files of version 0, compact headers and aligned blocks are not supported. */
+            return -1;
+        uint64_t offset = header_size;
+        return ((load_block<Is>(p_buffer, p_size, &offset) == 0) && ...) ? 0 : -1;
+    }
+
+    /**
+     * Loads object I from the block at an offset of a file in memory.
+     * \param p_buffer The file.
+     * \param p_size Size of the file.
+     * \param p_offset Offset of the block. Advanced past the block.
+     * \return 0 if no error. -1 if the block is invalid or get_load_data() fails.
+    */
+    template <std::size_t I>
+    int load_block(const unsigned char *__restrict__ const p_buffer, const uint64_t p_size, uint64_t *__restrict__ const p_offset) noexcept
+    {
+        using T = std::tuple_element_t<I, std::tuple<Ts...>>;
+        if(p_size - *p_offset < SERIALIZE_HEADER_SIZE)
+            return -1;
+        S_SerializeHeader header;
+        decode_serialize_header(p_buffer + *p_offset, &header);
+        if(header.m_flags != 0)
+            return -1;
+        if constexpr (S_FixedSize<T>::value) {
+            if((header.m_type != T::m_serialize_type) || (header.m_size != T::m_serialize_size))
+                return -1;
+        }
+        if(header.m_size > p_size - *p_offset - SERIALIZE_HEADER_SIZE)
+            return -1;
+
+        const unsigned char *data = p_buffer + *p_offset + SERIALIZE_HEADER_SIZE;
+        *p_offset += SERIALIZE_HEADER_SIZE + header.m_size;
+        WY_SerializeStats::record_block_read(header.m_type, header.m_size, SERIALIZE_HEADER_SIZE + header.m_size);
+        return (std::get<I>(m_objs).T::get_load_data(header.m_size, data) == 0) ? 0 : -1;
+    }
+
+    std::tuple<Ts &...> m_objs; /**< The objects, in the order they are saved. */
+};
+}
+
+#endif
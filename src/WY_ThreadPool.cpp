@@ -0,0 +1,111 @@
+/*
+* Copyright 2023 Au Yeong Wing Yau
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include <exception>
+#include "WY_ThreadPool.hpp"
+using namespace WY_Serialize;
+
+
+WY_ThreadPool::WY_ThreadPool(const unsigned int p_threads)
+{
+    m_task = NULL;
+    m_count = 0;
+    m_next = 0;
+    m_active = 0;
+    m_generation = 0;
+    m_stop = false;
+
+    try {
+        for(unsigned int i=1; i<p_threads; i++) /* The thread calling run() is the first thread. */
+            m_threads.emplace_back(&WY_ThreadPool::worker, this);
+    } catch (std::exception &e) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_start.notify_all();
+        for(std::thread &thread : m_threads)
+            thread.join();
+        throw -1;
+    }
+}
+
+
+WY_ThreadPool::~WY_ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_start.notify_all();
+    for(std::thread &thread : m_threads)
+        thread.join();
+}
+
+
+unsigned int WY_ThreadPool::get_thread_count() const noexcept
+{
+    return m_threads.size()+1;
+}
+
+
+void WY_ThreadPool::run(const unsigned int p_count, const std::function<void(const unsigned int)> &p_task) noexcept
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_task = &p_task;
+        m_count = p_count;
+        m_next = 0;
+        m_active = m_threads.size();
+        ++m_generation;
+    }
+    m_start.notify_all();
+
+    run_tasks(); /* The calling thread takes its share too. */
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_done.wait(lock, [this] {return m_active == 0;});
+    m_task = NULL;
+}
+
+
+void WY_ThreadPool::worker() noexcept
+{
+    unsigned long long generation = 0;
+
+    while(true) {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_start.wait(lock, [this, generation] {return m_stop || (m_generation != generation);});
+            if(m_stop)
+                return;
+            generation = m_generation;
+        }
+
+        run_tasks();
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if(--m_active == 0)
+            m_done.notify_one();
+    }
+}
+
+
+void WY_ThreadPool::run_tasks() noexcept
+{
+    for(unsigned int i=m_next++; i<m_count; i=m_next++)
+        (*m_task)(i);
+}
@@ -0,0 +1,94 @@
+/*
+* Copyright 2023 Au Yeong Wing Yau
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#ifndef _WY_THREAD_POOL_HPP_
+#define _WY_THREAD_POOL_HPP_
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#pragma once
+namespace WY_Serialize
+{
+
+/**
+ * A fixed-size pool of worker threads that runs a task over a range of indices. Used by WY_SerializeMgr to save and load objects in parallel.
+ *
+ * Usage: <br>
+ * <br>
+ * @code
+ * WY_ThreadPool pool(4); // The calling thread plus 3 workers. 
+ * pool.run(count, [&](const unsigned int i) { 
+ *  process(i); // Called exactly once for every i in [0, count). 
+ * }); // Returns when all indices are done. 
+ * @endcode
+ */
+class WY_ThreadPool
+{
+public:
+    /**
+     * Constructor. Starts the worker threads.
+     * \param p_threads Number of threads that run tasks, including the thread that calls run(). 0 is treated as 1.
+     * \throw Integer exception if the threads cannot be started.
+    */
+    WY_ThreadPool(const unsigned int p_threads);
+
+    /**
+     * Destructor. Stops and joins the worker threads.
+    */
+    ~WY_ThreadPool();
+
+    /**
+     * Gets the number of threads that run tasks, including the thread that calls run().
+     * \return Number of threads.
+    */
+    unsigned int get_thread_count() const noexcept;
+
+    /**
+     * Calls p_task once for every index in [0, p_count), spread over all threads of the pool, and waits until all calls are done. Only one run() may be active at a time.
+     * \param p_count Number of indices.
+     * \param p_task The task. It must not throw.
+    */
+    void run(const unsigned int p_count, const std::function<void(const unsigned int)> &p_task) noexcept;
+
+private:
+    /**
+     * Main loop of the worker threads.
+    */
+    void worker() noexcept;
+
+    /**
+     * Calls m_task on indices taken from m_next until there are none left.
+    */
+    void run_tasks() noexcept;
+
+    std::vector<std::thread> m_threads; /**< The worker threads. */
+    std::mutex m_mutex; /**< Protects the members below. */
+    std::condition_variable m_start; /**< Wakes the workers when a run starts or the pool stops. */
+    std::condition_variable m_done; /**< Wakes run() when the last worker finishes. */
+    const std::function<void(const unsigned int)> * m_task; /**< The task of the current run. */
+    unsigned int m_count; /**< Number of indices of the current run. */
+    std::atomic<unsigned int> m_next; /**< Next index to hand out in the current run. */
+    unsigned int m_active; /**< Number of workers still busy with the current run. */
+    unsigned long long m_generation; /**< Incremented for every run so workers can tell a new run from a spurious wakeup. */
+    bool m_stop; /**< True when the pool is being destroyed. */
+};
+}
+
+#endif
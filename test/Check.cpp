@@ -0,0 +1,107 @@
+/*
+* Copyright 2023 Au Yeong Wing Yau
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+/**
+ * \file Check.cpp
+ * Runs the checks of the WY_Serialize library. Built by "make check" twice, once as is and once with -DWY_SERIALIZE_FORCE_SWAP, which runs the byte swapping of big-endian machines. <br>
+ * Usage: Check [-g] fixture_dir work_dir <br>
+ * -g writes the fixtures instead of checking anything.
+*/
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include "Check.hpp"
+#include "WY_ByteOrder.hpp"
+
+using namespace WY_SerializeCheck;
+
+int WY_SerializeCheck::g_failures = 0;
+
+
+int WY_SerializeCheck::read_file(const std::string &p_file, std::vector<unsigned char> *p_data)
+{
+    std::ifstream file(p_file, std::ifstream::binary);
+    if(!file.is_open())
+        return -1;
+    p_data->assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    return file.bad() ? -1 : 0;
+}
+
+
+int WY_SerializeCheck::write_file(const std::string &p_file, const std::vector<unsigned char> &p_data)
+{
+    std::ofstream file(p_file, std::ofstream::binary | std::ofstream::trunc);
+    file.write((const char *)p_data.data(), p_data.size());
+    file.close();
+    return file.fail() ? -1 : 0;
+}
+
+
+/**
+ * Runs one suite and reports how many of its checks failed.
+ * \param p_name Name of the suite.
+ * \param p_suite The suite.
+ */
+template <typename F>
+static void run_suite(const char *p_name, F p_suite)
+{
+    const int failures = g_failures;
+    try {
+        p_suite();
+    } catch (int &e) {
+        std::cout << "FAIL " << p_name << ": unexpected exception\n";
+        ++g_failures;
+    }
+    std::cout << p_name << ": " << ((g_failures == failures) ? "OK" : "FAILED") << "\n";
+}
+
+
+int main(int argc, char * argv[])
+{
+    const bool generate = (argc == 4) && (strcmp(argv[1], "-g") == 0);
+    if((argc != 3) && !generate) {
+        std::cout << "Usage: Check [-g] fixture_dir work_dir\n";
+        return 2;
+    }
+    const std::string fixtures = argv[argc-2];
+    const std::string work = argv[argc-1];
+
+    if(generate) {
+        if(WY_Serialize::WY_ByteOrder::is_swapping()) {
+            std::cout << "Fixtures are only written by a build that does not swap.\n";
+            return 2;
+        }
+        return (write_byte_order_fixtures(fixtures) == 0) ? 0 : 1;
+    }
+
+    std::cout << "Checking WY_Serialize" << (WY_Serialize::WY_ByteOrder::is_swapping() ? " with byte swapping" : "") << "\n";
+    run_suite("ByteOrder", [&]() { check_byte_order(fixtures, work); });
+    run_suite("Agent", [&]() { check_agent(work); });
+    run_suite("Codec", []() { check_codec(); });
+    run_suite("Crc32c", []() { check_crc32c(); });
+    run_suite("Legacy", [&]() { check_legacy(fixtures, work); });
+    run_suite("Log", [&]() { check_log(work); });
+    run_suite("Mgr", [&]() { check_mgr(work); });
+    run_suite("Varint", []() { check_varint(); });
+
+    if(g_failures != 0) {
+        std::cout << g_failures << " checks failed.\n";
+        return 1;
+    }
+    std::cout << "All checks passed.\n";
+    return 0;
+}
@@ -0,0 +1,118 @@
+/*
+* Copyright 2023 Au Yeong Wing Yau
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+#ifndef _CHECK_HPP_
+#define _CHECK_HPP_
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+#pragma once
+
+/**
+ * \file Check.hpp
+ * Shared declarations of the checks run by "make check". Each suite is a function in its own Check*.cpp file, called from main() in Check.cpp.
+*/
+namespace WY_SerializeCheck
+{
+
+extern int g_failures; /**< Number of failed CHECK() conditions so far. */
+
+/**
+ * Counts and reports a failed condition without stopping the suite.
+ */
+#define CHECK(p_cond) do { \
+        if(!(p_cond)) { \
+            std::cout << "FAIL " << __FILE__ << ":" << __LINE__ << ": " << #p_cond << "\n"; \
+            ++WY_SerializeCheck::g_failures; \
+        } \
+    } while(0)
+
+/**
+ * Reads a whole file.
+ * \param p_file Name of the file.
+ * \param p_data Returns the content of the file.
+ * \return 0 if no error. -1 if the file cannot be read.
+ */
+int read_file(const std::string &p_file, std::vector<unsigned char> *p_data);
+
+/**
+ * Writes a whole file, replacing it.
+ * \param p_file Name of the file.
+ * \param p_data The content of the file.
+ * \return 0 if no error. -1 if the file cannot be written.
+ */
+int write_file(const std::string &p_file, const std::vector<unsigned char> &p_data);
+
+/**
+ * Checks the loading of WY_SerializeAgent in every load mode, and its atomic saves.
+ * \param p_work Directory for temporary files.
+ */
+void check_agent(const std::string &p_work);
+
+/**
+ * Checks round trips of WY_LZCodec and its handling of corrupt input.
+ */
+void check_codec();
+
+/**
+ * Checks WY_Crc32c, and that its CRC32 instruction and table implementations agree.
+ */
+void check_crc32c();
+
+/**
+ * Checks loading files of version 0, the original format without a file header.
+ * \param p_fixtures Directory of the checked-in fixtures.
+ * \param p_work Directory for temporary files.
+ */
+void check_legacy(const std::string &p_fixtures, const std::string &p_work);
+
+/**
+ * Checks log files of WY_SerializeMgr, including commit records with corrupt slots.
+ * \param p_work Directory for temporary files.
+ */
+void check_log(const std::string &p_work);
+
+/**
+ * Checks WY_SerializeMgr beyond loading single files, and WY_SerializeObj.
+ * \param p_work Directory for temporary files.
+ */
+void check_mgr(const std::string &p_work);
+
+/**
+ * Checks WY_SerializeVarint, and that the fast paths of its header decoding agree with decoding one byte at a time.
+ */
+void check_varint();
+
+/**
+ * Checks WY_ByteOrder, the little-endian helpers of WY_SerializeDef.hpp and save files against the checked-in fixtures, and round-trips files through WY_SerializeMgr.
+ * \param p_fixtures Directory of the fixtures.
+ * \param p_work Directory for temporary files.
+ */
+void check_byte_order(const std::string &p_fixtures, const std::string &p_work);
+
+/**
+ * Writes the fixtures checked by check_byte_order(). Only done on little-endian machines without -DWY_SERIALIZE_FORCE_SWAP, when the file format changes on purpose.
+ * \param p_fixtures Directory of the fixtures.
+ * \return 0 if no error. -1 if a fixture cannot be written.
+ */
+int write_byte_order_fixtures(const std::string &p_fixtures);
+
+}
+
+#endif
@@ -0,0 +1,600 @@
+/*
+* Copyright 2023 Au Yeong Wing Yau
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+/**
+ * \file CheckAgent.cpp
+ * Checks WY_SerializeAgent beyond what the byte order checks cover: the memory used by the load modes, unusual blocks, block sizes, CRCs, saves and loads through memory and every I/O backend, and atomic saves.
+*/
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <dirent.h>
+#include <sys/uio.h>
+#include "Check.hpp"
+#include "WY_SerializeAgent.hpp"
+#include "WY_SerializeAllocator.hpp"
+#include "WY_SerializeCodec.hpp"
+#include "WY_SerializeIO.hpp"
+
+using namespace WY_Serialize;
+using namespace WY_SerializeCheck;
+
+/**
+ * A WY_ArenaAllocator that counts the bytes it hands out.
+ */
+class C_CountingAllocator: public WY_SerializeAllocator
+{
+public:
+    C_CountingAllocator(): m_allocated(0) {};
+
+    void * allocate(const uint64_t p_size, const uint64_t p_align) noexcept
+    {
+        m_allocated += p_size;
+        return m_arena.allocate(p_size, p_align);
+    }
+
+    void reset() noexcept
+    {
+        m_allocated = 0;
+        m_arena.reset();
+    }
+
+    uint64_t m_allocated; /**< Bytes allocated since the last reset(). */
+
+private:
+    WY_ArenaAllocator m_arena;
+};
+
+/**
+ * Saves blocks of distinct content to memory.
+ * \param p_count Number of blocks.
+ * \param p_size Size of every block.
+ * \param p_file Returns the save file.
+ */
+static void save_blocks(const unsigned int p_count, const unsigned int p_size, std::vector<unsigned char> *p_file)
+{
+    std::vector<unsigned char> buffer(p_size);
+    S_SerializeData data;
+    init_serializable_data(&data);
+    WY_SerializeAgent agent;
+    agent.set_save_buffer(p_file);
+    agent.prepare_save_file();
+    for(unsigned int i=0; i<p_count; i++) {
+        for(unsigned int j=0; j<p_size; j++)
+            buffer[j] = (unsigned char)(i*31 + j);
+        data.m_type = i+1;
+        data.m_size = p_size;
+        data.m_data = buffer.data();
+        agent.append_save_file(&data);
+    }
+    agent.finalise_save_file();
+}
+
+/**
+ * Checks that load_next_serializable_data() in LOAD_STREAM mode reuses one buffer, so memory does not grow with the number of blocks, and that the other modes still give copies that stay valid.
+ */
+static void check_data_copies()
+{
+    const unsigned int count = 200, size = 3000;
+    std::vector<unsigned char> file;
+    save_blocks(count, size, &file);
+
+    const LOAD_MODE modes[] = {LOAD_BUFFERED, LOAD_MMAP, LOAD_STREAM};
+    for(const LOAD_MODE mode : modes) {
+        C_CountingAllocator allocator;
+        WY_SerializeAgent agent;
+        agent.set_allocator(&allocator);
+        agent.set_load_memory(file.data(), file.size());
+        agent.set_load_mode(mode);
+        agent.set_stream_window(8192);
+        agent.load_from_file();
+        std::vector<unsigned char *> copies;
+        for(unsigned int i=0; i<count; i++) {
+            S_SerializeData data;
+            init_serializable_data(&data);
+            if(agent.load_next_serializable_data(&data) != 0) {
+                CHECK(false);
+                break;
+            }
+            bool same = (data.m_type == i+1) && (data.m_size == size);
+            for(unsigned int j=0; same && (j<size); j++)
+                same = (data.m_data[j] == (unsigned char)(i*31 + j));
+            CHECK(same);
+            copies.push_back(data.m_data);
+            clear_loaded_serializable_data(&data);
+        }
+        CHECK(agent.is_load_end());
+        if(mode == LOAD_STREAM) { /* Only the window, one buffer for all copies. */
+            CHECK(allocator.m_allocated < 2*8192);
+            CHECK((copies.size() == count) && (copies.front() == copies.back()));
+        } else { /* Every copy is its own and still holds its block. */
+            CHECK(allocator.m_allocated >= (uint64_t)count*size);
+            for(unsigned int i=0; i<copies.size(); i++)
+                CHECK(copies[i][0] == (unsigned char)(i*31));
+        }
+        agent.clear_loaded_file_buffer();
+    }
+}
+
+/**
+ * Checks that LOAD_BUFFERED reserves one chunk for the file only, so copying a few blocks does not allocate another chunk as large as the file.
+ */
+static void check_buffer_chunks()
+{
+    const unsigned int count = 200, size = 3000, loaded = 10;
+    std::vector<unsigned char> file;
+    save_blocks(count, size, &file);
+
+    WY_ArenaAllocator arena;
+    WY_SerializeAgent agent;
+    agent.set_allocator(&arena);
+    agent.set_load_memory(file.data(), file.size());
+    agent.set_load_mode(LOAD_BUFFERED);
+    agent.load_from_file();
+    CHECK(arena.get_chunk_count() == 1);
+    for(unsigned int i=0; i<loaded; i++) {
+        S_SerializeData data;
+        init_serializable_data(&data);
+        CHECK((agent.load_next_serializable_data(&data) == 0) && (data.m_type == i+1));
+        clear_loaded_serializable_data(&data);
+    }
+    CHECK(arena.get_chunk_bytes() <= file.size()+64 + 64*1024); /* The file, then one chunk of the default size for the copies. */
+    agent.clear_loaded_file_buffer();
+}
+
+
+/**
+ * Checks that empty blocks load in every mode, in order and through the index.
+ */
+static void check_empty_blocks()
+{
+    const unsigned char byte = 0x5A;
+    std::vector<unsigned char> file;
+    S_SerializeData data;
+    init_serializable_data(&data);
+    WY_SerializeAgent save;
+    save.set_save_buffer(&file);
+    save.set_save_index(true);
+    save.prepare_save_file();
+    data.m_type = 1; /* Empty, between two blocks that are not. */
+    data.m_size = 1;
+    data.m_data = (unsigned char *)&byte;
+    save.append_save_file(&data);
+    data.m_type = 2;
+    data.m_size = 0;
+    data.m_data = NULL;
+    save.append_save_file(&data);
+    data.m_type = 3;
+    data.m_size = 1;
+    data.m_data = (unsigned char *)&byte;
+    save.append_save_file(&data);
+    save.finalise_save_file();
+
+    const LOAD_MODE modes[] = {LOAD_BUFFERED, LOAD_MMAP, LOAD_STREAM};
+    for(const LOAD_MODE mode : modes) {
+        WY_SerializeAgent agent;
+        agent.set_load_memory(file.data(), file.size());
+        agent.set_load_mode(mode);
+        agent.load_from_file();
+        CHECK(agent.has_index());
+        S_SerializeView view;
+        CHECK((agent.load_serializable_view_by_type(2, &view) == 0) && (view.m_size == 0));
+        CHECK((agent.load_serializable_view_by_type(3, &view) == 0) && (view.m_size == 1) && (view.m_data[0] == byte));
+        for(unsigned int i=1; i<=3; i++) {
+            init_serializable_data(&data);
+            CHECK((agent.load_next_serializable_data(&data) == 0) && (data.m_type == i) && (data.m_size == ((i == 2) ? 0u : 1u)));
+            clear_loaded_serializable_data(&data);
+        }
+        CHECK(agent.is_load_end());
+        agent.clear_loaded_file_buffer();
+    }
+}
+
+
+/**
+ * Saves at most one block to memory with the given settings.
+ * \param p_data The block, or NULL to save none.
+ * \param p_crc Whether the block is saved with a CRC32C.
+ * \param p_compact Whether the block is saved with a compact header.
+ * \param p_codec Codec of the save, or NULL.
+ * \param p_block_size Returns the size from get_save_block_size() if p_data is not NULL.
+ * \return Size of the save.
+ */
+static uint64_t save_sized_block(const S_SerializeData *p_data, const bool p_crc, const bool p_compact, const WY_SerializeCodec *p_codec, uint64_t *p_block_size)
+{
+    std::vector<unsigned char> file;
+    WY_SerializeAgent agent;
+    agent.set_save_buffer(&file);
+    agent.set_save_crc(p_crc);
+    agent.set_save_compact(p_compact);
+    agent.set_codec(p_codec);
+    agent.prepare_save_file();
+    if(p_data != NULL) {
+        S_SerializeData data = *p_data;
+        *p_block_size = agent.get_save_block_size(&data);
+        agent.append_save_file(&data);
+    }
+    agent.finalise_save_file();
+    return file.size();
+}
+
+
+/**
+ * Checks that get_save_block_size() gives the bytes a block adds to a save, for every header form and block prefix, and an upper bound when a codec is set.
+ */
+static void check_block_sizes()
+{
+    const uint64_t sizes[] = {0, 1, 100, 300, 70000};
+    const uint32_t instances[] = {0, 7};
+    std::vector<unsigned char> buffer(70000, 0x33);
+    WY_LZCodec codec;
+    S_SerializeData data;
+    init_serializable_data(&data);
+    data.m_type = 0x12345;
+    data.m_data = buffer.data();
+
+    for(unsigned int crc=0; crc<2; crc++) {
+        for(unsigned int compact=0; compact<2; compact++) {
+            const uint64_t empty = save_sized_block(NULL, crc, compact, NULL, NULL);
+            for(const uint64_t size : sizes) {
+                for(const uint32_t instance : instances) {
+                    uint64_t block_size = 0;
+                    data.m_size = size;
+                    data.m_instance = instance;
+                    CHECK(save_sized_block(&data, crc, compact, NULL, &block_size) - empty == block_size);
+                    CHECK(save_sized_block(&data, crc, compact, &codec, &block_size) - empty <= block_size);
+                }
+            }
+        }
+    }
+}
+
+
+/**
+ * Checks that CRC32Cs checked while the file is read find the same corrupt blocks as checks made when the blocks are loaded, for blocks smaller and larger than the reads and the stream window.
+ */
+static void check_crc_reads()
+{
+    const uint64_t sizes[] = {100, 300000, 0, 700000, 5, 262144, 3000};
+    const unsigned int count = sizeof(sizes)/sizeof(sizes[0]);
+    for(unsigned int config=0; config<4; config++) {
+        const bool compact = (config & 1) != 0, index = (config & 2) != 0;
+        std::vector<std::vector<unsigned char>> blocks(count);
+        std::vector<unsigned char> file;
+        WY_SerializeAgent save;
+        save.set_save_buffer(&file);
+        save.set_save_crc(true);
+        save.set_save_compact(compact);
+        save.set_save_index(index);
+        save.set_save_alignment(16);
+        save.prepare_save_file();
+        for(unsigned int i=0; i<count; i++) {
+            blocks[i].resize(sizes[i]);
+            for(uint64_t j=0; j<sizes[i]; j++)
+                blocks[i][j] = (unsigned char)(i + j*7 + (j >> 9));
+            S_SerializeData data;
+            init_serializable_data(&data);
+            data.m_type = i+1;
+            data.m_instance = i;
+            data.m_size = sizes[i];
+            data.m_data = blocks[i].data();
+            save.append_save_file(&data);
+        }
+        save.finalise_save_file();
+
+        std::vector<uint64_t> ends; /* File offset of the end of every block. */
+        WY_SerializeAgent agent;
+        agent.set_load_memory(file.data(), file.size());
+        agent.load_from_file();
+        S_SerializeView view;
+        while(agent.load_next_serializable_view(&view) == 0)
+            ends.push_back(agent.get_load_offset());
+        agent.clear_loaded_file_buffer();
+        CHECK(ends.size() == count);
+        if(ends.size() != count)
+            continue;
+
+        for(unsigned int corrupt=0; corrupt<=count; corrupt++) { /* count is the file without corruption. */
+            if((corrupt < count) && (sizes[corrupt] == 0))
+                continue;
+            std::vector<unsigned char> changed = file;
+            if(corrupt < count)
+                changed[ends[corrupt] - 1 - sizes[corrupt]/2] ^= 0x40;
+            const LOAD_MODE modes[] = {LOAD_BUFFERED, LOAD_MMAP, LOAD_STREAM};
+            for(const LOAD_MODE mode : modes) {
+                WY_SerializeAgent load;
+                load.set_load_memory(changed.data(), changed.size());
+                load.set_load_mode(mode);
+                load.set_stream_window(65536);
+                load.load_from_file();
+                if(index) { /* Lookups first, so the blocks are not loaded in order. */
+                    for(unsigned int i=count; i-- > 0;) {
+                        const bool loaded = (load.load_serializable_view_by_type(i+1, &view) == 0);
+                        CHECK(loaded == (i != corrupt));
+                        CHECK(!loaded || ((view.m_size == sizes[i]) && std::equal(blocks[i].begin(), blocks[i].end(), view.m_data)));
+                    }
+                }
+                unsigned int loaded = 0;
+                while((load.load_next_serializable_view(&view) == 0) && (loaded < count)) {
+                    CHECK((view.m_instance == loaded) && (view.m_size == sizes[loaded]) && std::equal(blocks[loaded].begin(), blocks[loaded].end(), view.m_data));
+                    ++loaded;
+                }
+                CHECK(loaded == std::min(corrupt, count));
+                load.clear_loaded_file_buffer();
+            }
+        }
+    }
+}
+
+
+/**
+ * Gets the size of a block saved by save_options_blocks().
+ * \param p_block Index of the block.
+ * \param p_large Size of the last block, 0 if there is none.
+ * \return Size in bytes.
+ */
+static uint64_t get_options_block_size(const unsigned int p_block, const uint64_t p_large)
+{
+    if(p_block == 40)
+        return p_large;
+    return (p_block % 5 == 4) ? 0 : (p_block*p_block*53) % 7000 + 1;
+}
+
+/**
+ * Saves blocks of different sizes, some empty, with the save options of one of the combinations checked by check_memory_io() and check_io_backends().
+ * \param p_agent The agent, with the file or memory to save to set.
+ * \param p_options Index of the combination of options.
+ * \param p_large Size of one more block at the end, 0 for none.
+ */
+static void save_options_blocks(WY_SerializeAgent *p_agent, const unsigned int p_options, const uint64_t p_large=0)
+{
+    std::vector<std::vector<unsigned char>> blocks((p_large != 0) ? 41 : 40); /* SAVE_VECTORED writes the data of a block after it is appended. */
+    S_SerializeData data;
+    init_serializable_data(&data);
+    p_agent->set_save_mode((p_options & 1) ? SAVE_VECTORED : SAVE_STREAM);
+    p_agent->set_save_index(p_options & 2);
+    p_agent->set_save_crc(p_options & 2);
+    p_agent->set_save_alignment((p_options & 4) ? 64 : 1);
+    p_agent->prepare_save_file();
+    for(unsigned int i=0; i<blocks.size(); i++) {
+        blocks[i].resize(get_options_block_size(i, p_large));
+        for(unsigned int j=0; j<blocks[i].size(); j++)
+            blocks[i][j] = (unsigned char)(i*17 + j);
+        data.m_type = i+1;
+        data.m_size = blocks[i].size();
+        data.m_data = blocks[i].data();
+        p_agent->append_save_file(&data);
+    }
+    p_agent->finalise_save_file();
+}
+
+/**
+ * Loads the blocks saved by save_options_blocks() and compares them.
+ * \param p_agent The agent, with the file or memory to load set.
+ * \param p_large Size of the last block, 0 if there is none.
+ * \return True if every block loaded as it was saved.
+ */
+static bool load_options_blocks(WY_SerializeAgent *p_agent, const uint64_t p_large=0)
+{
+    S_SerializeView view;
+    unsigned int loaded = 0;
+    bool same = true;
+    p_agent->load_from_file();
+    while(same && !p_agent->is_load_end() && (p_agent->load_next_serializable_view(&view) == 0)) {
+        const uint64_t size = get_options_block_size(loaded, p_large);
+        same = (view.m_type == loaded+1) && (view.m_size == size);
+        for(uint64_t j=0; same && (j<size); j++)
+            same = (view.m_data[j] == (unsigned char)(loaded*17 + j));
+        ++loaded;
+    }
+    p_agent->clear_loaded_file_buffer();
+    return same && (loaded == ((p_large != 0) ? 41u : 40u));
+}
+
+/**
+ * Checks that saves through WY_MemoryIO, set with set_io() or by set_save_buffer() and set_save_span(), give the same bytes as a save to a file, and that they load from memory in every mode.
+ * \param p_work Directory for the save file.
+ */
+static void check_memory_io(const std::string &p_work)
+{
+    const std::string name = p_work + "/check_memory.sav";
+    for(unsigned int options=0; options<8; options++) {
+        std::vector<unsigned char> file, buffer, io_buffer, span(1 << 20);
+        WY_SerializeAgent file_agent, buffer_agent, span_agent, io_agent;
+        WY_MemoryIO memory_io;
+        file_agent.set_file_name(name.c_str());
+        save_options_blocks(&file_agent, options);
+        CHECK(read_file(name, &file) == 0);
+        buffer_agent.set_save_buffer(&buffer);
+        save_options_blocks(&buffer_agent, options);
+        CHECK(buffer == file);
+        span_agent.set_save_span(span.data(), span.size());
+        save_options_blocks(&span_agent, options);
+        CHECK((span_agent.get_save_size() == file.size()) && std::equal(file.begin(), file.end(), span.begin()));
+        memory_io.set_buffer(&io_buffer);
+        io_agent.set_file_name("memory"); /* Ignored by WY_MemoryIO. */
+        io_agent.set_io(&memory_io);
+        save_options_blocks(&io_agent, options);
+        CHECK((io_buffer == file) && (memory_io.get_size() == file.size()));
+
+        const LOAD_MODE modes[] = {LOAD_BUFFERED, LOAD_MMAP, LOAD_STREAM};
+        for(const LOAD_MODE mode : modes) {
+            for(unsigned int region=0; region<2; region++) { /* set_load_memory(), then a WY_MemoryIO set with set_io(). */
+                if((region == 1) && (mode == LOAD_MMAP)) /* Maps the file whatever the backend. */
+                    continue;
+                WY_SerializeAgent load;
+                WY_MemoryIO load_io;
+                if(region == 0) {
+                    load.set_load_memory(buffer.data(), buffer.size());
+                } else {
+                    load_io.set_region(buffer.data(), buffer.size());
+                    load.set_file_name("memory");
+                    load.set_io(&load_io);
+                }
+                load.set_load_mode(mode);
+                load.set_stream_window(8192);
+                CHECK(load_options_blocks(&load));
+            }
+        }
+    }
+    remove(name.c_str());
+}
+
+/**
+ * Checks that saves through every built-in I/O backend, and through a WY_UringIO with chunks small enough that a file spans many, give the same bytes as a save to memory and load back. The blocks include one of several default chunks with an unaligned tail, so O_DIRECT reads and writes mix aligned chunks with unaligned heads and tails read through the page cache. Also checks that WY_UringIO reads at unaligned offsets, and fails reads past the end of the file. The io_uring backends are skipped where io_uring is not available.
+ * \param p_work Directory for the save file.
+ */
+static void check_io_backends(const std::string &p_work)
+{
+    const std::string name = p_work + "/check_backend.sav";
+    const uint64_t large = 3*1024*1024 + 1001;
+    const unsigned int options[] = {0, 1, 3, 5}; /* Both save modes, with an index and CRCs, with aligned blocks. */
+    const IO_BACKEND backends[] = {IO_BACKEND_FSTREAM, IO_BACKEND_POSIX, IO_BACKEND_URING, IO_BACKEND_URING_DIRECT};
+    WY_UringIO probe;
+    const bool uring = (probe.open_file(name.c_str(), IO_OPEN_CREATE) == 0) && probe.is_ring_active();
+    probe.close_file();
+    if(!uring)
+        std::cout << "io_uring is not available, its backends are not checked.\n";
+
+    std::vector<unsigned char> reference, file;
+    for(const unsigned int option : options) {
+        WY_SerializeAgent memory;
+        memory.set_save_buffer(&reference);
+        save_options_blocks(&memory, option, large);
+        for(unsigned int backend=0; backend<6; backend++) { /* The built-in backends, then a WY_UringIO of 8 KB chunks without and with O_DIRECT. */
+            if((backend >= 2) && !uring)
+                break;
+            WY_UringIO chunked_io(2, 8192);
+            chunked_io.set_direct(backend == 5);
+            const auto set_backend = [&](WY_SerializeAgent *p_agent) {
+                p_agent->set_file_name(name.c_str());
+                if(backend < 4)
+                    p_agent->set_io_backend(backends[backend]);
+                else
+                    p_agent->set_io(&chunked_io);
+            };
+            WY_SerializeAgent save;
+            set_backend(&save);
+            save_options_blocks(&save, option, large);
+            CHECK((read_file(name, &file) == 0) && (file == reference));
+
+            const LOAD_MODE modes[] = {LOAD_BUFFERED, LOAD_STREAM};
+            for(const LOAD_MODE mode : modes) {
+                WY_SerializeAgent load;
+                set_backend(&load);
+                load.set_load_mode(mode);
+                load.set_stream_window(65536);
+                CHECK(load_options_blocks(&load, large));
+            }
+        }
+    }
+
+    for(unsigned int direct=0; uring && (direct<2); direct++) {
+        WY_UringIO io(2, 8192);
+        io.set_direct(direct == 1);
+        const uint64_t size = file.size();
+        struct iovec iov[2] = {{file.data()+100, size-100}, {file.data(), 100}};
+        CHECK(io.open_file(name.c_str(), IO_OPEN_CREATE) == 0); /* The first chunk starts unaligned and ends aligned, then the head is written. */
+        CHECK((io.write_file(&iov[0], 1, 100) == 0) && (io.write_file(&iov[1], 1, 0) == 0) && (io.close_file() == 0));
+        std::vector<unsigned char> written;
+        CHECK((read_file(name, &written) == 0) && (written == file));
+        std::unique_ptr<unsigned char, decltype(&free)> buffer((unsigned char *)aligned_alloc(4096, (size + 8192 + 4095) & ~(uint64_t)4095), &free);
+        CHECK(io.open_file(name.c_str(), IO_OPEN_READ) == 0);
+        CHECK((io.read_file(buffer.get(), size, 0) == 0) && std::equal(file.begin(), file.end(), buffer.get()));
+        CHECK((io.read_file(buffer.get()+1, size-4097, 4097) == 0) && std::equal(file.begin()+4097, file.end(), buffer.get()+1));
+        CHECK(io.read_file(buffer.get(), size+8192, 0) != 0); /* The last chunk comes up short. */
+        CHECK(io.close_file() == 0);
+    }
+    remove(name.c_str());
+}
+
+/**
+ * Counts the files in a directory whose name starts with a prefix.
+ * \param p_dir The directory.
+ * \param p_prefix The prefix.
+ * \return Number of files.
+ */
+static unsigned int count_files(const std::string &p_dir, const std::string &p_prefix)
+{
+    unsigned int count = 0;
+    DIR * const dir = opendir(p_dir.c_str());
+    if(dir == NULL)
+        return 0;
+    while(const struct dirent * const entry = readdir(dir)) {
+        if(strncmp(entry->d_name, p_prefix.c_str(), p_prefix.size()) == 0)
+            ++count;
+    }
+    closedir(dir);
+    return count;
+}
+
+/**
+ * Checks that atomic saves to the same file in progress at once each have their own temporary file, and that none is left behind.
+ * \param p_work Directory for the save files.
+ */
+static void check_atomic_saves(const std::string &p_work)
+{
+    const std::string name = "check_atomic.sav";
+    const std::string file = p_work + "/" + name;
+    const unsigned char values[3] = {1, 2, 3};
+    S_SerializeData data;
+    init_serializable_data(&data);
+    data.m_type = 1;
+    data.m_size = 1;
+
+    {
+        WY_SerializeAgent agents[3];
+        for(unsigned int i=0; i<3; i++) {
+            agents[i].set_file_name(file.c_str());
+            agents[i].set_save_atomic(true);
+            agents[i].prepare_save_file();
+        }
+        CHECK(count_files(p_work, name) == 3); /* Only the temporary files. */
+        for(unsigned int i=0; i<3; i++) {
+            data.m_data = (unsigned char *)&values[i];
+            agents[i].append_save_file(&data);
+        }
+        agents[1].finalise_save_file();
+        agents[0].finalise_save_file(); /* The last save to finish replaces the file. */
+        CHECK(count_files(p_work, name) == 2); /* The file and the save of agents[2], which is never finalised. */
+    }
+    CHECK(count_files(p_work, name) == 1);
+
+    WY_SerializeAgent load;
+    load.set_file_name(file.c_str());
+    load.load_from_file();
+    S_SerializeView view;
+    CHECK((load.load_next_serializable_view(&view) == 0) && (view.m_size == 1) && (view.m_data[0] == values[0]));
+    load.clear_loaded_file_buffer();
+    remove(file.c_str());
+}
+
+
+void WY_SerializeCheck::check_agent(const std::string &p_work)
+{
+    check_data_copies();
+    check_buffer_chunks();
+    check_empty_blocks();
+    check_block_sizes();
+    check_crc_reads();
+    check_memory_io(p_work);
+    check_io_backends(p_work);
+    check_atomic_saves(p_work);
+}
@@ -0,0 +1,400 @@
+/*
+* Copyright 2023 Au Yeong Wing Yau
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+/**
+ * \file CheckByteOrder.cpp
+ * Checks that save files are little-endian whatever the byte order of the build. The fixtures were written by a little-endian build. Every build must write the same bytes for the same blocks and load the same values from them. <br>
+ * A build with -DWY_SERIALIZE_FORCE_SWAP on a little-endian machine swaps values that are already little-endian, so it writes big-endian files. It checks that every field is swapped and that its own files load, but not the fixtures.
+*/
+#include <cstring>
+#include <cstdio>
+#include "Check.hpp"
+#include "WY_ByteOrder.hpp"
+#include "WY_SerializeAgent.hpp"
+#include "WY_SerializeCodec.hpp"
+#include "WY_SerializeColumns.hpp"
+#include "WY_SerializeMgr.hpp"
+#include "WY_SerializeObj.hpp"
+
+using namespace WY_Serialize;
+using namespace WY_SerializeCheck;
+
+/**
+ * A record saved as a columnar block in the fixtures.
+ */
+struct S_FixtureRecord {
+    uint32_t m_id; /**< Increasing IDs, stored as COLUMN_DELTA. */
+    double m_x; /**< Stored as COLUMN_SHUFFLE. */
+    int16_t m_level; /**< Stored as COLUMN_RAW. */
+    char m_tag[3]; /**< Not a number, stored as it is in memory. */
+};
+
+/**
+ * The values saved in the fixtures, computed the same way on every machine.
+ */
+struct S_FixtureValues {
+    std::vector<uint16_t> m_u16;
+    std::vector<uint32_t> m_u32;
+    std::vector<uint64_t> m_u64;
+    std::vector<double> m_f64;
+    std::vector<S_FixtureRecord> m_records;
+    std::vector<uint32_t> m_pattern; /**< Repeats, so the block is encoded by the codec. */
+
+    S_FixtureValues()
+    {
+        for(unsigned int i=0; i<9; i++)
+            m_u16.push_back(0x0102*i + 1);
+        for(unsigned int i=0; i<13; i++)
+            m_u32.push_back(0x01020304u*i + 5);
+        for(unsigned int i=0; i<7; i++)
+            m_u64.push_back(0x0102030405060708ULL*i + i);
+        for(unsigned int i=0; i<10; i++)
+            m_f64.push_back(i*1.5 - 3.25);
+        for(unsigned int i=0; i<40; i++) {
+            S_FixtureRecord record;
+            memset(&record, 0, sizeof(record));
+            record.m_id = 1000 + 3*i;
+            record.m_x = 0.125*i*i;
+            record.m_level = (int16_t)(i*977 - 20000);
+            record.m_tag[0] = 'a' + i%26;
+            record.m_tag[1] = 'A' + i%7;
+            record.m_tag[2] = 0;
+            m_records.push_back(record);
+        }
+        for(unsigned int i=0; i<160; i++)
+            m_pattern.push_back(0xA0B0C000u + i%8);
+    }
+};
+
+/**
+ * Settings of a fixture file.
+ */
+struct S_Fixture {
+    const char * m_name; /**< File name in the fixture directory. */
+    bool m_compact; /**< Compact block headers. */
+    bool m_crc; /**< CRC32C on every block. */
+    bool m_index; /**< Block index at the end. */
+    unsigned int m_alignment; /**< Alignment of block data. */
+};
+
+static const bool g_forced = WY_ByteOrder::is_swapping() && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__); /**< Whether this build swaps on a little-endian machine, so its files are big-endian. */
+
+static const S_Fixture g_fixtures[] = {
+    {"fixture_le.bin", false, true, true, 1},
+    {"fixture_le_compact.bin", true, false, false, 16},
+}; /**< The checked-in fixtures. */
+
+
+/**
+ * Writes the blocks of a fixture into memory.
+ * \param p_fixture Settings of the fixture.
+ * \param p_file Returns the file.
+ */
+static void save_fixture(const S_Fixture &p_fixture, std::vector<unsigned char> *p_file)
+{
+    const S_FixtureValues values;
+    WY_LZCodec codec;
+    WY_SerializeColumns<S_FixtureRecord> columns;
+    std::vector<unsigned char> buffers[6];
+    S_SerializeData data[6];
+
+    columns.add_column(&S_FixtureRecord::m_id, COLUMN_DELTA);
+    columns.add_column(&S_FixtureRecord::m_x, COLUMN_SHUFFLE);
+    columns.add_column(&S_FixtureRecord::m_level);
+    columns.add_column(&S_FixtureRecord::m_tag);
+    columns.set_codec(&codec);
+
+    for(unsigned int i=0; i<6; i++) {
+        init_serializable_data(&data[i]);
+        data[i].m_type = i+1;
+    }
+    CHECK(WY_ByteOrder::save_array(values.m_u16.data(), values.m_u16.size(), &buffers[0], &data[0]) == 0);
+    CHECK(WY_ByteOrder::save_array(values.m_u32.data(), values.m_u32.size(), &buffers[1], &data[1]) == 0);
+    CHECK(WY_ByteOrder::save_array(values.m_u64.data(), values.m_u64.size(), &buffers[2], &data[2]) == 0);
+    CHECK(WY_ByteOrder::save_array(values.m_f64.data(), values.m_f64.size(), &buffers[3], &data[3]) == 0);
+    CHECK(columns.save_columns(values.m_records.data(), values.m_records.size(), &buffers[4], &data[4]) == 0);
+    data[4].m_instance = 7;
+    CHECK(WY_ByteOrder::save_array(values.m_pattern.data(), values.m_pattern.size(), &buffers[5], &data[5]) == 0);
+
+    WY_SerializeAgent agent;
+    agent.set_save_buffer(p_file);
+    agent.set_save_compact(p_fixture.m_compact);
+    agent.set_save_crc(p_fixture.m_crc);
+    agent.set_save_index(p_fixture.m_index);
+    agent.set_save_alignment(p_fixture.m_alignment);
+    agent.set_codec(&codec, 512); /* Only the last block is that large. */
+    agent.prepare_save_file();
+    for(S_SerializeData &block : data)
+        agent.append_save_file(&block);
+    agent.finalise_save_file();
+}
+
+
+/**
+ * Loads the next block of a fixture.
+ * \param p_agent The agent the fixture is loaded with.
+ * \param p_type The type the block must have.
+ * \param p_instance The instance the block must have.
+ * \param p_view Returns the block. Empty if it cannot be loaded or is not of that type and instance.
+ * \return True if the block was loaded.
+ */
+static bool load_block(WY_SerializeAgent &p_agent, const unsigned int p_type, const uint32_t p_instance, S_SerializeView *p_view)
+{
+    if((p_agent.load_next_serializable_view(p_view) == 0) && (p_view->m_type == p_type) && (p_view->m_instance == p_instance))
+        return true;
+    p_view->m_size = 0;
+    p_view->m_data = NULL;
+    return false;
+}
+
+
+/**
+ * Loads a fixture and checks every value in it.
+ * \param p_fixture Settings of the fixture.
+ * \param p_file The file.
+ */
+static void load_fixture(const S_Fixture &p_fixture, const std::vector<unsigned char> &p_file)
+{
+    const S_FixtureValues values;
+    WY_LZCodec codec;
+    WY_SerializeColumns<S_FixtureRecord> columns;
+    std::vector<uint16_t> u16;
+    std::vector<uint32_t> u32, pattern, ids;
+    std::vector<uint64_t> u64;
+    std::vector<double> f64, xs;
+    std::vector<S_FixtureRecord> records;
+    S_SerializeView view;
+
+    columns.add_column(&S_FixtureRecord::m_id, COLUMN_DELTA);
+    columns.add_column(&S_FixtureRecord::m_x, COLUMN_SHUFFLE);
+    columns.add_column(&S_FixtureRecord::m_level);
+    columns.add_column(&S_FixtureRecord::m_tag);
+    columns.set_codec(&codec);
+
+    for(LOAD_MODE mode : {LOAD_BUFFERED, LOAD_MMAP, LOAD_STREAM}) {
+        WY_SerializeAgent agent;
+        agent.set_load_memory(p_file.data(), p_file.size());
+        agent.set_load_mode(mode);
+        agent.load_from_file();
+        CHECK(agent.has_index() == p_fixture.m_index);
+        CHECK(load_block(agent, 1, 0, &view));
+        CHECK((WY_ByteOrder::load_array(view.m_size, view.m_data, &u16) == 0) && (u16 == values.m_u16));
+        CHECK(load_block(agent, 2, 0, &view));
+        CHECK((WY_ByteOrder::load_array(view.m_size, view.m_data, &u32) == 0) && (u32 == values.m_u32));
+        CHECK(load_block(agent, 3, 0, &view));
+        CHECK((WY_ByteOrder::load_array(view.m_size, view.m_data, &u64) == 0) && (u64 == values.m_u64));
+        CHECK(load_block(agent, 4, 0, &view));
+        CHECK((WY_ByteOrder::load_array(view.m_size, view.m_data, &f64) == 0) && (f64 == values.m_f64));
+        CHECK(load_block(agent, 5, 7, &view));
+        CHECK((columns.load_columns(view.m_size, view.m_data, &records) == 0) && (records.size() == values.m_records.size()));
+        for(uint64_t i=0; i<records.size() && i<values.m_records.size(); i++) {
+            const S_FixtureRecord &a = records[i], &b = values.m_records[i];
+            CHECK((a.m_id == b.m_id) && (a.m_x == b.m_x) && (a.m_level == b.m_level) && (memcmp(a.m_tag, b.m_tag, sizeof(a.m_tag)) == 0));
+        }
+        CHECK((WY_ColumnBlock::read_column(view.m_data, view.m_size, 0, &ids, &codec) == 0) && (ids.size() == 40) && (ids[39] == values.m_records[39].m_id));
+        CHECK((WY_ColumnBlock::read_column(view.m_data, view.m_size, 1, &xs, &codec) == 0) && (xs.size() == 40) && (xs[17] == values.m_records[17].m_x));
+        CHECK(load_block(agent, 6, 0, &view));
+        CHECK((WY_ByteOrder::load_array(view.m_size, view.m_data, &pattern) == 0) && (pattern == values.m_pattern));
+        CHECK(agent.is_load_end());
+        if(p_fixture.m_index) {
+            u64.clear();
+            CHECK((agent.load_serializable_view_by_type(3, &view) == 0) && (WY_ByteOrder::load_array(view.m_size, view.m_data, &u64) == 0));
+            CHECK(u64 == values.m_u64);
+        }
+        agent.clear_loaded_file_buffer();
+    }
+}
+
+
+/**
+ * Checks the fields of the fixture without compact headers that are not covered by loading it: the file header, the first block header and the block encoded by the codec.
+ * \param p_file The fixture without compact headers.
+ */
+static void check_fixture_layout(const std::vector<unsigned char> &p_file)
+{
+    static const unsigned char file_header[] = {'W', 'Y', 'S', 'E', 'R', 'I', 'A', 'L', 2, 0, 0, 0, 0, 0, 0, 0};
+    static const unsigned char block_header[] = {1, 0, 0, 0, 0, 1, 0, 0, 4+18, 0, 0, 0, 0, 0, 0, 0}; /* Type 1, SERIALIZE_FLAG_CRC, CRC and 9 values of 2 bytes. */
+    static const unsigned char first_values[] = {1, 0, 3, 1, 5, 2}; /* 0x0001, 0x0103, 0x0205 */
+
+    if(p_file.size() < 64) {
+        CHECK(false);
+        return;
+    }
+    CHECK(memcmp(p_file.data(), file_header, sizeof(file_header)) == 0);
+    CHECK(memcmp(p_file.data()+16, block_header, sizeof(block_header)) == 0);
+    CHECK(memcmp(p_file.data()+36, first_values, sizeof(first_values)) == 0);
+    CHECK(decode_le64(p_file.data()+p_file.size()-8) == SERIALIZE_INDEX_MAGIC);
+    CHECK(p_file[p_file.size()-24] == 6); /* Entries in the index. */
+}
+
+
+/**
+ * Checks swap_array() against a plain loop for every value size, with counts and offsets that cover the vector loops and their tails.
+ */
+static void check_swap_array()
+{
+    std::vector<unsigned char> src(1024+8), dst(1024+8), expect(1024+8);
+    for(uint64_t i=0; i<src.size(); i++)
+        src[i] = (unsigned char)(i*7 + 3);
+
+    for(unsigned int size : {1u, 2u, 4u, 8u}) {
+        for(uint64_t count : {0ull, 1ull, 3ull, 7ull, 8ull, 15ull, 16ull, 17ull, 31ull, 33ull, 64ull, 127ull}) {
+            for(unsigned int offset : {0u, 1u, 3u}) {
+                if(offset + count*size > 1024)
+                    continue;
+                for(uint64_t i=0; i<count; i++)
+                    for(unsigned int j=0; j<size; j++)
+                        expect[i*size+j] = src[offset + i*size + size-1-j];
+                std::fill(dst.begin(), dst.end(), 0xEE);
+                WY_ByteOrder::swap_array(src.data()+offset, dst.data()+offset, count, size);
+                CHECK(memcmp(dst.data()+offset, expect.data(), count*size) == 0);
+                CHECK(dst[offset+count*size] == 0xEE); /* Nothing written past the end. */
+                std::vector<unsigned char> inplace(src);
+                WY_ByteOrder::swap_array(inplace.data()+offset, inplace.data()+offset, count, size);
+                CHECK(memcmp(inplace.data()+offset, expect.data(), count*size) == 0);
+            }
+        }
+    }
+}
+
+
+/**
+ * Checks the little-endian helpers and the block header encoding against fixed bytes. A forced swap build must write every field in the opposite order.
+ */
+static void check_helpers()
+{
+    static const unsigned char le_bytes[] = {4, 3, 2, 1, 6, 5, 0, 0, 0x0E, 0x0D, 0x0C, 0x0B, 0x0A, 9, 8, 7};
+    static const unsigned char be_bytes[] = {1, 2, 3, 4, 0, 0, 5, 6, 7, 8, 9, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E};
+    const unsigned char * const header_bytes = g_forced ? be_bytes : le_bytes;
+    const S_SerializeHeader header = {0x01020304, 0x0506, 0x0708090A0B0C0D0EULL};
+    S_SerializeHeader decoded;
+    unsigned char bytes[16];
+
+    encode_serialize_header(bytes, &header);
+    CHECK(memcmp(bytes, header_bytes, sizeof(le_bytes)) == 0);
+    decode_serialize_header(header_bytes, &decoded);
+    CHECK((decoded.m_type == header.m_type) && (decoded.m_flags == header.m_flags) && (decoded.m_size == header.m_size));
+    encode_le32(bytes, 0xA1B2C3D4);
+    CHECK((bytes[g_forced ? 3 : 0] == 0xD4) && (bytes[g_forced ? 0 : 3] == 0xA1) && (decode_le32(bytes) == 0xA1B2C3D4));
+    encode_le64(bytes, 0x1122334455667788ULL);
+    CHECK((bytes[g_forced ? 7 : 0] == 0x88) && (bytes[g_forced ? 0 : 7] == 0x11) && (decode_le64(bytes) == 0x1122334455667788ULL));
+
+    const uint32_t value = 0x01020304;
+    unsigned char encoded[4];
+    uint32_t decoded_value;
+    WY_ByteOrder::encode_array(&value, 1, encoded);
+    CHECK((encoded[g_forced ? 3 : 0] == 4) && (encoded[g_forced ? 0 : 3] == 1));
+    WY_ByteOrder::decode_array(encoded, 1, &decoded_value);
+    CHECK(decoded_value == value);
+}
+
+
+/**
+ * An object that saves an array of doubles with WY_ByteOrder.
+ */
+class C_ArrayObj: public WY_SerializeObj
+{
+public:
+    std::vector<double> m_values; /**< The data of the object. */
+
+    int get_save_data(S_SerializeData *__restrict__ const p_data) noexcept
+    {
+        p_data->m_type = 1;
+        return WY_ByteOrder::save_array(m_values.data(), m_values.size(), &m_buffer, p_data);
+    }
+
+    int get_load_data(const uint64_t p_size, const unsigned char *__restrict__ const p_data) noexcept
+    {
+        return WY_ByteOrder::load_array(p_size, p_data, &m_values);
+    }
+
+private:
+    std::vector<unsigned char> m_buffer; /**< Swapped values while they are saved. */
+};
+
+
+/**
+ * Saves and loads objects through WY_SerializeMgr with combinations of the save settings and every load mode.
+ * \param p_work Directory for the save file.
+ */
+static void check_round_trips(const std::string &p_work)
+{
+    const std::string file = p_work + "/check_byte_order.sav";
+    C_ArrayObj saved[5], loaded[5];
+    WY_LZCodec codec;
+
+    for(unsigned int i=0; i<5; i++)
+        for(unsigned int j=0; j<100*i*i; j++)
+            saved[i].m_values.push_back(j%16 + i*0.5);
+
+    for(unsigned int config=0; config<32; config++) {
+        WY_SerializeMgr save;
+        for(unsigned int i=0; i<5; i++)
+            (config & 16) ? save.add_serialize_obj(&saved[i], 1, i) : save.add_serialize_obj(&saved[i]);
+        save.set_save_compact(config & 1);
+        save.set_save_crc(config & 2);
+        save.set_save_index(config & 4);
+        save.set_save_alignment((config & 8) ? 64 : 1);
+        save.set_codec(&codec, 64);
+        save.save_all_objs(file.c_str());
+
+        for(LOAD_MODE mode : {LOAD_BUFFERED, LOAD_MMAP, LOAD_STREAM}) {
+            WY_SerializeMgr load;
+            for(unsigned int i=0; i<5; i++) {
+                loaded[i].m_values.clear();
+                (config & 16) ? load.add_serialize_obj(&loaded[i], 1, i) : load.add_serialize_obj(&loaded[i]);
+            }
+            load.set_load_mode(mode);
+            load.set_codec(&codec);
+            load.load_all_objs(file.c_str());
+            for(unsigned int i=0; i<5; i++)
+                CHECK(loaded[i].m_values == saved[i].m_values);
+        }
+    }
+    remove(file.c_str());
+}
+
+
+void WY_SerializeCheck::check_byte_order(const std::string &p_fixtures, const std::string &p_work)
+{
+    check_helpers();
+    check_swap_array();
+    for(const S_Fixture &fixture : g_fixtures) {
+        if(g_forced)
+            break;
+        std::vector<unsigned char> expect, file;
+        CHECK(read_file(p_fixtures + "/" + fixture.m_name, &expect) == 0);
+        save_fixture(fixture, &file);
+        CHECK(file == expect); /* Same bytes as the little-endian build that wrote the fixture. */
+        load_fixture(fixture, expect);
+        if(!fixture.m_compact)
+            check_fixture_layout(expect);
+    }
+    check_round_trips(p_work);
+}
+
+
+int WY_SerializeCheck::write_byte_order_fixtures(const std::string &p_fixtures)
+{
+    for(const S_Fixture &fixture : g_fixtures) {
+        std::vector<unsigned char> file;
+        save_fixture(fixture, &file);
+        if(write_file(p_fixtures + "/" + fixture.m_name, file) != 0)
+            return -1;
+    }
+    return 0;
+}
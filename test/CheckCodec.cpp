@@ -0,0 +1,177 @@
+/*
+* Copyright 2023 Au Yeong Wing Yau
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+/**
+ * \file CheckCodec.cpp
+ * Checks that WY_LZCodec round-trips data of every kind, and that it rejects corrupt input without writing past the decoded size.
+*/
+#include <algorithm>
+#include <cstring>
+#include <random>
+#include "Check.hpp"
+#include "WY_SerializeAgent.hpp"
+#include "WY_SerializeCodec.hpp"
+
+using namespace WY_Serialize;
+using namespace WY_SerializeCheck;
+
+static const unsigned int g_guard_size = 64; /**< Bytes after the decoded data that decoding must not touch. */
+static const unsigned char g_guard_byte = 0xCD; /**< Value of the guard bytes. */
+
+/**
+ * Decodes into a buffer followed by guard bytes.
+ * \param p_codec The codec.
+ * \param p_encoded The encoded data.
+ * \param p_decoded_size Size the data decodes to.
+ * \param p_decoded Returns the decoded data.
+ * \return Result of WY_LZCodec::decode(). -2 if the guard bytes were overwritten.
+ */
+static int decode_guarded(const WY_LZCodec &p_codec, const std::vector<unsigned char> &p_encoded, const uint64_t p_decoded_size, std::vector<unsigned char> *p_decoded)
+{
+    p_decoded->assign(p_decoded_size+g_guard_size, g_guard_byte);
+    const int result = p_codec.decode(p_encoded.data(), p_encoded.size(), p_decoded->data(), p_decoded_size);
+    for(unsigned int i=0; i<g_guard_size; i++) {
+        if((*p_decoded)[p_decoded_size+i] != g_guard_byte)
+            return -2;
+    }
+    p_decoded->resize(p_decoded_size);
+    return result;
+}
+
+/**
+ * Makes the inputs of the round trips: empty, tiny, random, runs, short repeats and text-like data, in sizes around the codec's limits.
+ * \param p_inputs Returns the inputs.
+ */
+static void make_inputs(std::vector<std::vector<unsigned char>> *p_inputs)
+{
+    std::mt19937 rng(9);
+    const uint64_t sizes[] = {0, 1, 4, 12, 13, 16, 17, 100, 4096, 65535, 65536, 65537, 300000};
+    for(const uint64_t size : sizes) {
+        for(unsigned int kind=0; kind<5; kind++) {
+            std::vector<unsigned char> input(size);
+            for(uint64_t i=0; i<size; i++) {
+                switch(kind) {
+                case 0: input[i] = (unsigned char)rng(); break; /* Incompressible. */
+                case 1: input[i] = 7; break; /* One long run, overlapping matches. */
+                case 2: input[i] = (unsigned char)(i%3); break; /* Short period. */
+                case 3: input[i] = (unsigned char)((i/100)%5 + (i%11)); break; /* Matches at many offsets. */
+                default: input[i] = ((rng() & 7) == 0) ? (unsigned char)rng() : (unsigned char)('a' + i%26); break; /* Mostly repeats with noise. */
+                }
+            }
+            p_inputs->push_back(input);
+        }
+    }
+    std::vector<unsigned char> far(200000); /* Repeats further apart than the largest offset. */
+    for(uint64_t i=0; i<far.size(); i++)
+        far[i] = (unsigned char)((i%70000)*2654435761u >> 13);
+    p_inputs->push_back(far);
+}
+
+/**
+ * Checks encoding and decoding of every input.
+ */
+static void check_round_trips(const WY_LZCodec &p_codec, const std::vector<std::vector<unsigned char>> &p_inputs)
+{
+    for(const std::vector<unsigned char> &input : p_inputs) {
+        std::vector<unsigned char> encoded(input.size() + input.size()/255 + 64), decoded;
+        const uint64_t size = p_codec.encode(input.data(), input.size(), encoded.data(), encoded.size());
+        CHECK((size != 0) || input.empty());
+        encoded.resize(size);
+        CHECK(p_codec.get_max_decoded_size(size) >= input.size());
+        CHECK((decode_guarded(p_codec, encoded, input.size(), &decoded) == 0) && (decoded == input));
+        if(input.size() > 16) { /* A wrong size is an error, never a short or long result. */
+            CHECK(decode_guarded(p_codec, encoded, input.size()-1, &decoded) == -1);
+            CHECK(decode_guarded(p_codec, encoded, input.size()+1, &decoded) == -1);
+        }
+        if(size > 1) { /* Does not fit, so nothing is encoded. */
+            std::vector<unsigned char> small(size-1);
+            CHECK(p_codec.encode(input.data(), input.size(), small.data(), small.size()) == 0);
+        }
+    }
+}
+
+/**
+ * Checks that truncated and corrupt input fails or decodes to something without overrunning the output.
+ */
+static void check_corruption(const WY_LZCodec &p_codec, const std::vector<std::vector<unsigned char>> &p_inputs)
+{
+    std::mt19937 rng(10);
+    for(const std::vector<unsigned char> &input : p_inputs) {
+        if(input.size() < 100)
+            continue;
+        std::vector<unsigned char> encoded(input.size() + input.size()/255 + 64), decoded;
+        encoded.resize(p_codec.encode(input.data(), input.size(), encoded.data(), encoded.size()));
+        for(unsigned int i=1; i<8; i++) { /* Only an empty last token can be cut off and still give all the data. */
+            const std::vector<unsigned char> truncated(encoded.begin(), encoded.end()-std::max<size_t>(encoded.size()*i/8, 1));
+            const int result = decode_guarded(p_codec, truncated, input.size(), &decoded);
+            CHECK((result == -1) || ((result == 0) && (decoded == input)));
+        }
+        for(unsigned int i=0; i<50; i++) {
+            std::vector<unsigned char> corrupt = encoded;
+            corrupt[rng()%corrupt.size()] ^= (unsigned char)(1u << (rng()%8));
+            const int result = decode_guarded(p_codec, corrupt, input.size(), &decoded);
+            CHECK((result == 0) || (result == -1));
+        }
+    }
+}
+
+/**
+ * Checks that a save with a CRC reports a corrupt encoded block as an error in every load mode.
+ */
+static void check_corrupt_blocks(const WY_LZCodec &p_codec, const std::vector<std::vector<unsigned char>> &p_inputs)
+{
+    std::vector<unsigned char> file;
+    WY_SerializeAgent save;
+    save.set_save_buffer(&file);
+    save.set_save_crc(true);
+    save.set_codec(&p_codec, 0);
+    save.prepare_save_file();
+    const std::vector<unsigned char> &input = p_inputs[3*5+3]; /* 12 bytes of matches, encoded. */
+    S_SerializeData data;
+    init_serializable_data(&data);
+    data.m_type = 1;
+    data.m_size = input.size();
+    data.m_data = (unsigned char *)input.data();
+    save.append_save_file(&data);
+    save.finalise_save_file();
+
+    const LOAD_MODE modes[] = {LOAD_BUFFERED, LOAD_MMAP, LOAD_STREAM};
+    for(const LOAD_MODE mode : modes) {
+        for(uint64_t offset=SERIALIZE_FILE_HEADER_SIZE; offset<file.size(); offset++) {
+            std::vector<unsigned char> corrupt = file;
+            corrupt[offset] ^= 0x10;
+            WY_SerializeAgent agent;
+            agent.set_load_memory(corrupt.data(), corrupt.size());
+            agent.set_load_mode(mode);
+            agent.load_from_file();
+            S_SerializeView view;
+            CHECK(agent.load_next_serializable_view(&view) != 0);
+            agent.clear_loaded_file_buffer();
+        }
+    }
+}
+
+
+void WY_SerializeCheck::check_codec()
+{
+    WY_LZCodec codec;
+    std::vector<std::vector<unsigned char>> inputs;
+    make_inputs(&inputs);
+    check_round_trips(codec, inputs);
+    check_corruption(codec, inputs);
+    check_corrupt_blocks(codec, inputs);
+}
@@ -0,0 +1,83 @@
+/*
+* Copyright 2023 Au Yeong Wing Yau
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+/**
+ * \file CheckCrc32c.cpp
+ * Checks WY_Crc32c against the standard check value, and the CRC32 instruction against the table implementation on data of every length and alignment.
+*/
+#include <cstring>
+#include <random>
+#include "Check.hpp"
+#include "WY_Crc32c.hpp"
+
+using namespace WY_Serialize;
+using namespace WY_SerializeCheck;
+
+/**
+ * Computes a CRC32C one bit at a time, straight from the definition of the polynomial.
+ * \param p_data The data.
+ * \param p_size Size of p_data.
+ * \return CRC32C of p_data.
+ */
+static uint32_t crc32c_bitwise(const unsigned char *p_data, const uint64_t p_size)
+{
+    uint32_t crc = 0xFFFFFFFF;
+    for(uint64_t i=0; i<p_size; i++) {
+        crc ^= p_data[i];
+        for(unsigned int bit=0; bit<8; bit++)
+            crc = (crc >> 1) ^ (0x82F63B78 & (0u - (crc & 1)));
+    }
+    return crc ^ 0xFFFFFFFF;
+}
+
+
+void WY_SerializeCheck::check_crc32c()
+{
+    const unsigned char check[] = "123456789";
+    const bool hardware = WY_Crc32c::is_hardware();
+    CHECK(WY_Crc32c::update(0, check, 9) == 0xE3069283);
+    CHECK(WY_Crc32c::update_software(0, check, 9) == 0xE3069283);
+    CHECK(!hardware || (WY_Crc32c::update_hardware(0, check, 9) == 0xE3069283));
+    CHECK(WY_Crc32c::update(0, check, 0) == 0);
+    CHECK(WY_Crc32c::update(WY_Crc32c::update(0, check, 4), check+4, 5) == 0xE3069283);
+
+    std::mt19937 rng(10);
+    std::vector<unsigned char> data(100000 + 64);
+    for(unsigned char &byte : data)
+        byte = (unsigned char)rng();
+    std::vector<uint64_t> sizes; /* Around the sizes of the three stream loops of the hardware version, and random ones. */
+    for(uint64_t size=0; size<300; size++)
+        sizes.push_back(size);
+    const uint64_t edges[] = {3*256, 3*8192, 3*8192+3*256};
+    for(const uint64_t edge : edges) {
+        for(uint64_t size=edge-9; size<edge+9; size++)
+            sizes.push_back(size);
+    }
+    for(unsigned int i=0; i<30; i++)
+        sizes.push_back(rng() % 100000);
+
+    for(const uint64_t size : sizes) {
+        for(unsigned int offset=0; offset<8; offset++) {
+            const unsigned char * const start = data.data()+offset;
+            const uint32_t expected = crc32c_bitwise(start, size);
+            CHECK(WY_Crc32c::update_software(0, start, size) == expected);
+            CHECK(!hardware || (WY_Crc32c::update_hardware(0, start, size) == expected));
+            const uint64_t split = (size == 0) ? 0 : rng() % size; /* Any split of the data gives the same CRC. */
+            CHECK(WY_Crc32c::update(WY_Crc32c::update(0, start, split), start+split, size-split) == expected);
+        }
+    }
+}
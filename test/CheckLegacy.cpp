@@ -0,0 +1,205 @@
+/*
+* Copyright 2023 Au Yeong Wing Yau
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+/**
+ * \file CheckLegacy.cpp
+ * Checks that files of version 0, the original format with 8 byte block headers and no file header, load in every load mode. fixture_v0.bin was written by the Demo of the original release: a DemoObj1 block and a DemoObj2 block holding "Hello World!".
+*/
+#include <cstring>
+#include <random>
+#include "Check.hpp"
+#include "WY_ByteOrder.hpp"
+#include "WY_SerializeAgent.hpp"
+#include "WY_SerializeMgr.hpp"
+#include "WY_SerializeObj.hpp"
+
+using namespace WY_Serialize;
+using namespace WY_SerializeCheck;
+
+/**
+ * An object that keeps the data of the block it is loaded from.
+ */
+class C_BlockObj: public WY_SerializeObj
+{
+public:
+    int get_save_data(S_SerializeData *__restrict__ const p_data) noexcept
+    {
+        p_data->m_type = 1;
+        p_data->m_size = m_data.size();
+        p_data->m_data = m_data.data();
+        return 0;
+    }
+
+    int get_load_data(const uint64_t p_size, const unsigned char *__restrict__ const p_data) noexcept
+    {
+        m_data.assign(p_data, p_data+p_size);
+        return 0;
+    }
+
+    std::vector<unsigned char> m_data; /**< The data of the object. */
+};
+
+/**
+ * A block expected in a file.
+ */
+struct S_Block {
+    uint32_t m_type; /**< Type of the block. */
+    std::vector<unsigned char> m_data; /**< Data of the block. */
+};
+
+/**
+ * Loads every block of a file in memory with an agent.
+ * \param p_file The file.
+ * \param p_mode The load mode.
+ * \param p_window Stream window, 0 for the default.
+ * \param p_blocks Returns the blocks.
+ * \return True if the file loaded to its end.
+ */
+static bool load_blocks(const std::vector<unsigned char> &p_file, const LOAD_MODE p_mode, const uint64_t p_window, std::vector<S_Block> *p_blocks)
+{
+    WY_SerializeAgent agent;
+    S_SerializeView view;
+    agent.set_load_memory(p_file.data(), p_file.size());
+    agent.set_load_mode(p_mode);
+    if(p_window != 0)
+        agent.set_stream_window(p_window);
+    try {
+        agent.load_from_file();
+    } catch (int &e) {
+        return false;
+    }
+    p_blocks->clear();
+    while(agent.load_next_serializable_view(&view) == 0)
+        p_blocks->push_back({view.m_type, std::vector<unsigned char>(view.m_data, view.m_data+view.m_size)});
+    const bool end = agent.is_load_end();
+    agent.clear_loaded_file_buffer();
+    return end;
+}
+
+/**
+ * Checks that a file loads with the expected blocks in every load mode.
+ * \param p_file The file.
+ * \param p_expect The blocks of the file.
+ */
+static void check_blocks(const std::vector<unsigned char> &p_file, const std::vector<S_Block> &p_expect)
+{
+    const LOAD_MODE modes[] = {LOAD_BUFFERED, LOAD_MMAP, LOAD_STREAM};
+    const uint64_t windows[] = {0, 64}; /* A small window is refilled many times. */
+    std::vector<S_Block> blocks;
+    for(const LOAD_MODE mode : modes) {
+        for(const uint64_t window : windows) {
+            CHECK(load_blocks(p_file, mode, window, &blocks));
+            CHECK(blocks.size() == p_expect.size());
+            for(size_t i=0; (i<blocks.size()) && (i<p_expect.size()); i++)
+                CHECK((blocks[i].m_type == p_expect[i].m_type) && (blocks[i].m_data == p_expect[i].m_data));
+        }
+    }
+}
+
+/**
+ * Writes blocks with the 8 byte headers of version 0.
+ * \param p_blocks The blocks.
+ * \param p_file Returns the file.
+ */
+static void write_legacy_file(const std::vector<S_Block> &p_blocks, std::vector<unsigned char> *p_file)
+{
+    p_file->clear();
+    for(const S_Block &block : p_blocks) {
+        unsigned char header[SERIALIZE_LEGACY_HEADER_SIZE];
+        encode_le32(header, block.m_type);
+        encode_le32(header+4, block.m_data.size());
+        p_file->insert(p_file->end(), header, header+sizeof(header));
+        p_file->insert(p_file->end(), block.m_data.begin(), block.m_data.end());
+    }
+}
+
+/**
+ * Checks the fixture written by the original release, through WY_SerializeAgent and WY_SerializeMgr, and that it cannot be appended to.
+ * \param p_fixtures Directory of the fixtures.
+ * \param p_work Directory for temporary files.
+ */
+static void check_fixture(const std::string &p_fixtures, const std::string &p_work)
+{
+    std::vector<unsigned char> file;
+    CHECK(read_file(p_fixtures + "/fixture_v0.bin", &file) == 0);
+    CHECK(file.size() == 2*SERIALIZE_LEGACY_HEADER_SIZE + 36 + 13);
+
+    S_Block obj1 = {1, std::vector<unsigned char>(36, 0)}; /* struct {int s_int; char s_char[32];} */
+    encode_le32(obj1.m_data.data(), 123);
+    memcpy(obj1.m_data.data()+4, "Hello 123", 9);
+    const char hello[] = "Hello World!";
+    const S_Block obj2 = {2, std::vector<unsigned char>(hello, hello+sizeof(hello))};
+    check_blocks(file, {obj1, obj2});
+
+    const std::string name = p_work + "/check_legacy.sav";
+    CHECK(write_file(name, file) == 0);
+    C_BlockObj objs[2];
+    WY_SerializeMgr mgr;
+    for(C_BlockObj &obj : objs)
+        mgr.add_serialize_obj(&obj);
+    mgr.load_all_objs(name.c_str());
+    CHECK((objs[0].m_data == obj1.m_data) && (objs[1].m_data == obj2.m_data));
+
+    WY_SerializeAgent agent;
+    agent.set_file_name(name.c_str());
+    bool thrown = false;
+    try {
+        agent.prepare_append_file(file.size());
+    } catch (int &e) {
+        thrown = true;
+    }
+    CHECK(thrown);
+    std::vector<unsigned char> after;
+    CHECK((read_file(name, &after) == 0) && (after == file));
+    remove(name.c_str());
+}
+
+
+void WY_SerializeCheck::check_legacy(const std::string &p_fixtures, const std::string &p_work)
+{
+    if(!WY_ByteOrder::is_swapping()) /* The fixture is little-endian, a swapping build reads it as big-endian. */
+        check_fixture(p_fixtures, p_work);
+
+    /* Files of many blocks, empty ones among them. */
+    std::mt19937 rng(0);
+    for(unsigned int n=1; n<=40; n++) {
+        std::vector<S_Block> blocks(n);
+        for(S_Block &block : blocks) {
+            block.m_type = 1 + rng() % 1000;
+            block.m_data.resize((rng() % 4 == 0) ? 0 : rng() % 300);
+            for(unsigned char &byte : block.m_data)
+                byte = (unsigned char)rng();
+        }
+        std::vector<unsigned char> file;
+        write_legacy_file(blocks, &file);
+        check_blocks(file, blocks);
+
+        /* One byte less or more and the last block or header is incomplete. */
+        std::vector<unsigned char> cut(file.begin(), file.end()-1);
+        std::vector<S_Block> loaded;
+        CHECK(!load_blocks(cut, LOAD_BUFFERED, 0, &loaded) || (loaded.size() != blocks.size()));
+        cut = file;
+        cut.push_back(0);
+        CHECK(!load_blocks(cut, LOAD_BUFFERED, 0, &loaded) || (loaded.size() != blocks.size()));
+    }
+
+    /* Also parses as one empty block with a 16 byte header, with flags of 8. It is still version 0. */
+    const S_Block zeros = {1, std::vector<unsigned char>(8, 0)};
+    std::vector<unsigned char> file;
+    write_legacy_file({zeros}, &file);
+    check_blocks(file, {zeros});
+}
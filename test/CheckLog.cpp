@@ -0,0 +1,135 @@
+/*
+* Copyright 2023 Au Yeong Wing Yau
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+/**
+ * \file CheckLog.cpp
+ * Checks log files written by WY_SerializeMgr::save_changed_objs(), and that a corrupt commit record ends the log instead of being trusted.
+*/
+#include <cstdio>
+#include "Check.hpp"
+#include "WY_SerializeMgr.hpp"
+#include "WY_SerializeObj.hpp"
+
+using namespace WY_Serialize;
+using namespace WY_SerializeCheck;
+
+/**
+ * An object holding one value, saved as 4 bytes.
+ */
+class C_ValueObj: public WY_SerializeObj
+{
+public:
+    C_ValueObj(): m_value(0) {};
+
+    int get_save_data(S_SerializeData *__restrict__ const p_data) noexcept
+    {
+        encode_le32(m_data, m_value);
+        p_data->m_type = 1;
+        p_data->m_size = sizeof(m_data);
+        p_data->m_data = m_data;
+        return 0;
+    }
+
+    int get_load_data(const uint64_t p_size, const unsigned char *__restrict__ const p_data) noexcept
+    {
+        if(p_size != sizeof(m_data))
+            return -1;
+        m_value = decode_le32(p_data);
+        return 0;
+    }
+
+    uint32_t m_value; /**< The data of the object. */
+
+private:
+    unsigned char m_data[4]; /**< m_value while it is saved. */
+};
+
+/**
+ * Loads a log into new objects.
+ * \param p_file The log file.
+ * \param p_values Returns the value of every object.
+ * \return True if the log loaded.
+ */
+static bool load_values(const std::string &p_file, std::vector<uint32_t> *p_values)
+{
+    C_ValueObj objs[3];
+    WY_SerializeMgr mgr;
+    for(C_ValueObj &obj : objs)
+        mgr.add_serialize_obj(&obj);
+    try {
+        mgr.load_all_objs(p_file.c_str());
+    } catch (int &e) {
+        return false;
+    }
+    p_values->clear();
+    for(const C_ValueObj &obj : objs)
+        p_values->push_back(obj.m_value);
+    return true;
+}
+
+
+void WY_SerializeCheck::check_log(const std::string &p_work)
+{
+    const std::string file = p_work + "/check_log.sav";
+    const std::vector<uint32_t> first = {10, 11, 12}, second = {10, 21, 12};
+    std::vector<unsigned char> log, corrupt;
+    std::vector<uint32_t> values;
+
+    remove(file.c_str());
+    {
+        C_ValueObj objs[3];
+        WY_SerializeMgr mgr;
+        for(unsigned int i=0; i<3; i++) {
+            objs[i].m_value = first[i];
+            mgr.add_serialize_obj(&objs[i]);
+        }
+        mgr.save_changed_objs(file.c_str()); /* The objects do not track changes, so both commits have all of them. */
+        objs[1].m_value = second[1];
+        mgr.save_changed_objs(file.c_str());
+    }
+    CHECK(read_file(file, &log) == 0);
+    CHECK(load_values(file, &values) && (values == second));
+
+    /* The file ends with the second commit record, whose last 4 bytes are the slot of object 2. A slot beyond the objects, or beyond the blocks of the log, ends the log before that commit instead of growing the tables of the slots. */
+    const unsigned char changes[] = {0x80, 0x01, 0x7F};
+    const size_t bytes[] = {1, 2, 3}; /* Counted from the end of the file. */
+    for(unsigned int i=0; i<3; i++) {
+        if(log.size() < bytes[i])
+            break;
+        corrupt = log;
+        corrupt[corrupt.size()-bytes[i]] ^= changes[i];
+        CHECK(write_file(file, corrupt) == 0);
+        CHECK(load_values(file, &values) && (values == first));
+        WY_SerializeMgr compact;
+        try {
+            compact.compact_log_file(file.c_str());
+        } catch (int &e) {
+            CHECK(false);
+        }
+        CHECK(load_values(file, &values) && (values == first));
+    }
+
+    CHECK(write_file(file, log) == 0);
+    WY_SerializeMgr compact;
+    try {
+        compact.compact_log_file(file.c_str());
+    } catch (int &e) {
+        CHECK(false);
+    }
+    CHECK(load_values(file, &values) && (values == second));
+    remove(file.c_str());
+}
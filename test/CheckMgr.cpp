@@ -0,0 +1,641 @@
+/*
+* Copyright 2023 Au Yeong Wing Yau
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+/**
+ * \file CheckMgr.cpp
+ * Checks WY_SerializeMgr: objects written against the original WY_SerializeObj interface, failing loads, saves and loads with threads, asynchronous saves and sharded saves. Also checks WY_StaticSerializeMgr against it.
+*/
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <future>
+#include <thread>
+#include <tuple>
+#include <vector>
+#include "Check.hpp"
+#include "WY_SerializeCodec.hpp"
+#include "WY_SerializeMgr.hpp"
+#include "WY_SerializeObj.hpp"
+#include "WY_SerializePod.hpp"
+#include "WY_StaticSerializeMgr.hpp"
+
+using namespace WY_Serialize;
+using namespace WY_SerializeCheck;
+
+/**
+ * An object that only overrides get_load_data() with the unsigned int size of the original interface.
+ */
+class C_OldObj: public WY_SerializeObj
+{
+public:
+    C_OldObj(): m_value(0), m_fail(false) {};
+
+    int get_save_data(S_SerializeData *__restrict__ const p_data) noexcept
+    {
+        encode_le32(m_data, m_value);
+        p_data->m_type = 1;
+        p_data->m_size = sizeof(m_data);
+        p_data->m_data = m_data;
+        return 0;
+    }
+
+    int get_load_data(const unsigned int p_size, const unsigned char *__restrict__ const p_data) noexcept
+    {
+        if(m_fail || (p_size != sizeof(m_data)))
+            return -1;
+        m_value = decode_le32(p_data);
+        return 0;
+    }
+
+    uint32_t m_value; /**< The data of the object. */
+    bool m_fail; /**< Whether get_load_data() fails. */
+
+private:
+    unsigned char m_data[4]; /**< m_value while it is saved. */
+};
+
+/**
+ * An object holding any number of bytes, saved as one block.
+ */
+class C_DataObj: public WY_SerializeObj
+{
+public:
+    using WY_SerializeObj::get_load_data;
+
+    C_DataObj(): m_type(1) {};
+
+    int get_save_data(S_SerializeData *__restrict__ const p_data) noexcept
+    {
+        p_data->m_type = m_type;
+        p_data->m_size = m_data.size();
+        p_data->m_data = m_data.data();
+        return 0;
+    }
+
+    int get_load_data(const uint64_t p_size, const unsigned char *__restrict__ const p_data) noexcept
+    {
+        try {
+            m_data.assign(p_data, p_data+p_size);
+        } catch (std::exception &e) {
+            return -1;
+        }
+        return 0;
+    }
+
+    std::vector<unsigned char> m_data; /**< The data of the object. */
+    unsigned int m_type; /**< Type of its block. */
+};
+
+/**
+ * An object whose get_load_data() is not thread-safe. It records on which thread it was loaded, and how many objects were loaded before it.
+ */
+class C_UnsafeObj: public C_DataObj
+{
+public:
+    using C_DataObj::get_load_data;
+
+    C_UnsafeObj(): m_loads(NULL), m_loads_before(0) {};
+
+    int get_load_data(const uint64_t p_size, const unsigned char *__restrict__ const p_data) noexcept
+    {
+        m_thread = std::this_thread::get_id();
+        m_loads_before = m_loads->fetch_add(1);
+        return C_DataObj::get_load_data(p_size, p_data);
+    }
+
+    bool is_load_thread_safe() noexcept {return false;};
+
+    std::atomic<unsigned int> * m_loads; /**< Loads of all objects so far. */
+    std::thread::id m_thread; /**< Thread of the last load. */
+    unsigned int m_loads_before; /**< Value of m_loads at the last load. */
+};
+
+/**
+ * A C_DataObj that counts its loads.
+ */
+class C_CountedObj: public C_DataObj
+{
+public:
+    using C_DataObj::get_load_data;
+
+    C_CountedObj(): m_loads(NULL) {};
+
+    int get_load_data(const uint64_t p_size, const unsigned char *__restrict__ const p_data) noexcept
+    {
+        m_loads->fetch_add(1);
+        return C_DataObj::get_load_data(p_size, p_data);
+    }
+
+    std::atomic<unsigned int> * m_loads; /**< Loads of all objects so far. */
+};
+
+/**
+ * Data of C_PointObj.
+ */
+struct S_Point {
+    uint32_t m_x; /**< First coordinate. */
+    uint32_t m_y; /**< Second coordinate. */
+};
+
+/**
+ * An object of constant block size.
+ */
+class C_PointObj: public WY_SerializePod<C_PointObj, S_Point, 7>
+{
+public:
+    using WY_SerializePod::m_data;
+};
+
+/**
+ * Data of C_RangeObj.
+ */
+struct S_Range {
+    uint64_t m_first; /**< First value. */
+    uint64_t m_last; /**< Last value. */
+    uint16_t m_step; /**< Step between values. */
+};
+
+/**
+ * Another object of constant block size, whose struct has padding.
+ */
+class C_RangeObj: public WY_SerializePod<C_RangeObj, S_Range, 8>
+{
+public:
+    using WY_SerializePod::m_data;
+};
+
+/**
+ * Gives objects data of different sizes, some empty and some larger than others, so sharded saves have something to balance.
+ * \param p_objs The objects.
+ * \param p_count Number of objects.
+ * \param p_seed Changes the content of the data.
+ */
+static void fill_objs(C_DataObj *p_objs, const unsigned int p_count, const unsigned int p_seed)
+{
+    for(unsigned int i=0; i<p_count; i++) {
+        p_objs[i].m_type = i+1;
+        p_objs[i].m_data.resize((i % 4 == 3) ? 0 : (i*i*97) % 5000 + 1);
+        for(unsigned int j=0; j<p_objs[i].m_data.size(); j++)
+            p_objs[i].m_data[j] = (unsigned char)(p_seed + i*31 + j);
+    }
+}
+
+/**
+ * Checks whether two sets of objects hold the same data.
+ * \param p_a The first objects.
+ * \param p_b The second objects.
+ * \param p_count Number of objects.
+ * \return True if they are the same.
+ */
+static bool same_objs(const C_DataObj *p_a, const C_DataObj *p_b, const unsigned int p_count)
+{
+    for(unsigned int i=0; i<p_count; i++) {
+        if(p_a[i].m_data != p_b[i].m_data)
+            return false;
+    }
+    return true;
+}
+
+/**
+ * Checks whether a file exists.
+ * \param p_file Name of the file.
+ * \return True if it exists.
+ */
+static bool file_exists(const std::string &p_file)
+{
+    FILE * const file = fopen(p_file.c_str(), "rb");
+    if(file == NULL)
+        return false;
+    fclose(file);
+    return true;
+}
+
+/**
+ * Checks whether loading a file into a WY_SerializeMgr throws.
+ * \param p_mgr The manager.
+ * \param p_file Name of the file.
+ * \return True if load_all_objs() threw.
+ */
+static bool load_throws(WY_SerializeMgr *p_mgr, const std::string &p_file)
+{
+    try {
+        p_mgr->load_all_objs(p_file.c_str());
+    } catch (int &e) {
+        return true;
+    }
+    return false;
+}
+
+/**
+ * Checks that objects overriding the unsigned int get_load_data() are loaded, and that a failing get_load_data() makes the load throw, serially and with threads.
+ * \param p_work Directory for temporary files.
+ */
+static void check_old_objs(const std::string &p_work)
+{
+    const std::string name = p_work + "/check_mgr_old.sav";
+    C_OldObj saved[3];
+    WY_SerializeMgr save;
+    for(unsigned int i=0; i<3; i++) {
+        saved[i].m_value = 5+i;
+        save.add_serialize_obj(&saved[i]);
+    }
+    save.save_all_objs(name.c_str());
+
+    for(unsigned int threads=1; threads<=2; threads++) {
+        C_OldObj loaded[3];
+        WY_SerializeMgr load;
+        load.set_thread_count(threads);
+        for(C_OldObj &obj : loaded)
+            load.add_serialize_obj(&obj);
+        load.load_all_objs(name.c_str());
+        CHECK((loaded[0].m_value == 5) && (loaded[1].m_value == 6) && (loaded[2].m_value == 7));
+
+        loaded[1].m_fail = true;
+        bool thrown = false;
+        try {
+            load.load_all_objs(name.c_str());
+        } catch (int &e) {
+            thrown = true;
+        }
+        CHECK(thrown);
+    }
+
+    C_OldObj obj; /* The uint64_t overload of the base class only passes on sizes that fit. */
+    WY_SerializeObj &base = obj;
+    unsigned char data[4];
+    encode_le32(data, 9);
+    CHECK((base.get_load_data((uint64_t)4, data) == 0) && (obj.m_value == 9));
+    CHECK(base.get_load_data((uint64_t)UINT32_MAX + 5, data) != 0);
+    remove(name.c_str());
+}
+
+/**
+ * Checks that a save with threads, which writes blocks in any order at reserved offsets, gives the same file as a serial save, with the save options that change the layout of blocks and with objects added with a key.
+ * \param p_work Directory for temporary files.
+ */
+static void check_parallel_saves(const std::string &p_work)
+{
+    const unsigned int count = 60;
+    const std::string name = p_work + "/check_mgr_parallel.sav";
+    const WY_LZCodec codec;
+    C_DataObj saved[count];
+    fill_objs(saved, count, 3);
+    for(unsigned int option=0; option<7; option++) { /* Plain, index and CRCs, compact headers, aligned blocks, a codec, keys, SAVE_VECTORED and the POSIX backend. */
+        std::vector<unsigned char> serial, parallel, file;
+        WY_SerializeMgr mgr;
+        for(unsigned int i=0; i<count; i++) {
+            if(option == 5)
+                mgr.add_serialize_obj(&saved[i], 1 + i%3, i);
+            else
+                mgr.add_serialize_obj(&saved[i]);
+        }
+        mgr.set_save_index(option == 1);
+        mgr.set_save_crc(option == 1);
+        mgr.set_save_compact(option == 2);
+        mgr.set_save_alignment((option == 3) ? 64 : 1);
+        mgr.set_codec((option == 4) ? &codec : NULL, 64);
+        if(option == 6) {
+            mgr.set_save_mode(SAVE_VECTORED);
+            mgr.set_io_backend(IO_BACKEND_POSIX);
+        }
+        mgr.save_all_objs(&serial);
+        mgr.set_thread_count(4);
+        mgr.save_all_objs(&parallel);
+        mgr.save_all_objs(name.c_str());
+        CHECK(parallel == serial);
+        CHECK((read_file(name, &file) == 0) && (file == serial));
+
+        C_DataObj loaded[count];
+        WY_SerializeMgr load;
+        for(unsigned int i=0; i<count; i++) {
+            if(option == 5)
+                load.add_serialize_obj(&loaded[i], 1 + i%3, i);
+            else
+                load.add_serialize_obj(&loaded[i]);
+        }
+        load.set_thread_count(4);
+        load.load_all_objs(name.c_str());
+        CHECK(same_objs(saved, loaded, count));
+    }
+    remove(name.c_str());
+}
+
+/**
+ * Checks that loads with threads call get_load_data() of objects that are not thread-safe on the calling thread, after all other objects and in the order they were added, from a file in every load mode that uses threads, from memory and from a sharded save.
+ * \param p_work Directory for temporary files.
+ */
+static void check_unsafe_loads(const std::string &p_work)
+{
+    const unsigned int count = 30;
+    const std::string name = p_work + "/check_mgr_unsafe.sav";
+    const std::string manifest = p_work + "/check_mgr_unsafe.man";
+    const char * const dirs[2] = {p_work.c_str(), p_work.c_str()};
+    C_DataObj saved[count];
+    std::vector<unsigned char> buffer;
+    WY_SerializeMgr save;
+    fill_objs(saved, count, 7);
+    for(C_DataObj &obj : saved)
+        save.add_serialize_obj(&obj);
+    save.save_all_objs(name.c_str());
+    save.save_all_objs(&buffer);
+    remove(manifest.c_str());
+    save.save_all_objs_sharded(manifest.c_str(), dirs, 2);
+
+    for(unsigned int source=0; source<4; source++) { /* LOAD_BUFFERED, LOAD_MMAP, memory, the manifest. */
+        std::atomic<unsigned int> loads(0);
+        C_CountedObj safe[count];
+        C_UnsafeObj unsafe[count];
+        WY_SerializeObj * loaded[count];
+        WY_SerializeMgr load;
+        load.set_thread_count(4);
+        load.set_load_mode((source == 1) ? LOAD_MMAP : LOAD_BUFFERED);
+        for(unsigned int i=0; i<count; i++) { /* Every third object is not thread-safe. */
+            safe[i].m_loads = &loads;
+            unsafe[i].m_loads = &loads;
+            loaded[i] = (i % 3 == 1) ? (WY_SerializeObj *)&unsafe[i] : (WY_SerializeObj *)&safe[i];
+            load.add_serialize_obj(loaded[i]);
+        }
+        if(source == 2)
+            load.load_all_objs(buffer.data(), buffer.size());
+        else
+            load.load_all_objs(((source == 3) ? manifest : name).c_str());
+
+        CHECK(loads == count);
+        unsigned int order = count - count/3;
+        for(unsigned int i=0; i<count; i++) {
+            const C_DataObj &obj = (i % 3 == 1) ? (C_DataObj &)unsafe[i] : (C_DataObj &)safe[i];
+            CHECK(obj.m_data == saved[i].m_data);
+            if(i % 3 == 1) {
+                CHECK(unsafe[i].m_thread == std::this_thread::get_id());
+                CHECK(unsafe[i].m_loads_before == order++);
+            }
+        }
+    }
+    remove(name.c_str());
+    remove((manifest + ".1.0").c_str());
+    remove((manifest + ".1.1").c_str());
+    remove(manifest.c_str());
+}
+
+/**
+ * Checks save_all_objs_async(): changing the objects once it returns does not change what is saved, the future and the callback report the result of each save, an IO error included, and the destructor waits for pending saves.
+ * \param p_work Directory for temporary files.
+ */
+static void check_async_saves(const std::string &p_work)
+{
+    const unsigned int count = 20, saves = 3;
+    const std::string name = p_work + "/check_mgr_async";
+    C_DataObj objs[count], expected[saves][count];
+    std::future<int> results[saves];
+    std::atomic<int> callbacks[saves];
+    {
+        WY_SerializeMgr save;
+        for(C_DataObj &obj : objs)
+            save.add_serialize_obj(&obj);
+        for(unsigned int k=0; k<saves; k++) { /* Each save is started, then the objects change in place and in size before it can complete. */
+            fill_objs(objs, count, k);
+            for(unsigned int i=0; i<count; i++)
+                expected[k][i].m_data = objs[i].m_data;
+            callbacks[k] = 1;
+            std::atomic<int> &callback = callbacks[k];
+            results[k] = save.save_all_objs_async((name + std::to_string(k) + ".sav").c_str(), [&callback](const int p_status) { callback = p_status; });
+            for(C_DataObj &obj : objs) {
+                std::fill(obj.m_data.begin(), obj.m_data.end(), 0xEE);
+                obj.m_data.resize(obj.m_data.size()/2);
+            }
+        }
+        CHECK(results[0].get() == 0);
+        CHECK(callbacks[0] == 0);
+
+        std::atomic<int> failed_callback(1); /* Fails to open the file, and saves after it still run. */
+        std::future<int> failed = save.save_all_objs_async((p_work + "/check_mgr_missing/async.sav").c_str(), [&failed_callback](const int p_status) { failed_callback = p_status; });
+        std::future<int> after = save.save_all_objs_async((name + ".after.sav").c_str());
+        CHECK(failed.get() == -1);
+        CHECK(failed_callback == -1);
+        CHECK(after.get() == 0);
+        remove((name + ".after.sav").c_str());
+    } /* Waits for the saves still pending. */
+
+    for(unsigned int k=0; k<saves; k++) {
+        if(k != 0) /* The first was already taken. */
+            CHECK((results[k].wait_for(std::chrono::seconds(0)) == std::future_status::ready) && (results[k].get() == 0));
+        CHECK(callbacks[k] == 0);
+        C_DataObj loaded[count];
+        WY_SerializeMgr load;
+        for(C_DataObj &obj : loaded)
+            load.add_serialize_obj(&obj);
+        load.load_all_objs((name + std::to_string(k) + ".sav").c_str());
+        CHECK(same_objs(expected[k], loaded, count));
+        remove((name + std::to_string(k) + ".sav").c_str());
+    }
+}
+
+/**
+ * Checks save_all_objs_sharded() and loading its manifest: a round trip in every load mode, the removal of the shards of the previous save when saving again with fewer shards, and that a corrupt manifest or a missing shard makes the load throw.
+ * \param p_work Directory for temporary files.
+ */
+static void check_sharded(const std::string &p_work)
+{
+    const unsigned int count = 12;
+    const std::string manifest = p_work + "/check_mgr_shard.man";
+    const char * const dirs[3] = {p_work.c_str(), p_work.c_str(), p_work.c_str()};
+    const std::string shards[2][3] = {
+        {manifest + ".1.0", manifest + ".1.1", manifest + ".1.2"},
+        {manifest + ".2.0", manifest + ".2.1", ""}
+    };
+    C_DataObj saved[count];
+    WY_SerializeMgr save;
+    remove(manifest.c_str());
+    fill_objs(saved, count, 0);
+    for(C_DataObj &obj : saved)
+        save.add_serialize_obj(&obj);
+    save.set_save_crc(true);
+    save.save_all_objs_sharded(manifest.c_str(), dirs, 3);
+    for(const std::string &shard : shards[0])
+        CHECK(file_exists(shard));
+
+    const LOAD_MODE modes[] = {LOAD_BUFFERED, LOAD_MMAP, LOAD_STREAM};
+    for(const LOAD_MODE mode : modes) {
+        for(unsigned int threads=1; threads<=2; threads++) {
+            C_DataObj loaded[count];
+            WY_SerializeMgr load;
+            load.set_load_mode(mode);
+            load.set_thread_count(threads);
+            for(C_DataObj &obj : loaded)
+                load.add_serialize_obj(&obj);
+            load.load_all_objs(manifest.c_str());
+            CHECK(same_objs(saved, loaded, count));
+        }
+    }
+
+    fill_objs(saved, count, 1); /* Saved again over two shards, the three of the first save go. */
+    save.save_all_objs_sharded(manifest.c_str(), dirs, 2);
+    for(const std::string &shard : shards[0])
+        CHECK(!file_exists(shard));
+    CHECK(file_exists(shards[1][0]) && file_exists(shards[1][1]));
+    C_DataObj loaded[count];
+    WY_SerializeMgr load;
+    for(C_DataObj &obj : loaded)
+        load.add_serialize_obj(&obj);
+    load.load_all_objs(manifest.c_str());
+    CHECK(same_objs(saved, loaded, count));
+
+    std::vector<unsigned char> file, changed; /* The generation is not checked by read_manifest(), only the CRC of the manifest catches a change to it. */
+    unsigned char magic[8];
+    encode_le64(magic, SERIALIZE_MANIFEST_MAGIC);
+    CHECK(read_file(manifest, &file) == 0);
+    const auto data = std::search(file.begin(), file.end(), magic, magic+8);
+    CHECK(file.end()-data > 8);
+    if(file.end()-data > 8) {
+        changed = file;
+        changed[data-file.begin()+8] ^= 0x40;
+        CHECK(write_file(manifest, changed) == 0);
+        CHECK(load_throws(&load, manifest));
+        CHECK(write_file(manifest, file) == 0);
+        CHECK(!load_throws(&load, manifest));
+    }
+
+    remove(shards[1][1].c_str());
+    CHECK(load_throws(&load, manifest));
+    remove(shards[1][0].c_str());
+    remove(manifest.c_str());
+}
+
+/**
+ * Checks that a WY_StaticSerializeMgr and a WY_SerializeMgr of the same objects save the same bytes and load each other's files, and that WY_StaticSerializeMgr rejects files it cannot load: version 0 files and files saved with options.
+ * \tparam Ts The types of the objects.
+ * \param p_work Directory for temporary files.
+ * \param p_saved The objects to save, holding their data.
+ * \param p_loaded Objects of the same types to load into.
+ * \param p_same Checks whether both sets of objects hold the same data.
+ */
+template <typename... Ts, typename F>
+static void check_static_objs(const std::string &p_work, std::tuple<Ts &...> p_saved, std::tuple<Ts &...> p_loaded, F p_same)
+{
+    const std::string name = p_work + "/check_mgr_static.sav";
+    const std::string dynamic_name = p_work + "/check_mgr_dynamic.sav";
+    std::vector<unsigned char> static_file, dynamic_file;
+    WY_StaticSerializeMgr<Ts...> static_save = std::make_from_tuple<WY_StaticSerializeMgr<Ts...>>(p_saved);
+    WY_StaticSerializeMgr<Ts...> static_load = std::make_from_tuple<WY_StaticSerializeMgr<Ts...>>(p_loaded);
+    WY_SerializeMgr dynamic_save, dynamic_load;
+    std::apply([&](auto &... p_objs) { (dynamic_save.add_serialize_obj(&p_objs), ...); }, p_saved);
+    std::apply([&](auto &... p_objs) { (dynamic_load.add_serialize_obj(&p_objs), ...); }, p_loaded);
+    const auto reset = [&]() { /* So a load that does nothing is caught. */
+        std::apply([](auto &... p_objs) { ((p_objs = std::remove_reference_t<decltype(p_objs)>()), ...); }, p_loaded);
+    };
+
+    static_save.save_all_objs(name.c_str());
+    dynamic_save.save_all_objs(dynamic_name.c_str());
+    CHECK((read_file(name, &static_file) == 0) && (read_file(dynamic_name, &dynamic_file) == 0));
+    CHECK(static_file == dynamic_file);
+    if(WY_StaticSerializeMgr<Ts...>::m_fixed)
+        CHECK(static_file.size() == WY_StaticSerializeMgr<Ts...>::m_file_size);
+
+    dynamic_load.load_all_objs(name.c_str());
+    CHECK(p_same());
+    reset();
+    static_load.load_all_objs(dynamic_name.c_str());
+    CHECK(p_same());
+
+    /* Version 0: the same blocks with 8 byte headers and no file header. */
+    std::vector<unsigned char> legacy;
+    std::apply([&](auto &... p_objs) {
+        const auto add_block = [&](WY_SerializeObj &p_obj) {
+            S_SerializeData data;
+            init_serializable_data(&data);
+            p_obj.get_save_data(&data);
+            unsigned char header[SERIALIZE_LEGACY_HEADER_SIZE];
+            encode_le32(header, data.m_type);
+            encode_le32(header+4, (uint32_t)data.m_size);
+            legacy.insert(legacy.end(), header, header+SERIALIZE_LEGACY_HEADER_SIZE);
+            legacy.insert(legacy.end(), data.m_data, data.m_data+data.m_size);
+        };
+        (add_block(p_objs), ...);
+    }, p_saved);
+    CHECK(write_file(name, legacy) == 0);
+    reset();
+    dynamic_load.load_all_objs(name.c_str());
+    CHECK(p_same());
+    bool thrown = false;
+    try {
+        static_load.load_all_objs(name.c_str());
+    } catch (int &e) {
+        thrown = true;
+    }
+    CHECK(thrown);
+
+    for(unsigned int option=0; option<3; option++) { /* CRCs, compact headers, aligned blocks. */
+        WY_SerializeMgr options;
+        std::apply([&](auto &... p_objs) { (options.add_serialize_obj(&p_objs), ...); }, p_saved);
+        options.set_save_crc(option == 0);
+        options.set_save_compact(option == 1);
+        options.set_save_alignment((option == 2) ? 64 : 1);
+        options.save_all_objs(name.c_str());
+        reset();
+        dynamic_load.load_all_objs(name.c_str());
+        CHECK(p_same());
+        thrown = false;
+        try {
+            static_load.load_all_objs(name.c_str());
+        } catch (int &e) {
+            thrown = true;
+        }
+        CHECK(thrown);
+    }
+    remove(name.c_str());
+    remove(dynamic_name.c_str());
+}
+
+/**
+ * Checks WY_StaticSerializeMgr with objects of constant size, whose file is loaded into a stack buffer, and with an object of varying size, whose file is loaded into a heap buffer.
+ * \param p_work Directory for temporary files.
+ */
+static void check_static(const std::string &p_work)
+{
+    C_PointObj point, loaded_point;
+    C_RangeObj range, loaded_range;
+    point.m_data = {3, 0xFFFFFFFF};
+    memset((void *)&range.m_data, 0, sizeof(range.m_data)); /* So the padding saved is the same every time. */
+    range.m_data.m_first = 10;
+    range.m_data.m_last = (uint64_t)1 << 40;
+    range.m_data.m_step = 7;
+    static_assert(WY_StaticSerializeMgr<C_PointObj, C_RangeObj>::m_fixed, "Constant size objects.");
+    check_static_objs<C_PointObj, C_RangeObj>(p_work, std::tie(point, range), std::tie(loaded_point, loaded_range), [&]() {
+        return (memcmp(&point.m_data, &loaded_point.m_data, sizeof(S_Point)) == 0) && (memcmp(&range.m_data, &loaded_range.m_data, sizeof(S_Range)) == 0);
+    });
+
+    C_DataObj data[2], loaded_data[2];
+    fill_objs(data, 2, 5);
+    data[1].m_data.resize(200000); /* Larger than m_stack_max. */
+    static_assert(!WY_StaticSerializeMgr<C_PointObj, C_DataObj, C_DataObj>::m_fixed, "An object of varying size.");
+    check_static_objs<C_PointObj, C_DataObj, C_DataObj>(p_work, std::tie(point, data[0], data[1]), std::tie(loaded_point, loaded_data[0], loaded_data[1]), [&]() {
+        return (memcmp(&point.m_data, &loaded_point.m_data, sizeof(S_Point)) == 0) && same_objs(data, loaded_data, 2);
+    });
+}
+
+
+void WY_SerializeCheck::check_mgr(const std::string &p_work)
+{
+    check_old_objs(p_work);
+    check_parallel_saves(p_work);
+    check_unsafe_loads(p_work);
+    check_async_saves(p_work);
+    check_sharded(p_work);
+    check_static(p_work);
+}
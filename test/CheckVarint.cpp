@@ -0,0 +1,109 @@
+/*
+* Copyright 2023 Au Yeong Wing Yau
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+/**
+ * \file CheckVarint.cpp
+ * Checks the varints of WY_SerializeVarint, and that the fast paths of decode_header() agree with decode_header_bytewise() on valid, corrupt and random headers.
+*/
+#include <random>
+#include "Check.hpp"
+#include "WY_SerializeVarint.hpp"
+
+using namespace WY_Serialize;
+using namespace WY_SerializeCheck;
+
+/**
+ * Gets a random value of a random bit length, so values of every varint length are equally likely.
+ * \param p_rng The random number generator.
+ * \param p_bits Largest bit length.
+ * \return The value.
+ */
+static uint64_t random_value(std::mt19937_64 &p_rng, const unsigned int p_bits)
+{
+    const unsigned int bits = p_rng() % (p_bits+1);
+    return (bits == 0) ? 0 : (p_rng() >> (64 - bits));
+}
+
+/**
+ * Decodes a header with both decode_header() and decode_header_bytewise() and checks that they agree. The header is copied to a buffer of exactly p_avail bytes, so a sanitizer build also finds reads past the end.
+ * \param p_src The header.
+ * \param p_avail Bytes available at p_src.
+ * \return Result of decode_header().
+ */
+static unsigned int check_decode(const unsigned char *p_src, const uint64_t p_avail)
+{
+    const std::vector<unsigned char> src(p_src, p_src+p_avail);
+    S_SerializeHeader fast = {0, 0, 0};
+    S_SerializeHeader bytewise = {0, 0, 0};
+    const unsigned int fast_size = WY_SerializeVarint::decode_header(src.data(), p_avail, &fast);
+    const unsigned int bytewise_size = WY_SerializeVarint::decode_header_bytewise(src.data(), p_avail, &bytewise);
+    CHECK(fast_size == bytewise_size);
+    if((fast_size != 0) && (fast_size == bytewise_size))
+        CHECK((fast.m_type == bytewise.m_type) && (fast.m_flags == bytewise.m_flags) && (fast.m_size == bytewise.m_size));
+    return fast_size;
+}
+
+
+void WY_SerializeCheck::check_varint()
+{
+    std::mt19937_64 rng(19);
+    unsigned char buffer[2*SERIALIZE_HEADER_MAX];
+
+    /* Single varints of every length, and their limits. */
+    for(unsigned int i=0; i<10000; i++) {
+        const uint64_t value = (i < 64) ? (1ULL << i) - 1 : random_value(rng, 64);
+        const unsigned int size = WY_SerializeVarint::encode(value, buffer);
+        uint64_t decoded = 0;
+        CHECK(size == WY_SerializeVarint::get_size(value));
+        CHECK((WY_SerializeVarint::decode(buffer, size, &decoded) == size) && (decoded == value));
+        CHECK(WY_SerializeVarint::decode(buffer, size-1, &decoded) == 0);
+    }
+    const unsigned char overlong[] = {0x80, 0x00};
+    const unsigned char overflow[] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x02};
+    uint64_t decoded;
+    CHECK(WY_SerializeVarint::decode(overlong, sizeof(overlong), &decoded) == 0);
+    CHECK(WY_SerializeVarint::decode(overflow, sizeof(overflow), &decoded) == 0);
+
+    /* Valid headers followed by random bytes, whole, cut short and with one byte changed. */
+    for(unsigned int i=0; i<100000; i++) {
+        S_SerializeHeader header = {(uint32_t)random_value(rng, 32), (uint32_t)random_value(rng, 32), random_value(rng, 64)};
+        for(unsigned char &byte : buffer)
+            byte = (unsigned char)rng();
+        const unsigned int size = WY_SerializeVarint::encode_header(buffer, &header);
+        CHECK(size == WY_SerializeVarint::get_header_size(&header));
+        const uint64_t avail = size + rng() % (sizeof(buffer) - size + 1);
+        S_SerializeHeader decoded_header;
+        CHECK(check_decode(buffer, avail) == size);
+        CHECK((WY_SerializeVarint::decode_header(buffer, avail, &decoded_header) == size) && (decoded_header.m_type == header.m_type) && (decoded_header.m_flags == header.m_flags) && (decoded_header.m_size == header.m_size));
+        CHECK(check_decode(buffer, rng() % size) == 0);
+        buffer[rng() % size] ^= (unsigned char)(1 << (rng() % 8));
+        check_decode(buffer, avail);
+    }
+
+    /* Random bytes, with the continuation bit set more or less often and many zero bytes, so all lengths and invalid encodings come up. */
+    const unsigned int continuation[] = {10, 50, 80, 95};
+    for(unsigned int i=0; i<200000; i++) {
+        const unsigned int percent = continuation[i % 4];
+        for(unsigned char &byte : buffer) {
+            const uint64_t bits = rng();
+            byte = (unsigned char)(((bits % 4) == 0) ? 0 : (bits >> 8) & 0x7F);
+            if(((bits >> 16) % 100) < percent)
+                byte |= 0x80;
+        }
+        check_decode(buffer, rng() % (sizeof(buffer)+1));
+    }
+}